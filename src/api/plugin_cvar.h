@@ -2,6 +2,7 @@
 #define CHUNKWM_PLUGIN_CVAR_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 struct cvar
 {
@@ -28,6 +29,38 @@ typedef CHUNKWM_API_FIND_CVAR_FUNC(chunkwm_find_cvar_func);
 #endif
 typedef CHUNKWM_API_LOG_FUNC(chunkwm_log);
 
+/*
+ * NOTE(koekeishiya): Read-only view of the window registry owned by chunkwm. Windows are
+ * identified by their CGWindowID, which is stable for the lifetime of the window. The epoch
+ * is incremented every time a window is added to or removed from the registry, so a plugin
+ * that remembers the epoch of its last view can tell whether anything has changed. Owners
+ * holds the pid of the application that owns each window, so that a plugin can select the
+ * windows of an application without copying every window.
+ */
+struct chunkwm_window_view
+{
+    uint64_t Epoch;
+    uint32_t *Ids;
+    int32_t *Owners;
+    uint32_t Count;
+};
+
+#define CHUNKWM_API_WINDOW_EPOCH_FUNC(name) uint64_t name()
+typedef CHUNKWM_API_WINDOW_EPOCH_FUNC(chunkwm_window_epoch_func);
+
+#define CHUNKWM_API_ACQUIRE_WINDOW_VIEW_FUNC(name) bool name(chunkwm_window_view *View, uint64_t Epoch)
+typedef CHUNKWM_API_ACQUIRE_WINDOW_VIEW_FUNC(chunkwm_acquire_window_view_func);
+
+#define CHUNKWM_API_RELEASE_WINDOW_VIEW_FUNC(name) void name(chunkwm_window_view *View)
+typedef CHUNKWM_API_RELEASE_WINDOW_VIEW_FUNC(chunkwm_release_window_view_func);
+
+struct macos_window;
+#define CHUNKWM_API_ACQUIRE_WINDOW_FUNC(name) macos_window *name(uint32_t WindowId)
+typedef CHUNKWM_API_ACQUIRE_WINDOW_FUNC(chunkwm_acquire_window_func);
+
+#define CHUNKWM_API_RELEASE_WINDOW_FUNC(name) void name(macos_window *Window)
+typedef CHUNKWM_API_RELEASE_WINDOW_FUNC(chunkwm_release_window_func);
+
 struct chunkwm_api
 {
     chunkwm_update_cvar_func *UpdateCVar;
@@ -35,6 +68,12 @@ struct chunkwm_api
     chunkwm_find_cvar_func *FindCVar;
     plugin_broadcast_func *Broadcast;
     chunkwm_log *Log;
+
+    chunkwm_window_epoch_func *WindowEpoch;
+    chunkwm_acquire_window_view_func *AcquireWindowView;
+    chunkwm_release_window_view_func *ReleaseWindowView;
+    chunkwm_acquire_window_func *AcquireWindow;
+    chunkwm_release_window_func *ReleaseWindow;
 };
 
 #endif
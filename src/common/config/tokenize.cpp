@@ -11,7 +11,7 @@
 bool TokenEquals(token Token, const char *Match)
 {
     const char *At = Match;
-    for (int Index = 0; Index < Token.Length; ++Index, ++At) {
+    for (unsigned Index = 0; Index < Token.Length; ++Index, ++At) {
         if ((*At == 0) || (Token.Text[Index] != *At)) {
             return false;
         }
@@ -58,7 +58,7 @@ unsigned TokenToUnsigned(token Token)
 
 bool TokenIsDigit(token Token)
 {
-    for (int Index = 0; Index < Token.Length; ++Index) {
+    for (unsigned Index = 0; Index < Token.Length; ++Index) {
         if (Token.Text[Index] < '0' || Token.Text[Index] > '9') {
             return false;
         }
@@ -90,7 +90,10 @@ token GetToken(const char **Data)
         }
         Token.Length = *Data - Token.Text;
 
-        ++(*Data);
+        // NOTE(koekeishiya): Do not go past the null-terminator of an unterminated string!
+        if (**Data == '"') {
+            ++(*Data);
+        }
     } else {
         Token.Text = *Data;
         while (**Data && !IsWhiteSpace(**Data)) {
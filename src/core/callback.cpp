@@ -428,7 +428,7 @@ CHUNKWM_CALLBACK(Callback_ChunkWM_WindowDestroyed)
 #else
     ProcessPluginListThreaded(chunkwm_export_window_destroyed, Window);
 #endif
-    AXLibDestroyWindow(Window);
+    ReleaseWindowAPI(Window);
 }
 
 CHUNKWM_CALLBACK(Callback_ChunkWM_WindowFocused)
@@ -19,7 +19,9 @@ internal pthread_mutex_t LoadedPluginLock;
 internal pthread_mutex_t Mutexes[chunkwm_export_count];
 internal plugin_list ExportedPlugins[chunkwm_export_count];
 
-internal chunkwm_api API = { UpdateCVarAPI,  AcquireCVarAPI, FindCVarAPI, ChunkwmBroadcast, (chunkwm_log*)c_log };
+internal chunkwm_api API = { UpdateCVarAPI,  AcquireCVarAPI, FindCVarAPI, ChunkwmBroadcast, (chunkwm_log*)c_log,
+                             WindowEpochAPI, AcquireWindowViewAPI, ReleaseWindowViewAPI,
+                             AcquireWindowAPI, ReleaseWindowAPI };
 
 internal bool
 VerifyPluginFormat(plugin_details *Info)
@@ -3,6 +3,8 @@
 #include "dispatch/event.h"
 #include "clog.h"
 
+#include "../api/plugin_cvar.h"
+
 #include "../common/accessibility/application.h"
 #include "../common/accessibility/window.h"
 #include "../common/accessibility/element.h"
@@ -22,10 +24,15 @@ typedef macos_application_map::iterator macos_application_map_it;
 typedef std::map<uint32_t, macos_window *> macos_window_map;
 typedef macos_window_map::iterator macos_window_map_it;
 
+typedef std::map<macos_window *, uint32_t> macos_window_reference_map;
+typedef macos_window_reference_map::iterator macos_window_reference_map_it;
+
 internal macos_application_map Applications;
 
 internal macos_window_map Windows;
 internal pthread_mutex_t WindowsLock;
+internal uint64_t WindowsEpoch;
+internal macos_window_reference_map WindowReferences;
 
 internal inline AXUIElementRef
 SystemWideElement()
@@ -98,6 +105,8 @@ bool AddWindowToCollection(macos_window *Window)
 
     pthread_mutex_lock(&WindowsLock);
     Windows[Window->Id] = Window;
+    WindowReferences[Window] = 1;
+    ++WindowsEpoch;
     pthread_mutex_unlock(&WindowsLock);
 
     goto out;
@@ -113,7 +122,9 @@ out:
 void RemoveWindowFromCollection(macos_window *Window)
 {
     pthread_mutex_lock(&WindowsLock);
-    Windows.erase(Window->Id);
+    if (Windows.erase(Window->Id)) {
+        ++WindowsEpoch;
+    }
     pthread_mutex_unlock(&WindowsLock);
 
     AXLibRemoveObserverNotification(&Window->Owner->Observer, Window->Ref, kAXUIElementDestroyedNotification);
@@ -123,14 +134,110 @@ void RemoveWindowFromCollection(macos_window *Window)
     AXLibRemoveObserverNotification(&Window->Owner->Observer, Window->Ref, kAXDrawerCreatedNotification);
 }
 
+// NOTE(koekeishiya): We pass a pointer to this function to every plugin as they are loaded.
+uint64_t WindowEpochAPI()
+{
+    pthread_mutex_lock(&WindowsLock);
+    uint64_t Result = WindowsEpoch;
+    pthread_mutex_unlock(&WindowsLock);
+    return Result;
+}
+
+/*
+ * NOTE(koekeishiya): We pass a pointer to this function to every plugin as they are loaded.
+ * If the registry has not changed since the given epoch, we return false and the view is
+ * left untouched. Otherwise the view receives the ids of every window in the registry, in
+ * ascending order, together with the pid of their owners, and must be released by the plugin
+ * when it is done with it. Both arrays share a single allocation.
+ */
+bool AcquireWindowViewAPI(chunkwm_window_view *View, uint64_t Epoch)
+{
+    bool Result = false;
+
+    pthread_mutex_lock(&WindowsLock);
+    if (WindowsEpoch == Epoch) goto out;
+
+    View->Epoch = WindowsEpoch;
+    View->Count = 0;
+    View->Ids = (uint32_t *) malloc((sizeof(uint32_t) + sizeof(int32_t)) * (Windows.size() + 1));
+    View->Owners = (int32_t *) (View->Ids + Windows.size() + 1);
+
+    for (macos_window_map_it It = Windows.begin(); It != Windows.end(); ++It) {
+        View->Ids[View->Count] = It->first;
+        View->Owners[View->Count] = It->second->Owner->PID;
+        ++View->Count;
+    }
+
+    Result = true;
+
+out:
+    pthread_mutex_unlock(&WindowsLock);
+    return Result;
+}
+
+// NOTE(koekeishiya): We pass a pointer to this function to every plugin as they are loaded.
+void ReleaseWindowViewAPI(chunkwm_window_view *View)
+{
+    free(View->Ids);
+    View->Ids = NULL;
+    View->Owners = NULL;
+    View->Count = 0;
+}
+
+/*
+ * NOTE(koekeishiya): We pass a pointer to this function to every plugin as they are loaded.
+ * Plugins share the windows in our registry instead of copying them. The registry holds one
+ * reference to a window for as long as the window is in it, and every plugin that acquires the
+ * window holds another. The window is destroyed when the last reference is released.
+ */
+macos_window *AcquireWindowAPI(uint32_t WindowId)
+{
+    macos_window *Result = NULL;
+
+    pthread_mutex_lock(&WindowsLock);
+    macos_window_map_it It = Windows.find(WindowId);
+    if (It != Windows.end()) {
+        Result = It->second;
+        ++WindowReferences[Result];
+    }
+    pthread_mutex_unlock(&WindowsLock);
+
+    return Result;
+}
+
+// NOTE(koekeishiya): We pass a pointer to this function to every plugin as they are loaded.
+void ReleaseWindowAPI(macos_window *Window)
+{
+    bool Destroy = false;
+
+    pthread_mutex_lock(&WindowsLock);
+    macos_window_reference_map_it It = WindowReferences.find(Window);
+    ASSERT(It != WindowReferences.end());
+    if (--It->second == 0) {
+        WindowReferences.erase(It);
+        Destroy = true;
+    }
+    pthread_mutex_unlock(&WindowsLock);
+
+    if (Destroy) {
+        AXLibDestroyWindow(Window);
+    }
+}
+
 // NOTE(koekeishiya): Caller is responsible for passing a valid window!
 void UpdateWindowTitle(macos_window *Window)
 {
-    if (Window->Name) {
-        free(Window->Name);
-    }
+    char *Name = AXLibGetWindowTitle(Window->Ref);
+
+    // NOTE(koekeishiya): Plugins share this window through AcquireWindowAPI.
+    pthread_mutex_lock(&WindowsLock);
+    char *Previous = Window->Name;
+    Window->Name = Name;
+    pthread_mutex_unlock(&WindowsLock);
 
-    Window->Name = AXLibGetWindowTitle(Window->Ref);
+    if (Previous) {
+        free(Previous);
+    }
 }
 
 /*
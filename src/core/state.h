@@ -8,6 +8,13 @@ bool AddWindowToCollection(macos_window *Window);
 void RemoveWindowFromCollection(macos_window *Window);
 void UpdateWindowCollection();
 
+struct chunkwm_window_view;
+uint64_t WindowEpochAPI();
+bool AcquireWindowViewAPI(chunkwm_window_view *View, uint64_t Epoch);
+void ReleaseWindowViewAPI(chunkwm_window_view *View);
+macos_window *AcquireWindowAPI(uint32_t WindowId);
+void ReleaseWindowAPI(macos_window *Window);
+
 void UpdateWindowTitle(macos_window *Window);
 
 struct macos_application;
@@ -55,16 +55,17 @@ PLUGIN_MAIN_FUNC(PluginMain)
 {
     if (StringsAreEqual(Node, "chunkwm_export_application_launched")) {
         macos_application *Application = (macos_application *) Data;
-        macos_window **WindowList = AXLibWindowListForApplication(Application);
-        if (WindowList) {
-            macos_window **List = WindowList;
-            macos_window *Window;
-            while ((Window = *List++)) {
-                ExtendedDockDisableWindowShadow(Window->Id);
-                AXLibDestroyWindow(Window);
+
+        // NOTE(koekeishiya): chunkwm has added the windows of the application to its registry.
+        chunkwm_window_view View;
+        if (API.AcquireWindowView(&View, 0)) {
+            for (uint32_t Index = 0; Index < View.Count; ++Index) {
+                if (View.Owners[Index] == Application->PID) {
+                    ExtendedDockDisableWindowShadow(View.Ids[Index]);
+                }
             }
 
-            free(WindowList);
+            API.ReleaseWindowView(&View);
         }
         return true;
     } else if (StringsAreEqual(Node, "chunkwm_export_window_created")) {
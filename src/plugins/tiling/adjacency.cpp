@@ -0,0 +1,130 @@
+#include "adjacency.h"
+#include "node.h"
+#include "vspace.h"
+
+#include "../../common/misc/profile.h"
+
+#include <math.h>
+
+#define internal static
+
+bool IsInDirection(directions Direction, float X1, float Y1, float W1, float H1,
+                   float X2, float Y2, float W2, float H2)
+{
+    bool Result = false;
+
+    switch (Direction) {
+    case Dir_North:
+    case Dir_South: {
+        Result = (Y1 != Y2) && (fmax(X1, X2) < fmin(X2 + W2, X1 + W1));
+    } break;
+    case Dir_East:
+    case Dir_West: {
+        Result = (X1 != X2) && (fmax(Y1, Y2) < fmin(Y2 + H2, Y1 + H1));
+    } break;
+    case Dir_Unknown: { /* NOTE(koekeishiya) compiler warning.. */ } break;
+    }
+
+    return Result;
+}
+
+float DirectionalDistance(directions Direction, float X1, float Y1, float X2, float Y2)
+{
+    float DeltaX    = X2 - X1;
+    float DeltaY    = Y2 - Y1;
+    float Angle     = atan2(DeltaY, DeltaX);
+    float Distance  = hypot(DeltaX, DeltaY);
+    float DeltaA    = 0;
+
+    switch (Direction) {
+    case Dir_North: {
+        if (DeltaY >= 0) return 0xFFFFFFFF;
+        DeltaA = -M_PI_2 - Angle;
+    } break;
+    case Dir_East: {
+        if (DeltaX <= 0) return 0xFFFFFFFF;
+        DeltaA = 0.0 - Angle;
+    } break;
+    case Dir_South: {
+        if (DeltaY <= 0) return 0xFFFFFFFF;
+        DeltaA = M_PI_2 - Angle;
+    } break;
+    case Dir_West: {
+        if (DeltaX >= 0) return 0xFFFFFFFF;
+        DeltaA = M_PI - fabs(Angle);
+    } break;
+    case Dir_Unknown: { /* NOTE(koekeishiya) compiler warning.. */ } break;
+    }
+
+    return (Distance / cos(DeltaA / 2.0));
+}
+
+internal inline bool
+IsAdjacencyCandidate(node *Node)
+{
+    bool Result = ((Node->WindowId != Node_Root) &&
+                   (Node->WindowId != (uint32_t) Node_PseudoLeaf));
+    return Result;
+}
+
+internal node *
+FindAdjacentNode(node *Tree, node *NodeA, directions Direction)
+{
+    BEGIN_TIMED_BLOCK();
+    node *Result = NULL;
+    float MinDist = 0xFFFFFFFF;
+
+    region *A = &NodeA->Region;
+    float X1 = A->X + A->Width / 2;
+    float Y1 = A->Y + A->Height / 2;
+
+    for (node *NodeB = GetFirstLeafNode(Tree); NodeB != NULL; NodeB = GetNextLeafNode(NodeB)) {
+        if ((NodeA == NodeB) || (!IsAdjacencyCandidate(NodeB))) continue;
+
+        region *B = &NodeB->Region;
+        if (IsInDirection(Direction,
+                          A->X, A->Y, A->Width, A->Height,
+                          B->X, B->Y, B->Width, B->Height)) {
+            float X2 = B->X + B->Width / 2;
+            float Y2 = B->Y + B->Height / 2;
+            float Dist = DirectionalDistance(Direction, X1, Y1, X2, Y2);
+            if (Dist < MinDist) {
+                MinDist = Dist;
+                Result = NodeB;
+            }
+        }
+    }
+
+    END_TIMED_BLOCK();
+    return Result;
+}
+
+// NOTE(koekeishiya): Nodes are zeroed when allocated, so generation 0 is never current.
+void InvalidateAdjacencyGraph(virtual_space *VirtualSpace)
+{
+    if (++VirtualSpace->AdjacencyGeneration == 0) {
+        VirtualSpace->AdjacencyGeneration = 1;
+    }
+}
+
+node *GetAdjacentNode(virtual_space *VirtualSpace, node *Node, directions Direction)
+{
+    if ((Direction == Dir_Unknown) ||
+        (!VirtualSpace->Tree) ||
+        (!IsAdjacencyCandidate(Node))) {
+        return NULL;
+    }
+
+    if (Node->AdjacencyGeneration != VirtualSpace->AdjacencyGeneration) {
+        Node->AdjacencyGeneration = VirtualSpace->AdjacencyGeneration;
+        Node->AdjacencyMask = 0;
+    }
+
+    uint32_t Slot = Direction - Dir_North;
+    if (!(Node->AdjacencyMask & (1 << Slot))) {
+        Node->Adjacent[Slot] = FindAdjacentNode(VirtualSpace->Tree, Node, Direction);
+        Node->AdjacencyMask |= (1 << Slot);
+    }
+
+    return Node->Adjacent[Slot];
+}
@@ -0,0 +1,34 @@
+#ifndef PLUGIN_ADJACENCY_H
+#define PLUGIN_ADJACENCY_H
+
+struct node;
+struct virtual_space;
+
+enum directions
+{
+    Dir_Unknown,
+    Dir_North,
+    Dir_East,
+    Dir_South,
+    Dir_West,
+};
+
+#define DIRECTION_COUNT 4
+
+/*
+ * NOTE(koekeishiya): Every leaf node in a bsp-tree caches its closest neighbour in each
+ * direction. The virtual_space bumps its adjacency generation whenever the region of a
+ * node changes or a node is released, which makes every cached neighbour stale at once.
+ * A neighbour is only computed when it is requested, by a single scan over the leaves,
+ * so a layout change followed by a directional command costs O(n). Directional commands
+ * issued between two layout changes are then simple lookups.
+ */
+
+bool IsInDirection(directions Direction, float X1, float Y1, float W1, float H1,
+                   float X2, float Y2, float W2, float H2);
+float DirectionalDistance(directions Direction, float X1, float Y1, float X2, float Y2);
+
+void InvalidateAdjacencyGraph(virtual_space *VirtualSpace);
+node *GetAdjacentNode(virtual_space *VirtualSpace, node *Node, directions Direction);
+
+#endif
@@ -0,0 +1,50 @@
+#include "backend.h"
+
+#include "../../common/misc/assert.h"
+
+#include <stdlib.h>
+
+#define internal static
+
+internal window_backend *WindowBackend;
+
+void SetWindowBackend(window_backend *Backend)
+{
+    WindowBackend = Backend;
+}
+
+window_backend *GetWindowBackend()
+{
+    ASSERT(WindowBackend);
+    return WindowBackend;
+}
+
+void BeginWindowFrameList(window_frame_list *List)
+{
+    List->Frames = NULL;
+    List->Count = 0;
+    List->Capacity = 0;
+}
+
+void WindowFrameListAdd(window_frame_list *List, uint32_t WindowId, region Region, bool Center)
+{
+    if (List->Count == List->Capacity) {
+        List->Capacity = List->Capacity ? List->Capacity * 2 : 16;
+        List->Frames = (window_frame *) realloc(List->Frames, sizeof(window_frame) * List->Capacity);
+    }
+
+    window_frame *Frame = List->Frames + List->Count++;
+    Frame->WindowId = WindowId;
+    Frame->Region = Region;
+    Frame->Center = Center;
+}
+
+void CommitWindowFrameList(window_frame_list *List)
+{
+    if (List->Count > 0) {
+        GetWindowBackend()->ApplyWindowFrames(List->Frames, List->Count);
+    }
+
+    free(List->Frames);
+    BeginWindowFrameList(List);
+}
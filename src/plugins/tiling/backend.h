@@ -0,0 +1,50 @@
+#ifndef PLUGIN_BACKEND_H
+#define PLUGIN_BACKEND_H
+
+#include <stdint.h>
+
+#include "region.h"
+
+struct macos_space;
+struct presel_window;
+
+struct window_frame
+{
+    uint32_t WindowId;
+    region Region;
+    bool Center;
+};
+
+/*
+ * NOTE(koekeishiya): The frames requested during a layout pass are collected in a
+ * window_frame_list, and handed to the window backend in a single call once the
+ * pass is complete.
+ */
+struct window_frame_list
+{
+    window_frame *Frames;
+    uint32_t Count;
+    uint32_t Capacity;
+};
+
+/*
+ * NOTE(koekeishiya): Everything the layout code needs from the platform. The tree,
+ * region and serialization code only reaches the windowing system through this
+ * interface, and does not include any platform headers, so that it can be built
+ * and profiled on its own.
+ */
+struct window_backend
+{
+    region (*SpaceRegion)(macos_space *Space);
+    void (*ApplyWindowFrames)(window_frame *Frames, uint32_t Count);
+    void (*DestroyPreselBorder)(presel_window *Border);
+};
+
+void SetWindowBackend(window_backend *Backend);
+window_backend *GetWindowBackend();
+
+void BeginWindowFrameList(window_frame_list *List);
+void WindowFrameListAdd(window_frame_list *List, uint32_t WindowId, region Region, bool Center);
+void CommitWindowFrameList(window_frame_list *List);
+
+#endif
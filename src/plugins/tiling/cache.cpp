@@ -0,0 +1,135 @@
+#include "cache.h"
+
+#include "../../common/misc/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+
+#define internal static
+
+internal window_snapshot *volatile CurrentSnapshot;
+internal window_cache_release_func *ReleaseRetiredWindow;
+
+/*
+ * NOTE(koekeishiya): Readers only enter the epoch while they take a reference to the
+ * current snapshot, which is a handful of instructions. A writer that replaces the
+ * snapshot advances the epoch, and waits for the readers of the previous epoch to leave
+ * before it drops the reference that the cache holds on the old snapshot.
+ */
+internal volatile uint32_t SnapshotEpoch;
+internal volatile uint32_t SnapshotReaders[2];
+
+internal window_snapshot *
+AllocateWindowSnapshot(macos_window **Windows, uint32_t Count)
+{
+    window_snapshot *Snapshot = (window_snapshot *) malloc(sizeof(window_snapshot) + sizeof(macos_window *) * Count);
+    memset(Snapshot, 0, sizeof(window_snapshot));
+
+    Snapshot->References = 1;
+    Snapshot->Windows = (macos_window **) (Snapshot + 1);
+    Snapshot->Count = Count;
+
+    if (Count) {
+        memcpy(Snapshot->Windows, Windows, sizeof(macos_window *) * Count);
+    }
+
+    return Snapshot;
+}
+
+internal inline window_snapshot *
+RetainWindowSnapshot(window_snapshot *Snapshot)
+{
+    __sync_add_and_fetch(&Snapshot->References, 1);
+    return Snapshot;
+}
+
+void ReleaseWindowSnapshot(window_snapshot *Snapshot)
+{
+    while ((Snapshot) && (__sync_sub_and_fetch(&Snapshot->References, 1) == 0)) {
+        window_snapshot *Next = Snapshot->Next;
+
+        for (uint32_t Index = 0; Index < Snapshot->RetiredCount; ++Index) {
+            ReleaseRetiredWindow(Snapshot->Retired[Index]);
+        }
+
+        free(Snapshot->Retired);
+        free(Snapshot);
+        Snapshot = Next;
+    }
+}
+
+window_snapshot *AcquireWindowSnapshot()
+{
+    uint32_t Epoch;
+
+    while (1) {
+        Epoch = SnapshotEpoch;
+        __sync_add_and_fetch(&SnapshotReaders[Epoch & 1], 1);
+        if (Epoch == SnapshotEpoch) break;
+        __sync_sub_and_fetch(&SnapshotReaders[Epoch & 1], 1);
+    }
+
+    window_snapshot *Result = RetainWindowSnapshot(CurrentSnapshot);
+    __sync_sub_and_fetch(&SnapshotReaders[Epoch & 1], 1);
+
+    return Result;
+}
+
+internal void
+SynchronizeWindowSnapshot()
+{
+    uint32_t Epoch = SnapshotEpoch;
+    __sync_synchronize();
+    SnapshotEpoch = Epoch + 1;
+    __sync_synchronize();
+
+    while (SnapshotReaders[Epoch & 1] != 0) {
+        sched_yield();
+    }
+}
+
+void PublishWindowSnapshot(macos_window **Windows, uint32_t Count)
+{
+    window_snapshot *Snapshot = AllocateWindowSnapshot(Windows, Count);
+    window_snapshot *Previous = CurrentSnapshot;
+
+    if (Previous) {
+        Previous->Next = RetainWindowSnapshot(Snapshot);
+    }
+
+    __sync_synchronize();
+    CurrentSnapshot = Snapshot;
+
+    SynchronizeWindowSnapshot();
+    ReleaseWindowSnapshot(Previous);
+}
+
+void RetireWindow(macos_window *Window)
+{
+    window_snapshot *Snapshot = CurrentSnapshot;
+    ASSERT(Snapshot);
+
+    if (Snapshot->RetiredCount == Snapshot->RetiredCapacity) {
+        Snapshot->RetiredCapacity = Snapshot->RetiredCapacity ? Snapshot->RetiredCapacity * 2 : 8;
+        Snapshot->Retired = (macos_window **) realloc(Snapshot->Retired, sizeof(macos_window *) * Snapshot->RetiredCapacity);
+    }
+
+    Snapshot->Retired[Snapshot->RetiredCount++] = Window;
+}
+
+bool BeginWindowCache(window_cache_release_func *Release)
+{
+    ReleaseRetiredWindow = Release;
+    SnapshotEpoch = 0;
+    SnapshotReaders[0] = SnapshotReaders[1] = 0;
+    CurrentSnapshot = AllocateWindowSnapshot(NULL, 0);
+    return true;
+}
+
+void EndWindowCache()
+{
+    window_snapshot *Snapshot = CurrentSnapshot;
+    CurrentSnapshot = NULL;
+    ReleaseWindowSnapshot(Snapshot);
+}
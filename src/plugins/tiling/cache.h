@@ -0,0 +1,45 @@
+#ifndef PLUGIN_CACHE_H
+#define PLUGIN_CACHE_H
+
+#include <stdint.h>
+
+struct macos_window;
+
+/*
+ * NOTE(koekeishiya): An immutable array of the windows we track. A new snapshot is
+ * published every time a window is added to or removed from our collection, and code
+ * that has to visit every window iterates the current snapshot without taking a lock
+ * or allocating memory. Writers never wait for an iteration to finish.
+ *
+ * A snapshot holds a reference to the snapshot that replaced it, so a snapshot is only
+ * freed after every older snapshot is gone. Windows that are removed from the collection
+ * are retired on the current snapshot, and released when that snapshot is freed; by then
+ * no snapshot that contains them can be in use.
+ */
+struct window_snapshot
+{
+    uint32_t References;
+    window_snapshot *Next;
+
+    macos_window **Retired;
+    uint32_t RetiredCount;
+    uint32_t RetiredCapacity;
+
+    macos_window **Windows;
+    uint32_t Count;
+};
+
+#define WINDOW_CACHE_RELEASE_FUNC(name) void name(macos_window *Window)
+typedef WINDOW_CACHE_RELEASE_FUNC(window_cache_release_func);
+
+bool BeginWindowCache(window_cache_release_func *Release);
+void EndWindowCache();
+
+// NOTE(koekeishiya): The following functions must be called with the window collection locked.
+void PublishWindowSnapshot(macos_window **Windows, uint32_t Count);
+void RetireWindow(macos_window *Window);
+
+window_snapshot *AcquireWindowSnapshot();
+void ReleaseWindowSnapshot(window_snapshot *Snapshot);
+
+#endif
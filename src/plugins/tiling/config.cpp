@@ -1,6 +1,7 @@
 #include "config.h"
 #include "vspace.h"
 #include "node.h"
+#include "macos.h"
 #include "controller.h"
 #include "rule.h"
 #include "constants.h"
@@ -10,78 +11,402 @@
 #include "../../common/config/tokenize.h"
 #include "../../common/config/cvar.h"
 #include "../../common/misc/assert.h"
+#include "../../common/misc/profile.h"
 
 #include <CoreFoundation/CFString.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
-#include <getopt.h>
+#include <limits.h>
+#include <math.h>
 
+#define internal static
 #define local_persist static
+#define ArrayCount(Array) (sizeof(Array) / sizeof((Array)[0]))
 
-inline char **
-BuildArguments(const char *Message, int *Count)
+enum command_arg_type
 {
-    char **Args = (char **) malloc(16 * sizeof(char *));
-    *Count = 1;
+    Command_Arg_None     = 0,
+    Command_Arg_Selector = (1 << 0),
+    Command_Arg_Integer  = (1 << 1),
+    Command_Arg_Float    = (1 << 2),
+    Command_Arg_Grid     = (1 << 3),
+    Command_Arg_String   = (1 << 4),
+};
+
+struct command_option
+{
+    const char *Long;
+    char Short;
+    uint32_t Type;
+    const char **Selectors;
+};
+
+struct command_grammar
+{
+    const char *Name;
+    const command_option *Options;
+    size_t Count;
+};
+
+/*
+ * NOTE(koekeishiya): A parsed message. Arguments point into 'Buffer', which is the
+ * only allocation made while parsing; every token is null-terminated in place.
+ * Nothing here is shared between calls, so parsing is safe from any thread.
+ *
+ * 'Type' is the single argument type that matched, and only the field belonging
+ * to it is set. 'Selector' points to the entry in the grammar's selector table.
+ */
+#define COMMAND_LIST_MAX 32
+struct command
+{
+    char Flag;
+    uint32_t Type;
+    char *Arg;
+    const char *Selector;
+    int Integer;
+    float Float;
+};
+
+struct command_list
+{
+    char *Buffer;
+    int Count;
+    command Commands[COMMAND_LIST_MAX];
+};
+
+internal const char *WindowSelectors[] = { "biggest", "west", "east", "north", "south", "prev", "next", NULL };
+internal const char *DirectionSelectors[] = { "west", "east", "north", "south", NULL };
+internal const char *InsertionSelectors[] = { "west", "east", "north", "south", "cancel", NULL };
+internal const char *ToggleSelectors[] = { "float", "fade", "split", "sticky", "fullscreen", "native-fullscreen", "parent", NULL };
+internal const char *CycleSelectors[] = { "prev", "next", NULL };
+internal const char *RotateSelectors[] = { "90", "180", "270", NULL };
+internal const char *LayoutSelectors[] = { "bsp", "monocle", "float", NULL };
+internal const char *SpaceToggleSelectors[] = { "offset", NULL };
+internal const char *MirrorSelectors[] = { "vertical", "horizontal", NULL };
+internal const char *AdjustSelectors[] = { "inc", "dec", NULL };
+internal const char *QueryWindowSelectors[] = { "id", "owner", "name", "tag", "float", NULL };
+internal const char *QueryDesktopSelectors[] = { "id", "mode", "uuid", "windows", "monocle-index", "monocle-count", NULL };
+internal const char *QueryMonitorSelectors[] = { "id", "count", NULL };
+
+internal const command_option WindowOptions[] =
+{
+    // NOTE(koekeishiya): The '-f', '-s', '-w' flag support the same arguments, '-f' also accepts a window id.
+    { "focus",               'f', Command_Arg_Selector | Command_Arg_Integer, WindowSelectors },
+    { "swap",                's', Command_Arg_Selector,                       WindowSelectors },
+    { "use-insertion-point", 'i', Command_Arg_Selector,                       InsertionSelectors },
+    { "toggle",              't', Command_Arg_Selector,                       ToggleSelectors },
+    { "warp",                'w', Command_Arg_Selector,                       WindowSelectors },
+    { "use-temporary-ratio", 'r', Command_Arg_Float,                          NULL },
+    { "adjust-window-edge",  'e', Command_Arg_Selector,                       DirectionSelectors },
+    { "send-to-desktop",     'd', Command_Arg_Selector | Command_Arg_Integer, CycleSelectors },
+    { "send-to-monitor",     'm', Command_Arg_Selector | Command_Arg_Integer, CycleSelectors },
+    { "close",               'c', Command_Arg_None,                           NULL },
+    { "grid-layout",         'g', Command_Arg_Grid,                           NULL },
+};
+
+internal const command_option SpaceOptions[] =
+{
+    { "rotate",      'r', Command_Arg_Selector,                       RotateSelectors },
+    { "layout",      'l', Command_Arg_Selector,                       LayoutSelectors },
+    { "toggle",      't', Command_Arg_Selector,                       SpaceToggleSelectors },
+    { "mirror",      'm', Command_Arg_Selector,                       MirrorSelectors },
+    { "padding",     'p', Command_Arg_Selector,                       AdjustSelectors },
+    { "gap",         'g', Command_Arg_Selector,                       AdjustSelectors },
+    { "equalize",    'e', Command_Arg_None,                           NULL },
+    { "serialize",   's', Command_Arg_String,                         NULL },
+    { "deserialize", 'd', Command_Arg_String,                         NULL },
+    { "undo",        'u', Command_Arg_None,                           NULL },
+    { "redo",        'R', Command_Arg_None,                           NULL },
+    { "focus",       'f', Command_Arg_Selector | Command_Arg_Integer, CycleSelectors },
+    { "create",      'c', Command_Arg_None,                           NULL },
+    { "annihilate",  'a', Command_Arg_None,                           NULL },
+    { "move",        'M', Command_Arg_Selector | Command_Arg_Integer, CycleSelectors },
+};
+
+internal const command_option MonitorOptions[] =
+{
+    { "focus", 'f', Command_Arg_Selector | Command_Arg_Integer, CycleSelectors },
+};
+
+internal const command_option QueryOptions[] =
+{
+    { "window",               'w', Command_Arg_Selector | Command_Arg_Integer, QueryWindowSelectors },
+    { "desktop",              'd', Command_Arg_Selector,                       QueryDesktopSelectors },
+    { "monitor",              'm', Command_Arg_Selector,                       QueryMonitorSelectors },
+    { "windows-for-desktop",  'W', Command_Arg_Integer,                        NULL },
+    { "desktops-for-monitor", 'D', Command_Arg_Integer,                        NULL },
+    { "monitor-for-desktop",  'M', Command_Arg_Integer,                        NULL },
+};
+
+internal const command_option RuleOptions[] =
+{
+    { "owner",          'o', Command_Arg_String, NULL },
+    { "name",           'n', Command_Arg_String, NULL },
+    { "role",           'r', Command_Arg_String, NULL },
+    { "subrole",        'R', Command_Arg_String, NULL },
+    { "except",         'e', Command_Arg_String, NULL },
+    { "state",          's', Command_Arg_String, NULL },
+    { "desktop",        'd', Command_Arg_String, NULL },
+    { "monitor",        'm', Command_Arg_String, NULL },
+    { "follow-desktop", 'D', Command_Arg_None,   NULL },
+    { "level",          'l', Command_Arg_String, NULL },
+    { "alpha",          'a', Command_Arg_String, NULL },
+    { "grid-layout",    'g', Command_Arg_String, NULL },
+};
 
-    while (*Message) {
-        token ArgToken = GetToken(&Message);
-        char *Arg = TokenToString(ArgToken);
-        Args[(*Count)++] = Arg;
+internal const command_grammar WindowGrammar = { "window", WindowOptions, ArrayCount(WindowOptions) };
+internal const command_grammar SpaceGrammar = { "desktop", SpaceOptions, ArrayCount(SpaceOptions) };
+internal const command_grammar MonitorGrammar = { "monitor", MonitorOptions, ArrayCount(MonitorOptions) };
+internal const command_grammar QueryGrammar = { "query", QueryOptions, ArrayCount(QueryOptions) };
+internal const command_grammar RuleGrammar = { "rule", RuleOptions, ArrayCount(RuleOptions) };
+
+internal const command_option *
+FindShortOption(const command_grammar *Grammar, char Flag)
+{
+    for (size_t Index = 0; Index < Grammar->Count; ++Index) {
+        if (Grammar->Options[Index].Short == Flag) {
+            return &Grammar->Options[Index];
+        }
     }
 
-#if 0
-    for (int Index = 1; Index < *Count; ++Index) {
-        c_log(C_LOG_LEVEL_DEBUG, "%d arg '%s'\n", Index, Args[Index]);
+    return NULL;
+}
+
+/*
+ * NOTE(koekeishiya): Long options may be abbreviated as long as the prefix
+ * is unambiguous, same as getopt_long used to allow.
+ */
+internal const command_option *
+FindLongOption(const command_grammar *Grammar, const char *Name, size_t Length)
+{
+    const command_option *Result = NULL;
+    for (size_t Index = 0; Index < Grammar->Count; ++Index) {
+        const command_option *Option = &Grammar->Options[Index];
+        if (strncmp(Option->Long, Name, Length) != 0) {
+            continue;
+        }
+
+        if (Option->Long[Length] == '\0') {
+            return Option;
+        }
+
+        if (Result) {
+            return NULL;
+        }
+
+        Result = Option;
     }
-#endif
 
-    return Args;
+    return Result;
 }
 
-inline void
-FreeArguments(int Count, char **Args)
+internal bool
+ParseInteger(const char *Arg, int *Integer)
 {
-    for (int Index = 1; Index < Count; ++Index) {
-        free(Args[Index]);
+    char *End;
+    long Value = strtol(Arg, &End, 10);
+    if (End == Arg || *End != '\0' || Value < INT_MIN || Value > INT_MAX) {
+        return false;
     }
-    free(Args);
+
+    *Integer = (int) Value;
+    return true;
 }
 
-struct command
+internal bool
+ParseFloat(const char *Arg, float *Float)
 {
-    char Flag;
-    char *Arg;
-    struct command *Next;
-};
+    char *End;
+    float Value = strtof(Arg, &End);
+    if (End == Arg || *End != '\0' || !isfinite(Value)) {
+        return false;
+    }
 
-inline void
-FreeCommandChain(command *Chain)
-{
-    command *Command = Chain->Next;
-    while (Command) {
-        command *Next = Command->Next;
-        free(Command->Arg);
-        free(Command);
-        Command = Next;
+    *Float = Value;
+    return true;
+}
+
+/*
+ * NOTE(koekeishiya): Option types are tried in the order they are declared, so an
+ * argument that is both a valid selector and a number (e.g. '90' for rotate) is a selector.
+ */
+internal bool
+ParseArgument(const command_option *Option, char *Arg, command *Command)
+{
+    if ((Option->Type & Command_Arg_Selector) && Option->Selectors) {
+        for (const char **Selector = Option->Selectors; *Selector; ++Selector) {
+            if (StringEquals(Arg, *Selector)) {
+                Command->Type = Command_Arg_Selector;
+                Command->Selector = *Selector;
+                return true;
+            }
+        }
+    }
+
+    if ((Option->Type & Command_Arg_Integer) && ParseInteger(Arg, &Command->Integer)) {
+        Command->Type = Command_Arg_Integer;
+        return true;
     }
+
+    if ((Option->Type & Command_Arg_Float) && ParseFloat(Arg, &Command->Float)) {
+        Command->Type = Command_Arg_Float;
+        return true;
+    }
+
+    if (Option->Type & Command_Arg_Grid) {
+        int Integer;
+        if (sscanf(Arg, "%d:%d:%d:%d:%d:%d", &Integer, &Integer, &Integer, &Integer, &Integer, &Integer) == 6) {
+            Command->Type = Command_Arg_Grid;
+            return true;
+        }
+    }
+
+    if ((Option->Type & Command_Arg_String) && *Arg != '\0') {
+        Command->Type = Command_Arg_String;
+        return true;
+    }
+
+    return false;
+}
+
+internal inline char *
+NextArgument(const char **Cursor)
+{
+    while (**Cursor) {
+        token Token = GetToken(Cursor);
+        if (Token.Length == 0) {
+            continue;
+        }
+
+        // NOTE(koekeishiya): GetToken has already moved past the delimiter,
+        // so the token can be terminated in place.
+        char *Arg = (char *) Token.Text;
+        Arg[Token.Length] = '\0';
+        return Arg;
+    }
+
+    return NULL;
 }
 
-inline command *
-ConstructCommand(char Flag, char *Arg)
+internal bool
+PushCommand(const command_grammar *Grammar, command_list *List,
+            const command_option *Option, char *Arg)
 {
-    command *Command = (command *) malloc(sizeof(command));
+    if (List->Count == COMMAND_LIST_MAX) {
+        c_log(C_LOG_LEVEL_WARN, "    too many flags for %s command, max is %d\n", Grammar->Name, COMMAND_LIST_MAX);
+        return false;
+    }
+
+    command *Command = &List->Commands[List->Count];
+    memset(Command, 0, sizeof(command));
+
+    if (Option->Type != Command_Arg_None) {
+        if (!Arg) {
+            c_log(C_LOG_LEVEL_WARN, "    missing selector for %s flag '%c'\n", Grammar->Name, Option->Short);
+            return false;
+        }
+
+        if (!ParseArgument(Option, Arg, Command)) {
+            c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for %s flag '%c'\n", Arg, Grammar->Name, Option->Short);
+            return false;
+        }
+    }
 
-    Command->Flag = Flag;
-    Command->Arg = Arg ? strdup(Arg) : NULL;
-    Command->Next = NULL;
+    Command->Flag = Option->Short;
+    Command->Arg = Arg;
+    ++List->Count;
+    return true;
+}
 
-    return Command;
+inline void
+FreeCommandList(command_list *List)
+{
+    free(List->Buffer);
+    List->Buffer = NULL;
+    List->Count = 0;
+}
+
+/*
+ * NOTE(koekeishiya): Accepts the same syntax as getopt_long did;
+ * '-f west', '-fwest', '--focus west', '--focus=west' and grouped
+ * flags that take no argument, e.g '-ec'.
+ */
+internal bool
+ParseCommand(const command_grammar *Grammar, const char *Message, command_list *List)
+{
+    List->Count = 0;
+    List->Buffer = strdup(Message);
+
+    const char *Cursor = List->Buffer;
+    char *Arg;
+
+    while ((Arg = NextArgument(&Cursor))) {
+        if (Arg[0] != '-' || Arg[1] == '\0') {
+            c_log(C_LOG_LEVEL_WARN, "    unexpected argument '%s' for %s command\n", Arg, Grammar->Name);
+            goto err;
+        }
+
+        if (Arg[1] == '-') {
+            char *Name = Arg + 2;
+            char *Value = strchr(Name, '=');
+            size_t Length = Value ? Value - Name : strlen(Name);
+
+            const command_option *Option = FindLongOption(Grammar, Name, Length);
+            if (!Option) {
+                c_log(C_LOG_LEVEL_WARN, "    unknown or ambiguous option '%s' for %s command\n", Arg, Grammar->Name);
+                goto err;
+            }
+
+            if (Option->Type == Command_Arg_None) {
+                if (Value) {
+                    c_log(C_LOG_LEVEL_WARN, "    %s flag '%c' takes no selector\n", Grammar->Name, Option->Short);
+                    goto err;
+                }
+            } else {
+                Value = Value ? Value + 1 : NextArgument(&Cursor);
+            }
+
+            if (!PushCommand(Grammar, List, Option, Value)) {
+                goto err;
+            }
+        } else {
+            for (char *Flag = Arg + 1; *Flag; ++Flag) {
+                const command_option *Option = FindShortOption(Grammar, *Flag);
+                if (!Option) {
+                    c_log(C_LOG_LEVEL_WARN, "    unknown option '-%c' for %s command\n", *Flag, Grammar->Name);
+                    goto err;
+                }
+
+                if (Option->Type == Command_Arg_None) {
+                    if (!PushCommand(Grammar, List, Option, NULL)) {
+                        goto err;
+                    }
+                    continue;
+                }
+
+                char *Value = Flag[1] ? Flag + 1 : NextArgument(&Cursor);
+                if (!PushCommand(Grammar, List, Option, Value)) {
+                    goto err;
+                }
+                break;
+            }
+        }
+    }
+
+    return true;
+
+err:
+    FreeCommandList(List);
+    return false;
 }
 
 typedef void (*query_func)(char *, int);
+typedef void (*integer_query_func)(int, int);
 typedef void (*command_func)(char *);
+typedef void (*integer_command_func)(int);
+typedef void (*float_command_func)(float);
+
 command_func WindowCommandDispatch(char Flag)
 {
     switch (Flag) {
@@ -90,7 +415,6 @@ command_func WindowCommandDispatch(char Flag)
     case 'i': return UseInsertionPoint;     break;
     case 't': return ToggleWindow;          break;
     case 'w': return WarpWindow;            break;
-    case 'r': return TemporaryRatio;        break;
     case 'e': return AdjustWindowRatio;     break;
     case 'd': return SendWindowToDesktop;   break;
     case 'm': return SendWindowToMonitor;   break;
@@ -102,187 +426,6 @@ command_func WindowCommandDispatch(char Flag)
     }
 }
 
-inline bool
-ParseWindowCommand(const char *Message, command *Chain)
-{
-    int Count;
-    char **Args = BuildArguments(Message, &Count);
-
-    int Option;
-    bool Success = true;
-    const char *Short = "f:s:i:t:w:r:e:d:m:cg:";
-
-    struct option Long[] = {
-        { "focus", required_argument, NULL, 'f' },
-        { "swap", required_argument, NULL, 's' },
-        { "use-insertion-point", required_argument, NULL, 'i' },
-        { "toggle", required_argument, NULL, 't' },
-        { "warp", required_argument, NULL, 'w' },
-        { "use-temporary-ratio", required_argument, NULL, 'r' },
-        { "adjust-window-edge", required_argument, NULL, 'e' },
-        { "send-to-desktop", required_argument, NULL, 'd' },
-        { "send-to-monitor", required_argument, NULL, 'm' },
-        { "close", no_argument, NULL, 'c' },
-        { "grid-layout", required_argument, NULL, 'g' },
-        { NULL, 0, NULL, 0 }
-    };
-
-    command *Command = Chain;
-    while ((Option = getopt_long(Count, Args, Short, Long, NULL)) != -1) {
-        switch (Option) {
-        // NOTE(koekeishiya): The '-f', '-s', '-w' flag support the same arguments.
-        case 'f': {
-            uint32_t WindowId;
-            if ((StringEquals(optarg, "biggest")) ||
-                (StringEquals(optarg, "west")) ||
-                (StringEquals(optarg, "east")) ||
-                (StringEquals(optarg, "north")) ||
-                (StringEquals(optarg, "south")) ||
-                (StringEquals(optarg, "prev")) ||
-                (StringEquals(optarg, "next")) ||
-                (sscanf(optarg, "%d", &WindowId) == 1)) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 's':
-        case 'w': {
-            if ((StringEquals(optarg, "biggest")) ||
-                (StringEquals(optarg, "west")) ||
-                (StringEquals(optarg, "east")) ||
-                (StringEquals(optarg, "north")) ||
-                (StringEquals(optarg, "south")) ||
-                (StringEquals(optarg, "prev")) ||
-                (StringEquals(optarg, "next"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'e': {
-            if ((StringEquals(optarg, "west")) ||
-                (StringEquals(optarg, "east")) ||
-                (StringEquals(optarg, "north")) ||
-                (StringEquals(optarg, "south"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'i': {
-            if ((StringEquals(optarg, "west")) ||
-                (StringEquals(optarg, "east")) ||
-                (StringEquals(optarg, "north")) ||
-                (StringEquals(optarg, "south")) ||
-                (StringEquals(optarg, "cancel"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'r': {
-            float Float;
-            if (sscanf(optarg, "%f", &Float) == 1) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 't': {
-            if ((StringEquals(optarg, "float")) ||
-                (StringEquals(optarg, "fade")) ||
-                (StringEquals(optarg, "split")) ||
-                (StringEquals(optarg, "sticky")) ||
-                (StringEquals(optarg, "fullscreen")) ||
-                (StringEquals(optarg, "native-fullscreen")) ||
-                (StringEquals(optarg, "parent"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'd':
-        case 'm': {
-            unsigned Unsigned;
-            if ((StringEquals(optarg, "prev")) ||
-                (StringEquals(optarg, "next")) ||
-                (sscanf(optarg, "%d", &Unsigned) == 1)) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'c': {
-                // NOTE(koekeishiya): This option takes no arguments
-                command *Entry = ConstructCommand(Option, NULL);
-                Command->Next = Entry;
-                Command = Entry;
-        } break;
-        case 'g': {
-            unsigned Unsigned;
-            if ((sscanf(optarg, "%d:%d:%d:%d:%d:%d", &Unsigned, &Unsigned, &Unsigned, &Unsigned, &Unsigned, &Unsigned) == 6)) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case '?': {
-            Success = false;
-            FreeCommandChain(Chain);
-            goto End;
-        } break;
-        }
-    }
-
-End:
-    // NOTE(koekeishiya): Reset getopt.
-    optind = 1;
-
-    FreeArguments(Count, Args);
-    return Success;
-}
-
 command_func SpaceCommandDispatch(char Flag)
 {
     switch (Flag) {
@@ -295,6 +438,8 @@ command_func SpaceCommandDispatch(char Flag)
     case 'e': return EqualizeWindowTree;     break;
     case 's': return SerializeDesktop;       break;
     case 'd': return DeserializeDesktop;     break;
+    case 'u': return UndoDesktop;            break;
+    case 'R': return RedoDesktop;            break;
     case 'f': return FocusDesktop;           break;
     case 'c': return CreateDesktop;          break;
     case 'a': return DestroyDesktop;         break;
@@ -305,209 +450,49 @@ command_func SpaceCommandDispatch(char Flag)
     }
 }
 
-inline bool
-ParseSpaceCommand(const char *Message, command *Chain)
+/*
+ * NOTE(koekeishiya): Numeric arguments are handed over as parsed by ParseCommand.
+ * A flag without an entry here receives the argument text instead.
+ */
+integer_command_func WindowIntegerCommandDispatch(char Flag)
 {
-    int Count;
-    char **Args = BuildArguments(Message, &Count);
+    switch (Flag) {
+    case 'f': return FocusWindow; break;
 
-    int Option;
-    bool Success = true;
-    const char *Short = "r:l:t:m:p:g:ef:caM:";
-
-    struct option Long[] = {
-        { "rotate", required_argument, NULL, 'r' },
-        { "layout", required_argument, NULL, 'l' },
-        { "toggle", required_argument, NULL, 't' },
-        { "mirror", required_argument, NULL, 'm' },
-        { "padding", required_argument, NULL, 'p' },
-        { "gap", required_argument, NULL, 'g' },
-        { "equalize", no_argument, NULL, 'e' },
-        { "serialize", required_argument, NULL, 's' },
-        { "deserialize", required_argument, NULL, 'd' },
-        { "focus", required_argument, NULL, 'f' },
-        { "create", no_argument, NULL, 'c' },
-        { "annihilate", no_argument, NULL, 'a' },
-        { "move", required_argument, NULL, 'M' },
-        { NULL, 0, NULL, 0 }
-    };
-
-    command *Command = Chain;
-    while ((Option = getopt_long(Count, Args, Short, Long, NULL)) != -1) {
-        switch (Option) {
-        case 'f':
-        case 'M': {
-            unsigned Unsigned;
-            if ((StringEquals(optarg, "prev")) ||
-                (StringEquals(optarg, "next")) ||
-                (sscanf(optarg, "%d", &Unsigned) == 1)) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for desktop flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'r': {
-            if ((StringEquals(optarg, "90")) ||
-                (StringEquals(optarg, "180")) ||
-                (StringEquals(optarg, "270"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for desktop flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'l': {
-            if ((StringEquals(optarg, "bsp")) ||
-                (StringEquals(optarg, "monocle")) ||
-                (StringEquals(optarg, "float"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for desktop flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 't': {
-            if ((StringEquals(optarg, "offset"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for desktop flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'm': {
-            if ((StringEquals(optarg, "vertical")) ||
-                (StringEquals(optarg, "horizontal"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for desktop flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'p':
-        case 'g': {
-            if ((StringEquals(optarg, "inc")) ||
-                (StringEquals(optarg, "dec"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for desktop flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'c':
-        case 'a':
-        case 'e': {
-            // NOTE(koekeishiya): These options take no arguments
-            command *Entry = ConstructCommand(Option, NULL);
-            Command->Next = Entry;
-            Command = Entry;
-        } break;
-        case 's':
-        case 'd': {
-            // NOTE(koekeishiya): This option takes a filepath as argument
-            if (optarg) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    missing selector for desktop flag '%c'\n", Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case '?': {
-            Success = false;
-            FreeCommandChain(Chain);
-            goto End;
-        } break;
-        }
+    // NOTE(koekeishiya): silence compiler warning.
+    default: return 0; break;
     }
-
-End:
-    // NOTE(koekeishiya): Reset getopt.
-    optind = 1;
-
-    FreeArguments(Count, Args);
-    return Success;
 }
 
-command_func MonitorCommandDispatch(char Flag)
+float_command_func WindowFloatCommandDispatch(char Flag)
 {
     switch (Flag) {
-    case 'f': return FocusMonitor; break;
+    case 'r': return TemporaryRatio; break;
 
     // NOTE(koekeishiya): silence compiler warning.
     default: return 0; break;
     }
 }
 
-inline bool
-ParseMonitorCommand(const char *Message, command *Chain)
+integer_command_func SpaceIntegerCommandDispatch(char Flag)
 {
-    int Count;
-    char **Args = BuildArguments(Message, &Count);
+    switch (Flag) {
+    case 'f': return FocusDesktop; break;
+    case 'M': return MoveDesktop;  break;
 
-    int Option;
-    bool Success = true;
-    const char *Short = "f:";
-
-    command *Command = Chain;
-    while ((Option = getopt_long(Count, Args, Short, NULL, NULL)) != -1) {
-        switch (Option) {
-        case 'f': {
-            unsigned Unsigned;
-            if ((StringEquals(optarg, "prev")) ||
-                (StringEquals(optarg, "next")) ||
-                (sscanf(optarg, "%d", &Unsigned) == 1)) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for monitor flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case '?': {
-            Success = false;
-            FreeCommandChain(Chain);
-            goto End;
-        } break;
-        }
+    // NOTE(koekeishiya): silence compiler warning.
+    default: return 0; break;
     }
+}
 
-End:
-    // NOTE(koekeishiya): Reset getopt.
-    optind = 1;
+command_func MonitorCommandDispatch(char Flag)
+{
+    switch (Flag) {
+    case 'f': return FocusMonitor; break;
 
-    FreeArguments(Count, Args);
-    return Success;
+    // NOTE(koekeishiya): silence compiler warning.
+    default: return 0; break;
+    }
 }
 
 query_func QueryCommandDispatch(char Flag)
@@ -516,6 +501,16 @@ query_func QueryCommandDispatch(char Flag)
     case 'w': return QueryWindow;             break;
     case 'd': return QueryDesktop;            break;
     case 'm': return QueryMonitor;            break;
+
+    // NOTE(koekeishiya): silence compiler warning.
+    default: return 0; break;
+    }
+}
+
+integer_query_func QueryIntegerCommandDispatch(char Flag)
+{
+    switch (Flag) {
+    case 'w': return QueryWindow;             break;
     case 'W': return QueryWindowsForDesktop;  break;
     case 'D': return QueryDesktopsForMonitor; break;
     case 'M': return QueryMonitorForDesktop;  break;
@@ -524,197 +519,124 @@ query_func QueryCommandDispatch(char Flag)
     default: return 0; break;
     }
 }
-inline bool
-ParseQueryCommand(const char *Message, command *Chain)
+
+// NOTE(koekeishiya): Every skipped window saves a position and a size call.
+internal void
+LogFrameApplyStats(command *Command)
 {
-    int Count;
-    char **Args = BuildArguments(Message, &Count);
+    frame_apply_stats Stats = GetFrameApplyStats();
+    if (Stats.Applied || Stats.Skipped) {
+        c_log(C_LOG_LEVEL_DEBUG, "    command: '%c', frames applied: %u, unchanged: %u, ax calls avoided: %u\n",
+              Command->Flag, Stats.Applied, Stats.Skipped, Stats.Skipped * 2);
+    }
+}
 
-    int Option;
-    bool Success = true;
-    const char *Short = "w:d:m:D:M:";
-
-    struct option Long[] = {
-        { "window", required_argument, NULL, 'w' },
-        { "desktop", required_argument, NULL, 'd' },
-        { "monitor", required_argument, NULL, 'm' },
-        { "windows-for-desktop", required_argument, NULL, 'W' },
-        { "desktops-for-monitor", required_argument, NULL, 'D' },
-        { "monitor-for-desktop", required_argument, NULL, 'M' },
-        { NULL, 0, NULL, 0 }
-    };
-
-    command *Command = Chain;
-    while ((Option = getopt_long(Count, Args, Short, Long, NULL)) != -1) {
-        switch (Option) {
-        case 'w': {
-            uint32_t WindowId;
-            if ((StringEquals(optarg, "id")) ||
-                (StringEquals(optarg, "owner")) ||
-                (StringEquals(optarg, "name")) ||
-                (StringEquals(optarg, "tag")) ||
-                (StringEquals(optarg, "float")) ||
-                (sscanf(optarg, "%d", &WindowId) == 1)) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for window flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'd': {
-            if ((StringEquals(optarg, "id")) ||
-                (StringEquals(optarg, "mode")) ||
-                (StringEquals(optarg, "uuid")) ||
-                (StringEquals(optarg, "windows")) ||
-                (StringEquals(optarg, "monocle-index")) ||
-                (StringEquals(optarg, "monocle-count"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for desktop flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'm': {
-            if ((StringEquals(optarg, "id")) ||
-                (StringEquals(optarg, "count"))) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for monitor flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case 'W':
-        case 'D':
-        case 'M': {
-            int Integer;
-            if (sscanf(optarg, "%d", &Integer) == 1) {
-                command *Entry = ConstructCommand(Option, optarg);
-                Command->Next = Entry;
-                Command = Entry;
-            } else {
-                c_log(C_LOG_LEVEL_WARN, "    invalid selector '%s' for flag '%c'\n", optarg, Option);
-                Success = false;
-                FreeCommandChain(Chain);
-                goto End;
-            }
-        } break;
-        case '?': {
-            Success = false;
-            FreeCommandChain(Chain);
-            goto End;
-        } break;
-        }
+internal void
+LogWindowPropertyStats(command *Command)
+{
+    window_property_stats Stats = GetWindowPropertyStats();
+    if (Stats.Hits || Stats.Misses) {
+        c_log(C_LOG_LEVEL_DEBUG, "    command: '%c', window properties cached: %u, queried: %u, mismatched: %u\n",
+              Command->Flag, Stats.Hits, Stats.Misses, Stats.Mismatches);
     }
+}
 
-End:
-    // NOTE(koekeishiya): Reset getopt.
-    optind = 1;
+/*
+ * NOTE(koekeishiya): Profile builds log the time spent in every command, including the
+ * layout pass it triggers, so that a slow command can be told apart from a slow client.
+ */
+internal void
+RunCommand(command_func Func, integer_command_func IntegerFunc,
+           float_command_func FloatFunc, command *Command)
+{
+#ifdef CHUNKWM_PROFILE
+    clock_t Begin = clock();
+#endif
 
-    FreeArguments(Count, Args);
-    return Success;
+    ResetFrameApplyStats();
+    ResetWindowPropertyStats();
+    if (IntegerFunc && Command->Type == Command_Arg_Integer) {
+        (*IntegerFunc)(Command->Integer);
+    } else if (FloatFunc && Command->Type == Command_Arg_Float) {
+        (*FloatFunc)(Command->Float);
+    } else {
+        (*Func)(Command->Arg);
+    }
+    LogFrameApplyStats(Command);
+    LogWindowPropertyStats(Command);
+
+#ifdef CHUNKWM_PROFILE
+    double Elapsed = ((clock() - Begin) / (double)CLOCKS_PER_SEC) * 1000.0f;
+    c_log(C_LOG_LEVEL_PROFILE, "    command: '%c', arg: '%s' = %.8fms\n",
+          Command->Flag, Command->Arg, Elapsed);
+#endif
 }
 
 inline bool
 ParseRuleCommand(const char *Message, window_rule *Rule)
 {
-    int Count;
-    char **Args = BuildArguments(Message, &Count);
+    command_list List;
+    if (!ParseCommand(&RuleGrammar, Message, &List)) {
+        return false;
+    }
 
-    int Option;
     bool Success = true;
-    const char *Short = "o:n:r:R:e:s:d:Dl:a:g:";
-
-    struct option Long[] = {
-        { "owner", required_argument, NULL, 'o' },
-        { "name", required_argument, NULL, 'n' },
-        { "role", required_argument, NULL, 'r' },
-        { "subrole", required_argument, NULL, 'R' },
-        { "except", required_argument, NULL, 'e' },
-        { "state", required_argument, NULL, 's' },
-        { "desktop", required_argument, NULL, 'd' },
-        { "monitor", required_argument, NULL, 'm' },
-        { "follow-desktop", no_argument, NULL, 'D' },
-        { "level", required_argument, NULL, 'l' },
-        { "alpha", required_argument, NULL, 'a' },
-        { "grid-layout", required_argument, NULL, 'g' },
-        { NULL, 0, NULL, 0 }
-    };
-
     bool HasFilter = false;
     bool HasProperty = false;
 
-    while ((Option = getopt_long(Count, Args, Short, Long, NULL)) != -1) {
-        switch (Option) {
+    for (int Index = 0; Index < List.Count; ++Index) {
+        command *Command = &List.Commands[Index];
+        switch (Command->Flag) {
         case 'o': {
-            Rule->Owner = strdup(optarg);
+            Rule->Owner = strdup(Command->Arg);
             HasFilter = true;
         } break;
         case 'n': {
-            Rule->Name = strdup(optarg);
+            Rule->Name = strdup(Command->Arg);
             HasFilter = true;
         } break;
         case 'r': {
-            Rule->Role = CFStringCreateWithCString(NULL, optarg, kCFStringEncodingMacRoman);
+            Rule->Role = CFStringCreateWithCString(NULL, Command->Arg, kCFStringEncodingMacRoman);
             HasFilter = true;
         } break;
         case 'R': {
-            Rule->Subrole = CFStringCreateWithCString(NULL, optarg, kCFStringEncodingMacRoman);
+            Rule->Subrole = CFStringCreateWithCString(NULL, Command->Arg, kCFStringEncodingMacRoman);
             HasFilter = true;
         } break;
         case 'e': {
-            Rule->Except = strdup(optarg);
+            Rule->Except = strdup(Command->Arg);
             HasFilter = true;
         } break;
         case 's': {
-            Rule->State = strdup(optarg);
+            Rule->State = strdup(Command->Arg);
             HasProperty = true;
         } break;
         case 'd': {
-            Rule->Desktop = strdup(optarg);
+            Rule->Desktop = strdup(Command->Arg);
             HasProperty = true;
         } break;
         case 'm': {
-            Rule->Monitor = strdup(optarg);
+            Rule->Monitor = strdup(Command->Arg);
             HasProperty = true;
         } break;
         case 'D': {
             Rule->FollowDesktop = true;
         } break;
         case 'l': {
-            Rule->Level = strdup(optarg);
+            Rule->Level = strdup(Command->Arg);
             HasProperty = true;
         } break;
         case 'a': {
-            Rule->Alpha = strdup(optarg);
+            Rule->Alpha = strdup(Command->Arg);
             HasProperty = true;
         } break;
         case 'g': {
-            Rule->GridLayout = strdup(optarg);
+            Rule->GridLayout = strdup(Command->Arg);
             HasProperty = true;
         } break;
-        case '?': {
-            Success = false;
-            goto End;
-        } break;
         }
     }
 
-End:
-    // NOTE(koekeishiya): Reset getopt.
-    optind = 1;
-
     if (!HasFilter) {
         c_log(C_LOG_LEVEL_WARN, "chunkwm-tiling: window rule - no filter specified, ignored..\n");
         Success = false;
@@ -725,69 +647,71 @@ End:
         Success = false;
     }
 
-    FreeArguments(Count, Args);
+    FreeCommandList(&List);
     return Success;
 }
 
 void CommandCallback(int SockFD, const char *Type, const char *Message)
 {
+    command_list List;
     if (StringEquals(Type, "query")) {
-        command Chain = {};
-        bool Success = ParseQueryCommand(Message, &Chain);
-        if (Success) {
-            command *Command = &Chain;
-            while ((Command = Command->Next)) {
+        if (ParseCommand(&QueryGrammar, Message, &List)) {
+            for (int Index = 0; Index < List.Count; ++Index) {
+                command *Command = &List.Commands[Index];
                 c_log(C_LOG_LEVEL_DEBUG, "    command: '%c', arg: '%s'\n", Command->Flag, Command->Arg);
-                (*QueryCommandDispatch(Command->Flag))(Command->Arg, SockFD);
+                if (Command->Type == Command_Arg_Integer) {
+                    (*QueryIntegerCommandDispatch(Command->Flag))(Command->Integer, SockFD);
+                } else {
+                    (*QueryCommandDispatch(Command->Flag))(Command->Arg, SockFD);
+                }
             }
 
-            FreeCommandChain(&Chain);
+            FreeCommandList(&List);
         }
     } else if (StringEquals(Type, "rule")) {
         window_rule Rule = {};
         if (ParseRuleCommand(Message, &Rule)) {
-            AddWindowRule(&Rule);
+            AddWindowRule(&Rule, SockFD);
         }
     } else if (StringEquals(Type, "window")) {
-        command Chain = {};
-        bool Success = ParseWindowCommand(Message, &Chain);
-        if (Success) {
+        if (ParseCommand(&WindowGrammar, Message, &List)) {
             float Ratio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
-            command *Command = &Chain;
-            while ((Command = Command->Next)) {
+            for (int Index = 0; Index < List.Count; ++Index) {
+                command *Command = &List.Commands[Index];
                 c_log(C_LOG_LEVEL_DEBUG, "    command: '%c', arg: '%s'\n", Command->Flag, Command->Arg);
-                (*WindowCommandDispatch(Command->Flag))(Command->Arg);
+                RunCommand(WindowCommandDispatch(Command->Flag),
+                           WindowIntegerCommandDispatch(Command->Flag),
+                           WindowFloatCommandDispatch(Command->Flag),
+                           Command);
             }
 
             if (Ratio != CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO)) {
                 UpdateCVar(CVAR_BSP_SPLIT_RATIO, Ratio);
             }
 
-            FreeCommandChain(&Chain);
+            FreeCommandList(&List);
         }
     } else if (StringEquals(Type, "desktop")) {
-        command Chain = {};
-        bool Success = ParseSpaceCommand(Message, &Chain);
-        if (Success) {
-            command *Command = &Chain;
-            while ((Command = Command->Next)) {
+        if (ParseCommand(&SpaceGrammar, Message, &List)) {
+            for (int Index = 0; Index < List.Count; ++Index) {
+                command *Command = &List.Commands[Index];
                 c_log(C_LOG_LEVEL_DEBUG, "    command: '%c', arg: '%s'\n", Command->Flag, Command->Arg);
-                (*SpaceCommandDispatch(Command->Flag))(Command->Arg);
+                RunCommand(SpaceCommandDispatch(Command->Flag),
+                           SpaceIntegerCommandDispatch(Command->Flag),
+                           NULL, Command);
             }
 
-            FreeCommandChain(&Chain);
+            FreeCommandList(&List);
         }
     } else if (StringEquals(Type, "monitor")) {
-        command Chain = {};
-        bool Success = ParseMonitorCommand(Message, &Chain);
-        if (Success) {
-            command *Command = &Chain;
-            while ((Command = Command->Next)) {
+        if (ParseCommand(&MonitorGrammar, Message, &List)) {
+            for (int Index = 0; Index < List.Count; ++Index) {
+                command *Command = &List.Commands[Index];
                 c_log(C_LOG_LEVEL_DEBUG, "    command: '%c', arg: '%s'\n", Command->Flag, Command->Arg);
-                (*MonitorCommandDispatch(Command->Flag))(Command->Arg);
+                RunCommand(MonitorCommandDispatch(Command->Flag), NULL, NULL, Command);
             }
 
-            FreeCommandChain(&Chain);
+            FreeCommandList(&List);
         }
     } else {
         c_log(C_LOG_LEVEL_WARN, "chunkwm-tiling: no match for '%s %s'\n", Type, Message);
@@ -27,6 +27,9 @@
 
 #define CVAR_PADDING_STEP_SIZE      "desktop_padding_step_size"
 #define CVAR_GAP_STEP_SIZE          "desktop_gap_step_size"
+#define CVAR_DESKTOP_HISTORY_DEPTH  "desktop_history_depth"
+#define CVAR_DESKTOP_STATE_FILE     "desktop_state_file"
+#define DESKTOP_STATE_FILE_FMT      "/tmp/chunkwm-tiling_%s-state"
 
 #define CVAR_BSP_SPAWN_LEFT         "bsp_spawn_left"
 #define CVAR_BSP_OPTIMAL_RATIO      "bsp_optimal_ratio"
@@ -52,6 +55,8 @@
 
 #define CVAR_WINDOW_FLOAT_NEXT      "window_float_next"
 #define CVAR_WINDOW_REGION_LOCKED   "window_region_locked"
+#define CVAR_WINDOW_FRAME_TIMEOUT   "window_frame_timeout"
+#define CVAR_WINDOW_PROPERTY_VERIFY "window_property_verify"
 
 #define CVAR_PRE_BORDER_COLOR       "preselect_border_color"
 #define CVAR_PRE_BORDER_WIDTH       "preselect_border_width"
@@ -11,6 +11,12 @@
 #include "presel.h"
 #include "region.h"
 #include "node.h"
+#include "backend.h"
+#include "macos.h"
+#include "cache.h"
+#include "adjacency.h"
+#include "layout.h"
+#include "history.h"
 #include "vspace.h"
 #include "misc.h"
 #include "constants.h"
@@ -21,11 +27,11 @@
 
 #define internal static
 
-typedef std::map<uint32_t, macos_window *> macos_window_map;
-typedef macos_window_map::iterator macos_window_map_it;
-
-extern macos_window_map CopyWindowCache();
 extern macos_window *GetWindowByID(uint32_t Id);
+extern char *CopyWindowName(macos_window *Window);
+extern void AddWindowFlags(macos_window *Window, uint32_t Flags);
+extern void ClearWindowFlags(macos_window *Window, uint32_t Flags);
+extern bool WindowHasFlags(macos_window *Window, uint32_t Flags);
 extern macos_window *GetFocusedWindow();
 extern uint32_t GetFocusedWindowId();
 extern std::vector<uint32_t> GetAllVisibleWindowsForSpace(macos_space *Space);
@@ -130,15 +136,6 @@ void CenterMouseInWindow(macos_window *Window)
     CenterMouseInRegion(&Region);
 }
 
-enum directions
-{
-    Dir_Unknown,
-    Dir_North,
-    Dir_East,
-    Dir_South,
-    Dir_West,
-};
-
 internal directions
 DirectionFromString(char *Direction)
 {
@@ -154,7 +151,7 @@ WrapMonitorEdge(macos_space *Space, int Direction,
                 float *X1, float *X2, float *Y1, float *Y2)
 {
     CFStringRef DisplayRef = AXLibGetDisplayIdentifierFromSpace(Space->Id);
-    CGRect Display = AXLibGetDisplayBounds(DisplayRef);
+    CGRect Display = GetDisplayGeometry(DisplayRef).Bounds;
     CFRelease(DisplayRef);
 
     switch (Direction) {
@@ -174,71 +171,55 @@ GetWindowDistance(macos_space *Space, float X1, float Y1,
         WrapMonitorEdge(Space, Direction, &X1, &X2, &Y1, &Y2);
     }
 
-    float DeltaX    = X2 - X1;
-    float DeltaY    = Y2 - Y1;
-    float Angle     = atan2(DeltaY, DeltaX);
-    float Distance  = hypot(DeltaX, DeltaY);
-    float DeltaA    = 0;
-
-    switch (Direction) {
-    case Dir_North: {
-        if (DeltaY >= 0) return 0xFFFFFFFF;
-        DeltaA = -M_PI_2 - Angle;
-    } break;
-    case Dir_East: {
-        if (DeltaX <= 0) return 0xFFFFFFFF;
-        DeltaA = 0.0 - Angle;
-    } break;
-    case Dir_South: {
-        if (DeltaY <= 0) return 0xFFFFFFFF;
-        DeltaA = M_PI_2 - Angle;
-    } break;
-    case Dir_West: {
-        if (DeltaX >= 0) return 0xFFFFFFFF;
-        DeltaA = M_PI - fabs(Angle);
-    } break;
-    case Dir_Unknown: { /* NOTE(koekeishiya) compiler warning.. */ } break;
-    }
-
-    return (Distance / cos(DeltaA / 2.0));
+    return DirectionalDistance(Direction, X1, Y1, X2, Y2);
 }
 
 internal bool
 WindowIsInDirection(char *Op, float X1, float Y1, float W1, float H1,
                     float X2, float Y2, float W2, float H2)
 {
-    bool Result = false;
-
     directions Direction = DirectionFromString(Op);
-    switch (Direction) {
-    case Dir_North:
-    case Dir_South: {
-        Result = (Y1 != Y2) && (fmax(X1, X2) < fmin(X2 + W2, X1 + W1));
-    } break;
-    case Dir_East:
-    case Dir_West: {
-        Result = (X1 != X2) && (fmax(Y1, Y2) < fmin(Y2 + H2, Y1 + H1));
-    } break;
-    case Dir_Unknown: { /* NOTE(koekeishiya) compiler warning.. */ } break;
-    }
-
-    return Result;
+    return IsInDirection(Direction, X1, Y1, W1, H1, X2, Y2, W2, H2);
 }
 
+/*
+ * NOTE(koekeishiya): Without wrapping, the closest window is the neighbour stored in the
+ * adjacency graph of the virtual space. We only have to look at every visible window when
+ * we need to wrap around the edge of the monitor.
+ */
 bool FindClosestWindow(macos_space *Space, virtual_space *VirtualSpace,
                        macos_window *Match, macos_window **ClosestWindow,
                        char *Direction, bool Wrap)
 {
+    BEGIN_TIMED_BLOCK();
     float MinDist = 0xFFFFFFFF;
-    std::vector<uint32_t> Windows = GetAllVisibleWindowsForSpace(Space);
+    bool Result = false;
+    std::vector<uint32_t> Windows;
+
+    node *NodeA = GetNodeWithId(VirtualSpace, Match->Id);
+    if (!NodeA) goto out;
+
+    if (!Wrap) {
+        node *NodeB = GetAdjacentNode(VirtualSpace, NodeA, DirectionFromString(Direction));
+        if (!NodeB) goto out;
 
+        macos_window *Window = GetWindowByID(NodeB->WindowId);
+        if (Window) {
+            *ClosestWindow = Window;
+            Result = true;
+            goto out;
+        }
+
+        // NOTE(koekeishiya): The neighbour is not in our window cache, look at the visible windows instead.
+    }
+
+    Windows = GetAllVisibleWindowsForSpace(Space);
     for (int Index = 0; Index < Windows.size(); ++Index) {
         macos_window *Window = GetWindowByID(Windows[Index]);
         if ((!Window) || (Match->Id == Window->Id)) continue;
 
-        node *NodeA = GetNodeWithId(VirtualSpace->Tree, Match->Id, VirtualSpace->Mode);
-        node *NodeB = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
-        if ((!NodeA) || (!NodeB) || NodeA == NodeB) continue;
+        node *NodeB = GetNodeWithId(VirtualSpace, Window->Id);
+        if ((!NodeB) || NodeA == NodeB) continue;
 
         region *A = &NodeA->Region;
         region *B = &NodeB->Region;
@@ -254,11 +235,14 @@ bool FindClosestWindow(macos_space *Space, virtual_space *VirtualSpace,
             if (Dist < MinDist) {
                 MinDist = Dist;
                 *ClosestWindow = Window;
+                Result = true;
             }
         }
     }
 
-    return MinDist != 0xFFFFFFFF;
+out:
+    END_TIMED_BLOCK();
+    return Result;
 }
 
 internal bool
@@ -390,7 +374,7 @@ FocusWindowNoFocus(char *Direction)
     macos_space *Space;
     virtual_space *VirtualSpace;
     macos_window *Window;
-    node *Node = NULL;
+    uint32_t WindowId = 0;
 
     Space = GetActiveSpace();
     ASSERT(Space);
@@ -403,22 +387,26 @@ FocusWindowNoFocus(char *Direction)
     }
 
     VirtualSpace = AcquireVirtualSpace(Space);
-    if ((!VirtualSpace->Tree) || (VirtualSpace->Mode == Virtual_Space_Float)) {
+    if ((!VirtualSpaceHasWindows(VirtualSpace)) || (VirtualSpace->Mode == Virtual_Space_Float)) {
         goto vspace_release;
     }
 
     if ((StringEquals(Direction, "prev")) ||
         (StringEquals(Direction, "west")) ||
         (StringEquals(Direction, "north"))) {
-        Node = GetLastLeafNode(VirtualSpace->Tree);
+        WindowId = VirtualSpace->Mode == Virtual_Space_Monocle
+                 ? MonocleWindowAt(&VirtualSpace->Monocle, -1)
+                 : GetLastLeafNode(VirtualSpace->Tree)->WindowId;
     } else if ((StringEquals(Direction, "next")) ||
                (StringEquals(Direction, "east")) ||
                (StringEquals(Direction, "south"))) {
-        Node = GetFirstLeafNode(VirtualSpace->Tree);
+        WindowId = VirtualSpace->Mode == Virtual_Space_Monocle
+                 ? MonocleWindowAt(&VirtualSpace->Monocle, 0)
+                 : GetFirstLeafNode(VirtualSpace->Tree)->WindowId;
     }
 
-    if (Node) {
-        Window = GetWindowByID(Node->WindowId);
+    if (WindowId) {
+        Window = GetWindowByID(WindowId);
         ASSERT(Window);
         FocusWindow(Window);
     } else {
@@ -463,7 +451,7 @@ FocusWindowFocus(char *Direction, macos_window *Window)
     }
 
     VirtualSpace = AcquireVirtualSpace(Space);
-    if ((!VirtualSpace->Tree) || (VirtualSpace->Mode == Virtual_Space_Float)) {
+    if ((!VirtualSpaceHasWindows(VirtualSpace)) || (VirtualSpace->Mode == Virtual_Space_Float)) {
         goto vspace_release;
     }
 
@@ -471,7 +459,7 @@ FocusWindowFocus(char *Direction, macos_window *Window)
         char *FocusCycleMode = CVarStringValue(CVAR_WINDOW_FOCUS_CYCLE);
         ASSERT(FocusCycleMode);
 
-        node *WindowNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+        node *WindowNode = GetNodeWithId(VirtualSpace, Window->Id);
         if (WindowNode) {
             if (StringEquals(FocusCycleMode, Window_Focus_Cycle_All)) {
                 bool WrapMonitor = AXLibDisplayCount() == 1;
@@ -499,41 +487,42 @@ FocusWindowFocus(char *Direction, macos_window *Window)
         char *FocusCycleMode = CVarStringValue(CVAR_WINDOW_FOCUS_CYCLE);
         ASSERT(FocusCycleMode);
 
-        node *WindowNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
-        if (WindowNode) {
-            node *Node = NULL;
+        monocle_list *Monocle = &VirtualSpace->Monocle;
+        int Index = MonocleWindowIndex(Monocle, Window->Id);
+        if (Index != -1) {
+            uint32_t WindowId = 0;
             if ((StringEquals(Direction, "west")) ||
                 (StringEquals(Direction, "prev"))) {
-                if (WindowNode->Left) {
-                    Node = WindowNode->Left;
+                if (Index > 0) {
+                    WindowId = Monocle->Windows[Index - 1];
                 } else if (StringEquals(FocusCycleMode, Window_Focus_Cycle_All)) {
                     bool WrapMonitor = AXLibDisplayCount() == 1;
                     if (WrapMonitor) {
-                        Node = GetLastLeafNode(VirtualSpace->Tree);
+                        WindowId = MonocleWindowAt(Monocle, -1);
                     } else {
                         FocusMonitor("prev");
                     }
                 } else if (StringEquals(FocusCycleMode, Window_Focus_Cycle_Monitor)) {
-                    Node = GetLastLeafNode(VirtualSpace->Tree);
+                    WindowId = MonocleWindowAt(Monocle, -1);
                 }
             } else if ((StringEquals(Direction, "east")) ||
                        (StringEquals(Direction, "next"))) {
-                if (WindowNode->Right) {
-                    Node = WindowNode->Right;
+                if ((uint32_t) Index + 1 < Monocle->Count) {
+                    WindowId = Monocle->Windows[Index + 1];
                 } else if (StringEquals(FocusCycleMode, Window_Focus_Cycle_All)) {
                     bool WrapMonitor = AXLibDisplayCount() == 1;
                     if (WrapMonitor) {
-                        Node = GetFirstLeafNode(VirtualSpace->Tree);
+                        WindowId = MonocleWindowAt(Monocle, 0);
                     } else {
                         FocusMonitor("next");
                     }
                 } else if (StringEquals(FocusCycleMode, Window_Focus_Cycle_Monitor)) {
-                    Node = GetFirstLeafNode(VirtualSpace->Tree);
+                    WindowId = MonocleWindowAt(Monocle, 0);
                 }
             }
 
-            if (Node) {
-                macos_window *WindowToFocus = GetWindowByID(Node->WindowId);
+            if (WindowId) {
+                macos_window *WindowToFocus = GetWindowByID(WindowId);
                 ASSERT(WindowToFocus);
                 FocusWindow(WindowToFocus);
             }
@@ -550,19 +539,19 @@ space_free:
 
 void FocusWindow(char *Direction)
 {
-    unsigned WindowId;
-    macos_window *Window;
-
-    if (sscanf(Direction, "%d", &WindowId) == 1) {
-        if ((Window = GetWindowByID(WindowId))) {
-            FocusWindow(Window);
-        }
+    macos_window *Window = GetFocusedWindow();
+    if (Window) {
+        FocusWindowFocus(Direction, Window);
     } else {
-        if ((Window = GetFocusedWindow())) {
-            FocusWindowFocus(Direction, Window);
-        } else {
-            FocusWindowNoFocus(Direction);
-        }
+        FocusWindowNoFocus(Direction);
+    }
+}
+
+void FocusWindow(int WindowId)
+{
+    macos_window *Window = GetWindowByID(WindowId);
+    if (Window) {
+        FocusWindow(Window);
     }
 }
 
@@ -589,12 +578,12 @@ void SwapWindow(char *Direction)
     }
 
     VirtualSpace = AcquireVirtualSpace(Space);
-    if ((!VirtualSpace->Tree) || (VirtualSpace->Mode == Virtual_Space_Float)) {
+    if ((!VirtualSpaceHasWindows(VirtualSpace)) || (VirtualSpace->Mode == Virtual_Space_Float)) {
         goto vspace_release;
     }
 
     if (VirtualSpace->Mode == Virtual_Space_Bsp) {
-        WindowNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+        WindowNode = GetNodeWithId(VirtualSpace, Window->Id);
         if (!WindowNode) {
             goto vspace_release;
         }
@@ -605,38 +594,39 @@ void SwapWindow(char *Direction)
             }
         }
 
-        ClosestNode = GetNodeWithId(VirtualSpace->Tree, ClosestWindow->Id, VirtualSpace->Mode);
+        ClosestNode = GetNodeWithId(VirtualSpace, ClosestWindow->Id);
         ASSERT(ClosestNode);
 
-        SwapNodeIds(WindowNode, ClosestNode);
-        ResizeWindowToRegionSize(WindowNode);
-        ResizeWindowToRegionSize(ClosestNode);
+        RecordLayoutHistory(VirtualSpace);
+        SwapNodeIds(WindowNode, ClosestNode, VirtualSpace);
+
+        window_frame_list Frames;
+        BeginWindowFrameList(&Frames);
+        ResizeWindowToRegionSize(WindowNode, true, &Frames);
+        ResizeWindowToRegionSize(ClosestNode, true, &Frames);
+        CommitWindowFrameList(&Frames);
 
         if (!StringEquals(CVarStringValue(CVAR_MOUSE_FOLLOWS_FOCUS), Mouse_Follows_Focus_Off)) {
             CenterMouseInRegion(&ClosestNode->Region);
         }
     } else if (VirtualSpace->Mode == Virtual_Space_Monocle) {
-        WindowNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
-        if (!WindowNode) {
+        monocle_list *Monocle = &VirtualSpace->Monocle;
+        int Index = MonocleWindowIndex(Monocle, Window->Id);
+        if (Index == -1) {
             goto vspace_release;
         }
 
+        int ClosestIndex = Index;
         if ((StringEquals(Direction, "west")) || (StringEquals(Direction, "prev"))) {
-            ClosestNode = WindowNode->Left
-                        ? WindowNode->Left
-                        : GetLastLeafNode(VirtualSpace->Tree);
-        } else if((StringEquals(Direction, "east")) || (StringEquals(Direction, "next"))) {
-            ClosestNode = WindowNode->Right
-                        ? WindowNode->Right
-                        : GetFirstLeafNode(VirtualSpace->Tree);
-        } else {
-            ClosestNode = NULL;
+            ClosestIndex = Index > 0 ? Index - 1 : Monocle->Count - 1;
+        } else if ((StringEquals(Direction, "east")) || (StringEquals(Direction, "next"))) {
+            ClosestIndex = (uint32_t) Index + 1 < Monocle->Count ? Index + 1 : 0;
         }
 
-        if (ClosestNode && ClosestNode != WindowNode) {
+        if (ClosestIndex != Index) {
             // NOTE(koekeishiya): Swapping windows in monocle mode
             // should not trigger mouse_follows_focus.
-            SwapNodeIds(WindowNode, ClosestNode);
+            MonocleSwapWindows(Monocle, Index, ClosestIndex);
         }
     }
 
@@ -671,12 +661,12 @@ void WarpWindow(char *Direction)
     }
 
     VirtualSpace = AcquireVirtualSpace(Space);
-    if ((!VirtualSpace->Tree) || (VirtualSpace->Mode == Virtual_Space_Float)) {
+    if ((!VirtualSpaceHasWindows(VirtualSpace)) || (VirtualSpace->Mode == Virtual_Space_Float)) {
         goto vspace_release;
     }
 
     if (VirtualSpace->Mode == Virtual_Space_Bsp) {
-        WindowNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+        WindowNode = GetNodeWithId(VirtualSpace, Window->Id);
         ASSERT(WindowNode);
 
         if (!FindWindowUndirected(Space, VirtualSpace, WindowNode, &ClosestWindow, Direction, false)) {
@@ -685,14 +675,21 @@ void WarpWindow(char *Direction)
             }
         }
 
-        ClosestNode = GetNodeWithId(VirtualSpace->Tree, ClosestWindow->Id, VirtualSpace->Mode);
+        ClosestNode = GetNodeWithId(VirtualSpace, ClosestWindow->Id);
         ASSERT(ClosestNode);
 
+        RecordLayoutHistory(VirtualSpace);
+
         if (WindowNode->Parent == ClosestNode->Parent) {
             // NOTE(koekeishiya): Windows have the same parent, perform a regular swap.
-            SwapNodeIds(WindowNode, ClosestNode);
-            ResizeWindowToRegionSize(WindowNode);
-            ResizeWindowToRegionSize(ClosestNode);
+            SwapNodeIds(WindowNode, ClosestNode, VirtualSpace);
+
+            window_frame_list Frames;
+            BeginWindowFrameList(&Frames);
+            ResizeWindowToRegionSize(WindowNode, true, &Frames);
+            ResizeWindowToRegionSize(ClosestNode, true, &Frames);
+            CommitWindowFrameList(&Frames);
+
             FocusedNode = ClosestNode;
         } else {
             // NOTE(koekeishiya): Modify tree layout.
@@ -701,7 +698,7 @@ void WarpWindow(char *Direction)
             TileWindowOnSpace(Window, Space, VirtualSpace);
             UpdateCVar(CVAR_BSP_INSERTION_POINT, 0);
 
-            FocusedNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+            FocusedNode = GetNodeWithId(VirtualSpace, Window->Id);
         }
 
         ASSERT(FocusedNode);
@@ -710,27 +707,23 @@ void WarpWindow(char *Direction)
             CenterMouseInRegion(&ClosestNode->Region);
         }
     } else if (VirtualSpace->Mode == Virtual_Space_Monocle) {
-        WindowNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
-        if (!WindowNode) {
+        monocle_list *Monocle = &VirtualSpace->Monocle;
+        int Index = MonocleWindowIndex(Monocle, Window->Id);
+        if (Index == -1) {
             goto vspace_release;
         }
 
+        int ClosestIndex = Index;
         if ((StringEquals(Direction, "west")) || (StringEquals(Direction, "prev"))) {
-            ClosestNode = WindowNode->Left
-                        ? WindowNode->Left
-                        : GetLastLeafNode(VirtualSpace->Tree);
+            ClosestIndex = Index > 0 ? Index - 1 : Monocle->Count - 1;
         } else if ((StringEquals(Direction, "east")) || (StringEquals(Direction, "next"))) {
-            ClosestNode = WindowNode->Right
-                        ? WindowNode->Right
-                        : GetFirstLeafNode(VirtualSpace->Tree);
-        } else {
-            ClosestNode = NULL;
+            ClosestIndex = (uint32_t) Index + 1 < Monocle->Count ? Index + 1 : 0;
         }
 
-        if (ClosestNode && ClosestNode != WindowNode) {
+        if (ClosestIndex != Index) {
             // NOTE(koekeishiya): Swapping windows in monocle mode
             // should not trigger mouse_follows_focus.
-            SwapNodeIds(WindowNode, ClosestNode);
+            MonocleSwapWindows(Monocle, Index, ClosestIndex);
         }
     }
 
@@ -742,11 +735,9 @@ space_free:
     AXLibDestroySpace(Space);
 }
 
-void TemporaryRatio(char *Ratio)
+void TemporaryRatio(float Ratio)
 {
-    float FloatRatio;
-    sscanf(Ratio, "%f", &FloatRatio);
-    UpdateCVar(CVAR_BSP_SPLIT_RATIO, FloatRatio);
+    UpdateCVar(CVAR_BSP_SPLIT_RATIO, Ratio);
 }
 
 void ExtendedDockSetWindowAlpha(uint32_t WindowId, float Value, float Duration)
@@ -775,28 +766,32 @@ void EnableWindowFading(uint32_t FocusedWindowId)
 {
     float Alpha = CVarFloatingPointValue(CVAR_WINDOW_FADE_ALPHA);
     float Duration = CVarFloatingPointValue(CVAR_WINDOW_FADE_DURATION);
-    macos_window_map Copy = CopyWindowCache();
+    window_snapshot *Snapshot = AcquireWindowSnapshot();
 
     ExtendedDockSetWindowAlpha(FocusedWindowId, 1.0f, Duration);
-    for (macos_window_map_it It = Copy.begin(); It != Copy.end(); ++It) {
-        macos_window *Window = It->second;
+    for (uint32_t Index = 0; Index < Snapshot->Count; ++Index) {
+        macos_window *Window = Snapshot->Windows[Index];
         if (Window->Id == FocusedWindowId) continue;
         ExtendedDockSetWindowAlpha(Window->Id, Alpha, Duration);
     }
 
+    ReleaseWindowSnapshot(Snapshot);
+
     UpdateCVar(CVAR_WINDOW_FADE_INACTIVE, 1);
 }
 
 void DisableWindowFading()
 {
     float Duration = CVarFloatingPointValue(CVAR_WINDOW_FADE_DURATION);
-    macos_window_map Copy = CopyWindowCache();
+    window_snapshot *Snapshot = AcquireWindowSnapshot();
 
-    for (macos_window_map_it It = Copy.begin(); It != Copy.end(); ++It) {
-        macos_window *Window = It->second;
+    for (uint32_t Index = 0; Index < Snapshot->Count; ++Index) {
+        macos_window *Window = Snapshot->Windows[Index];
         ExtendedDockSetWindowAlpha(Window->Id, 1.0f, Duration);
     }
 
+    ReleaseWindowSnapshot(Snapshot);
+
     UpdateCVar(CVAR_WINDOW_FADE_INACTIVE, 0);
 }
 
@@ -835,7 +830,7 @@ void ExtendedDockSetWindowSticky(macos_window *Window, int Value)
 
 void FloatWindow(macos_window *Window)
 {
-    AXLibAddFlags(Window, Window_Float);
+    AddWindowFlags(Window, Window_Float);
     BroadcastFocusedWindowFloating(Window);
 
     if (CVarIntegerValue(CVAR_WINDOW_FLOAT_TOPMOST)) {
@@ -846,7 +841,7 @@ void FloatWindow(macos_window *Window)
 internal void
 UnfloatWindow(macos_window *Window)
 {
-    AXLibClearFlags(Window, Window_Float);
+    ClearWindowFlags(Window, Window_Float);
     BroadcastFocusedWindowFloating(Window);
 
     if (CVarIntegerValue(CVAR_WINDOW_FLOAT_TOPMOST)) {
@@ -877,7 +872,7 @@ ToggleWindowFloat()
         return;
     }
 
-    if (AXLibHasFlags(Window, Window_Float)) {
+    if (WindowHasFlags(Window, Window_Float)) {
         UnfloatWindow(Window);
         TileWindow(Window);
     } else {
@@ -894,19 +889,19 @@ ToggleWindowSticky()
         return;
     }
 
-    if (AXLibHasFlags(Window, Window_Sticky)) {
+    if (WindowHasFlags(Window, Window_Sticky)) {
         ExtendedDockSetWindowSticky(Window, 0);
-        AXLibClearFlags(Window, Window_Sticky);
+        ClearWindowFlags(Window, Window_Sticky);
 
-        if (AXLibHasFlags(Window, Window_Float)) {
+        if (WindowHasFlags(Window, Window_Float)) {
             UnfloatWindow(Window);
             TileWindow(Window);
         }
     } else {
         ExtendedDockSetWindowSticky(Window, 1);
-        AXLibAddFlags(Window, Window_Sticky);
+        AddWindowFlags(Window, Window_Sticky);
 
-        if (!AXLibHasFlags(Window, Window_Float)) {
+        if (!WindowHasFlags(Window, Window_Float)) {
             UntileWindow(Window);
             FloatWindow(Window);
         }
@@ -921,17 +916,19 @@ ToggleWindowNativeFullscreen()
         return;
     }
 
-    bool Fullscreen = AXLibIsWindowFullscreen(Window->Ref);
+    bool Fullscreen = IsWindowFullscreen(Window);
     if (Fullscreen) {
         AXLibSetWindowFullscreen(Window->Ref, !Fullscreen);
+        InvalidateWindowProperties(Window->Id, Window_Property_Fullscreen);
 
-        if (AXLibIsWindowMovable(Window->Ref))   AXLibAddFlags(Window, Window_Movable);
-        if (AXLibIsWindowResizable(Window->Ref)) AXLibAddFlags(Window, Window_Resizable);
+        if (AXLibIsWindowMovable(Window->Ref))   AddWindowFlags(Window, Window_Movable);
+        if (AXLibIsWindowResizable(Window->Ref)) AddWindowFlags(Window, Window_Resizable);
 
         TileWindow(Window);
     } else {
         UntileWindow(Window);
         AXLibSetWindowFullscreen(Window->Ref, !Fullscreen);
+        InvalidateWindowProperties(Window->Id, Window_Property_Fullscreen);
     }
 }
 
@@ -963,7 +960,7 @@ ToggleWindowFullscreenZoom()
         goto vspace_release;
     }
 
-    Node = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+    Node = GetNodeWithId(VirtualSpace, Window->Id);
     if (!Node) {
         goto vspace_release;
     }
@@ -1026,7 +1023,7 @@ ToggleWindowParentZoom()
         goto vspace_release;
     }
 
-    Node = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+    Node = GetNodeWithId(VirtualSpace, Window->Id);
     if (!Node || !Node->Parent) {
         goto vspace_release;
     }
@@ -1089,11 +1086,13 @@ ToggleWindowSplitMode()
         goto vspace_release;
     }
 
-    Node = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+    Node = GetNodeWithId(VirtualSpace, Window->Id);
     if (!Node || !Node->Parent) {
         goto vspace_release;
     }
 
+    RecordLayoutHistory(VirtualSpace);
+
     if (Node->Parent->Split == Split_Horizontal) {
         Node->Parent->Split = Split_Vertical;
     } else if (Node->Parent->Split == Split_Vertical) {
@@ -1155,7 +1154,7 @@ void UseInsertionPoint(char *Direction)
         goto vspace_release;
     }
 
-    Node = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+    Node = GetNodeWithId(VirtualSpace, Window->Id);
     if (!Node) {
         goto vspace_release;
     }
@@ -1238,29 +1237,6 @@ space_free:
     AXLibDestroySpace(Space);
 }
 
-internal void
-RotateBSPTree(node *Node, char *Degrees)
-{
-    if ((StringEquals(Degrees, "90") && Node->Split == Split_Vertical) ||
-        (StringEquals(Degrees, "270") && Node->Split == Split_Horizontal) ||
-        (StringEquals(Degrees, "180"))) {
-        node *Temp = Node->Left;
-        Node->Left = Node->Right;
-        Node->Right = Temp;
-        Node->Ratio = 1 - Node->Ratio;
-    }
-
-    if (!StringEquals(Degrees, "180")) {
-        if      (Node->Split == Split_Horizontal)   Node->Split = Split_Vertical;
-        else if (Node->Split == Split_Vertical)     Node->Split = Split_Horizontal;
-    }
-
-    if (!IsLeafNode(Node)) {
-        RotateBSPTree(Node->Left, Degrees);
-        RotateBSPTree(Node->Right, Degrees);
-    }
-}
-
 void RotateWindowTree(char *Degrees)
 {
     macos_space *Space;
@@ -1278,6 +1254,7 @@ void RotateWindowTree(char *Degrees)
         goto vspace_release;
     }
 
+    RecordLayoutHistory(VirtualSpace);
     RotateBSPTree(VirtualSpace->Tree, Degrees);
     CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
     ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode);
@@ -1289,22 +1266,6 @@ space_free:
     AXLibDestroySpace(Space);
 }
 
-internal node *
-MirrorBSPTree(node *Tree, node_split Axis)
-{
-    if (!IsLeafNode(Tree)) {
-        node *Left = MirrorBSPTree(Tree->Left, Axis);
-        node *Right = MirrorBSPTree(Tree->Right, Axis);
-
-        if (Tree->Split == Axis) {
-            Tree->Left = Right;
-            Tree->Right = Left;
-        }
-    }
-
-    return Tree;
-}
-
 void MirrorWindowTree(char *Direction)
 {
     macos_space *Space;
@@ -1322,6 +1283,8 @@ void MirrorWindowTree(char *Direction)
         goto vspace_release;
     }
 
+    RecordLayoutHistory(VirtualSpace);
+
     if (StringEquals(Direction, "vertical")) {
         VirtualSpace->Tree = MirrorBSPTree(VirtualSpace->Tree, Split_Vertical);
     } else if (StringEquals(Direction, "horizontal")) {
@@ -1368,7 +1331,7 @@ void AdjustWindowRatio(char *Direction)
         goto vspace_release;
     }
 
-    WindowNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
+    WindowNode = GetNodeWithId(VirtualSpace, Window->Id);
     if (!WindowNode) {
         goto vspace_release;
     }
@@ -1379,7 +1342,7 @@ void AdjustWindowRatio(char *Direction)
         }
     }
 
-    ClosestNode = GetNodeWithId(VirtualSpace->Tree, ClosestWindow->Id, VirtualSpace->Mode);
+    ClosestNode = GetNodeWithId(VirtualSpace, ClosestWindow->Id);
     ASSERT(ClosestNode);
 
     Ancestor = GetLowestCommonAncestor(WindowNode, ClosestNode);
@@ -1394,6 +1357,7 @@ void AdjustWindowRatio(char *Direction)
 
     Ratio = Ancestor->Ratio + Offset;
     if (Ratio >= 0.1 && Ratio <= 0.9) {
+        RecordLayoutHistory(VirtualSpace);
         Ancestor->Ratio = Ratio;
         ResizeNodeRegion(Ancestor, Space, VirtualSpace);
         ApplyNodeRegion(Ancestor, VirtualSpace->Mode);
@@ -1431,10 +1395,11 @@ void ActivateSpaceLayout(char *Layout)
     }
 
     if (VirtualSpace->Tree) {
-        FreeNodeTree(VirtualSpace->Tree, VirtualSpace->Mode);
-        VirtualSpace->Tree = NULL;
+        FreeNodeTree(VirtualSpace);
     }
 
+    ClearMonocleList(&VirtualSpace->Monocle);
+    VirtualSpace->RestoreState = NULL;
     VirtualSpace->Mode = NewLayout;
     if (ShouldDeserializeVirtualSpace(VirtualSpace)) {
         CreateDeserializedWindowTreeForSpace(Space, VirtualSpace);
@@ -1472,10 +1437,8 @@ void ToggleSpace(char *Op)
                              ? NULL
                              : &VirtualSpace->_Offset;
 
-        if (VirtualSpace->Tree) {
-            CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
-            CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
-            ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode, false);
+        if (VirtualSpaceHasWindows(VirtualSpace)) {
+            VirtualSpaceRecreateRegions(Space, VirtualSpace);
         }
     }
 
@@ -1522,10 +1485,8 @@ void AdjustSpacePadding(char *Op)
         VirtualSpace->_Offset.Right = NewRight;
     }
 
-    if (VirtualSpace->Tree) {
-        CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
-        CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
-        ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode, false);
+    if (VirtualSpaceHasWindows(VirtualSpace)) {
+        VirtualSpaceRecreateRegions(Space, VirtualSpace);
     }
 
 vspace_release:
@@ -1563,10 +1524,8 @@ void AdjustSpaceGap(char *Op)
         VirtualSpace->_Offset.Gap = NewGap;
     }
 
-    if (VirtualSpace->Tree) {
-        CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
-        CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
-        ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode, false);
+    if (VirtualSpaceHasWindows(VirtualSpace)) {
+        VirtualSpaceRecreateRegions(Space, VirtualSpace);
     }
 
 vspace_release:
@@ -1657,7 +1616,7 @@ bool SendWindowToDesktop(macos_window *Window, char *Op)
         goto space_free;
     }
 
-    ValidWindow = ((!AXLibHasFlags(Window, Window_Float)) && (IsWindowValid(Window)));
+    ValidWindow = ((!WindowHasFlags(Window, Window_Float)) && (IsWindowValid(Window)));
     if (ValidWindow) {
         virtual_space *VirtualSpace = AcquireVirtualSpace(Space);
         UntileWindowFromSpace(Window, Space, VirtualSpace);
@@ -1797,7 +1756,7 @@ bool SendWindowToMonitor(macos_window *Window, char *Op)
         goto dest_space_free;
     }
 
-    ValidWindow = ((!AXLibHasFlags(Window, Window_Float)) && (IsWindowValid(Window)));
+    ValidWindow = ((!WindowHasFlags(Window, Window_Float)) && (IsWindowValid(Window)));
     if (ValidWindow) {
         virtual_space *VirtualSpace = AcquireVirtualSpace(Space);
         UntileWindowFromSpace(Window, Space, VirtualSpace);
@@ -1980,7 +1939,7 @@ void GridLayout(macos_window *Window, char *Op)
     ASSERT(Space);
 
     virtual_space *VirtualSpace = AcquireVirtualSpace(Space);
-    if ((AXLibHasFlags(Window, Window_Float)) || (VirtualSpace->Mode == Virtual_Space_Float)) {
+    if ((WindowHasFlags(Window, Window_Float)) || (VirtualSpace->Mode == Virtual_Space_Float)) {
         unsigned GridRows, GridCols, WinX, WinY, WinWidth, WinHeight;
         if (sscanf(Op, "%d:%d:%d:%d:%d:%d", &GridRows, &GridCols, &WinX, &WinY, &WinWidth, &WinHeight) == 6) {
             WinX = WinX >= GridCols ? GridCols - 1 : WinX;
@@ -2028,6 +1987,7 @@ void EqualizeWindowTree(char *Unused)
         goto vspace_release;
     }
 
+    RecordLayoutHistory(VirtualSpace);
     EqualizeNodeTree(VirtualSpace->Tree);
     ResizeNodeRegion(VirtualSpace->Tree, Space, VirtualSpace);
     ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode);
@@ -2041,8 +2001,6 @@ space_free:
 
 void SerializeDesktop(char *Op)
 {
-    char *Buffer;
-    FILE *Handle;
     macos_space *Space;
     virtual_space *VirtualSpace;
 
@@ -2058,19 +2016,10 @@ void SerializeDesktop(char *Op)
         goto vspace_release;
     }
 
-    Buffer = SerializeNodeToBuffer(VirtualSpace->Tree);
-
-    Handle = fopen(Op, "w");
-    if (Handle) {
-        size_t Length = strlen(Buffer);
-        fwrite(Buffer, sizeof(char), Length, Handle);
-        fclose(Handle);
-    } else {
+    if (!SerializeNodeToFile(VirtualSpace->Tree, Op)) {
         c_log(C_LOG_LEVEL_ERROR, "failed to open '%s' for writing!\n", Op);
     }
 
-    free(Buffer);
-
 vspace_release:
     ReleaseVirtualSpace(VirtualSpace);
 
@@ -2080,7 +2029,7 @@ space_free:
 
 void DeserializeDesktop(char *Op)
 {
-    char *Buffer;
+    layout_file Layout;
     macos_space *Space;
     virtual_space *VirtualSpace;
 
@@ -2096,17 +2045,47 @@ void DeserializeDesktop(char *Op)
         goto vspace_release;
     }
 
-    Buffer = ReadFile(Op);
-    if (Buffer) {
+    if (BeginLayoutFile(Op, &Layout)) {
         if (VirtualSpace->Tree) {
-            FreeNodeTree(VirtualSpace->Tree, VirtualSpace->Mode);
+            RecordLayoutHistory(VirtualSpace);
+            FreeNodeTree(VirtualSpace);
         }
 
-        VirtualSpace->Tree = DeserializeNodeFromBuffer(Buffer);
+        VirtualSpace->Tree = DeserializeLayoutFile(&Layout, VirtualSpace);
+        EndLayoutFile(&Layout);
         CreateDeserializedWindowTreeForSpace(Space, VirtualSpace);
-        free(Buffer);
     } else {
-        c_log(C_LOG_LEVEL_ERROR, "failed to open '%s' for reading!\n", Op);
+        c_log(C_LOG_LEVEL_ERROR, "failed to load layout '%s'!\n", Op);
+    }
+
+vspace_release:
+    ReleaseVirtualSpace(VirtualSpace);
+
+space_free:
+    AXLibDestroySpace(Space);
+}
+
+internal void
+StepDesktopHistory(bool Redo)
+{
+    macos_space *Space;
+    virtual_space *VirtualSpace;
+
+    Space = GetActiveSpace();
+    ASSERT(Space);
+
+    if (Space->Type != kCGSSpaceUser) {
+        goto space_free;
+    }
+
+    VirtualSpace = AcquireVirtualSpace(Space);
+    if ((!VirtualSpace->Tree) || (VirtualSpace->Mode != Virtual_Space_Bsp)) {
+        goto vspace_release;
+    }
+
+    if (!(Redo ? RedoLayoutHistory(Space, VirtualSpace)
+               : UndoLayoutHistory(Space, VirtualSpace))) {
+        c_log(C_LOG_LEVEL_DEBUG, "chunkwm-tiling: no layout to %s on this desktop\n", Redo ? "redo" : "undo");
     }
 
 vspace_release:
@@ -2116,6 +2095,16 @@ space_free:
     AXLibDestroySpace(Space);
 }
 
+void UndoDesktop(char *Unused)
+{
+    StepDesktopHistory(false);
+}
+
+void RedoDesktop(char *Unused)
+{
+    StepDesktopHistory(true);
+}
+
 internal inline CGSSpaceID
 CurrentDesktopId(unsigned *DesktopId, unsigned *Arrangement, bool IncludeFullscreenSpaces)
 {
@@ -2129,25 +2118,9 @@ CurrentDesktopId(unsigned *DesktopId, unsigned *Arrangement, bool IncludeFullscr
     return Result;
 }
 
-void FocusDesktop(char *Op)
+internal void
+FocusDesktop(unsigned DesktopId, unsigned Arrangement, bool IncludeFullscreenSpaces)
 {
-    unsigned DesktopId = 0;
-    unsigned Arrangement = 0;
-    bool IncludeFullscreenSpaces = 0;
-    if (StringEquals(Op, "prev")) {
-        IncludeFullscreenSpaces = true;
-        CurrentDesktopId(&DesktopId, &Arrangement, IncludeFullscreenSpaces);
-        DesktopId -= 1;
-    } else if (StringEquals(Op, "next")) {
-        IncludeFullscreenSpaces = true;
-        CurrentDesktopId(&DesktopId, &Arrangement, IncludeFullscreenSpaces);
-        DesktopId += 1;
-    } else if (sscanf(Op, "%d", &DesktopId) == 1) {
-        CurrentDesktopId(NULL, &Arrangement, IncludeFullscreenSpaces);
-    } else {
-        return;
-    }
-
     CGSSpaceID SpaceId;
     unsigned DestArrangement = 0;
     bool Success = AXLibCGSSpaceIDFromDesktopID(DesktopId, &DestArrangement, &SpaceId, IncludeFullscreenSpaces);
@@ -2194,6 +2167,29 @@ void FocusDesktop(char *Op)
     }
 }
 
+void FocusDesktop(char *Op)
+{
+    int DesktopId;
+    unsigned CurrentDesktop = 0;
+    unsigned Arrangement = 0;
+    if (StringEquals(Op, "prev")) {
+        CurrentDesktopId(&CurrentDesktop, &Arrangement, true);
+        FocusDesktop(CurrentDesktop - 1, Arrangement, true);
+    } else if (StringEquals(Op, "next")) {
+        CurrentDesktopId(&CurrentDesktop, &Arrangement, true);
+        FocusDesktop(CurrentDesktop + 1, Arrangement, true);
+    } else if (sscanf(Op, "%d", &DesktopId) == 1) {
+        FocusDesktop(DesktopId);
+    }
+}
+
+void FocusDesktop(int DesktopId)
+{
+    unsigned Arrangement = 0;
+    CurrentDesktopId(NULL, &Arrangement, false);
+    FocusDesktop(DesktopId, Arrangement, false);
+}
+
 void CreateDesktop(char *Unused)
 {
     int SockFD;
@@ -2237,28 +2233,9 @@ space_free:
 out:;
 }
 
-void MoveDesktop(char *Op)
+internal void
+MoveDesktop(CGSSpaceID CurrentSpaceId, unsigned CurrentArrangement, unsigned Arrangement)
 {
-    CGSSpaceID CurrentSpaceId = 0;
-    unsigned DesktopId = 0;
-    unsigned CurrentArrangement = 0;
-    unsigned Arrangement = 0;
-    bool IncludeFullscreenSpaces = 0;
-    if (StringEquals(Op, "prev")) {
-        IncludeFullscreenSpaces = true;
-        CurrentSpaceId = CurrentDesktopId(&DesktopId, &CurrentArrangement, IncludeFullscreenSpaces);
-        Arrangement = CurrentArrangement - 1;
-    } else if (StringEquals(Op, "next")) {
-        IncludeFullscreenSpaces = true;
-        CurrentSpaceId = CurrentDesktopId(&DesktopId, &CurrentArrangement, IncludeFullscreenSpaces);
-        Arrangement = CurrentArrangement + 1;
-    } else if (sscanf(Op, "%d", &Arrangement) == 1) {
-        CurrentSpaceId = CurrentDesktopId(&DesktopId, &CurrentArrangement, IncludeFullscreenSpaces);
-        --Arrangement;
-    } else {
-        return;
-    }
-
     // TODO(koekeishiya): Do we want to allow monitor wrapping ??
     if (Arrangement == CurrentArrangement) return;
     if (Arrangement < 0) return;
@@ -2308,17 +2285,34 @@ void MoveDesktop(char *Op)
         ASSERT(Space);
         CFRelease(DisplayRef);
         virtual_space *VirtualSpace = AcquireVirtualSpace(Space);
-        VirtualSpaceAddFlags(VirtualSpace, Virtual_Space_Require_Resize);
-        VirtualSpaceAddFlags(VirtualSpace, Virtual_Space_Require_Region_Update);
+        VirtualSpaceDeferResize(VirtualSpace);
         ReleaseVirtualSpace(VirtualSpace);
-        char Op[256] = {};
         unsigned DesktopId = 0;
         AXLibCGSSpaceIDToDesktopID(Space->Id, NULL, &DesktopId);
-        snprintf(Op, sizeof(Op), "%d", DesktopId);
-        FocusDesktop(Op);
+        FocusDesktop(DesktopId);
     }
 }
 
+void MoveDesktop(char *Op)
+{
+    CGSSpaceID CurrentSpaceId;
+    unsigned CurrentArrangement = 0;
+    if (StringEquals(Op, "prev")) {
+        CurrentSpaceId = CurrentDesktopId(NULL, &CurrentArrangement, true);
+        MoveDesktop(CurrentSpaceId, CurrentArrangement, CurrentArrangement - 1);
+    } else if (StringEquals(Op, "next")) {
+        CurrentSpaceId = CurrentDesktopId(NULL, &CurrentArrangement, true);
+        MoveDesktop(CurrentSpaceId, CurrentArrangement, CurrentArrangement + 1);
+    }
+}
+
+void MoveDesktop(int MonitorId)
+{
+    unsigned CurrentArrangement = 0;
+    CGSSpaceID CurrentSpaceId = CurrentDesktopId(NULL, &CurrentArrangement, false);
+    MoveDesktop(CurrentSpaceId, CurrentArrangement, MonitorId - 1);
+}
+
 internal void
 QueryFocusedWindowFloat(int SockFD)
 {
@@ -2327,7 +2321,7 @@ QueryFocusedWindowFloat(int SockFD)
 
     Window = GetFocusedWindow();
     if (Window) {
-        snprintf(Message, sizeof(Message), "%d", AXLibHasFlags(Window, Window_Float));
+        snprintf(Message, sizeof(Message), "%d", WindowHasFlags(Window, Window_Float));
     } else {
         snprintf(Message, sizeof(Message), "?");
     }
@@ -2375,7 +2369,9 @@ QueryFocusedWindowName(int SockFD)
 
     Window = GetFocusedWindow();
     if (Window) {
-        snprintf(Message, sizeof(Message), "%s", Window->Name);
+        char *Name = CopyWindowName(Window);
+        snprintf(Message, sizeof(Message), "%s", Name);
+        free(Name);
     } else {
         snprintf(Message, sizeof(Message), "?");
     }
@@ -2407,7 +2403,7 @@ QueryWindowDetails(uint32_t WindowId, int SockFD)
     if (Window) {
         char *Mainrole = Window->Mainrole ? CopyCFStringToC(Window->Mainrole) : NULL;
         char *Subrole = Window->Subrole ? CopyCFStringToC(Window->Subrole) : NULL;
-        char *Name = AXLibGetWindowTitle(Window->Ref);
+        char *Name = CopyWindowName(Window);
 
         snprintf(Buffer, sizeof(Buffer),
                 "id: %d\n"
@@ -2424,8 +2420,8 @@ QueryWindowDetails(uint32_t WindowId, int SockFD)
                 Window->Owner->Name,
                 Mainrole ? Mainrole : "<unknown>",
                 Subrole ? Subrole : "<unknown>",
-                AXLibHasFlags(Window, Window_Movable),
-                AXLibHasFlags(Window, Window_Resizable));
+                WindowHasFlags(Window, Window_Movable),
+                WindowHasFlags(Window, Window_Resizable));
 
         if (Name)     { free(Name); }
         if (Subrole)  { free(Subrole); }
@@ -2439,7 +2435,6 @@ QueryWindowDetails(uint32_t WindowId, int SockFD)
 
 void QueryWindow(char *Op, int SockFD)
 {
-    uint32_t WindowId;
     if (StringEquals(Op, "id")) {
         QueryFocusedWindowId(SockFD);
     } else if (StringEquals(Op, "owner")) {
@@ -2450,11 +2445,14 @@ void QueryWindow(char *Op, int SockFD)
         QueryFocusedWindowTag(SockFD);
     } else if (StringEquals(Op, "float")) {
         QueryFocusedWindowFloat(SockFD);
-    } else if (sscanf(Op, "%d", &WindowId) == 1) {
-        QueryWindowDetails(WindowId, SockFD);
     }
 }
 
+void QueryWindow(int WindowId, int SockFD)
+{
+    QueryWindowDetails(WindowId, SockFD);
+}
+
 internal void
 QueryFocusedDesktop(int SockFD)
 {
@@ -2569,7 +2567,6 @@ QueryMonocleDesktopWindowCount(int SockFD)
 {
     virtual_space *VirtualSpace;
     char Message[512];
-    node *Node;
 
     unsigned int Count = 0;
     macos_space *Space = GetActiveSpace();
@@ -2579,11 +2576,7 @@ QueryMonocleDesktopWindowCount(int SockFD)
 
     VirtualSpace = AcquireVirtualSpace(Space);
     if (VirtualSpace->Mode == Virtual_Space_Monocle) {
-        Node = VirtualSpace->Tree;
-        while (Node) {
-            ++Count;
-            Node = Node->Right;
-        }
+        Count = VirtualSpace->Monocle.Count;
     }
     ReleaseVirtualSpace(VirtualSpace);
     AXLibDestroySpace(Space);
@@ -2600,8 +2593,6 @@ QueryMonocleDesktopWindowIndex(int SockFD)
     macos_window *Window;
     macos_space *Space;
     char Message[512];
-    node *ActiveNode;
-    node *Node;
     unsigned int Index = 0;
 
     if (!(Window = GetFocusedWindow())) {
@@ -2614,17 +2605,8 @@ QueryMonocleDesktopWindowIndex(int SockFD)
 
     VirtualSpace = AcquireVirtualSpace(Space);
     if (VirtualSpace->Mode == Virtual_Space_Monocle) {
-        if (VirtualSpace->Tree) {
-            ActiveNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
-            Node = VirtualSpace->Tree;
-            while (Node) {
-                ++Index;
-                if (ActiveNode == Node) {
-                    break;
-                }
-                Node = Node->Right;
-            }
-        }
+        // NOTE(koekeishiya): The index is 1-based, a window that is not tiled reports 0.
+        Index = MonocleWindowIndex(&VirtualSpace->Monocle, Window->Id) + 1;
     }
     ReleaseVirtualSpace(VirtualSpace);
     AXLibDestroySpace(Space);
@@ -2692,11 +2674,8 @@ void QueryMonitor(char *Op, int SockFD)
     }
 }
 
-void QueryWindowsForDesktop(char *Op, int SockFD)
+void QueryWindowsForDesktop(int DesktopId, int SockFD)
 {
-    int DesktopId;
-    if (sscanf(Op, "%d", &DesktopId) != 1) return;
-
     CGSSpaceID SpaceId;
     unsigned Arrangement;
     bool Success = AXLibCGSSpaceIDFromDesktopID(DesktopId, &Arrangement, &SpaceId);
@@ -2738,10 +2717,9 @@ void QueryWindowsForDesktop(char *Op, int SockFD)
     free(Buffer);
 }
 
-void QueryDesktopsForMonitor(char *Op, int SockFD)
+void QueryDesktopsForMonitor(int MonitorId, int SockFD)
 {
-    int MonitorId, Arrangement;
-    if (sscanf(Op, "%d", &MonitorId) != 1) return;
+    int Arrangement;
 
     int DisplayCount = AXLibDisplayCount();
     if (MonitorId > DisplayCount) return;
@@ -2778,11 +2756,8 @@ void QueryDesktopsForMonitor(char *Op, int SockFD)
     CFRelease(DisplayRef);
 }
 
-void QueryMonitorForDesktop(char *Op, int SockFD)
+void QueryMonitorForDesktop(int DesktopId, int SockFD)
 {
-    int DesktopId;
-    if (sscanf(Op, "%d", &DesktopId) != 1) return;
-
     CGSSpaceID SpaceId;
     unsigned Arrangement;
     bool Success = AXLibCGSSpaceIDFromDesktopID(DesktopId, &Arrangement, &SpaceId);
@@ -25,11 +25,12 @@ void GridLayout(macos_window *Window, char *Op);
 void GridLayout(char *Op);
 void CloseWindow(char *Unused);
 void FocusWindow(char *Direction);
+void FocusWindow(int WindowId);
 void SwapWindow(char *Direction);
 void WarpWindow(char *Direction);
 void ToggleWindow(char *Type);
 void UseInsertionPoint(char *Direction);
-void TemporaryRatio(char *Ratio);
+void TemporaryRatio(float Ratio);
 void AdjustWindowRatio(char *Direction);
 
 void RotateWindowTree(char *Degrees);
@@ -53,16 +54,21 @@ void FocusMonitor(char *Op);
 
 void SerializeDesktop(char *Op);
 void DeserializeDesktop(char *Op);
+void UndoDesktop(char *Unused);
+void RedoDesktop(char *Unused);
 void FocusDesktop(char *Op);
+void FocusDesktop(int DesktopId);
 void CreateDesktop(char *Unused);
 void DestroyDesktop(char *Unused);
 void MoveDesktop(char *Op);
+void MoveDesktop(int MonitorId);
 
 void QueryWindow(char *Op, int SockFD);
+void QueryWindow(int WindowId, int SockFD);
 void QueryDesktop(char *Op, int SockFD);
 void QueryMonitor(char *Op, int SockFD);
-void QueryWindowsForDesktop(char *Op, int SockFD);
-void QueryDesktopsForMonitor(char *Op, int SockFD);
-void QueryMonitorForDesktop(char *Op, int SockFD);
+void QueryWindowsForDesktop(int DesktopId, int SockFD);
+void QueryDesktopsForMonitor(int MonitorId, int SockFD);
+void QueryMonitorForDesktop(int DesktopId, int SockFD);
 
 #endif
@@ -0,0 +1,421 @@
+#include "frame.h"
+#include "constants.h"
+
+#include "../../common/accessibility/window.h"
+#include "../../common/accessibility/application.h"
+#include "../../common/config/cvar.h"
+#include "../../common/misc/assert.h"
+#include "../../common/misc/profile.h"
+
+#include <dispatch/dispatch.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <sys/time.h>
+#include <map>
+
+#define internal static
+
+struct frame_job
+{
+    pid_t PID;
+    const char *Name;
+    float Timeout;
+
+    frame_request *Requests;
+    int Count;
+
+    bool Done;
+    bool Abandoned;
+};
+
+typedef std::map<uint32_t, frame_request> frame_request_map;
+typedef frame_request_map::iterator frame_request_map_it;
+
+typedef std::map<pid_t, frame_request_map> unresponsive_application_map;
+typedef unresponsive_application_map::iterator unresponsive_application_map_it;
+
+/*
+ * NOTE(koekeishiya): Applications that did not finish a frame_job in time. The latest
+ * request for each of their windows is kept here and applied by the outstanding job
+ * once the application responds again. FrameLock protects this map, and the Done and
+ * Abandoned flags of every frame_job that is in flight. FrameJobDone is signalled
+ * whenever a job finishes.
+ *
+ * Every job is dispatched on FrameJobGroup, including the jobs that a batch stopped
+ * waiting for. EndFrameApply waits for the group to be empty before the lock and the
+ * map are destroyed, so no worker can still be running our code once the plugin is
+ * unloaded. FrameApplyStopping tells the workers to skip the frames they have left.
+ */
+internal unresponsive_application_map UnresponsiveApplications;
+internal pthread_mutex_t FrameLock;
+internal pthread_cond_t FrameJobDone;
+internal dispatch_group_t FrameJobGroup;
+internal volatile bool FrameApplyStopping;
+
+internal void
+CenterWindowInRegion(frame_request *Request)
+{
+    region Region = Request->Region;
+    CGPoint Position = AXLibGetWindowPosition(Request->Ref);
+    CGSize Size = AXLibGetWindowSize(Request->Ref);
+    Request->Position = Position;
+    Request->Size = Size;
+    Request->Moved = Request->Resized = true;
+
+    float DiffX = (Region.X + Region.Width) - (Position.x + Size.width);
+    float DiffY = (Region.Y + Region.Height) - (Position.y + Size.height);
+
+    if ((DiffX > 0.0f) || (DiffY > 0.0f)) {
+        float OffsetX = DiffX / 2.0f;
+        Region.X += OffsetX;
+        Region.Width -= OffsetX;
+
+        float OffsetY = DiffY / 2.0f;
+        Region.Y += OffsetY;
+        Region.Height -= OffsetY;
+
+        if (AXLibSetWindowPosition(Request->Ref, Region.X, Region.Y)) {
+            Request->Position = CGPointMake(Region.X, Region.Y);
+        }
+
+        if (AXLibSetWindowSize(Request->Ref, Region.Width, Region.Height)) {
+            Request->Size = CGSizeMake(Region.Width, Region.Height);
+        }
+    }
+}
+
+/*
+ * NOTE(koekeishiya): Limit how long each of the AX calls below may block. The timeout
+ * is set on the element of the window that every other part of the plugin uses too, so
+ * it is reset afterwards; a timeout of 0 makes the element use the global timeout again.
+ */
+internal void
+SetWindowFrame(frame_request *Request, float Timeout)
+{
+    AXUIElementSetMessagingTimeout(Request->Ref, Timeout);
+
+    region Region = Request->Region;
+    Request->Moved = AXLibSetWindowPosition(Request->Ref, Region.X, Region.Y);
+    if (Request->Moved) {
+        Request->Position = CGPointMake(Region.X, Region.Y);
+    }
+
+    Request->Resized = AXLibSetWindowSize(Request->Ref, Region.Width, Region.Height);
+    if (Request->Resized) {
+        Request->Size = CGSizeMake(Region.Width, Region.Height);
+    }
+
+    if (Request->Center) {
+        if (Request->Moved || Request->Resized) {
+            CenterWindowInRegion(Request);
+        }
+    }
+
+    AXUIElementSetMessagingTimeout(Request->Ref, 0);
+}
+
+internal void
+FreeFrameJob(frame_job *Job)
+{
+    for (int Index = 0; Index < Job->Count; ++Index) {
+        CFRelease(Job->Requests[Index].Ref);
+    }
+
+    free(Job->Requests);
+    free(Job);
+}
+
+internal void
+FrameJobThreadProc(void *Context)
+{
+    frame_job *Job = (frame_job *) Context;
+
+    for (int Index = 0; Index < Job->Count; ++Index) {
+        if (FrameApplyStopping) break;
+        SetWindowFrame(Job->Requests + Index, Job->Timeout);
+    }
+
+    pthread_mutex_lock(&FrameLock);
+    if (!Job->Abandoned) {
+        Job->Done = true;
+        pthread_cond_broadcast(&FrameJobDone);
+        pthread_mutex_unlock(&FrameLock);
+        return;
+    }
+
+    /*
+     * NOTE(koekeishiya): The batch that dispatched this job stopped waiting for us.
+     * The application is responding again, so we apply the frames that were requested
+     * in the meantime before we allow new batches to talk to it directly.
+     */
+    while (!FrameApplyStopping) {
+        unresponsive_application_map_it It = UnresponsiveApplications.find(Job->PID);
+        ASSERT(It != UnresponsiveApplications.end());
+
+        if (It->second.empty()) {
+            UnresponsiveApplications.erase(It);
+            break;
+        }
+
+        frame_request Request = It->second.begin()->second;
+        It->second.erase(It->second.begin());
+        pthread_mutex_unlock(&FrameLock);
+
+        SetWindowFrame(&Request, Job->Timeout);
+        CFRelease(Request.Ref);
+
+        pthread_mutex_lock(&FrameLock);
+    }
+    pthread_mutex_unlock(&FrameLock);
+
+    if (!FrameApplyStopping) {
+        c_log(C_LOG_LEVEL_DEBUG, "chunkwm-tiling: application %d is responding again\n", Job->PID);
+    }
+
+    FreeFrameJob(Job);
+}
+
+internal void
+DeferFrameRequest(frame_request_map *Deferred, frame_request *Request)
+{
+    frame_request_map_it It = Deferred->find(Request->Window->Id);
+    if (It != Deferred->end()) {
+        CFRelease(It->second.Ref);
+    }
+
+    (*Deferred)[Request->Window->Id] = *Request;
+    Request->Ref = NULL;
+}
+
+internal void
+CopyFrameRequestResult(frame_request *Request)
+{
+    if (Request->Moved) {
+        Request->Window->Position = Request->Position;
+    }
+
+    if (Request->Resized) {
+        Request->Window->Size = Request->Size;
+    }
+}
+
+void BeginFrameBatch(frame_batch *Batch)
+{
+    Batch->Requests = NULL;
+    Batch->Count = 0;
+    Batch->Capacity = 0;
+}
+
+void FrameBatchAdd(frame_batch *Batch, macos_window *Window, region Region, bool Center)
+{
+    if (Batch->Count == Batch->Capacity) {
+        Batch->Capacity = Batch->Capacity ? Batch->Capacity * 2 : 16;
+        Batch->Requests = (frame_request *) realloc(Batch->Requests, sizeof(frame_request) * Batch->Capacity);
+    }
+
+    frame_request *Request = Batch->Requests + Batch->Count++;
+    memset(Request, 0, sizeof(frame_request));
+
+    Request->Window = Window;
+    Request->Ref = (AXUIElementRef) CFRetain(Window->Ref);
+    Request->PID = Window->Owner->PID;
+    Request->Region = Region;
+    Request->Center = Center;
+}
+
+internal struct timespec
+FrameJobDeadline(float Timeout)
+{
+    struct timeval Now;
+    gettimeofday(&Now, NULL);
+
+    int64_t Nanoseconds = (int64_t) Now.tv_usec * 1000 + (int64_t)(Timeout * NSEC_PER_SEC);
+
+    struct timespec Result;
+    Result.tv_sec = Now.tv_sec + Nanoseconds / NSEC_PER_SEC;
+    Result.tv_nsec = Nanoseconds % NSEC_PER_SEC;
+    return Result;
+}
+
+// NOTE(koekeishiya): The caller must hold FrameLock.
+internal bool
+AreFrameJobsDone(frame_job **Jobs, int JobCount)
+{
+    for (int Job = 0; Job < JobCount; ++Job) {
+        if (!Jobs[Job]->Done) return false;
+    }
+
+    return true;
+}
+
+/*
+ * NOTE(koekeishiya): Group the requests by owning application and apply every group on
+ * a worker thread. We wait for all groups to finish, or for the timeout to expire. The
+ * frames of groups that finished in time are written back to the window, so that later
+ * layout passes can skip windows that are already in place.
+ */
+internal void
+ApplyFrameBatch(frame_batch *Batch)
+{
+    BEGIN_TIMED_BLOCK();
+
+    float Timeout = CVarFloatingPointValue(CVAR_WINDOW_FRAME_TIMEOUT);
+
+    /*
+     * NOTE(koekeishiya): The scratch arrays of a batch are carved out of a single allocation,
+     * ordered by alignment, and released when the batch has been applied.
+     */
+    size_t Count = Batch->Count;
+    char *Scratch = (char *) malloc(Count * (sizeof(frame_job *) + sizeof(const char *) +
+                                             sizeof(int) + sizeof(bool)));
+    frame_job **Jobs = (frame_job **) Scratch;
+    const char **JobNames = (const char **) (Jobs + Count);
+    int *JobIndex = (int *) (JobNames + Count);
+    bool *Done = (bool *) (JobIndex + Count);
+    int JobCount = 0;
+
+    pthread_mutex_lock(&FrameLock);
+    for (int Index = 0; Index < Batch->Count; ++Index) {
+        frame_request *Request = Batch->Requests + Index;
+        JobIndex[Index] = -1;
+
+        unresponsive_application_map_it It = UnresponsiveApplications.find(Request->PID);
+        if (It != UnresponsiveApplications.end()) {
+            DeferFrameRequest(&It->second, Request);
+            continue;
+        }
+
+        for (int Job = 0; Job < JobCount; ++Job) {
+            if (Jobs[Job]->PID == Request->PID) {
+                JobIndex[Index] = Job;
+                break;
+            }
+        }
+
+        if (JobIndex[Index] == -1) {
+            frame_job *Job = (frame_job *) malloc(sizeof(frame_job));
+            memset(Job, 0, sizeof(frame_job));
+            Job->PID = Request->PID;
+            Job->Name = Request->Window->Owner->Name;
+            Job->Timeout = Timeout;
+            JobIndex[Index] = JobCount;
+            JobNames[JobCount] = Job->Name;
+            Jobs[JobCount++] = Job;
+        }
+
+        ++Jobs[JobIndex[Index]]->Count;
+    }
+    pthread_mutex_unlock(&FrameLock);
+
+    for (int Job = 0; Job < JobCount; ++Job) {
+        Jobs[Job]->Requests = (frame_request *) malloc(sizeof(frame_request) * Jobs[Job]->Count);
+        Jobs[Job]->Count = 0;
+    }
+
+    for (int Index = 0; Index < Batch->Count; ++Index) {
+        if (JobIndex[Index] != -1) {
+            frame_job *Job = Jobs[JobIndex[Index]];
+            Job->Requests[Job->Count++] = Batch->Requests[Index];
+        }
+    }
+
+    if (JobCount > 0) {
+        dispatch_queue_t Queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_HIGH, 0);
+        for (int Job = 0; Job < JobCount; ++Job) {
+            dispatch_group_async_f(FrameJobGroup, Queue, Jobs[Job], &FrameJobThreadProc);
+        }
+    }
+
+    struct timespec Deadline = FrameJobDeadline(Timeout);
+
+    pthread_mutex_lock(&FrameLock);
+    while (!AreFrameJobsDone(Jobs, JobCount)) {
+        if (pthread_cond_timedwait(&FrameJobDone, &FrameLock, &Deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+
+    for (int Job = 0; Job < JobCount; ++Job) {
+        Done[Job] = Jobs[Job]->Done;
+        if (!Done[Job]) {
+            Jobs[Job]->Abandoned = true;
+            UnresponsiveApplications[Jobs[Job]->PID];
+        }
+    }
+    pthread_mutex_unlock(&FrameLock);
+
+    for (int Job = 0; Job < JobCount; ++Job) {
+        frame_job *FrameJob = Jobs[Job];
+        const char *Name = JobNames[Job];
+
+        if (Done[Job]) {
+            for (int Index = 0; Index < FrameJob->Count; ++Index) {
+                CopyFrameRequestResult(FrameJob->Requests + Index);
+            }
+            FreeFrameJob(FrameJob);
+        } else {
+            // NOTE(koekeishiya): The job now belongs to the worker thread, do not touch it.
+            c_log(C_LOG_LEVEL_WARN,
+                  "chunkwm-tiling: application '%s' did not respond within %.2fs, its windows will be updated later\n",
+                  Name, Timeout);
+        }
+    }
+
+    free(Scratch);
+    END_TIMED_BLOCK();
+}
+
+void CommitFrameBatch(frame_batch *Batch)
+{
+    if (Batch->Count > 0) {
+        ApplyFrameBatch(Batch);
+    }
+
+    free(Batch->Requests);
+    BeginFrameBatch(Batch);
+}
+
+bool BeginFrameApply()
+{
+    if (pthread_mutex_init(&FrameLock, NULL) != 0) {
+        return false;
+    }
+
+    if (pthread_cond_init(&FrameJobDone, NULL) != 0) {
+        pthread_mutex_destroy(&FrameLock);
+        return false;
+    }
+
+    FrameApplyStopping = false;
+    FrameJobGroup = dispatch_group_create();
+    return true;
+}
+
+/*
+ * NOTE(koekeishiya): Every AX call made by a worker is bounded by the frame timeout, and
+ * workers stop applying frames once FrameApplyStopping is set, so this does not wait for
+ * longer than a single AX call per unresponsive application.
+ */
+void EndFrameApply()
+{
+    FrameApplyStopping = true;
+    dispatch_group_wait(FrameJobGroup, DISPATCH_TIME_FOREVER);
+    dispatch_release(FrameJobGroup);
+
+    pthread_mutex_lock(&FrameLock);
+    for (unresponsive_application_map_it It = UnresponsiveApplications.begin();
+         It != UnresponsiveApplications.end();
+         ++It) {
+        for (frame_request_map_it RequestIt = It->second.begin();
+             RequestIt != It->second.end();
+             ++RequestIt) {
+            CFRelease(RequestIt->second.Ref);
+        }
+    }
+    UnresponsiveApplications.clear();
+    pthread_mutex_unlock(&FrameLock);
+
+    pthread_cond_destroy(&FrameJobDone);
+    pthread_mutex_destroy(&FrameLock);
+}
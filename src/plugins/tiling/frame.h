@@ -0,0 +1,47 @@
+#ifndef PLUGIN_FRAME_H
+#define PLUGIN_FRAME_H
+
+#include <Carbon/Carbon.h>
+#include <stdint.h>
+
+#include "region.h"
+
+struct macos_window;
+
+struct frame_request
+{
+    macos_window *Window;
+    AXUIElementRef Ref;
+    pid_t PID;
+
+    region Region;
+    bool Center;
+
+    bool Moved;
+    bool Resized;
+    CGPoint Position;
+    CGSize Size;
+};
+
+/*
+ * NOTE(koekeishiya): Setting the frame of a window is a synchronous call into the
+ * process that owns the window. A frame_batch collects the requests made during a
+ * layout pass, so that they can be grouped by application and applied in parallel.
+ * Applications that do not finish within the configured timeout are reported, and
+ * their windows are updated once the application responds again.
+ */
+struct frame_batch
+{
+    frame_request *Requests;
+    int Count;
+    int Capacity;
+};
+
+bool BeginFrameApply();
+void EndFrameApply();
+
+void BeginFrameBatch(frame_batch *Batch);
+void FrameBatchAdd(frame_batch *Batch, macos_window *Window, region Region, bool Center);
+void CommitFrameBatch(frame_batch *Batch);
+
+#endif
@@ -0,0 +1,47 @@
+/*
+ * NOTE(koekeishiya): Unity build of the parts of the tiling plugin that do not depend on
+ * macOS: the bsp-tree, virtual space, monocle, region, adjacency, layout and history code,
+ * the window table and the window rule index. The windowing system is only reached through
+ * the window_backend that the host registers with SetWindowBackend.
+ *
+ * The makefile builds this as a static library (make headless), so that the layout code
+ * can be compiled and profiled on machines that are not running macOS.
+ */
+
+#include "../../api/plugin_api.h"
+#include "../../common/config/cvar.h"
+#include "../../common/config/tokenize.h"
+#include "../../common/misc/assert.h"
+
+#include "../../common/config/cvar.cpp"
+#include "../../common/config/tokenize.cpp"
+
+#include "pool.h"
+#include "index.h"
+#include "history.h"
+#include "adjacency.h"
+#include "region.h"
+#include "backend.h"
+#include "monocle.h"
+#include "node.h"
+#include "vspace.h"
+#include "layout.h"
+#include "constants.h"
+#include "table.h"
+#include "ruleindex.h"
+
+// NOTE(koekeishiya): Set by the host, the same way the plugin receives it from chunkwm.
+chunkwm_log *c_log;
+
+#include "pool.cpp"
+#include "index.cpp"
+#include "adjacency.cpp"
+#include "region.cpp"
+#include "backend.cpp"
+#include "monocle.cpp"
+#include "node.cpp"
+#include "vspacebase.cpp"
+#include "layout.cpp"
+#include "history.cpp"
+#include "table.cpp"
+#include "ruleindex.cpp"
@@ -0,0 +1,786 @@
+/*
+ * NOTE(koekeishiya): Benchmarks for the headless library (make bench). Trees of three
+ * shapes are built with 10 to 10000 leaves: balanced trees grow the way the plugin tiles
+ * windows, degenerate trees always split the leftmost leaf, and random trees split a random
+ * leaf. The window table is timed with 500 and 5000 windows, and the window rule index
+ * with 500 rules and 1000 windows. Every operation is repeated until it has run for a
+ * while, and the time per run is reported. Results are written as csv, or as json with
+ * --json.
+ */
+
+#include "host.h"
+#include "../layout.h"
+#include "../adjacency.h"
+#include "../constants.h"
+#include "../table.h"
+#include "../ruleindex.h"
+#include "../../../common/config/cvar.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <regex.h>
+#include <vector>
+#include <map>
+#include <string>
+
+#include "host.cpp"
+
+#define internal static
+#define ArrayCount(Array) (sizeof(Array) / sizeof((Array)[0]))
+
+#define BENCH_DISPLAY_REGION { 0, 0, 2560, 1440, Region_Full }
+#define BENCH_MIN_NANOSECONDS 20000000ULL
+
+enum bench_shape
+{
+    Bench_Shape_Balanced,
+    Bench_Shape_Degenerate,
+    Bench_Shape_Random,
+};
+
+internal const char *bench_shape_str[] =
+{
+    "balanced",
+    "degenerate_left",
+    "random"
+};
+
+struct bench_result
+{
+    const char *Group;
+    const char *Shape;
+    uint32_t Size;
+    const char *Operation;
+    uint32_t Iterations;
+    double Nanoseconds;
+};
+
+internal std::vector<bench_result> Results;
+internal char BenchDirectory[64];
+
+internal uint64_t
+BenchClock()
+{
+    struct timespec Time;
+    clock_gettime(CLOCK_MONOTONIC, &Time);
+    return (uint64_t) Time.tv_sec * 1000000000ULL + Time.tv_nsec;
+}
+
+internal void
+RecordResult(const char *Group, const char *Shape, uint32_t Size,
+             const char *Operation, uint32_t Iterations, uint64_t Elapsed)
+{
+    bench_result Result = { Group, Shape, Size, Operation, Iterations, (double) Elapsed / Iterations };
+    Results.push_back(Result);
+    fprintf(stderr, "%-10s %-16s %6u %-16s %12.0f ns\n", Group, Shape, Size, Operation, Result.Nanoseconds);
+}
+
+/*
+ * NOTE(koekeishiya): Runs an operation on the same data until enough time has passed.
+ * Only used for operations that leave the shape of the data intact.
+ */
+#define BENCH_REPEAT(Group, Shape, Size, Name, Statement) do {   \
+    uint32_t Iterations = 0;                                     \
+    uint64_t Begin = BenchClock(), Elapsed;                      \
+    do {                                                         \
+        Statement;                                               \
+        ++Iterations;                                            \
+        Elapsed = BenchClock() - Begin;                          \
+    } while (Elapsed < BENCH_MIN_NANOSECONDS);                   \
+    RecordResult(Group, Shape, Size, Name, Iterations, Elapsed); \
+    } while(0)
+
+internal void
+SplitLeafNode(virtual_space *VirtualSpace, node *Node, uint32_t WindowId)
+{
+    node_split Split = OptimalSplitMode(Node);
+    CreateLeafNodePair(Node, Node->WindowId, WindowId, Split, NULL, VirtualSpace);
+}
+
+// NOTE(koekeishiya): Window ids are 1..Count, the first window is the root.
+internal void
+BuildBenchTree(virtual_space *VirtualSpace, bench_shape Shape, uint32_t Count)
+{
+    VirtualSpace->Tree = CreateRootNode(1, NULL, VirtualSpace);
+    node *Leftmost = VirtualSpace->Tree;
+
+    for (uint32_t WindowId = 2; WindowId <= Count; ++WindowId) {
+        switch (Shape) {
+        case Bench_Shape_Balanced: {
+            HeadlessTileWindow(VirtualSpace, WindowId, false);
+        } break;
+        case Bench_Shape_Degenerate: {
+            // NOTE(koekeishiya): bsp_spawn_left is set, so the new window is the left child.
+            SplitLeafNode(VirtualSpace, Leftmost, WindowId);
+            Leftmost = Leftmost->Left;
+        } break;
+        case Bench_Shape_Random: {
+            node *Node = GetNodeWithId(VirtualSpace, 1 + rand() % (WindowId - 1));
+            SplitLeafNode(VirtualSpace, Node, WindowId);
+        } break;
+        }
+    }
+}
+
+internal uint32_t
+CountNodes(node *Node)
+{
+    return Node ? 1 + CountNodes(Node->Left) + CountNodes(Node->Right) : 0;
+}
+
+internal void
+BenchTileAndUntile(bench_shape Shape, uint32_t Size)
+{
+    const char *ShapeName = bench_shape_str[Shape];
+    uint64_t TileElapsed = 0, UntileElapsed = 0;
+    uint32_t Iterations = 0;
+
+    std::vector<uint32_t> Order(Size);
+    for (uint32_t Index = 0; Index < Size; ++Index) {
+        Order[Index] = Index + 1;
+    }
+
+    do {
+        virtual_space VirtualSpace;
+        InitVirtualSpace(&VirtualSpace, Virtual_Space_Bsp);
+
+        uint64_t Begin = BenchClock();
+        BuildBenchTree(&VirtualSpace, Shape, Size);
+        TileElapsed += BenchClock() - Begin;
+
+        for (uint32_t Index = Size - 1; Index > 0; --Index) {
+            uint32_t Other = rand() % (Index + 1);
+            uint32_t Temp = Order[Index];
+            Order[Index] = Order[Other];
+            Order[Other] = Temp;
+        }
+
+        Begin = BenchClock();
+        for (uint32_t Index = 0; Index < Size; ++Index) {
+            HeadlessUntileWindow(&VirtualSpace, Order[Index], false);
+        }
+        UntileElapsed += BenchClock() - Begin;
+
+        FreeVirtualSpace(&VirtualSpace);
+        ++Iterations;
+    } while (TileElapsed + UntileElapsed < BENCH_MIN_NANOSECONDS);
+
+    RecordResult("tree", ShapeName, Size, "tile", Iterations, TileElapsed);
+    RecordResult("tree", ShapeName, Size, "untile", Iterations, UntileElapsed);
+}
+
+internal void
+BenchTeardown(bench_shape Shape, uint32_t Size)
+{
+    virtual_space VirtualSpace;
+    InitVirtualSpace(&VirtualSpace, Virtual_Space_Bsp);
+
+    // NOTE(koekeishiya): Building the tree is far slower than freeing it, so stop on wall time.
+    uint64_t Elapsed = 0;
+    uint32_t Iterations = 0;
+    uint64_t Start = BenchClock();
+    do {
+        srand(Size);
+        BuildBenchTree(&VirtualSpace, Shape, Size);
+
+        uint64_t Begin = BenchClock();
+        FreeNodeTree(&VirtualSpace);
+        Elapsed += BenchClock() - Begin;
+        ++Iterations;
+    } while (BenchClock() - Start < BENCH_MIN_NANOSECONDS);
+
+    RecordResult("tree", bench_shape_str[Shape], Size, "teardown", Iterations, Elapsed);
+    FreeVirtualSpace(&VirtualSpace);
+}
+
+internal void
+BenchLayoutLoad(virtual_space *VirtualSpace, bench_shape Shape, uint32_t Size, const char *Extension)
+{
+    char Path[256];
+    snprintf(Path, sizeof(Path), "%s/layout%s", BenchDirectory, Extension);
+    SerializeNodeToFile(VirtualSpace->Tree, Path);
+
+    virtual_space Restored;
+    InitVirtualSpace(&Restored, Virtual_Space_Bsp);
+
+    const char *Name = *Extension ? "load_binary" : "load_text";
+    BENCH_REPEAT("tree", bench_shape_str[Shape], Size, Name, {
+        layout_file File;
+        if (BeginLayoutFile(Path, &File)) {
+            Restored.Tree = DeserializeLayoutFile(&File, &Restored);
+            EndLayoutFile(&File);
+        }
+        FreeNodeTree(&Restored);
+    });
+
+    FreeVirtualSpace(&Restored);
+    unlink(Path);
+}
+
+internal void
+BenchTree(bench_shape Shape, uint32_t Size)
+{
+    const char *ShapeName = bench_shape_str[Shape];
+
+    BenchTileAndUntile(Shape, Size);
+    BenchTeardown(Shape, Size);
+
+    virtual_space VirtualSpace;
+    InitVirtualSpace(&VirtualSpace, Virtual_Space_Bsp);
+    srand(Size);
+    BuildBenchTree(&VirtualSpace, Shape, Size);
+    node *Tree = VirtualSpace.Tree;
+
+    BENCH_REPEAT("tree", ShapeName, Size, "regions", {
+        CreateNodeRegion(Tree, Region_Full, NULL, &VirtualSpace);
+        CreateNodeRegionRecursive(Tree, false, NULL, &VirtualSpace);
+    });
+
+    BENCH_REPEAT("tree", ShapeName, Size, "apply", ApplyNodeRegion(Tree, VirtualSpace.Mode));
+    BENCH_REPEAT("tree", ShapeName, Size, "equalize", EqualizeNodeTree(Tree));
+    BENCH_REPEAT("tree", ShapeName, Size, "rotate", RotateBSPTree(Tree, (char *) "90"));
+    BENCH_REPEAT("tree", ShapeName, Size, "mirror", MirrorBSPTree(Tree, Split_Vertical));
+
+    // NOTE(koekeishiya): Rotate and mirror move nodes around, rebuild the regions before any lookups.
+    CreateNodeRegion(Tree, Region_Full, NULL, &VirtualSpace);
+    CreateNodeRegionRecursive(Tree, false, NULL, &VirtualSpace);
+
+    std::vector<node *> Leaves;
+    for (node *Node = GetFirstLeafNode(Tree); Node; Node = GetNextLeafNode(Node)) {
+        Leaves.push_back(Node);
+    }
+
+    BENCH_REPEAT("tree", ShapeName, Size, "id_lookup", {
+        for (uint32_t WindowId = 1; WindowId <= Size; ++WindowId) {
+            GetNodeWithId(&VirtualSpace, WindowId);
+        }
+    });
+
+    BENCH_REPEAT("tree", ShapeName, Size, "point_lookup", {
+        for (size_t Index = 0; Index < Leaves.size(); ++Index) {
+            region *Region = &Leaves[Index]->Region;
+            GetNodeForPoint(Tree, Region->X + Region->Width / 2, Region->Y + Region->Height / 2);
+        }
+    });
+
+    directions Directions[] = { Dir_North, Dir_East, Dir_South, Dir_West };
+
+    // NOTE(koekeishiya): One directional command right after a layout change, e.g focus east.
+    BENCH_REPEAT("tree", ShapeName, Size, "adjacent_cold", {
+        InvalidateAdjacencyGraph(&VirtualSpace);
+        GetAdjacentNode(&VirtualSpace, Leaves[Leaves.size() / 2], Dir_East);
+    });
+
+    InvalidateAdjacencyGraph(&VirtualSpace);
+    for (size_t Index = 0; Index < Leaves.size(); ++Index) {
+        GetAdjacentNode(&VirtualSpace, Leaves[Index], Directions[Index % ArrayCount(Directions)]);
+    }
+
+    BENCH_REPEAT("tree", ShapeName, Size, "adjacent_warm", {
+        for (size_t Index = 0; Index < Leaves.size(); ++Index) {
+            GetAdjacentNode(&VirtualSpace, Leaves[Index], Directions[Index % ArrayCount(Directions)]);
+        }
+    });
+
+    BENCH_REPEAT("tree", ShapeName, Size, "serialize_text", free(SerializeNodeToBuffer(Tree)));
+    BENCH_REPEAT("tree", ShapeName, Size, "serialize_binary", {
+        size_t BinarySize;
+        free(SerializeNodeToBinary(Tree, &BinarySize));
+    });
+
+    BenchLayoutLoad(&VirtualSpace, Shape, Size, "");
+    BenchLayoutLoad(&VirtualSpace, Shape, Size, LAYOUT_BINARY_EXTENSION);
+
+    BENCH_REPEAT("tree", ShapeName, Size, "checkpoint", {
+        layout_buffer Buffer;
+        BeginSpaceStateBuffer(&Buffer);
+        SerializeSpaceState(&Buffer, 1, &VirtualSpace);
+        free(Buffer.Data);
+    });
+
+    ASSERT(CountNodes(Tree) == 2 * Size - 1);
+    FreeVirtualSpace(&VirtualSpace);
+}
+
+/*
+ * NOTE(koekeishiya): The window table is compared with the std::map of window pointers
+ * that it replaced. The struct below has the fields of the macos_window from the
+ * accessibility library with the CoreFoundation types replaced by pointers, and the
+ * flags are the ones that IsWindowValid in plugin.mm looks at.
+ */
+struct macos_window
+{
+    void *Ref;
+    void *Mainrole;
+    void *Subrole;
+    void *Owner;
+    uint32_t Id;
+    char *Name;
+
+    uint32_t volatile Flags;
+    uint32_t Level;
+
+    double Position[2];
+    double Size[2];
+};
+
+enum bench_window_flags
+{
+    Bench_Window_Movable = (1 << 1),
+    Bench_Window_Resizable = (1 << 2),
+    Bench_Window_Float = (1 << 4),
+    Bench_Window_Invalid = (1 << 6),
+    Bench_Window_ForceTile = (1 << 7),
+};
+
+typedef std::map<uint32_t, macos_window *> bench_window_map;
+typedef bench_window_map::iterator bench_window_map_it;
+
+internal uintptr_t volatile BenchSink;
+
+internal inline bool
+IsBenchWindowValid(uint32_t Flags, bool Standard)
+{
+    bool Result;
+    if (Flags & Bench_Window_Invalid) {
+        Result = false;
+    } else if (Flags & Bench_Window_ForceTile) {
+        Result = true;
+    } else {
+        Result = ((Standard) &&
+                  (Flags & Bench_Window_Movable) &&
+                  (Flags & Bench_Window_Resizable));
+    }
+    return Result;
+}
+
+internal inline uint32_t
+BenchWindowTableFlags(macos_window *Window)
+{
+    return Window->Subrole ? Window->Flags | Window_Table_Standard : Window->Flags;
+}
+
+// NOTE(koekeishiya): Same as GetAllVisibleWindowsForSpace before the window table.
+internal void
+FilterWindowsWithMap(bench_window_map *Map, std::vector<uint32_t> &WindowList, std::vector<uint32_t> &Result)
+{
+    Result.clear();
+    for (size_t Index = 0; Index < WindowList.size(); ++Index) {
+        bench_window_map_it It = Map->find(WindowList[Index]);
+        if (It == Map->end()) continue;
+
+        macos_window *Window = It->second;
+        if (IsBenchWindowValid(Window->Flags, Window->Subrole != NULL) &&
+            !(Window->Flags & Bench_Window_Float)) {
+            Result.push_back(Window->Id);
+        }
+    }
+}
+
+internal void
+FilterWindowsWithTable(window_table *Table, std::vector<uint32_t> &WindowList, std::vector<uint32_t> &Result)
+{
+    Result.clear();
+    for (size_t Index = 0; Index < WindowList.size(); ++Index) {
+        int Slot = WindowTableSlot(Table, WindowList[Index]);
+        if (Slot == -1) continue;
+
+        uint32_t Flags = Table->Flags[Slot];
+        if (IsBenchWindowValid(Flags, Flags & Window_Table_Standard) &&
+            !(Flags & Bench_Window_Float)) {
+            Result.push_back(WindowList[Index]);
+        }
+    }
+}
+
+/*
+ * NOTE(koekeishiya): Windows are allocated one at a time between unrelated allocations, the
+ * way the plugin creates them over a session. The window list of a space holds half of the
+ * windows we track, and some windows that chunkwm never reported, in random order.
+ */
+internal void
+BenchWindowTable(uint32_t Size)
+{
+    std::vector<macos_window *> Windows(Size);
+    std::vector<void *> Padding(Size);
+
+    for (uint32_t Index = 0; Index < Size; ++Index) {
+        macos_window *Window = (macos_window *) calloc(1, sizeof(macos_window));
+        Window->Id = 100 + Index * 7;
+        Window->Level = 0;
+        Window->Subrole = (rand() % 10) ? Window : NULL;
+        Window->Flags = Bench_Window_Movable | Bench_Window_Resizable;
+        if (rand() % 10 == 0) Window->Flags |= Bench_Window_Float;
+        if (rand() % 20 == 0) Window->Flags |= Bench_Window_Invalid;
+        Windows[Index] = Window;
+        Padding[Index] = malloc(16 + rand() % 256);
+    }
+
+    std::vector<uint32_t> WindowList;
+    for (uint32_t Index = 0; Index < Size; Index += 2) {
+        WindowList.push_back(Windows[Index]->Id);
+    }
+    for (uint32_t Index = 0; Index < Size / 10; ++Index) {
+        WindowList.push_back(1 + Index * 7);
+    }
+    for (size_t Index = WindowList.size() - 1; Index > 0; --Index) {
+        size_t Other = rand() % (Index + 1);
+        uint32_t Temp = WindowList[Index];
+        WindowList[Index] = WindowList[Other];
+        WindowList[Other] = Temp;
+    }
+
+    bench_window_map Map;
+    window_table Table;
+    InitWindowTable(&Table);
+
+    BENCH_REPEAT("windows", "map", Size, "insert", {
+        Map.clear();
+        for (uint32_t Index = 0; Index < Size; ++Index) {
+            Map[Windows[Index]->Id] = Windows[Index];
+        }
+    });
+
+    BENCH_REPEAT("windows", "table", Size, "insert", {
+        ClearWindowTable(&Table);
+        for (uint32_t Index = 0; Index < Size; ++Index) {
+            macos_window *Window = Windows[Index];
+            WindowTableInsert(&Table, Window, Window->Id, BenchWindowTableFlags(Window), Window->Level, 0);
+        }
+    });
+
+    BENCH_REPEAT("windows", "map", Size, "lookup", {
+        for (uint32_t Index = 0; Index < Size; ++Index) {
+            BenchSink += (uintptr_t) Map.find(Windows[Index]->Id)->second;
+        }
+    });
+
+    BENCH_REPEAT("windows", "table", Size, "lookup", {
+        for (uint32_t Index = 0; Index < Size; ++Index) {
+            BenchSink += (uintptr_t) WindowTableLookup(&Table, Windows[Index]->Id);
+        }
+    });
+
+    std::vector<uint32_t> MapResult, TableResult;
+
+    BENCH_REPEAT("windows", "map", Size, "space_filter", {
+        FilterWindowsWithMap(&Map, WindowList, MapResult);
+        BenchSink += MapResult.size();
+    });
+
+    BENCH_REPEAT("windows", "table", Size, "space_filter", {
+        FilterWindowsWithTable(&Table, WindowList, TableResult);
+        BenchSink += TableResult.size();
+    });
+
+    ASSERT(MapResult == TableResult);
+
+    // NOTE(koekeishiya): Every other window is destroyed and then created again.
+    BENCH_REPEAT("windows", "map", Size, "churn", {
+        for (uint32_t Index = 0; Index < Size; Index += 2) {
+            Map.erase(Windows[Index]->Id);
+        }
+        for (uint32_t Index = 0; Index < Size; Index += 2) {
+            Map[Windows[Index]->Id] = Windows[Index];
+        }
+    });
+
+    BENCH_REPEAT("windows", "table", Size, "churn", {
+        for (uint32_t Index = 0; Index < Size; Index += 2) {
+            WindowTableRemove(&Table, Windows[Index]->Id);
+        }
+        for (uint32_t Index = 0; Index < Size; Index += 2) {
+            macos_window *Window = Windows[Index];
+            WindowTableInsert(&Table, Window, Window->Id, BenchWindowTableFlags(Window), Window->Level, 0);
+        }
+    });
+
+    FreeWindowTable(&Table);
+    for (uint32_t Index = 0; Index < Size; ++Index) {
+        free(Windows[Index]);
+        free(Padding[Index]);
+    }
+}
+
+/*
+ * NOTE(koekeishiya): The window rule index is compared with testing every rule against
+ * every window. The rules are random patterns over names of common applications and
+ * titles, and a match only tests the owner, name and except patterns of a rule the same
+ * way ApplyWindowRule in rule.cpp does; roles are left out. The linear version does not
+ * look at the required literals, like rule.cpp before the index was added.
+ */
+struct bench_rule
+{
+    char *Owner;
+    char *Name;
+    char *Except;
+    regex_t OwnerRegex;
+    regex_t NameRegex;
+    regex_t ExceptRegex;
+    char *OwnerLiteral;
+    char *NameLiteral;
+};
+
+struct bench_rule_window
+{
+    char *Owner;
+    char *Name;
+};
+
+internal const char *bench_rule_words[] =
+{
+    "Safari", "Google", "Chrome", "Firefox", "Finder", "Terminal", "iTerm", "Code", "Slack",
+    "Mail", "Calendar", "Notes", "Preview", "System", "Preferences", "Spotify", "Music",
+    "Xcode", "Activity", "Monitor", "Messages", "Zoom", "Discord", "Steam", "Photos",
+    "GitHub", "Inbox", "Docs", "Sheets", "Editor", "Window", "Untitled", "main.cpp",
+    "rule.cpp", "README", "Settings", "Downloads", "Documents"
+};
+
+internal std::string
+BenchRuleWord()
+{
+    return bench_rule_words[rand() % ArrayCount(bench_rule_words)];
+}
+
+internal std::string
+BenchRulePattern()
+{
+    std::string Word = BenchRuleWord();
+    switch (rand() % 14) {
+    case 0:  return Word;
+    case 1:  return "^" + Word + "$";
+    case 2:  return Word + ".*" + BenchRuleWord();
+    case 3:  return "(" + Word + "|" + BenchRuleWord() + ")";
+    case 4:  return Word + "|" + BenchRuleWord();
+    case 5:  return Word.substr(0, 3) + "[a-z]+";
+    case 6:  return "\\." + Word;
+    case 7:  return Word + "s?";
+    case 8:  return Word.substr(0, 2) + "x?" + Word.substr(2);
+    case 9:  return "[[:alpha:]]+ " + Word;
+    case 10: return Word + "{0,1}";
+    case 11: return "(" + Word + ")+ " + BenchRuleWord();
+    case 12: return ".*";
+    default: return "^" + Word.substr(0, 4) + "+";
+    }
+}
+
+internal inline bool
+BenchRuleMatches(bench_rule *Rule, bench_rule_window *Window, bool Literals)
+{
+    if (Literals) {
+        if ((Rule->OwnerLiteral) && (Window->Owner) && (!strstr(Window->Owner, Rule->OwnerLiteral))) return false;
+        if ((Rule->NameLiteral) && (Window->Name) && (!strstr(Window->Name, Rule->NameLiteral))) return false;
+    }
+
+    if ((Rule->Owner) && (Window->Owner) && (regexec(&Rule->OwnerRegex, Window->Owner, 0, NULL, 0))) return false;
+    if ((Rule->Name) && (Window->Name) && (regexec(&Rule->NameRegex, Window->Name, 0, NULL, 0))) return false;
+    if ((Rule->Except) && (Window->Name) && (!regexec(&Rule->ExceptRegex, Window->Name, 0, NULL, 0))) return false;
+    return true;
+}
+
+internal void
+MatchRulesLinear(std::vector<bench_rule> &Rules, bench_rule_window *Window,
+                 bool TitleChanged, std::vector<uint32_t> &Matches)
+{
+    Matches.clear();
+    for (uint32_t Position = 0; Position < Rules.size(); ++Position) {
+        bench_rule *Rule = &Rules[Position];
+        if (TitleChanged && !Rule->Name && !Rule->Except) continue;
+        if (BenchRuleMatches(Rule, Window, false)) {
+            Matches.push_back(Position);
+        }
+    }
+}
+
+internal void
+MatchRulesIndexed(window_rule_index *Index, std::vector<bench_rule> &Rules, bench_rule_window *Window,
+                  bool TitleChanged, std::vector<uint32_t> &Matches)
+{
+    Matches.clear();
+    std::vector<uint64_t> &Candidates = FindWindowRuleCandidates(Index, Window->Owner, Window->Name, TitleChanged);
+    for (size_t Word = 0; Word < Candidates.size(); ++Word) {
+        uint64_t Bits = Candidates[Word];
+        while (Bits) {
+            uint32_t Position = (Word << 6) + __builtin_ctzll(Bits);
+            if (BenchRuleMatches(&Rules[Position], Window, true)) {
+                Matches.push_back(Position);
+            }
+            Bits &= Bits - 1;
+        }
+    }
+}
+
+// NOTE(koekeishiya): One in fifty windows has no owner name or no title.
+internal void
+BenchWindowRules(uint32_t RuleCount, uint32_t WindowCount)
+{
+    std::vector<bench_rule> Rules(RuleCount);
+    window_rule_index *Index = new window_rule_index;
+    srand(RuleCount);
+
+    for (uint32_t Position = 0; Position < RuleCount; ++Position) {
+        bench_rule *Rule = &Rules[Position];
+        memset(Rule, 0, sizeof(bench_rule));
+
+        int Filters = rand() % 4;
+        if (Filters != 1) Rule->Owner = strdup(BenchRulePattern().c_str());
+        if (Filters != 0) Rule->Name = strdup(BenchRulePattern().c_str());
+        if (rand() % 8 == 0) Rule->Except = strdup(BenchRuleWord().c_str());
+
+        if (Rule->Owner)  regcomp(&Rule->OwnerRegex, Rule->Owner, REG_EXTENDED);
+        if (Rule->Name)   regcomp(&Rule->NameRegex, Rule->Name, REG_EXTENDED);
+        if (Rule->Except) regcomp(&Rule->ExceptRegex, Rule->Except, REG_EXTENDED);
+
+        if (Rule->Owner) Rule->OwnerLiteral = ExtractRequiredLiteral(Rule->Owner);
+        if (Rule->Name)  Rule->NameLiteral = ExtractRequiredLiteral(Rule->Name);
+
+        AddWindowRuleToIndex(Index, Position, Rule->OwnerLiteral, Rule->NameLiteral, Rule->Name || Rule->Except);
+    }
+
+    std::vector<bench_rule_window> Windows(WindowCount);
+    for (uint32_t Position = 0; Position < WindowCount; ++Position) {
+        std::string Owner = BenchRuleWord() + ((rand() % 2) ? " " + BenchRuleWord() : "");
+        std::string Name = BenchRuleWord() + " - " + BenchRuleWord() + " " + BenchRuleWord() + " - " + BenchRuleWord();
+        Windows[Position].Owner = (rand() % 50) ? strdup(Owner.c_str()) : NULL;
+        Windows[Position].Name = (rand() % 50) ? strdup(Name.c_str()) : NULL;
+    }
+
+    std::vector<uint32_t> Linear, Indexed;
+    for (uint32_t Position = 0; Position < WindowCount; ++Position) {
+        for (int TitleChanged = 0; TitleChanged < 2; ++TitleChanged) {
+            MatchRulesLinear(Rules, &Windows[Position], TitleChanged, Linear);
+            MatchRulesIndexed(Index, Rules, &Windows[Position], TitleChanged, Indexed);
+            ASSERT(Linear == Indexed);
+        }
+    }
+
+    BENCH_REPEAT("rules", "linear", RuleCount, "window_created", {
+        for (uint32_t Position = 0; Position < WindowCount; ++Position) {
+            MatchRulesLinear(Rules, &Windows[Position], false, Linear);
+        }
+    });
+
+    BENCH_REPEAT("rules", "indexed", RuleCount, "window_created", {
+        for (uint32_t Position = 0; Position < WindowCount; ++Position) {
+            MatchRulesIndexed(Index, Rules, &Windows[Position], false, Indexed);
+        }
+    });
+
+    BENCH_REPEAT("rules", "linear", RuleCount, "title_changed", {
+        for (uint32_t Position = 0; Position < WindowCount; ++Position) {
+            MatchRulesLinear(Rules, &Windows[Position], true, Linear);
+        }
+    });
+
+    BENCH_REPEAT("rules", "indexed", RuleCount, "title_changed", {
+        for (uint32_t Position = 0; Position < WindowCount; ++Position) {
+            MatchRulesIndexed(Index, Rules, &Windows[Position], true, Indexed);
+        }
+    });
+
+    for (uint32_t Position = 0; Position < WindowCount; ++Position) {
+        free(Windows[Position].Owner);
+        free(Windows[Position].Name);
+    }
+
+    for (uint32_t Position = 0; Position < RuleCount; ++Position) {
+        bench_rule *Rule = &Rules[Position];
+        if (Rule->Owner)  regfree(&Rule->OwnerRegex);
+        if (Rule->Name)   regfree(&Rule->NameRegex);
+        if (Rule->Except) regfree(&Rule->ExceptRegex);
+        free(Rule->Owner);
+        free(Rule->Name);
+        free(Rule->Except);
+        free(Rule->OwnerLiteral);
+        free(Rule->NameLiteral);
+    }
+
+    ClearWindowRuleIndex(Index);
+    delete Index;
+}
+
+internal void
+PrintResultsAsCsv()
+{
+    printf("group,shape,size,operation,iterations,ns_per_op\n");
+    for (size_t Index = 0; Index < Results.size(); ++Index) {
+        bench_result *Result = &Results[Index];
+        printf("%s,%s,%u,%s,%u,%.1f\n",
+               Result->Group, Result->Shape, Result->Size,
+               Result->Operation, Result->Iterations, Result->Nanoseconds);
+    }
+}
+
+internal void
+PrintResultsAsJson()
+{
+    printf("[\n");
+    for (size_t Index = 0; Index < Results.size(); ++Index) {
+        bench_result *Result = &Results[Index];
+        printf("  { \"group\": \"%s\", \"shape\": \"%s\", \"size\": %u, \"operation\": \"%s\", "
+               "\"iterations\": %u, \"ns_per_op\": %.1f }%s\n",
+               Result->Group, Result->Shape, Result->Size,
+               Result->Operation, Result->Iterations, Result->Nanoseconds,
+               Index + 1 < Results.size() ? "," : "");
+    }
+    printf("]\n");
+}
+
+int main(int Count, char **Args)
+{
+    bool Json = false;
+    uint32_t MaxSize = 10000;
+
+    for (int Index = 1; Index < Count; ++Index) {
+        if (strcmp(Args[Index], "--json") == 0) {
+            Json = true;
+        } else if ((strcmp(Args[Index], "--max-size") == 0) && (Index + 1 < Count)) {
+            MaxSize = strtoul(Args[++Index], NULL, 10);
+        } else {
+            fprintf(stderr, "usage: %s [--json] [--max-size count]\n", Args[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    snprintf(BenchDirectory, sizeof(BenchDirectory), "/tmp/chunkwm-tiling-bench.XXXXXX");
+    if (!mkdtemp(BenchDirectory)) {
+        fprintf(stderr, "could not create bench directory!\n");
+        return EXIT_FAILURE;
+    }
+
+    BeginHeadlessHost(BENCH_DISPLAY_REGION);
+
+    uint32_t Sizes[] = { 10, 100, 1000, 10000 };
+    bench_shape Shapes[] = { Bench_Shape_Balanced, Bench_Shape_Degenerate, Bench_Shape_Random };
+
+    for (size_t ShapeIndex = 0; ShapeIndex < ArrayCount(Shapes); ++ShapeIndex) {
+        for (size_t SizeIndex = 0; SizeIndex < ArrayCount(Sizes); ++SizeIndex) {
+            if (Sizes[SizeIndex] <= MaxSize) {
+                BenchTree(Shapes[ShapeIndex], Sizes[SizeIndex]);
+            }
+        }
+    }
+
+    uint32_t WindowCounts[] = { 500, 5000 };
+    for (size_t Index = 0; Index < ArrayCount(WindowCounts); ++Index) {
+        if (WindowCounts[Index] <= MaxSize) {
+            BenchWindowTable(WindowCounts[Index]);
+        }
+    }
+
+    BenchWindowRules(500, 1000);
+
+    EndHeadlessHost();
+    rmdir(BenchDirectory);
+
+    if (Json) {
+        PrintResultsAsJson();
+    } else {
+        PrintResultsAsCsv();
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+#include "host.h"
+
+#include "../../../api/plugin_api.h"
+#include "../../../common/config/cvar.h"
+#include "../../../common/misc/assert.h"
+#include "../constants.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <pthread.h>
+#include <string>
+#include <map>
+#include <unordered_map>
+
+#define internal static
+
+extern chunkwm_log *c_log;
+
+internal std::map<std::string, char *> CVars;
+internal std::unordered_map<uint32_t, window_frame> WindowFrames;
+internal headless_frame_stats FrameStats;
+internal bool PreselBorderDestroyed;
+internal region DisplayRegion;
+
+internal CHUNKWM_API_UPDATE_CVAR_FUNC(HeadlessUpdateCVar)
+{
+    char *&Slot = CVars[Name];
+    free(Slot);
+    Slot = strdup(Value);
+}
+
+internal CHUNKWM_API_ACQUIRE_CVAR_FUNC(HeadlessAcquireCVar)
+{
+    std::map<std::string, char *>::iterator It = CVars.find(Name);
+    return It != CVars.end() ? It->second : NULL;
+}
+
+internal CHUNKWM_API_FIND_CVAR_FUNC(HeadlessFindCVar)
+{
+    return CVars.find(Name) != CVars.end();
+}
+
+// NOTE(koekeishiya): Debug and profile output would drown the results, so only warnings are printed.
+internal CHUNKWM_API_LOG_FUNC(HeadlessLog)
+{
+    if (Level < C_LOG_LEVEL_WARN) {
+        return;
+    }
+
+    va_list Args;
+    va_start(Args, Format);
+    vfprintf(stderr, Format, Args);
+    va_end(Args);
+}
+
+internal region
+HeadlessSpaceRegion(macos_space *Space)
+{
+    return DisplayRegion;
+}
+
+internal void
+HeadlessApplyWindowFrames(window_frame *Frames, uint32_t Count)
+{
+    ++FrameStats.Batches;
+    FrameStats.Frames += Count;
+
+    for (uint32_t Index = 0; Index < Count; ++Index) {
+        WindowFrames[Frames[Index].WindowId] = Frames[Index];
+    }
+}
+
+internal void
+HeadlessDestroyPreselBorder(presel_window *Border)
+{
+    PreselBorderDestroyed = true;
+}
+
+internal chunkwm_api HeadlessAPI;
+internal window_backend HeadlessBackend =
+{
+    HeadlessSpaceRegion,
+    HeadlessApplyWindowFrames,
+    HeadlessDestroyPreselBorder
+};
+
+// NOTE(koekeishiya): The cvars read by the layout code, with the defaults that the plugin creates.
+void BeginHeadlessHost(region Display)
+{
+    DisplayRegion = Display;
+
+    HeadlessAPI.UpdateCVar = HeadlessUpdateCVar;
+    HeadlessAPI.AcquireCVar = HeadlessAcquireCVar;
+    HeadlessAPI.FindCVar = HeadlessFindCVar;
+    HeadlessAPI.Log = HeadlessLog;
+
+    c_log = HeadlessLog;
+    BeginCVars(&HeadlessAPI);
+    SetWindowBackend(&HeadlessBackend);
+
+    CreateCVar(CVAR_DESKTOP_HISTORY_DEPTH, 20);
+    CreateCVar(CVAR_BSP_SPAWN_LEFT, 1);
+    CreateCVar(CVAR_BSP_OPTIMAL_RATIO, 1.618f);
+    CreateCVar(CVAR_BSP_SPLIT_RATIO, 0.5f);
+    CreateCVar(CVAR_BSP_SPLIT_MODE, node_split_str[Split_Optimal]);
+
+    ResetHeadlessFrames();
+}
+
+void EndHeadlessHost()
+{
+    for (std::map<std::string, char *>::iterator It = CVars.begin(); It != CVars.end(); ++It) {
+        free(It->second);
+    }
+
+    CVars.clear();
+    WindowFrames.clear();
+}
+
+void ResetHeadlessFrames()
+{
+    WindowFrames.clear();
+    FrameStats = {};
+    PreselBorderDestroyed = false;
+}
+
+headless_frame_stats GetHeadlessFrameStats()
+{
+    return FrameStats;
+}
+
+window_frame *HeadlessWindowFrame(uint32_t WindowId)
+{
+    std::unordered_map<uint32_t, window_frame>::iterator It = WindowFrames.find(WindowId);
+    return It != WindowFrames.end() ? &It->second : NULL;
+}
+
+uint32_t HeadlessWindowFrameCount()
+{
+    return WindowFrames.size();
+}
+
+bool HeadlessPreselBorderDestroyed()
+{
+    return PreselBorderDestroyed;
+}
+
+void HeadlessTileWindow(virtual_space *VirtualSpace, uint32_t WindowId, bool Apply)
+{
+    node *Node = InsertWindowNode(VirtualSpace, WindowId, 0, NULL);
+    if ((Node) && (Apply)) {
+        ApplyNodeRegion(Node, VirtualSpace->Mode);
+    }
+}
+
+void HeadlessUntileWindow(virtual_space *VirtualSpace, uint32_t WindowId, bool Apply)
+{
+    node *Node = VirtualSpace->Tree ? GetNodeWithId(VirtualSpace, WindowId) : NULL;
+    if (!Node) {
+        return;
+    }
+
+    node *NewLeaf = RemoveWindowNode(VirtualSpace, Node);
+    if (!NewLeaf) {
+        return;
+    }
+
+    if (NewLeaf->Left && NewLeaf->Right) {
+        CreateNodeRegionRecursive(NewLeaf, true, NULL, VirtualSpace);
+    }
+
+    if (Apply) {
+        ApplyNodeRegion(NewLeaf, VirtualSpace->Mode);
+    }
+}
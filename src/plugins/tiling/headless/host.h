@@ -0,0 +1,39 @@
+#ifndef PLUGIN_HEADLESS_HOST_H
+#define PLUGIN_HEADLESS_HOST_H
+
+#include <stdint.h>
+
+#include "../region.h"
+#include "../backend.h"
+#include "../node.h"
+#include "../vspace.h"
+
+/*
+ * NOTE(koekeishiya): A host for the headless library, used by the test and bench programs.
+ * It stands in for chunkwm and for macOS: cvars live in a map, and the window backend
+ * keeps the last frame that was applied to every window id instead of moving windows.
+ * Every desktop is the same fixed display region.
+ */
+struct headless_frame_stats
+{
+    uint32_t Batches;
+    uint32_t Frames;
+};
+
+void BeginHeadlessHost(region Display);
+void EndHeadlessHost();
+
+void ResetHeadlessFrames();
+headless_frame_stats GetHeadlessFrameStats();
+window_frame *HeadlessWindowFrame(uint32_t WindowId);
+uint32_t HeadlessWindowFrameCount();
+bool HeadlessPreselBorderDestroyed();
+
+/*
+ * NOTE(koekeishiya): TileWindowOnSpace and UntileWindowFromSpace from plugin.mm, for a
+ * bsp desktop without insertion points and preselections.
+ */
+void HeadlessTileWindow(virtual_space *VirtualSpace, uint32_t WindowId, bool Apply);
+void HeadlessUntileWindow(virtual_space *VirtualSpace, uint32_t WindowId, bool Apply);
+
+#endif
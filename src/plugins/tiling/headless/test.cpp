@@ -0,0 +1,819 @@
+/*
+ * NOTE(koekeishiya): Regression tests for the headless library (make test). Every test
+ * gets a fresh virtual space, and checks the tree, the index and the frames that were
+ * handed to the window backend. Files are written to a private temporary directory.
+ */
+
+#include "host.h"
+#include "../layout.h"
+#include "../history.h"
+#include "../adjacency.h"
+#include "../constants.h"
+#include "../table.h"
+#include "../ruleindex.h"
+#include "../../../common/config/cvar.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <vector>
+
+#include "host.cpp"
+
+#define internal static
+#define ArrayCount(Array) (sizeof(Array) / sizeof((Array)[0]))
+
+#define TEST_DISPLAY_REGION { 0, 0, 1920, 1080, Region_Full }
+
+internal bool TestFailed;
+internal char TestDirectory[64];
+
+#define EXPECT(Condition) do { if (!(Condition)) {          \
+    printf("    %s:%d: expected '%s'\n",                       \
+           __FILE__, __LINE__, #Condition);                   \
+    TestFailed = true;                                        \
+    } } while(0)
+
+internal void
+TileWindows(virtual_space *VirtualSpace, uint32_t First, uint32_t Count, bool Apply)
+{
+    for (uint32_t WindowId = First; WindowId < First + Count; ++WindowId) {
+        HeadlessTileWindow(VirtualSpace, WindowId, Apply);
+    }
+}
+
+/*
+ * NOTE(koekeishiya): Every node of a deserialized layout is a pseudo-leaf until it receives
+ * a window, so the helpers below look at the children of a node instead of its window id.
+ */
+internal uint32_t
+CountLeafNodes(node *Node)
+{
+    if (!Node) return 0;
+    if (!Node->Left) return 1;
+    return CountLeafNodes(Node->Left) + CountLeafNodes(Node->Right);
+}
+
+internal bool
+RegionEquals(region *A, region *B)
+{
+    bool Result = ((fabsf(A->X - B->X) < 0.01f) &&
+                   (fabsf(A->Y - B->Y) < 0.01f) &&
+                   (fabsf(A->Width - B->Width) < 0.01f) &&
+                   (fabsf(A->Height - B->Height) < 0.01f));
+    return Result;
+}
+
+internal bool
+TreesAreEqual(node *A, node *B, float Epsilon, bool CompareIds)
+{
+    if (!A || !B) {
+        return A == B;
+    }
+
+    if ((!A->Left) != (!B->Left)) {
+        return false;
+    }
+
+    if (!A->Left) {
+        return !CompareIds || A->WindowId == B->WindowId;
+    }
+
+    bool Result = ((A->Split == B->Split) &&
+                   (fabsf(A->Ratio - B->Ratio) <= Epsilon) &&
+                   (TreesAreEqual(A->Left, B->Left, Epsilon, CompareIds)) &&
+                   (TreesAreEqual(A->Right, B->Right, Epsilon, CompareIds)));
+    return Result;
+}
+
+internal void
+RandomizeRatios(node *Node)
+{
+    if (!IsLeafNode(Node)) {
+        Node->Ratio = 0.1f + (rand() % 800) / 1000.0f;
+        RandomizeRatios(Node->Left);
+        RandomizeRatios(Node->Right);
+    }
+}
+
+internal void
+BuildTestPath(char *Buffer, size_t Size, const char *Name)
+{
+    snprintf(Buffer, Size, "%s/%s", TestDirectory, Name);
+}
+
+internal void
+WriteTestFile(const char *Path, const void *Data, size_t Size)
+{
+    FILE *Handle = fopen(Path, "w");
+    fwrite(Data, 1, Size, Handle);
+    fclose(Handle);
+}
+
+internal void
+TestTileAppliesEveryWindow(virtual_space *VirtualSpace)
+{
+    region Display = TEST_DISPLAY_REGION;
+    TileWindows(VirtualSpace, 1, 16, true);
+
+    EXPECT(CountLeafNodes(VirtualSpace->Tree) == 16);
+    EXPECT(HeadlessWindowFrameCount() == 16);
+
+    float Area = 0;
+    for (node *Node = GetFirstLeafNode(VirtualSpace->Tree); Node; Node = GetNextLeafNode(Node)) {
+        window_frame *Frame = HeadlessWindowFrame(Node->WindowId);
+        EXPECT(Frame != NULL);
+        if (Frame) {
+            EXPECT(RegionEquals(&Frame->Region, &Node->Region));
+            Area += Frame->Region.Width * Frame->Region.Height;
+        }
+    }
+
+    EXPECT(fabsf(Area - Display.Width * Display.Height) < 1.0f);
+}
+
+internal void
+TestUntileMergesSibling(virtual_space *VirtualSpace)
+{
+    region Display = TEST_DISPLAY_REGION;
+    TileWindows(VirtualSpace, 1, 16, true);
+
+    for (uint32_t WindowId = 1; WindowId < 16; ++WindowId) {
+        ResetHeadlessFrames();
+        HeadlessUntileWindow(VirtualSpace, WindowId, true);
+
+        EXPECT(GetNodeWithId(VirtualSpace, WindowId) == NULL);
+        EXPECT(CountLeafNodes(VirtualSpace->Tree) == 16 - WindowId);
+        EXPECT(VirtualSpace->NodeIndex.Count == 16 - WindowId);
+        EXPECT(GetHeadlessFrameStats().Batches == 1);
+
+        // NOTE(koekeishiya): Only windows that are still tiled may receive a frame.
+        EXPECT(HeadlessWindowFrame(WindowId) == NULL);
+        EXPECT(HeadlessWindowFrameCount() > 0);
+    }
+
+    node *Last = GetNodeWithId(VirtualSpace, 16);
+    EXPECT(Last == VirtualSpace->Tree);
+    EXPECT(Last && RegionEquals(&Last->Region, &Display));
+
+    HeadlessUntileWindow(VirtualSpace, 16, true);
+    EXPECT(VirtualSpace->Tree == NULL);
+    EXPECT(VirtualSpace->NodeIndex.Count == 0);
+}
+
+internal void
+TestBatchedUntileMatchesSingleUntiles(virtual_space *VirtualSpace)
+{
+    srand(41);
+    TileWindows(VirtualSpace, 1, 64, false);
+
+    virtual_space Batched;
+    InitVirtualSpace(&Batched, Virtual_Space_Bsp);
+    TileWindows(&Batched, 1, 64, false);
+
+    uint32_t Windows[48];
+    uint32_t Count = 0;
+    for (uint32_t WindowId = 1; (WindowId <= 64) && (Count < ArrayCount(Windows)); ++WindowId) {
+        if (rand() % 4) Windows[Count++] = WindowId;
+    }
+
+    for (uint32_t Index = 0; Index < Count; ++Index) {
+        HeadlessUntileWindow(VirtualSpace, Windows[Index], false);
+    }
+    RemoveWindowNodes(&Batched, Windows, Count, NULL);
+
+    EXPECT(TreesAreEqual(VirtualSpace->Tree, Batched.Tree, 0, true));
+    EXPECT(VirtualSpace->NodeIndex.Count == Batched.NodeIndex.Count);
+
+    node *A = GetFirstLeafNode(VirtualSpace->Tree);
+    node *B = GetFirstLeafNode(Batched.Tree);
+    while (A && B) {
+        EXPECT(RegionEquals(&A->Region, &B->Region));
+        A = GetNextLeafNode(A);
+        B = GetNextLeafNode(B);
+    }
+    EXPECT(!A && !B);
+
+    FreeVirtualSpace(&Batched);
+}
+
+internal void
+TestNodeIndexMatchesTree(virtual_space *VirtualSpace)
+{
+    srand(37);
+
+    std::vector<uint32_t> Tiled;
+    for (uint32_t Step = 0; Step < 2000; ++Step) {
+        if (Tiled.empty() || rand() % 3) {
+            uint32_t WindowId = Step + 1;
+            HeadlessTileWindow(VirtualSpace, WindowId, false);
+            Tiled.push_back(WindowId);
+        } else {
+            uint32_t Index = rand() % Tiled.size();
+            HeadlessUntileWindow(VirtualSpace, Tiled[Index], false);
+            Tiled[Index] = Tiled.back();
+            Tiled.pop_back();
+        }
+    }
+
+    EXPECT(VirtualSpace->NodeIndex.Count == Tiled.size());
+    EXPECT(CountLeafNodes(VirtualSpace->Tree) == Tiled.size());
+
+    for (size_t Index = 0; Index < Tiled.size(); ++Index) {
+        node *Node = GetNodeWithId(VirtualSpace, Tiled[Index]);
+        EXPECT(Node && IsLeafNode(Node) && IsNodeInTree(VirtualSpace->Tree, Node));
+    }
+}
+
+internal void
+TestNodeTreeMatchesInsertion(virtual_space *VirtualSpace)
+{
+    uint32_t Windows[100];
+    for (uint32_t Index = 0; Index < ArrayCount(Windows); ++Index) {
+        Windows[Index] = Index + 1;
+    }
+
+    virtual_space Batch;
+    InitVirtualSpace(&Batch, Virtual_Space_Bsp);
+    Batch.Tree = CreateNodeTree(Windows, ArrayCount(Windows), Split_Optimal, NULL, &Batch);
+
+    TileWindows(VirtualSpace, 1, ArrayCount(Windows), false);
+    EXPECT(TreesAreEqual(VirtualSpace->Tree, Batch.Tree, 0, true));
+
+    node *Node = GetFirstLeafNode(VirtualSpace->Tree);
+    node *Other = GetFirstLeafNode(Batch.Tree);
+    while (Node && Other) {
+        EXPECT(RegionEquals(&Node->Region, &Other->Region));
+        Node = GetNextLeafNode(Node);
+        Other = GetNextLeafNode(Other);
+    }
+
+    FreeVirtualSpace(&Batch);
+}
+
+internal void
+TestRotateAndMirrorAreReversible(virtual_space *VirtualSpace)
+{
+    virtual_space Original;
+    InitVirtualSpace(&Original, Virtual_Space_Bsp);
+
+    srand(38);
+    TileWindows(VirtualSpace, 1, 32, false);
+    TileWindows(&Original, 1, 32, false);
+    RandomizeRatios(VirtualSpace->Tree);
+    srand(38);
+    RandomizeRatios(Original.Tree);
+    EXPECT(TreesAreEqual(VirtualSpace->Tree, Original.Tree, 0, true));
+
+    node_split RootSplit = VirtualSpace->Tree->Split;
+    RotateBSPTree(VirtualSpace->Tree, "90");
+    EXPECT(VirtualSpace->Tree->Split != RootSplit);
+    RotateBSPTree(VirtualSpace->Tree, "270");
+    EXPECT(TreesAreEqual(VirtualSpace->Tree, Original.Tree, 1e-6f, true));
+
+    RotateBSPTree(VirtualSpace->Tree, "180");
+    EXPECT(!TreesAreEqual(VirtualSpace->Tree, Original.Tree, 1e-6f, true));
+    RotateBSPTree(VirtualSpace->Tree, "180");
+    EXPECT(TreesAreEqual(VirtualSpace->Tree, Original.Tree, 1e-6f, true));
+
+    MirrorBSPTree(VirtualSpace->Tree, Split_Vertical);
+    EXPECT(!TreesAreEqual(VirtualSpace->Tree, Original.Tree, 1e-6f, true));
+    MirrorBSPTree(VirtualSpace->Tree, Split_Horizontal);
+    MirrorBSPTree(VirtualSpace->Tree, Split_Vertical);
+    MirrorBSPTree(VirtualSpace->Tree, Split_Horizontal);
+    EXPECT(TreesAreEqual(VirtualSpace->Tree, Original.Tree, 1e-6f, true));
+
+    FreeVirtualSpace(&Original);
+}
+
+internal void
+TestEqualizeGivesEqualWidths(virtual_space *VirtualSpace)
+{
+    region Display = TEST_DISPLAY_REGION;
+    UpdateCVar(CVAR_BSP_SPLIT_MODE, node_split_str[Split_Vertical]);
+
+    TileWindows(VirtualSpace, 1, 7, false);
+    RandomizeRatios(VirtualSpace->Tree);
+    EqualizeNodeTree(VirtualSpace->Tree);
+    CreateNodeRegionRecursive(VirtualSpace->Tree, false, NULL, VirtualSpace);
+
+    for (node *Node = GetFirstLeafNode(VirtualSpace->Tree); Node; Node = GetNextLeafNode(Node)) {
+        EXPECT(fabsf(Node->Region.Width - Display.Width / 7) < 0.01f);
+    }
+
+    UpdateCVar(CVAR_BSP_SPLIT_MODE, node_split_str[Split_Optimal]);
+}
+
+internal void
+TestNodeForPoint(virtual_space *VirtualSpace)
+{
+    TileWindows(VirtualSpace, 1, 200, false);
+
+    for (node *Node = GetFirstLeafNode(VirtualSpace->Tree); Node; Node = GetNextLeafNode(Node)) {
+        float X = Node->Region.X + Node->Region.Width / 2;
+        float Y = Node->Region.Y + Node->Region.Height / 2;
+        EXPECT(GetNodeForPoint(VirtualSpace->Tree, X, Y) == Node);
+    }
+
+    EXPECT(GetNodeForPoint(VirtualSpace->Tree, -10, -10) == NULL);
+    EXPECT(GetNodeForPoint(VirtualSpace->Tree, 5000, 500) == NULL);
+}
+
+// NOTE(koekeishiya): The same rule as FindAdjacentNode in adjacency.cpp, without the cache.
+internal node *
+ScanAdjacentNode(node *Tree, node *NodeA, directions Direction)
+{
+    node *Result = NULL;
+    float MinDist = 0xFFFFFFFF;
+    region *A = &NodeA->Region;
+
+    for (node *NodeB = GetFirstLeafNode(Tree); NodeB; NodeB = GetNextLeafNode(NodeB)) {
+        region *B = &NodeB->Region;
+        if ((NodeA != NodeB) &&
+            (IsInDirection(Direction, A->X, A->Y, A->Width, A->Height, B->X, B->Y, B->Width, B->Height))) {
+            float Dist = DirectionalDistance(Direction,
+                                             A->X + A->Width / 2, A->Y + A->Height / 2,
+                                             B->X + B->Width / 2, B->Y + B->Height / 2);
+            if (Dist < MinDist) {
+                MinDist = Dist;
+                Result = NodeB;
+            }
+        }
+    }
+
+    return Result;
+}
+
+internal void
+ExpectAdjacentNodes(virtual_space *VirtualSpace)
+{
+    directions Directions[] = { Dir_North, Dir_East, Dir_South, Dir_West };
+    for (node *Node = GetFirstLeafNode(VirtualSpace->Tree); Node; Node = GetNextLeafNode(Node)) {
+        for (size_t Index = 0; Index < ArrayCount(Directions); ++Index) {
+            node *Adjacent = GetAdjacentNode(VirtualSpace, Node, Directions[Index]);
+            EXPECT(Adjacent == ScanAdjacentNode(VirtualSpace->Tree, Node, Directions[Index]));
+        }
+    }
+}
+
+internal void
+TestAdjacentNodesFollowLayout(virtual_space *VirtualSpace)
+{
+    TileWindows(VirtualSpace, 1, 24, false);
+    ExpectAdjacentNodes(VirtualSpace);
+
+    // NOTE(koekeishiya): Cached neighbours must not survive a change to the tree.
+    HeadlessUntileWindow(VirtualSpace, 5, false);
+    HeadlessUntileWindow(VirtualSpace, 17, false);
+    ExpectAdjacentNodes(VirtualSpace);
+
+    VirtualSpace->Tree->Ratio = 0.2f;
+    CreateNodeRegionRecursive(VirtualSpace->Tree, false, NULL, VirtualSpace);
+    ExpectAdjacentNodes(VirtualSpace);
+}
+
+internal void
+TestLayoutRoundTrip(virtual_space *VirtualSpace)
+{
+    srand(39);
+    TileWindows(VirtualSpace, 1, 500, false);
+    RandomizeRatios(VirtualSpace->Tree);
+
+    const char *Names[] = { "layout", "layout" LAYOUT_BINARY_EXTENSION };
+    float Epsilon[] = { 0.0005f, 0 };
+
+    for (size_t Index = 0; Index < ArrayCount(Names); ++Index) {
+        char Path[256];
+        BuildTestPath(Path, sizeof(Path), Names[Index]);
+        EXPECT(SerializeNodeToFile(VirtualSpace->Tree, Path));
+
+        layout_file File;
+        EXPECT(BeginLayoutFile(Path, &File));
+
+        virtual_space Restored;
+        InitVirtualSpace(&Restored, Virtual_Space_Bsp);
+        Restored.Tree = DeserializeLayoutFile(&File, &Restored);
+        EndLayoutFile(&File);
+
+        EXPECT(CountLeafNodes(Restored.Tree) == 500);
+        EXPECT(TreesAreEqual(VirtualSpace->Tree, Restored.Tree, Epsilon[Index], false));
+        EXPECT(Restored.NodeIndex.Count == 0);
+
+        FreeVirtualSpace(&Restored);
+        unlink(Path);
+    }
+}
+
+// NOTE(koekeishiya): Every split of an equalized chain gives the left side (n - 1) / n.
+internal void
+TestEqualizedLayoutRoundTrip(virtual_space *VirtualSpace)
+{
+    VirtualSpace->Tree = CreateRootNode(1, NULL, VirtualSpace);
+    node *Leftmost = VirtualSpace->Tree;
+    for (uint32_t WindowId = 2; WindowId <= 2000; ++WindowId) {
+        CreateLeafNodePair(Leftmost, Leftmost->WindowId, WindowId, Split_Vertical, NULL, VirtualSpace);
+        Leftmost = Leftmost->Left;
+    }
+
+    EqualizeNodeTree(VirtualSpace->Tree);
+
+    char Path[256];
+    BuildTestPath(Path, sizeof(Path), "equalized");
+    EXPECT(SerializeNodeToFile(VirtualSpace->Tree, Path));
+
+    layout_file File;
+    EXPECT(BeginLayoutFile(Path, &File));
+
+    virtual_space Restored;
+    InitVirtualSpace(&Restored, Virtual_Space_Bsp);
+    Restored.Tree = DeserializeLayoutFile(&File, &Restored);
+    EndLayoutFile(&File);
+
+    EXPECT(CountLeafNodes(Restored.Tree) == 2000);
+    EXPECT(TreesAreEqual(VirtualSpace->Tree, Restored.Tree, 0.00001f, false));
+
+    FreeVirtualSpace(&Restored);
+    unlink(Path);
+}
+
+internal void
+TestLayoutRejectsInvalidRatios(virtual_space *VirtualSpace)
+{
+    const char *Layouts[] =
+    {
+        "version 1\nroot vertical 1.500\nleft_leaf\nright_leaf\n",
+        "version 1\nroot vertical 0.000\nleft_leaf\nright_leaf\n",
+        "version 1\nroot vertical -0.5\nleft_leaf\nright_leaf\n",
+        "version 1\nroot vertical nan\nleft_leaf\nright_leaf\n",
+        "version 1\nroot vertical 0.5x\nleft_leaf\nright_leaf\n",
+        "version 1\nroot vertical 0.5\nleft_leaf\nright_root horizontal inf\nleft_leaf\nright_leaf\n",
+    };
+
+    char Path[256];
+    BuildTestPath(Path, sizeof(Path), "invalid");
+
+    for (size_t Index = 0; Index < ArrayCount(Layouts); ++Index) {
+        layout_file File;
+        WriteTestFile(Path, Layouts[Index], strlen(Layouts[Index]));
+        EXPECT(!BeginLayoutFile(Path, &File));
+    }
+
+    float Ratios[] = { 1.0f, 0.0f, NAN };
+    BuildTestPath(Path, sizeof(Path), "invalid" LAYOUT_BINARY_EXTENSION);
+
+    for (size_t Index = 0; Index < ArrayCount(Ratios); ++Index) {
+        struct {
+            binary_layout_header Header;
+            binary_layout_node Nodes[3];
+        } Layout = {};
+
+        Layout.Header.Magic = LAYOUT_BINARY_MAGIC;
+        Layout.Header.Version = LAYOUT_BINARY_VERSION;
+        Layout.Header.Count = 3;
+        Layout.Nodes[0].Type = Binary_Layout_Root;
+        Layout.Nodes[0].Split = Split_Vertical;
+        Layout.Nodes[0].Ratio = Ratios[Index];
+
+        layout_file File;
+        WriteTestFile(Path, &Layout, sizeof(Layout));
+        EXPECT(!BeginLayoutFile(Path, &File));
+    }
+
+    unlink(Path);
+    BuildTestPath(Path, sizeof(Path), "invalid");
+    unlink(Path);
+}
+
+internal void
+TestSpaceStateRoundTrip(virtual_space *VirtualSpace)
+{
+    srand(40);
+    VirtualSpace->Uuid = "BSP-SPACE";
+    VirtualSpace->_Offset = { 20, 20, 20, 20, 10 };
+    VirtualSpace->Offset = &VirtualSpace->_Offset;
+    TileWindows(VirtualSpace, 1, 50, false);
+    RandomizeRatios(VirtualSpace->Tree);
+
+    virtual_space Monocle;
+    InitVirtualSpace(&Monocle, Virtual_Space_Monocle);
+    Monocle.Uuid = strdup("MONOCLE-SPACE");
+    for (uint32_t WindowId = 100; WindowId < 105; ++WindowId) {
+        MonocleInsertWindow(&Monocle.Monocle, Monocle.Monocle.Count, WindowId);
+    }
+
+    char Path[256];
+    BuildTestPath(Path, sizeof(Path), "state");
+
+    layout_buffer Buffer;
+    BeginSpaceStateBuffer(&Buffer);
+    SerializeSpaceState(&Buffer, 1, VirtualSpace);
+    SerializeSpaceState(&Buffer, 2, &Monocle);
+    EXPECT(WriteSpaceStateFile(&Buffer, Path));
+    free(Buffer.Data);
+
+    space_state_file File;
+    EXPECT(BeginSpaceStateFile(Path, &File));
+
+    uint32_t Count = 0;
+    for (space_state *State = NextSpaceState(&File, NULL); State; State = NextSpaceState(&File, State)) {
+        ++Count;
+    }
+    EXPECT(Count == 2);
+
+    EXPECT(FindSpaceState(&File, 1, "MONOCLE-SPACE") == NULL);
+    space_state *BspState = FindSpaceState(&File, 1, "BSP-SPACE");
+    space_state *MonocleState = FindSpaceState(&File, 2, "MONOCLE-SPACE");
+    EXPECT(BspState && MonocleState);
+
+    if (BspState && MonocleState) {
+        EXPECT(BspState->HasOffset && BspState->Offset.Gap == 10);
+
+        virtual_space Restored;
+        InitVirtualSpace(&Restored, Virtual_Space_Bsp);
+        DeserializeSpaceState(BspState, &Restored);
+        EXPECT(TreesAreEqual(VirtualSpace->Tree, Restored.Tree, 0, true));
+        EXPECT(Restored.NodeIndex.Count == 50);
+        FreeVirtualSpace(&Restored);
+
+        // NOTE(koekeishiya): A record copied into a new checkpoint must come back unchanged.
+        HeadlessUntileWindow(VirtualSpace, 1, false);
+        BeginSpaceStateBuffer(&Buffer);
+        SerializeSpaceState(&Buffer, 1, VirtualSpace);
+        CopySpaceState(&Buffer, MonocleState);
+        EndSpaceStateFile(&File);
+        EXPECT(WriteSpaceStateFile(&Buffer, Path));
+        free(Buffer.Data);
+
+        EXPECT(BeginSpaceStateFile(Path, &File));
+        MonocleState = FindSpaceState(&File, 2, "MONOCLE-SPACE");
+        EXPECT(MonocleState && MonocleState->Count == 5);
+
+        if (MonocleState) {
+            InitVirtualSpace(&Restored, Virtual_Space_Monocle);
+            DeserializeSpaceState(MonocleState, &Restored);
+            EXPECT(Restored.Monocle.Count == 5);
+            EXPECT(memcmp(Restored.Monocle.Windows, Monocle.Monocle.Windows, sizeof(uint32_t) * 5) == 0);
+            FreeVirtualSpace(&Restored);
+        }
+    }
+
+    EndSpaceStateFile(&File);
+    FreeVirtualSpace(&Monocle);
+    VirtualSpace->Uuid = NULL;
+    unlink(Path);
+}
+
+internal void
+TestSpaceStateRejectsInvalidFiles(virtual_space *VirtualSpace)
+{
+    TileWindows(VirtualSpace, 1, 4, false);
+
+    char Path[256], Link[256];
+    BuildTestPath(Path, sizeof(Path), "state");
+    BuildTestPath(Link, sizeof(Link), "state-link");
+
+    layout_buffer Buffer;
+    BeginSpaceStateBuffer(&Buffer);
+    SerializeSpaceState(&Buffer, 1, VirtualSpace);
+    EXPECT(WriteSpaceStateFile(&Buffer, Path));
+
+    space_state_file File;
+    EXPECT(symlink(Path, Link) == 0);
+    EXPECT(!BeginSpaceStateFile(Link, &File));
+
+    space_state *State = (space_state *) (Buffer.Data + sizeof(space_state_header));
+    space_state_node *Nodes = (space_state_node *) (State + 1);
+
+    Nodes[0].Ratio = 1.0f;
+    WriteTestFile(Path, Buffer.Data, Buffer.Size);
+    EXPECT(!BeginSpaceStateFile(Path, &File));
+
+    Nodes[0].Ratio = 0.5f;
+    Nodes[State->Count - 1].WindowId = Node_Root;
+    WriteTestFile(Path, Buffer.Data, Buffer.Size);
+    EXPECT(!BeginSpaceStateFile(Path, &File));
+
+    uint32_t First = 0;
+    while (Nodes[First].Type != Binary_Layout_Leaf) ++First;
+    uint32_t WindowId = Nodes[First].WindowId;
+
+    Nodes[First].WindowId = Node_PseudoLeaf;
+    Nodes[State->Count - 1].WindowId = Node_PseudoLeaf;
+    WriteTestFile(Path, Buffer.Data, Buffer.Size);
+    EXPECT(BeginSpaceStateFile(Path, &File));
+    EndSpaceStateFile(&File);
+
+    Nodes[First].WindowId = WindowId;
+    Nodes[State->Count - 1].WindowId = WindowId;
+    WriteTestFile(Path, Buffer.Data, Buffer.Size);
+    EXPECT(!BeginSpaceStateFile(Path, &File));
+
+    WriteTestFile(Path, Buffer.Data, Buffer.Size - 1);
+    EXPECT(!BeginSpaceStateFile(Path, &File));
+
+    free(Buffer.Data);
+    unlink(Link);
+    unlink(Path);
+}
+
+/*
+ * NOTE(koekeishiya): Removing a window moves the last row into its slot, and shifts entries
+ * of the index back over the hole. The window pointers are never read, so any value will do.
+ */
+internal void
+TestWindowTableRemove(virtual_space *VirtualSpace)
+{
+    window_table Table;
+    InitWindowTable(&Table);
+
+    for (uint32_t WindowId = 1; WindowId <= 1000; ++WindowId) {
+        WindowTableInsert(&Table, (macos_window *) (uintptr_t) WindowId, WindowId, WindowId, 0, 0);
+    }
+
+    srand(47);
+    for (uint32_t Index = 0; Index < 500; ++Index) {
+        uint32_t WindowId = 1 + rand() % 1000;
+        macos_window *Window = WindowTableRemove(&Table, WindowId);
+        EXPECT(!Window || Window == (macos_window *) (uintptr_t) WindowId);
+        EXPECT(WindowTableSlot(&Table, WindowId) == -1);
+    }
+
+    uint32_t Found = 0;
+    for (uint32_t WindowId = 1; WindowId <= 1000; ++WindowId) {
+        int Slot = WindowTableSlot(&Table, WindowId);
+        if (Slot == -1) continue;
+
+        EXPECT(Table.Ids[Slot] == WindowId);
+        EXPECT(Table.Flags[Slot] == WindowId);
+        EXPECT(Table.Windows[Slot] == (macos_window *) (uintptr_t) WindowId);
+        ++Found;
+    }
+
+    EXPECT(Found == Table.Count);
+    FreeWindowTable(&Table);
+}
+
+internal void
+TestRequiredLiterals(virtual_space *VirtualSpace)
+{
+    const char *Patterns[][2] =
+    {
+        { "Safari",             "Safari" },
+        { "^Google Chrome$",    "Google Chrome" },
+        { "(x|y)Finder",        "Finder" },
+        { "Fir[ae]fox",         "Fir" },
+        { "abc?def",            "def" },
+        { "\\.app",             ".app" },
+        { "ab{2}cdef",          "cdef" },
+        { "abc+def",            "abc" },
+        { "[]abc]xyz",          "xyz" },
+        { "[[:alpha:]]Term",    "Term" },
+        { "iTerm\\d",           "iTerm" },
+        { "Mail|Calendar",      NULL },
+        { "ab",                 NULL },
+        { ".*",                 NULL },
+    };
+
+    for (size_t Index = 0; Index < ArrayCount(Patterns); ++Index) {
+        char *Literal = ExtractRequiredLiteral(Patterns[Index][0]);
+        if (Patterns[Index][1]) {
+            EXPECT(Literal && strcmp(Literal, Patterns[Index][1]) == 0);
+        } else {
+            EXPECT(Literal == NULL);
+        }
+        free(Literal);
+    }
+}
+
+internal bool
+IsWindowRuleCandidate(std::vector<uint64_t> &Candidates, uint32_t Position)
+{
+    return (Candidates[Position >> 6] & (1ULL << (Position & 63))) != 0;
+}
+
+/*
+ * NOTE(koekeishiya): Rule 70 puts the rules in two words of the bitsets, so that the
+ * scratch bitset has to be cleared between lookups.
+ */
+internal void
+TestWindowRuleIndex(virtual_space *VirtualSpace)
+{
+    window_rule_index *Index = new window_rule_index;
+
+    AddWindowRuleToIndex(Index, 0, "Safari", NULL, false);
+    AddWindowRuleToIndex(Index, 1, NULL, "Inbox", true);
+    AddWindowRuleToIndex(Index, 2, NULL, NULL, false);
+    for (uint32_t Position = 3; Position < 70; ++Position) {
+        AddWindowRuleToIndex(Index, Position, "Terminal", NULL, false);
+    }
+    AddWindowRuleToIndex(Index, 70, "Safari", "Inbox", true);
+
+    std::vector<uint64_t> &Created = FindWindowRuleCandidates(Index, "Safari", "Inbox - Mail", false);
+    EXPECT(IsWindowRuleCandidate(Created, 0));
+    EXPECT(IsWindowRuleCandidate(Created, 1));
+    EXPECT(IsWindowRuleCandidate(Created, 2));
+    EXPECT(!IsWindowRuleCandidate(Created, 3));
+    EXPECT(IsWindowRuleCandidate(Created, 70));
+
+    std::vector<uint64_t> &Titled = FindWindowRuleCandidates(Index, "Terminal", "Inbox - Mail", true);
+    EXPECT(!IsWindowRuleCandidate(Titled, 0));
+    EXPECT(IsWindowRuleCandidate(Titled, 1));
+    EXPECT(!IsWindowRuleCandidate(Titled, 2));
+    EXPECT(!IsWindowRuleCandidate(Titled, 3));
+    EXPECT(!IsWindowRuleCandidate(Titled, 70));
+
+    std::vector<uint64_t> &Unnamed = FindWindowRuleCandidates(Index, NULL, NULL, false);
+    for (uint32_t Position = 0; Position <= 70; ++Position) {
+        EXPECT(IsWindowRuleCandidate(Unnamed, Position));
+    }
+    EXPECT(!IsWindowRuleCandidate(Unnamed, 71));
+
+    ClearWindowRuleIndex(Index);
+    delete Index;
+}
+
+internal void
+TestHistoryRestoresLayout(virtual_space *VirtualSpace)
+{
+    TileWindows(VirtualSpace, 1, 12, false);
+
+    virtual_space Original;
+    InitVirtualSpace(&Original, Virtual_Space_Bsp);
+    TileWindows(&Original, 1, 12, false);
+
+    RecordLayoutHistory(VirtualSpace);
+    RotateBSPTree(VirtualSpace->Tree, "90");
+    VirtualSpace->Tree->Ratio = 0.3f;
+
+    ResetHeadlessFrames();
+    EXPECT(UndoLayoutHistory(NULL, VirtualSpace));
+    EXPECT(TreesAreEqual(VirtualSpace->Tree, Original.Tree, 0, true));
+    EXPECT(HeadlessWindowFrameCount() == 12);
+
+    EXPECT(RedoLayoutHistory(NULL, VirtualSpace));
+    EXPECT(VirtualSpace->Tree->Ratio == 0.3f);
+    EXPECT(!RedoLayoutHistory(NULL, VirtualSpace));
+
+    FreeVirtualSpace(&Original);
+}
+
+struct headless_test
+{
+    const char *Name;
+    void (*Run)(virtual_space *VirtualSpace);
+};
+
+internal headless_test Tests[] =
+{
+    { "tile applies every window",          TestTileAppliesEveryWindow },
+    { "untile merges sibling",              TestUntileMergesSibling },
+    { "batched untile matches single",      TestBatchedUntileMatchesSingleUntiles },
+    { "node index matches tree",            TestNodeIndexMatchesTree },
+    { "node tree matches insertion",        TestNodeTreeMatchesInsertion },
+    { "rotate and mirror are reversible",   TestRotateAndMirrorAreReversible },
+    { "equalize gives equal widths",        TestEqualizeGivesEqualWidths },
+    { "node for point",                     TestNodeForPoint },
+    { "adjacent nodes follow layout",       TestAdjacentNodesFollowLayout },
+    { "layout round trip",                  TestLayoutRoundTrip },
+    { "equalized layout round trip",        TestEqualizedLayoutRoundTrip },
+    { "layout rejects invalid ratios",      TestLayoutRejectsInvalidRatios },
+    { "space state round trip",             TestSpaceStateRoundTrip },
+    { "space state rejects invalid files",  TestSpaceStateRejectsInvalidFiles },
+    { "history restores layout",            TestHistoryRestoresLayout },
+    { "window table remove",                TestWindowTableRemove },
+    { "required literals of rule patterns", TestRequiredLiterals },
+    { "window rule index candidates",       TestWindowRuleIndex },
+};
+
+int main(int Count, char **Args)
+{
+    snprintf(TestDirectory, sizeof(TestDirectory), "/tmp/chunkwm-tiling-test.XXXXXX");
+    if (!mkdtemp(TestDirectory)) {
+        fprintf(stderr, "could not create test directory!\n");
+        return EXIT_FAILURE;
+    }
+
+    BeginHeadlessHost(TEST_DISPLAY_REGION);
+
+    int Failed = 0;
+    for (size_t Index = 0; Index < ArrayCount(Tests); ++Index) {
+        virtual_space VirtualSpace;
+        InitVirtualSpace(&VirtualSpace, Virtual_Space_Bsp);
+        ResetHeadlessFrames();
+
+        TestFailed = false;
+        Tests[Index].Run(&VirtualSpace);
+        printf("%s %s\n", TestFailed ? "FAIL" : "ok  ", Tests[Index].Name);
+        Failed += TestFailed;
+
+        FreeVirtualSpace(&VirtualSpace);
+    }
+
+    EndHeadlessHost();
+    rmdir(TestDirectory);
+
+    printf("%d of %d tests failed\n", Failed, (int) ArrayCount(Tests));
+    return Failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,262 @@
+#include "history.h"
+#include "node.h"
+#include "region.h"
+#include "vspace.h"
+#include "constants.h"
+
+#include "../../common/config/cvar.h"
+#include "../../common/misc/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define internal static
+
+internal layout_state *
+RetainLayoutState(layout_state *State)
+{
+    ++State->References;
+    return State;
+}
+
+internal void
+ReleaseLayoutState(layout_state *State)
+{
+    ASSERT(State->References > 0);
+
+    if (--State->References == 0) {
+        if (State->Left)  ReleaseLayoutState(State->Left);
+        if (State->Right) ReleaseLayoutState(State->Right);
+        free(State);
+    }
+}
+
+/*
+ * NOTE(koekeishiya): The caller owns a reference to the returned state. If a node and
+ * its subtree are identical to the corresponding state in Previous, we return Previous
+ * instead of allocating a copy. A layout that did not change returns Previous itself.
+ */
+internal layout_state *
+CaptureLayoutState(node *Node, layout_state *Previous)
+{
+    layout_state *Left = NULL;
+    layout_state *Right = NULL;
+
+    if (Node->Left && Node->Right) {
+        Left = CaptureLayoutState(Node->Left, Previous ? Previous->Left : NULL);
+        Right = CaptureLayoutState(Node->Right, Previous ? Previous->Right : NULL);
+    }
+
+    if ((Previous) &&
+        (Previous->WindowId == Node->WindowId) &&
+        (Previous->Split == Node->Split) &&
+        (Previous->Ratio == Node->Ratio) &&
+        (Previous->Left == Left) &&
+        (Previous->Right == Right)) {
+        if (Left)  ReleaseLayoutState(Left);
+        if (Right) ReleaseLayoutState(Right);
+        return RetainLayoutState(Previous);
+    }
+
+    layout_state *State = (layout_state *) malloc(sizeof(layout_state));
+    State->References = 1;
+    State->WindowId = Node->WindowId;
+    State->Split = Node->Split;
+    State->Ratio = Node->Ratio;
+    State->Left = Left;
+    State->Right = Right;
+    return State;
+}
+
+internal node *
+CreateNodeFromLayoutState(layout_state *State, node *Parent, virtual_space *VirtualSpace)
+{
+    node *Node = AllocateNode(&VirtualSpace->NodePool);
+    Node->Parent = Parent;
+    Node->Depth = Parent ? Parent->Depth + 1 : 0;
+    Node->Split = (node_split) State->Split;
+    Node->Ratio = State->Ratio;
+    SetNodeWindowId(Node, State->WindowId, VirtualSpace);
+
+    if (State->Left && State->Right) {
+        Node->Left = CreateNodeFromLayoutState(State->Left, Node, VirtualSpace);
+        Node->Right = CreateNodeFromLayoutState(State->Right, Node, VirtualSpace);
+    }
+
+    return Node;
+}
+
+/*
+ * NOTE(koekeishiya): A state can only be restored if it contains exactly the windows
+ * that are currently tiled. Every window of the state must be in the tree, and the
+ * number of windows must match, because window ids are unique within a tree.
+ */
+internal bool
+LayoutStateHasWindows(layout_state *State, virtual_space *VirtualSpace, uint32_t *Count)
+{
+    if (State->Left && State->Right) {
+        return ((LayoutStateHasWindows(State->Left, VirtualSpace, Count)) &&
+                (LayoutStateHasWindows(State->Right, VirtualSpace, Count)));
+    }
+
+    if ((State->WindowId == Node_Root) ||
+        (State->WindowId == (uint32_t) Node_PseudoLeaf)) {
+        return true;
+    }
+
+    ++*Count;
+    return GetNodeWithId(VirtualSpace, State->WindowId) != NULL;
+}
+
+internal bool
+LayoutStateMatchesTree(layout_state *State, virtual_space *VirtualSpace)
+{
+    uint32_t Count = 0;
+    bool Result = ((VirtualSpace->Tree) &&
+                   (LayoutStateHasWindows(State, VirtualSpace, &Count)) &&
+                   (Count == VirtualSpace->NodeIndex.Count));
+    return Result;
+}
+
+/*
+ * NOTE(koekeishiya): The tree is rebuilt from the state, but windows that end up in the
+ * region they already occupy are skipped when the frames are applied, so only windows
+ * that actually move are touched.
+ */
+internal void
+RestoreLayoutState(macos_space *Space, virtual_space *VirtualSpace, layout_state *State)
+{
+    if (VirtualSpace->Preselect) {
+        FreePreselectNode(VirtualSpace);
+    }
+
+    FreeNodeTree(VirtualSpace);
+    VirtualSpace->Tree = CreateNodeFromLayoutState(State, NULL, VirtualSpace);
+
+    CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
+    CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
+    ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode);
+}
+
+internal void
+ReleaseLayoutStates(layout_state **Stack, uint32_t *Count)
+{
+    for (uint32_t Index = 0; Index < *Count; ++Index) {
+        ReleaseLayoutState(Stack[Index]);
+    }
+
+    *Count = 0;
+}
+
+internal void
+ReserveLayoutHistory(layout_history *History, uint32_t Depth)
+{
+    if (Depth > History->Capacity) {
+        History->Capacity = Depth;
+        History->Undo = (layout_state **) realloc(History->Undo, sizeof(layout_state *) * Depth);
+        History->Redo = (layout_state **) realloc(History->Redo, sizeof(layout_state *) * Depth);
+    }
+}
+
+/*
+ * NOTE(koekeishiya): Pop a state from one stack, and push the current layout on the other.
+ * A state that no longer matches the tiled windows invalidates the whole history, as every
+ * state recorded before it was captured with the same, or an even older, set of windows.
+ */
+internal bool
+StepLayoutHistory(macos_space *Space, virtual_space *VirtualSpace,
+                  layout_state **From, uint32_t *FromCount,
+                  layout_state **To, uint32_t *ToCount)
+{
+    if (*FromCount == 0) {
+        return false;
+    }
+
+    layout_state *State = From[--*FromCount];
+    if (!LayoutStateMatchesTree(State, VirtualSpace)) {
+        ReleaseLayoutState(State);
+        ClearLayoutHistory(&VirtualSpace->History);
+        return false;
+    }
+
+    ASSERT(*FromCount + *ToCount < VirtualSpace->History.Capacity);
+    To[(*ToCount)++] = CaptureLayoutState(VirtualSpace->Tree, State);
+
+    RestoreLayoutState(Space, VirtualSpace, State);
+    ReleaseLayoutState(State);
+    return true;
+}
+
+void RecordLayoutHistory(virtual_space *VirtualSpace)
+{
+    layout_history *History = &VirtualSpace->History;
+    int Depth = CVarIntegerValue(CVAR_DESKTOP_HISTORY_DEPTH);
+
+    ReleaseLayoutStates(History->Redo, &History->RedoCount);
+
+    if ((Depth <= 0) || (!VirtualSpace->Tree)) {
+        ReleaseLayoutStates(History->Undo, &History->UndoCount);
+        return;
+    }
+
+    ReserveLayoutHistory(History, Depth);
+
+    layout_state *Previous = History->UndoCount > 0
+                           ? History->Undo[History->UndoCount - 1]
+                           : NULL;
+
+    layout_state *State = CaptureLayoutState(VirtualSpace->Tree, Previous);
+    if (State == Previous) {
+        // NOTE(koekeishiya): The layout has not changed since the last recorded state.
+        ReleaseLayoutState(State);
+        return;
+    }
+
+    if (History->UndoCount >= (uint32_t) Depth) {
+        // NOTE(koekeishiya): Drop the oldest states to stay within the configured depth.
+        uint32_t Excess = History->UndoCount - Depth + 1;
+        for (uint32_t Index = 0; Index < Excess; ++Index) {
+            ReleaseLayoutState(History->Undo[Index]);
+        }
+
+        History->UndoCount -= Excess;
+        memmove(History->Undo, History->Undo + Excess, sizeof(layout_state *) * History->UndoCount);
+    }
+
+    History->Undo[History->UndoCount++] = State;
+}
+
+bool UndoLayoutHistory(macos_space *Space, virtual_space *VirtualSpace)
+{
+    layout_history *History = &VirtualSpace->History;
+    return StepLayoutHistory(Space, VirtualSpace,
+                             History->Undo, &History->UndoCount,
+                             History->Redo, &History->RedoCount);
+}
+
+bool RedoLayoutHistory(macos_space *Space, virtual_space *VirtualSpace)
+{
+    layout_history *History = &VirtualSpace->History;
+    return StepLayoutHistory(Space, VirtualSpace,
+                             History->Redo, &History->RedoCount,
+                             History->Undo, &History->UndoCount);
+}
+
+void InitLayoutHistory(layout_history *History)
+{
+    memset(History, 0, sizeof(layout_history));
+}
+
+void ClearLayoutHistory(layout_history *History)
+{
+    ReleaseLayoutStates(History->Undo, &History->UndoCount);
+    ReleaseLayoutStates(History->Redo, &History->RedoCount);
+}
+
+void FreeLayoutHistory(layout_history *History)
+{
+    ClearLayoutHistory(History);
+    free(History->Undo);
+    free(History->Redo);
+    InitLayoutHistory(History);
+}
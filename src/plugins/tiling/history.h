@@ -0,0 +1,50 @@
+#ifndef PLUGIN_HISTORY_H
+#define PLUGIN_HISTORY_H
+
+#include <stdint.h>
+
+struct virtual_space;
+struct macos_space;
+
+/*
+ * NOTE(koekeishiya): A layout_state is an immutable copy of a bsp-tree. States are
+ * reference counted, and a new state shares every subtree that is unchanged since the
+ * state it was captured against, so a snapshot only allocates the path to a change.
+ */
+struct layout_state
+{
+    uint32_t References;
+
+    uint32_t WindowId;
+    int Split;
+    float Ratio;
+
+    layout_state *Left;
+    layout_state *Right;
+};
+
+/*
+ * NOTE(koekeishiya): Every virtual_space owns a layout_history. A state is recorded
+ * before a command changes the layout, and the number of states that are kept is
+ * bounded by the desktop_history_depth cvar.
+ */
+struct layout_history
+{
+    layout_state **Undo;
+    uint32_t UndoCount;
+
+    layout_state **Redo;
+    uint32_t RedoCount;
+
+    uint32_t Capacity;
+};
+
+void InitLayoutHistory(layout_history *History);
+void ClearLayoutHistory(layout_history *History);
+void FreeLayoutHistory(layout_history *History);
+
+void RecordLayoutHistory(virtual_space *VirtualSpace);
+bool UndoLayoutHistory(macos_space *Space, virtual_space *VirtualSpace);
+bool RedoLayoutHistory(macos_space *Space, virtual_space *VirtualSpace);
+
+#endif
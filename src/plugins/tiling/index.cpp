@@ -0,0 +1,126 @@
+#include "index.h"
+
+#include "../../common/misc/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define internal static
+#define NODE_INDEX_MIN_CAPACITY 32
+
+internal inline uint32_t
+NodeIndexSlot(node_index *Index, uint32_t WindowId)
+{
+    uint32_t Hash = WindowId * 2654435761u;
+    return Hash & (Index->Capacity - 1);
+}
+
+internal void
+NodeIndexResize(node_index *Index, uint32_t Capacity)
+{
+    node_index_entry *Entries = Index->Entries;
+    uint32_t OldCapacity = Index->Capacity;
+
+    Index->Entries = (node_index_entry *) calloc(Capacity, sizeof(node_index_entry));
+    Index->Capacity = Capacity;
+    Index->Count = 0;
+
+    for (uint32_t Slot = 0; Slot < OldCapacity; ++Slot) {
+        if (Entries[Slot].WindowId) {
+            NodeIndexInsert(Index, Entries[Slot].WindowId, Entries[Slot].Node);
+        }
+    }
+
+    free(Entries);
+}
+
+void InitNodeIndex(node_index *Index)
+{
+    memset(Index, 0, sizeof(node_index));
+}
+
+void NodeIndexInsert(node_index *Index, uint32_t WindowId, node *Node)
+{
+    ASSERT(WindowId != 0);
+
+    // NOTE(koekeishiya): Keep the load factor below 3/4 so that probe sequences stay short.
+    if ((Index->Count + 1) * 4 > Index->Capacity * 3) {
+        NodeIndexResize(Index, Index->Capacity ? Index->Capacity * 2 : NODE_INDEX_MIN_CAPACITY);
+    }
+
+    uint32_t Slot = NodeIndexSlot(Index, WindowId);
+    while (Index->Entries[Slot].WindowId) {
+        if (Index->Entries[Slot].WindowId == WindowId) {
+            Index->Entries[Slot].Node = Node;
+            return;
+        }
+
+        Slot = (Slot + 1) & (Index->Capacity - 1);
+    }
+
+    Index->Entries[Slot].WindowId = WindowId;
+    Index->Entries[Slot].Node = Node;
+    ++Index->Count;
+}
+
+void NodeIndexRemove(node_index *Index, uint32_t WindowId)
+{
+    if (!Index->Count) return;
+
+    uint32_t Mask = Index->Capacity - 1;
+    uint32_t Slot = NodeIndexSlot(Index, WindowId);
+    while (Index->Entries[Slot].WindowId != WindowId) {
+        if (!Index->Entries[Slot].WindowId) return;
+        Slot = (Slot + 1) & Mask;
+    }
+
+    /*
+     * NOTE(koekeishiya): Shift following entries of the same probe sequence back
+     * into the hole, so that lookups never have to skip over deleted slots.
+     */
+    uint32_t Hole = Slot;
+    for (;;) {
+        Slot = (Slot + 1) & Mask;
+        if (!Index->Entries[Slot].WindowId) break;
+
+        uint32_t Home = NodeIndexSlot(Index, Index->Entries[Slot].WindowId);
+        if (((Slot - Home) & Mask) >= ((Slot - Hole) & Mask)) {
+            Index->Entries[Hole] = Index->Entries[Slot];
+            Hole = Slot;
+        }
+    }
+
+    Index->Entries[Hole].WindowId = 0;
+    Index->Entries[Hole].Node = NULL;
+    --Index->Count;
+}
+
+node *NodeIndexLookup(node_index *Index, uint32_t WindowId)
+{
+    if (!Index->Count) return NULL;
+
+    uint32_t Slot = NodeIndexSlot(Index, WindowId);
+    while (Index->Entries[Slot].WindowId) {
+        if (Index->Entries[Slot].WindowId == WindowId) {
+            return Index->Entries[Slot].Node;
+        }
+
+        Slot = (Slot + 1) & (Index->Capacity - 1);
+    }
+
+    return NULL;
+}
+
+void ClearNodeIndex(node_index *Index)
+{
+    if (Index->Count) {
+        memset(Index->Entries, 0, Index->Capacity * sizeof(node_index_entry));
+        Index->Count = 0;
+    }
+}
+
+void FreeNodeIndex(node_index *Index)
+{
+    free(Index->Entries);
+    memset(Index, 0, sizeof(node_index));
+}
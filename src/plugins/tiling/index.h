@@ -0,0 +1,33 @@
+#ifndef PLUGIN_INDEX_H
+#define PLUGIN_INDEX_H
+
+#include <stdint.h>
+
+struct node;
+
+struct node_index_entry
+{
+    uint32_t WindowId;
+    node *Node;
+};
+
+/*
+ * NOTE(koekeishiya): Open-addressing hash table from window id to the leaf node
+ * holding that window in a virtual_space. Slots with a WindowId of 0 (Node_Root)
+ * are empty, because only leaf nodes that contain a window are indexed.
+ */
+struct node_index
+{
+    node_index_entry *Entries;
+    uint32_t Capacity;
+    uint32_t Count;
+};
+
+void InitNodeIndex(node_index *Index);
+void NodeIndexInsert(node_index *Index, uint32_t WindowId, node *Node);
+void NodeIndexRemove(node_index *Index, uint32_t WindowId);
+node *NodeIndexLookup(node_index *Index, uint32_t WindowId);
+void ClearNodeIndex(node_index *Index);
+void FreeNodeIndex(node_index *Index);
+
+#endif
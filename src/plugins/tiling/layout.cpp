@@ -0,0 +1,806 @@
+#include "layout.h"
+#include "node.h"
+#include "vspace.h"
+#include "constants.h"
+
+#include "../../common/config/tokenize.h"
+#include "../../common/config/cvar.h"
+#include "../../common/misc/assert.h"
+
+#include <stdarg.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <unordered_set>
+
+#define internal static
+
+internal void
+ReserveLayoutBuffer(layout_buffer *Buffer, size_t Size)
+{
+    if (Buffer->Size + Size > Buffer->Capacity) {
+        while (Buffer->Size + Size > Buffer->Capacity) {
+            Buffer->Capacity = Buffer->Capacity ? Buffer->Capacity * 2 : 1024;
+        }
+
+        Buffer->Data = (char *) realloc(Buffer->Data, Buffer->Capacity);
+    }
+}
+
+internal void
+WriteLayoutBuffer(layout_buffer *Buffer, const void *Data, size_t Size)
+{
+    ReserveLayoutBuffer(Buffer, Size);
+    memcpy(Buffer->Data + Buffer->Size, Data, Size);
+    Buffer->Size += Size;
+}
+
+// NOTE(koekeishiya): The buffer is kept null-terminated, but the terminator is not part of Size.
+internal void
+PrintLayoutBuffer(layout_buffer *Buffer, const char *Format, ...)
+{
+    va_list Args;
+    ReserveLayoutBuffer(Buffer, 64);
+
+    va_start(Args, Format);
+    size_t Available = Buffer->Capacity - Buffer->Size;
+    int Length = vsnprintf(Buffer->Data + Buffer->Size, Available, Format, Args);
+    va_end(Args);
+    ASSERT(Length >= 0);
+
+    if ((size_t) Length >= Available) {
+        ReserveLayoutBuffer(Buffer, Length + 1);
+
+        va_start(Args, Format);
+        vsnprintf(Buffer->Data + Buffer->Size, Length + 1, Format, Args);
+        va_end(Args);
+    }
+
+    Buffer->Size += Length;
+}
+
+/*
+ * NOTE(koekeishiya): Equalizing a deep tree gives ratios like 1/1000, which would be written
+ * as 0.000 with a fixed number of decimals and then rejected when the layout is loaded.
+ */
+internal void
+SerializeTextNode(layout_buffer *Buffer, node *Node, const char *NodeType)
+{
+    PrintLayoutBuffer(Buffer, "%s %s %g\n", NodeType, node_split_str[Node->Split], Node->Ratio);
+
+    if (Node->Left && Node->Right) {
+        if (IsLeafNode(Node->Left)) {
+            PrintLayoutBuffer(Buffer, "left_leaf\n");
+        } else {
+            SerializeTextNode(Buffer, Node->Left, "left_root");
+        }
+
+        if (IsLeafNode(Node->Right)) {
+            PrintLayoutBuffer(Buffer, "right_leaf\n");
+        } else {
+            SerializeTextNode(Buffer, Node->Right, "right_root");
+        }
+    }
+}
+
+// NOTE(koekeishiya): Caller is responsible for memory
+char *SerializeNodeToBuffer(node *Node)
+{
+    layout_buffer Buffer = {};
+    PrintLayoutBuffer(&Buffer, "version %d\n", LAYOUT_TEXT_VERSION);
+    SerializeTextNode(&Buffer, Node, "root");
+    return Buffer.Data;
+}
+
+internal uint32_t
+SerializeBinaryNode(layout_buffer *Buffer, node *Node, bool Leaf)
+{
+    binary_layout_node Record = {};
+    Record.Type = Leaf ? Binary_Layout_Leaf : Binary_Layout_Root;
+    Record.Split = Leaf ? Split_None : Node->Split;
+    Record.Ratio = Node->Ratio;
+    WriteLayoutBuffer(Buffer, &Record, sizeof(binary_layout_node));
+
+    uint32_t Count = 1;
+    if (!Leaf && Node->Left && Node->Right) {
+        Count += SerializeBinaryNode(Buffer, Node->Left, IsLeafNode(Node->Left));
+        Count += SerializeBinaryNode(Buffer, Node->Right, IsLeafNode(Node->Right));
+    }
+
+    return Count;
+}
+
+// NOTE(koekeishiya): Caller is responsible for memory
+void *SerializeNodeToBinary(node *Node, size_t *Size)
+{
+    layout_buffer Buffer = {};
+
+    binary_layout_header Header = {};
+    Header.Magic = LAYOUT_BINARY_MAGIC;
+    Header.Version = LAYOUT_BINARY_VERSION;
+    WriteLayoutBuffer(&Buffer, &Header, sizeof(binary_layout_header));
+
+    uint32_t Count = SerializeBinaryNode(&Buffer, Node, false);
+    ((binary_layout_header *) Buffer.Data)->Count = Count;
+
+    *Size = Buffer.Size;
+    return Buffer.Data;
+}
+
+internal layout_format
+LayoutFormatFromPath(const char *Absolutepath)
+{
+    size_t Length = strlen(Absolutepath);
+    size_t ExtensionLength = strlen(LAYOUT_BINARY_EXTENSION);
+
+    if ((Length > ExtensionLength) &&
+        (strcmp(Absolutepath + Length - ExtensionLength, LAYOUT_BINARY_EXTENSION) == 0)) {
+        return Layout_Format_Binary;
+    }
+
+    return Layout_Format_Text;
+}
+
+bool SerializeNodeToFile(node *Node, const char *Absolutepath)
+{
+    bool Result = false;
+    void *Buffer;
+    size_t Size;
+    FILE *Handle;
+
+    if (LayoutFormatFromPath(Absolutepath) == Layout_Format_Binary) {
+        Buffer = SerializeNodeToBinary(Node, &Size);
+    } else {
+        Buffer = SerializeNodeToBuffer(Node);
+        Size = strlen((char *) Buffer);
+    }
+
+    Handle = fopen(Absolutepath, "w");
+    if (Handle) {
+        Result = fwrite(Buffer, 1, Size, Handle) == Size;
+        fclose(Handle);
+    }
+
+    free(Buffer);
+    return Result;
+}
+
+internal bool
+ParseSplitToken(token Token, node_split *Split)
+{
+    for (int Index = Split_None; Index <= Split_Horizontal; ++Index) {
+        if (TokenEquals(Token, node_split_str[Index])) {
+            *Split = (node_split) Index;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+internal bool
+IsTextRootToken(token Token)
+{
+    bool Result = ((TokenEquals(Token, "root")) ||
+                   (TokenEquals(Token, "left_root")) ||
+                   (TokenEquals(Token, "right_root")));
+    return Result;
+}
+
+internal bool
+IsTextLeafToken(token Token)
+{
+    bool Result = ((TokenEquals(Token, "left_leaf")) ||
+                   (TokenEquals(Token, "right_leaf")));
+    return Result;
+}
+
+internal inline bool
+IsValidSplitRatio(float Ratio)
+{
+    bool Result = ((isfinite(Ratio)) && (Ratio > 0.0f) && (Ratio < 1.0f));
+    return Result;
+}
+
+// NOTE(koekeishiya): The whole token has to be consumed, strtof stops at the first character it does not understand.
+internal bool
+ParseRatioToken(token Token, float *Ratio)
+{
+    char Buffer[32];
+    if ((Token.Length == 0) || (Token.Length >= sizeof(Buffer))) {
+        return false;
+    }
+
+    memcpy(Buffer, Token.Text, Token.Length);
+    Buffer[Token.Length] = '\0';
+
+    char *End;
+    *Ratio = strtof(Buffer, &End);
+
+    bool Result = ((End == Buffer + Token.Length) && (IsValidSplitRatio(*Ratio)));
+    return Result;
+}
+
+/*
+ * NOTE(koekeishiya): Layouts written before the format was versioned do not have a
+ * version line, and are otherwise identical to version 1.
+ */
+internal token
+SkipTextLayoutVersion(const char **Cursor, bool *Valid)
+{
+    token Token = GetToken(Cursor);
+    *Valid = true;
+
+    if (TokenEquals(Token, "version")) {
+        token Version = GetToken(Cursor);
+        *Valid = ((Version.Length > 0) &&
+                  (TokenIsDigit(Version)) &&
+                  (TokenToInt(Version) == LAYOUT_TEXT_VERSION));
+        Token = GetToken(Cursor);
+    }
+
+    return Token;
+}
+
+/*
+ * NOTE(koekeishiya): Every root node needs two children, and a layout is complete once
+ * there are no open slots left. A single root node without children is also accepted.
+ */
+internal bool
+ValidateTextLayout(const char *Buffer)
+{
+    const char *Cursor = Buffer;
+    bool Valid;
+
+    token Token = SkipTextLayoutVersion(&Cursor, &Valid);
+    if (!Valid || !TokenEquals(Token, "root")) {
+        return false;
+    }
+
+    uint32_t Count = 0;
+    uint32_t Slots = 1;
+
+    while (Token.Length > 0) {
+        if (Slots == 0) return false;
+        if (Count > 0 && TokenEquals(Token, "root")) return false;
+
+        if (IsTextRootToken(Token)) {
+            node_split Split;
+            float Ratio;
+            if (!ParseSplitToken(GetToken(&Cursor), &Split)) return false;
+            if (!ParseRatioToken(GetToken(&Cursor), &Ratio)) return false;
+            Slots += 1;
+        } else if (IsTextLeafToken(Token)) {
+            Slots -= 1;
+        } else {
+            return false;
+        }
+
+        ++Count;
+        Token = GetToken(&Cursor);
+    }
+
+    return (Slots == 0) || (Count == 1);
+}
+
+internal bool
+ValidateBinaryLayout(void *Data, size_t Size)
+{
+    if (Size < sizeof(binary_layout_header)) {
+        return false;
+    }
+
+    binary_layout_header *Header = (binary_layout_header *) Data;
+    if ((Header->Magic != LAYOUT_BINARY_MAGIC) ||
+        (Header->Version != LAYOUT_BINARY_VERSION) ||
+        (Header->Count == 0) ||
+        (Size != sizeof(binary_layout_header) + (size_t) Header->Count * sizeof(binary_layout_node))) {
+        return false;
+    }
+
+    binary_layout_node *Records = (binary_layout_node *) (Header + 1);
+    if (Records[0].Type != Binary_Layout_Root) {
+        return false;
+    }
+
+    uint32_t Slots = 1;
+    for (uint32_t Index = 0; Index < Header->Count; ++Index) {
+        binary_layout_node *Record = Records + Index;
+        if (Slots == 0) return false;
+
+        if (Record->Type == Binary_Layout_Root) {
+            if (Record->Split > Split_Horizontal) return false;
+            if (!IsValidSplitRatio(Record->Ratio)) return false;
+            Slots += 1;
+        } else if (Record->Type == Binary_Layout_Leaf) {
+            Slots -= 1;
+        } else {
+            return false;
+        }
+    }
+
+    return (Slots == 0) || (Header->Count == 1);
+}
+
+/*
+ * NOTE(koekeishiya): Nodes arrive in pre-order. A new node fills the first free child
+ * slot of Current. After a leaf, we move up until we find a node with a free slot.
+ * Returns the node that receives the next child.
+ */
+internal node *
+AttachLayoutNode(node **Tree, node *Current, node *Node, bool Root)
+{
+    if (!Current) {
+        *Tree = Node;
+    } else {
+        Node->Parent = Current;
+        Node->Depth = Current->Depth + 1;
+
+        if (!Current->Left) {
+            Current->Left = Node;
+        } else {
+            Current->Right = Node;
+        }
+    }
+
+    if (Root) {
+        return Node;
+    }
+
+    while (Current && Current->Left && Current->Right) {
+        Current = Current->Parent;
+    }
+
+    return Current;
+}
+
+internal node *
+DeserializeNodeFromText(const char *Buffer, virtual_space *VirtualSpace)
+{
+    node *Tree = NULL;
+    node *Current = NULL;
+    const char *Cursor = Buffer;
+    float LeafRatio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
+    bool Valid;
+
+    token Token = SkipTextLayoutVersion(&Cursor, &Valid);
+    ASSERT(Valid);
+
+    while (Token.Length > 0) {
+        node *Node = AllocateNode(&VirtualSpace->NodePool);
+        Node->WindowId = Node_PseudoLeaf;
+
+        bool Root = IsTextRootToken(Token);
+        if (Root) {
+            ParseSplitToken(GetToken(&Cursor), &Node->Split);
+            ParseRatioToken(GetToken(&Cursor), &Node->Ratio);
+        } else {
+            Node->Ratio = LeafRatio;
+        }
+
+        Current = AttachLayoutNode(&Tree, Current, Node, Root);
+        Token = GetToken(&Cursor);
+    }
+
+    return Tree;
+}
+
+internal node *
+DeserializeNodeFromBinary(void *Data, virtual_space *VirtualSpace)
+{
+    node *Tree = NULL;
+    node *Current = NULL;
+    float LeafRatio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
+
+    binary_layout_header *Header = (binary_layout_header *) Data;
+    binary_layout_node *Records = (binary_layout_node *) (Header + 1);
+
+    for (uint32_t Index = 0; Index < Header->Count; ++Index) {
+        binary_layout_node *Record = Records + Index;
+        node *Node = AllocateNode(&VirtualSpace->NodePool);
+        Node->WindowId = Node_PseudoLeaf;
+
+        bool Root = Record->Type == Binary_Layout_Root;
+        if (Root) {
+            Node->Split = (node_split) Record->Split;
+            Node->Ratio = Record->Ratio;
+        } else {
+            Node->Ratio = LeafRatio;
+        }
+
+        Current = AttachLayoutNode(&Tree, Current, Node, Root);
+    }
+
+    return Tree;
+}
+
+bool BeginLayoutFile(const char *Absolutepath, layout_file *File)
+{
+    struct stat Stat;
+    bool Result = false;
+
+    memset(File, 0, sizeof(layout_file));
+
+    int Handle = open(Absolutepath, O_RDONLY);
+    if (Handle == -1) {
+        goto out;
+    }
+
+    if ((fstat(Handle, &Stat) == -1) || (Stat.st_size == 0)) {
+        goto close_handle;
+    }
+
+    File->Size = Stat.st_size;
+    File->Data = mmap(NULL, File->Size, PROT_READ, MAP_PRIVATE, Handle, 0);
+    if (File->Data == MAP_FAILED) {
+        File->Data = NULL;
+        goto close_handle;
+    }
+
+    if ((File->Size >= sizeof(uint32_t)) &&
+        (*(uint32_t *) File->Data == LAYOUT_BINARY_MAGIC)) {
+        File->Format = Layout_Format_Binary;
+        Result = ValidateBinaryLayout(File->Data, File->Size);
+    } else {
+        File->Format = Layout_Format_Text;
+        File->Text = (char *) malloc(File->Size + 1);
+        memcpy(File->Text, File->Data, File->Size);
+        File->Text[File->Size] = '\0';
+        Result = ValidateTextLayout(File->Text);
+    }
+
+    if (!Result) {
+        c_log(C_LOG_LEVEL_WARN, "chunkwm-tiling: '%s' is not a valid layout\n", Absolutepath);
+        EndLayoutFile(File);
+    }
+
+close_handle:
+    close(Handle);
+
+out:
+    return Result;
+}
+
+node *DeserializeLayoutFile(layout_file *File, virtual_space *VirtualSpace)
+{
+    node *Result = File->Format == Layout_Format_Binary
+                 ? DeserializeNodeFromBinary(File->Data, VirtualSpace)
+                 : DeserializeNodeFromText(File->Text, VirtualSpace);
+    return Result;
+}
+
+void EndLayoutFile(layout_file *File)
+{
+    if (File->Data) {
+        munmap(File->Data, File->Size);
+    }
+
+    if (File->Text) {
+        free(File->Text);
+    }
+
+    memset(File, 0, sizeof(layout_file));
+}
+
+void BeginSpaceStateBuffer(layout_buffer *Buffer)
+{
+    memset(Buffer, 0, sizeof(layout_buffer));
+
+    space_state_header Header = {};
+    Header.Magic = SPACE_STATE_MAGIC;
+    Header.Version = SPACE_STATE_VERSION;
+    WriteLayoutBuffer(Buffer, &Header, sizeof(space_state_header));
+}
+
+internal void
+WriteSpaceStateNode(layout_buffer *Buffer, uint32_t WindowId, bool Leaf, node_split Split, float Ratio)
+{
+    space_state_node Record = {};
+    Record.WindowId = WindowId;
+    Record.Type = Leaf ? Binary_Layout_Leaf : Binary_Layout_Root;
+    Record.Split = Split;
+    Record.Ratio = Ratio;
+    WriteLayoutBuffer(Buffer, &Record, sizeof(space_state_node));
+}
+
+internal uint32_t
+SerializeSpaceStateNode(layout_buffer *Buffer, node *Node)
+{
+    bool Leaf = !(Node->Left && Node->Right);
+    WriteSpaceStateNode(Buffer, Node->WindowId, Leaf, Node->Split, Node->Ratio);
+
+    uint32_t Count = 1;
+    if (!Leaf) {
+        Count += SerializeSpaceStateNode(Buffer, Node->Left);
+        Count += SerializeSpaceStateNode(Buffer, Node->Right);
+    }
+
+    return Count;
+}
+
+// NOTE(koekeishiya): The caller must hold the lock of the virtual space.
+void SerializeSpaceState(layout_buffer *Buffer, int SpaceId, virtual_space *VirtualSpace)
+{
+    size_t Offset = Buffer->Size;
+
+    space_state State = {};
+    State.SpaceId = SpaceId;
+    if (VirtualSpace->Uuid) {
+        strncpy(State.Uuid, VirtualSpace->Uuid, SPACE_STATE_UUID_SIZE - 1);
+    }
+    State.Mode = VirtualSpace->Mode;
+    State.HasOffset = VirtualSpace->Offset != NULL;
+    State.Offset = VirtualSpace->_Offset;
+    WriteLayoutBuffer(Buffer, &State, sizeof(space_state));
+
+    uint32_t Count = 0;
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        monocle_list *Monocle = &VirtualSpace->Monocle;
+        for (uint32_t Index = 0; Index < Monocle->Count; ++Index) {
+            WriteSpaceStateNode(Buffer, Monocle->Windows[Index], true, Split_None, 0.0f);
+        }
+        Count = Monocle->Count;
+    } else if (VirtualSpace->Tree) {
+        Count = SerializeSpaceStateNode(Buffer, VirtualSpace->Tree);
+    }
+
+    ((space_state *) (Buffer->Data + Offset))->Count = Count;
+    ++((space_state_header *) Buffer->Data)->Count;
+}
+
+// NOTE(koekeishiya): Copy a record of a previous state file into a new checkpoint, unchanged.
+void CopySpaceState(layout_buffer *Buffer, space_state *State)
+{
+    WriteLayoutBuffer(Buffer, State, sizeof(space_state) + State->Count * sizeof(space_state_node));
+    ++((space_state_header *) Buffer->Data)->Count;
+}
+
+/*
+ * NOTE(koekeishiya): The state is written to a temporary file that is renamed over the
+ * previous state file, so that a state file is never observed in a partially written state.
+ * The state file lives in a shared directory, so the temporary file is created by mkstemp,
+ * which never opens a file that already exists; rename replaces a symlink instead of
+ * following it.
+ */
+bool WriteSpaceStateFile(layout_buffer *Buffer, const char *Absolutepath)
+{
+    bool Result = false;
+    char Temporary[PATH_MAX];
+    void *Data;
+
+    if (snprintf(Temporary, sizeof(Temporary), "%s.XXXXXX", Absolutepath) >= (int) sizeof(Temporary)) {
+        goto out;
+    }
+
+    int Handle;
+    Handle = mkstemp(Temporary);
+    if (Handle == -1) {
+        goto out;
+    }
+
+    if (ftruncate(Handle, Buffer->Size) == -1) {
+        goto close_handle;
+    }
+
+    Data = mmap(NULL, Buffer->Size, PROT_READ | PROT_WRITE, MAP_SHARED, Handle, 0);
+    if (Data == MAP_FAILED) {
+        goto close_handle;
+    }
+
+    memcpy(Data, Buffer->Data, Buffer->Size);
+    munmap(Data, Buffer->Size);
+
+    Result = rename(Temporary, Absolutepath) == 0;
+
+close_handle:
+    close(Handle);
+    if (!Result) unlink(Temporary);
+
+out:
+    return Result;
+}
+
+/*
+ * NOTE(koekeishiya): A window can only be tiled once per space, so a record that lists the same
+ * window twice is rejected. Pseudo leaves all share the same id, and may repeat in a bsp tree.
+ */
+internal bool
+ValidateSpaceState(space_state *State, space_state_node *Nodes)
+{
+    if (State->Mode > Virtual_Space_Float) {
+        return false;
+    }
+
+    std::unordered_set<uint32_t> Windows;
+    Windows.reserve(State->Count);
+
+    if (State->Mode == Virtual_Space_Monocle) {
+        for (uint32_t Index = 0; Index < State->Count; ++Index) {
+            if (Nodes[Index].Type != Binary_Layout_Leaf) return false;
+            if (Nodes[Index].WindowId == Node_Root) return false;
+            if (!Windows.insert(Nodes[Index].WindowId).second) return false;
+        }
+
+        return true;
+    }
+
+    if (State->Count == 0) {
+        return true;
+    }
+
+    uint32_t Slots = 1;
+    for (uint32_t Index = 0; Index < State->Count; ++Index) {
+        space_state_node *Node = Nodes + Index;
+        if (Slots == 0) return false;
+
+        if (Node->Type == Binary_Layout_Root) {
+            if (Node->Split > Split_Horizontal) return false;
+            if (Node->WindowId != Node_Root) return false;
+            if (!IsValidSplitRatio(Node->Ratio)) return false;
+            Slots += 1;
+        } else if (Node->Type == Binary_Layout_Leaf) {
+            if (Node->WindowId == Node_Root) return false;
+            if ((Node->WindowId != (uint32_t) Node_PseudoLeaf) &&
+                (!Windows.insert(Node->WindowId).second)) {
+                return false;
+            }
+            Slots -= 1;
+        } else {
+            return false;
+        }
+    }
+
+    return Slots == 0;
+}
+
+internal space_state *
+SpaceStateAfter(space_state *State)
+{
+    space_state_node *Nodes = (space_state_node *) (State + 1);
+    return (space_state *) (Nodes + State->Count);
+}
+
+internal bool
+ValidateSpaceStateFile(void *Data, size_t Size)
+{
+    if (Size < sizeof(space_state_header)) {
+        return false;
+    }
+
+    space_state_header *Header = (space_state_header *) Data;
+    if ((Header->Magic != SPACE_STATE_MAGIC) ||
+        (Header->Version != SPACE_STATE_VERSION)) {
+        return false;
+    }
+
+    char *End = (char *) Data + Size;
+    space_state *State = (space_state *) (Header + 1);
+
+    for (uint32_t Index = 0; Index < Header->Count; ++Index) {
+        if ((char *) (State + 1) > End) return false;
+        if ((size_t) (End - (char *) (State + 1)) / sizeof(space_state_node) < State->Count) return false;
+        if (!ValidateSpaceState(State, (space_state_node *) (State + 1))) return false;
+        State = SpaceStateAfter(State);
+    }
+
+    return (char *) State == End;
+}
+
+bool BeginSpaceStateFile(const char *Absolutepath, space_state_file *File)
+{
+    struct stat Stat;
+    bool Result = false;
+
+    memset(File, 0, sizeof(space_state_file));
+
+    int Handle = open(Absolutepath, O_RDONLY | O_NOFOLLOW);
+    if (Handle == -1) {
+        goto out;
+    }
+
+    // NOTE(koekeishiya): Only trust a state file that we wrote ourselves.
+    if ((fstat(Handle, &Stat) == -1) ||
+        (!S_ISREG(Stat.st_mode)) ||
+        (Stat.st_uid != getuid()) ||
+        (Stat.st_size == 0)) {
+        goto close_handle;
+    }
+
+    File->Size = Stat.st_size;
+    File->Data = mmap(NULL, File->Size, PROT_READ, MAP_PRIVATE, Handle, 0);
+    if (File->Data == MAP_FAILED) {
+        File->Data = NULL;
+        goto close_handle;
+    }
+
+    Result = ValidateSpaceStateFile(File->Data, File->Size);
+    if (!Result) {
+        c_log(C_LOG_LEVEL_WARN, "chunkwm-tiling: '%s' is not a valid state file\n", Absolutepath);
+        EndSpaceStateFile(File);
+    }
+
+close_handle:
+    close(Handle);
+
+out:
+    return Result;
+}
+
+space_state *FindSpaceState(space_state_file *File, int SpaceId, const char *Uuid)
+{
+    if (!File->Data) {
+        return NULL;
+    }
+
+    space_state_header *Header = (space_state_header *) File->Data;
+    space_state *State = (space_state *) (Header + 1);
+
+    for (uint32_t Index = 0; Index < Header->Count; ++Index) {
+        if ((State->SpaceId == SpaceId) &&
+            (strncmp(State->Uuid, Uuid, SPACE_STATE_UUID_SIZE - 1) == 0)) {
+            return State;
+        }
+
+        State = SpaceStateAfter(State);
+    }
+
+    return NULL;
+}
+
+// NOTE(koekeishiya): Pass NULL to get the first state in the file. Returns NULL after the last state.
+space_state *NextSpaceState(space_state_file *File, space_state *State)
+{
+    if (!File->Data) {
+        return NULL;
+    }
+
+    space_state_header *Header = (space_state_header *) File->Data;
+    space_state *Result = State ? SpaceStateAfter(State) : (space_state *) (Header + 1);
+
+    bool Valid = (char *) Result < (char *) File->Data + File->Size;
+    return Valid ? Result : NULL;
+}
+
+/*
+ * NOTE(koekeishiya): Restores the windows of the state into an empty virtual space, with
+ * the same tree shape, splits and ratios. No regions are created, and no frames are applied.
+ */
+void DeserializeSpaceState(space_state *State, virtual_space *VirtualSpace)
+{
+    space_state_node *Records = (space_state_node *) (State + 1);
+
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        monocle_list *Monocle = &VirtualSpace->Monocle;
+        for (uint32_t Index = 0; Index < State->Count; ++Index) {
+            MonocleInsertWindow(Monocle, Monocle->Count, Records[Index].WindowId);
+        }
+    } else {
+        node *Current = NULL;
+        for (uint32_t Index = 0; Index < State->Count; ++Index) {
+            space_state_node *Record = Records + Index;
+            node *Node = AllocateNode(&VirtualSpace->NodePool);
+            Node->Split = (node_split) Record->Split;
+            Node->Ratio = Record->Ratio;
+            SetNodeWindowId(Node, Record->WindowId, VirtualSpace);
+
+            bool Root = Record->Type == Binary_Layout_Root;
+            Current = AttachLayoutNode(&VirtualSpace->Tree, Current, Node, Root);
+        }
+    }
+}
+
+void EndSpaceStateFile(space_state_file *File)
+{
+    if (File->Data) {
+        munmap(File->Data, File->Size);
+    }
+
+    memset(File, 0, sizeof(space_state_file));
+}
@@ -0,0 +1,131 @@
+#ifndef PLUGIN_LAYOUT_H
+#define PLUGIN_LAYOUT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "region.h"
+
+struct node;
+struct virtual_space;
+
+#define LAYOUT_TEXT_VERSION     1
+#define LAYOUT_BINARY_VERSION   1
+#define LAYOUT_BINARY_MAGIC     0x544c5743
+#define LAYOUT_BINARY_EXTENSION ".bin"
+
+#define SPACE_STATE_VERSION     1
+#define SPACE_STATE_MAGIC       0x54534357
+#define SPACE_STATE_UUID_SIZE   64
+
+enum layout_format
+{
+    Layout_Format_Text,
+    Layout_Format_Binary,
+};
+
+/*
+ * NOTE(koekeishiya): The binary format is a header followed by one record per node,
+ * in the same pre-order as the text format. Values are stored in native byte order.
+ */
+struct binary_layout_header
+{
+    uint32_t Magic;
+    uint16_t Version;
+    uint16_t Reserved;
+    uint32_t Count;
+};
+
+enum binary_layout_node_type
+{
+    Binary_Layout_Leaf = 0,
+    Binary_Layout_Root = 1,
+};
+
+struct binary_layout_node
+{
+    uint8_t Type;
+    uint8_t Split;
+    uint16_t Reserved;
+    float Ratio;
+};
+
+/*
+ * NOTE(koekeishiya): A layout file is memory-mapped and validated by BeginLayoutFile,
+ * so that DeserializeLayoutFile cannot fail halfway through building a tree.
+ */
+struct layout_file
+{
+    layout_format Format;
+    void *Data;
+    size_t Size;
+    char *Text;
+};
+
+struct layout_buffer
+{
+    char *Data;
+    size_t Size;
+    size_t Capacity;
+};
+
+/*
+ * NOTE(koekeishiya): The state file is a checkpoint of every virtual space, so that the
+ * layouts survive a restart of chunkwm. It is a header followed by one space_state per
+ * virtual space. Every space_state is followed by Count nodes in pre-order. The nodes of
+ * a monocle desktop are all leaves, in cycle order. Window ids and space ids are only
+ * valid within a login session, which is why the state file does not outlive it.
+ */
+struct space_state_header
+{
+    uint32_t Magic;
+    uint16_t Version;
+    uint16_t Reserved;
+    uint32_t Count;
+};
+
+struct space_state
+{
+    int SpaceId;
+    char Uuid[SPACE_STATE_UUID_SIZE];
+    uint32_t Mode;
+    uint32_t HasOffset;
+    region_offset Offset;
+    uint32_t Count;
+};
+
+struct space_state_node
+{
+    uint32_t WindowId;
+    uint8_t Type;
+    uint8_t Split;
+    uint16_t Reserved;
+    float Ratio;
+};
+
+struct space_state_file
+{
+    void *Data;
+    size_t Size;
+};
+
+char *SerializeNodeToBuffer(node *Node);
+void *SerializeNodeToBinary(node *Node, size_t *Size);
+bool SerializeNodeToFile(node *Node, const char *Absolutepath);
+
+bool BeginLayoutFile(const char *Absolutepath, layout_file *File);
+node *DeserializeLayoutFile(layout_file *File, virtual_space *VirtualSpace);
+void EndLayoutFile(layout_file *File);
+
+void BeginSpaceStateBuffer(layout_buffer *Buffer);
+void SerializeSpaceState(layout_buffer *Buffer, int SpaceId, virtual_space *VirtualSpace);
+void CopySpaceState(layout_buffer *Buffer, space_state *State);
+bool WriteSpaceStateFile(layout_buffer *Buffer, const char *Absolutepath);
+
+bool BeginSpaceStateFile(const char *Absolutepath, space_state_file *File);
+space_state *FindSpaceState(space_state_file *File, int SpaceId, const char *Uuid);
+space_state *NextSpaceState(space_state_file *File, space_state *State);
+void DeserializeSpaceState(space_state *State, virtual_space *VirtualSpace);
+void EndSpaceStateFile(space_state_file *File);
+
+#endif
@@ -0,0 +1,543 @@
+#include "macos.h"
+#include "node.h"
+#include "vspace.h"
+#include "frame.h"
+#include "presel.h"
+#include "constants.h"
+
+#include "../../common/accessibility/display.h"
+#include "../../common/accessibility/window.h"
+#include "../../common/accessibility/element.h"
+#include "../../common/config/cvar.h"
+#include "../../common/misc/assert.h"
+#include "../../common/misc/string.h"
+
+#include <math.h>
+#include <string.h>
+#include <pthread.h>
+#include <map>
+#include <unordered_map>
+
+#define internal static
+
+extern macos_window *GetWindowByID(uint32_t Id);
+extern bool WindowHasFlags(macos_window *Window, uint32_t Flags);
+
+typedef std::map<const char *, display_geometry, string_comparator> display_geometry_map;
+typedef display_geometry_map::iterator display_geometry_map_it;
+
+typedef std::unordered_map<uint32_t, window_properties> window_properties_map;
+typedef window_properties_map::iterator window_properties_map_it;
+
+internal display_geometry_map DisplayGeometry;
+internal dock_geometry DockGeometry;
+internal pthread_mutex_t DisplayGeometryLock;
+
+internal window_properties_map WindowProperties;
+internal window_property_stats WindowPropertyStats;
+internal pthread_mutex_t WindowPropertyLock;
+
+internal inline bool
+DisplayRefEquals(CFStringRef DisplayRef, CFStringRef OtherRef)
+{
+    bool Result = false;
+    if (OtherRef) {
+        Result = CFStringCompare(DisplayRef, OtherRef, 0) == kCFCompareEqualTo;
+        CFRelease(OtherRef);
+    }
+    return Result;
+}
+
+internal display_geometry
+QueryDisplayGeometry(CFStringRef DisplayRef)
+{
+    display_geometry Result;
+    Result.Bounds = AXLibGetDisplayBounds(DisplayRef);
+    Result.IsMain = DisplayRefEquals(DisplayRef, AXLibGetDisplayIdentifierForMainDisplay());
+    Result.IsLeftMost = DisplayRefEquals(DisplayRef, AXLibGetDisplayIdentifierForLeftMostDisplay());
+    Result.IsRightMost = DisplayRefEquals(DisplayRef, AXLibGetDisplayIdentifierForRightMostDisplay());
+    Result.IsBottomMost = DisplayRefEquals(DisplayRef, AXLibGetDisplayIdentifierForBottomMostDisplay());
+    return Result;
+}
+
+internal void
+ClearDisplayGeometry()
+{
+    for (display_geometry_map_it It = DisplayGeometry.begin(); It != DisplayGeometry.end(); ++It) {
+        free((char *) It->first);
+    }
+
+    DisplayGeometry.clear();
+}
+
+bool BeginDisplayGeometryCache()
+{
+    return pthread_mutex_init(&DisplayGeometryLock, NULL) == 0;
+}
+
+void EndDisplayGeometryCache()
+{
+    ClearDisplayGeometry();
+    pthread_mutex_destroy(&DisplayGeometryLock);
+}
+
+// NOTE(koekeishiya): Called when a display is added, removed, moved or resized.
+void InvalidateDisplayGeometry()
+{
+    pthread_mutex_lock(&DisplayGeometryLock);
+    ClearDisplayGeometry();
+    DockGeometry.Valid = false;
+    pthread_mutex_unlock(&DisplayGeometryLock);
+}
+
+/*
+ * NOTE(koekeishiya): We are not notified when the dock or menubar settings change,
+ * so this state is refreshed once for every event we process instead of once for
+ * every region we create.
+ */
+void InvalidateDockGeometry()
+{
+    pthread_mutex_lock(&DisplayGeometryLock);
+    DockGeometry.Valid = false;
+    pthread_mutex_unlock(&DisplayGeometryLock);
+}
+
+display_geometry GetDisplayGeometry(CFStringRef DisplayRef)
+{
+    display_geometry Result;
+
+    char *DisplayCRef = CopyCFStringToC(DisplayRef);
+    ASSERT(DisplayCRef);
+
+    pthread_mutex_lock(&DisplayGeometryLock);
+    display_geometry_map_it It = DisplayGeometry.find(DisplayCRef);
+    if (It != DisplayGeometry.end()) {
+        Result = It->second;
+        free(DisplayCRef);
+    } else {
+        Result = QueryDisplayGeometry(DisplayRef);
+        DisplayGeometry[DisplayCRef] = Result;
+    }
+    pthread_mutex_unlock(&DisplayGeometryLock);
+
+    return Result;
+}
+
+internal dock_geometry
+GetDockGeometry()
+{
+    dock_geometry Result;
+
+    pthread_mutex_lock(&DisplayGeometryLock);
+    if (!DockGeometry.Valid) {
+        DockGeometry.MenuBarAutoHide = AXLibIsMenuBarAutoHideEnabled();
+        DockGeometry.DockAutoHide = AXLibIsDockAutoHideEnabled();
+        if (!DockGeometry.DockAutoHide) {
+            DockGeometry.DockOrientation = AXLibGetDockOrientation();
+            DockGeometry.DockRect = AXLibGetDockRect();
+        }
+        DockGeometry.Valid = true;
+    }
+    Result = DockGeometry;
+    pthread_mutex_unlock(&DisplayGeometryLock);
+
+    return Result;
+}
+
+region CGRectToRegion(CGRect Rect)
+{
+    region Result = { (float) Rect.origin.x,   (float) Rect.origin.y,
+                      (float) Rect.size.width, (float) Rect.size.height,
+                      Region_Full };
+    return Result;
+}
+
+region RoundPreselRegion(region Region, CGPoint Position, CGSize Size)
+{
+    region Result = {
+        roundf(Region.X),
+        roundf(Region.Y),
+        roundf(Region.Width),
+        roundf(Region.Height)
+    };
+
+    float DiffX = abs(Region.X - Position.x);
+    float DiffY = abs(Region.Y - Position.y);
+    float DiffW = abs(Region.Width - Size.width);
+    float DiffH = abs(Region.Height - Size.height);
+
+    if ((DiffX >= 0.5) && (DiffX <= 2.5)) {
+        Result.X = Position.x;
+    }
+
+    if ((DiffY >= 0.5) && (DiffY <= 2.5)) {
+        Result.Y = Position.y;
+    }
+
+    if ((DiffW >= 0.5) && (DiffW <= 2.5)) {
+        Result.Width = Size.width;
+    }
+
+    if ((DiffH >= 0.5) && (DiffH <= 2.5)) {
+        Result.Height = Size.height;
+    }
+
+    return Result;
+}
+
+#define OSX_MENU_BAR_HEIGHT 22.0f
+internal void
+ConstrainRegion(display_geometry *Display, dock_geometry *Dock, region *Region)
+{
+    // NOTE(koekeishiya): Automatically adjust padding to account for osx menubar status.
+    if (!Dock->MenuBarAutoHide) {
+        Region->Y += OSX_MENU_BAR_HEIGHT;
+        Region->Height -= OSX_MENU_BAR_HEIGHT;
+    }
+
+    if (CVarIntegerValue(CVAR_BAR_ENABLED)) {
+        bool ShouldApplyOffset = true;
+        if (!CVarIntegerValue(CVAR_BAR_ALL_MONITORS)) {
+            ShouldApplyOffset = Display->IsMain;
+        }
+
+        if (ShouldApplyOffset) {
+            Region->X += CVarFloatingPointValue(CVAR_BAR_OFFSET_LEFT);
+            Region->Width -= CVarFloatingPointValue(CVAR_BAR_OFFSET_LEFT);
+
+            Region->Y += CVarFloatingPointValue(CVAR_BAR_OFFSET_TOP);
+            Region->Height -= CVarFloatingPointValue(CVAR_BAR_OFFSET_TOP);
+
+            Region->Width -= CVarFloatingPointValue(CVAR_BAR_OFFSET_RIGHT);
+            Region->Height -= CVarFloatingPointValue(CVAR_BAR_OFFSET_BOTTOM);
+        }
+    }
+
+    if (!Dock->DockAutoHide) {
+        CGRect DockRect = Dock->DockRect;
+
+        switch (Dock->DockOrientation) {
+        case Dock_Orientation_Left: {
+            if (Display->IsLeftMost) {
+                Region->X += DockRect.size.width;
+                Region->Width -= DockRect.size.width;
+            }
+        } break;
+        case Dock_Orientation_Right: {
+            if (Display->IsRightMost) {
+                Region->Width -= DockRect.size.width;
+            }
+        } break;
+        case Dock_Orientation_Bottom: {
+            if (Display->IsBottomMost) {
+                Region->Height -= DockRect.size.height;
+            }
+        } break;
+        case Dock_Orientation_Top: { /* NOTE(koekeishiya) compiler warning.. */ } break;
+        }
+    }
+}
+
+void ConstrainRegion(CFStringRef DisplayRef, region *Region)
+{
+    display_geometry Display = GetDisplayGeometry(DisplayRef);
+    dock_geometry Dock = GetDockGeometry();
+    ConstrainRegion(&Display, &Dock, Region);
+}
+
+region FullscreenRegion(CFStringRef DisplayRef, virtual_space *VirtualSpace)
+{
+    display_geometry Display = GetDisplayGeometry(DisplayRef);
+    dock_geometry Dock = GetDockGeometry();
+
+    region Result = CGRectToRegion(Display.Bounds);
+    ConstrainRegion(&Display, &Dock, &Result);
+    ApplyRegionOffset(&Result, VirtualSpace->Offset);
+
+    return Result;
+}
+
+internal frame_apply_stats FrameApplyStats;
+
+void ResetFrameApplyStats()
+{
+    FrameApplyStats.Applied = 0;
+    FrameApplyStats.Skipped = 0;
+}
+
+frame_apply_stats GetFrameApplyStats()
+{
+    return FrameApplyStats;
+}
+
+bool BeginWindowPropertyCache()
+{
+    return pthread_mutex_init(&WindowPropertyLock, NULL) == 0;
+}
+
+void EndWindowPropertyCache()
+{
+    WindowProperties.clear();
+    pthread_mutex_destroy(&WindowPropertyLock);
+}
+
+// NOTE(koekeishiya): Called when we receive a notification for the window, or change it ourselves.
+void InvalidateWindowProperties(uint32_t WindowId, uint32_t Properties)
+{
+    pthread_mutex_lock(&WindowPropertyLock);
+    window_properties_map_it It = WindowProperties.find(WindowId);
+    if (It != WindowProperties.end()) {
+        It->second.Valid &= ~Properties;
+        ++It->second.Generation;
+    }
+    pthread_mutex_unlock(&WindowPropertyLock);
+}
+
+void AddWindowProperties(uint32_t WindowId)
+{
+    pthread_mutex_lock(&WindowPropertyLock);
+    WindowProperties.insert(std::make_pair(WindowId, window_properties()));
+    pthread_mutex_unlock(&WindowPropertyLock);
+}
+
+void RemoveWindowProperties(uint32_t WindowId)
+{
+    pthread_mutex_lock(&WindowPropertyLock);
+    WindowProperties.erase(WindowId);
+    pthread_mutex_unlock(&WindowPropertyLock);
+}
+
+void ClearWindowProperties()
+{
+    pthread_mutex_lock(&WindowPropertyLock);
+    WindowProperties.clear();
+    pthread_mutex_unlock(&WindowPropertyLock);
+}
+
+/*
+ * NOTE(koekeishiya): Returns true if the property is cached, and the generation that a value
+ * queried from the application must be stored with. If the window_property_verify cvar is
+ * set, a cached property is reported as missing so that the caller queries the live value,
+ * and compares the two. A window that we do not track is never cached.
+ */
+internal bool
+LookupWindowProperty(uint32_t WindowId, uint32_t Property, window_properties *Result)
+{
+    bool Cached = false;
+    memset(Result, 0, sizeof(window_properties));
+
+    pthread_mutex_lock(&WindowPropertyLock);
+    window_properties_map_it It = WindowProperties.find(WindowId);
+    if (It != WindowProperties.end()) {
+        Cached = (It->second.Valid & Property) != 0;
+        *Result = It->second;
+    }
+
+    if (Cached) {
+        ++WindowPropertyStats.Hits;
+    } else {
+        ++WindowPropertyStats.Misses;
+    }
+    pthread_mutex_unlock(&WindowPropertyLock);
+
+    return Cached;
+}
+
+internal void
+WindowPropertyMismatch(uint32_t WindowId, const char *Property)
+{
+    pthread_mutex_lock(&WindowPropertyLock);
+    ++WindowPropertyStats.Mismatches;
+    pthread_mutex_unlock(&WindowPropertyLock);
+
+    c_log(C_LOG_LEVEL_WARN, "chunkwm-tiling: window %d cached %s does not match the window!\n", WindowId, Property);
+}
+
+bool IsWindowFullscreen(macos_window *Window)
+{
+    window_properties Cached;
+    bool Verify = CVarIntegerValue(CVAR_WINDOW_PROPERTY_VERIFY);
+    bool Hit = LookupWindowProperty(Window->Id, Window_Property_Fullscreen, &Cached);
+    if (Hit && !Verify) {
+        return Cached.Fullscreen;
+    }
+
+    bool Result = AXLibIsWindowFullscreen(Window->Ref);
+    if (Hit && Result != Cached.Fullscreen) {
+        WindowPropertyMismatch(Window->Id, "fullscreen state");
+    }
+
+    // NOTE(koekeishiya): The window may have been removed while we queried it, do not add it back.
+    pthread_mutex_lock(&WindowPropertyLock);
+    window_properties_map_it It = WindowProperties.find(Window->Id);
+    if ((It != WindowProperties.end()) && (It->second.Generation == Cached.Generation)) {
+        It->second.Fullscreen = Result;
+        It->second.Valid |= Window_Property_Fullscreen;
+    }
+    pthread_mutex_unlock(&WindowPropertyLock);
+
+    return Result;
+}
+
+void ResetWindowPropertyStats()
+{
+    pthread_mutex_lock(&WindowPropertyLock);
+    memset(&WindowPropertyStats, 0, sizeof(window_property_stats));
+    pthread_mutex_unlock(&WindowPropertyLock);
+}
+
+window_property_stats GetWindowPropertyStats()
+{
+    pthread_mutex_lock(&WindowPropertyLock);
+    window_property_stats Result = WindowPropertyStats;
+    pthread_mutex_unlock(&WindowPropertyLock);
+    return Result;
+}
+
+internal inline bool
+WindowHasFrame(macos_window *Window, region Region)
+{
+    bool Result = ((fabs(Window->Position.x - Region.X) < 1.0f) &&
+                   (fabs(Window->Position.y - Region.Y) < 1.0f) &&
+                   (fabs(Window->Size.width - Region.Width) < 1.0f) &&
+                   (fabs(Window->Size.height - Region.Height) < 1.0f));
+    return Result;
+}
+
+/*
+ * NOTE(koekeishiya): Window->Position and Window->Size hold the last frame we applied,
+ * or the frame reported by the most recent moved / resized event if the window was
+ * changed by someone else since. If the window already has the requested frame, we
+ * do not have to make any (synchronous) AX calls into the owning application.
+ */
+internal void
+ApplyWindowFrame(macos_window *Window, region Region, bool Center, frame_batch *Batch)
+{
+    if (WindowHasFrame(Window, Region)) {
+        ++FrameApplyStats.Skipped;
+        return;
+    }
+
+    ++FrameApplyStats.Applied;
+    FrameBatchAdd(Batch, Window, Region, Center);
+}
+
+internal void
+MacOSApplyWindowFrames(window_frame *Frames, uint32_t Count)
+{
+    frame_batch Batch;
+    BeginFrameBatch(&Batch);
+
+    for (uint32_t Index = 0; Index < Count; ++Index) {
+        window_frame *Frame = Frames + Index;
+
+        macos_window *Window = GetWindowByID(Frame->WindowId);
+        if (!Window) {
+
+            /*
+             * NOTE(koekeishiya): Sometimes we appear to have a node with reference to a windowid
+             * that is no longer in our cache for whatever reason. We ignore this and continue for now,
+             * until we figure out why this is happening / can happen..
+             *
+             * This also happens when the zoom-system restores a window that is being untiled from
+             * the currently active desktop, in which case the window no longer exists anyway.
+             */
+
+            continue;
+        }
+
+        ApplyWindowFrame(Window, Frame->Region, Frame->Center, &Batch);
+    }
+
+    CommitFrameBatch(&Batch);
+}
+
+internal region
+MacOSSpaceRegion(macos_space *Space)
+{
+    CFStringRef DisplayRef = AXLibGetDisplayIdentifierFromSpace(Space->Id);
+    ASSERT(DisplayRef);
+
+    display_geometry Display = GetDisplayGeometry(DisplayRef);
+    dock_geometry Dock = GetDockGeometry();
+    CFRelease(DisplayRef);
+
+    region Result = CGRectToRegion(Display.Bounds);
+    ConstrainRegion(&Display, &Dock, &Result);
+    return Result;
+}
+
+window_backend MacOSWindowBackend =
+{
+    MacOSSpaceRegion,
+    MacOSApplyWindowFrames,
+    DestroyPreselWindow,
+};
+
+void ConstrainWindowToRegion(macos_window *Window)
+{
+    if (WindowHasFlags(Window, Window_Float) || IsWindowFullscreen(Window)) {
+        return;
+    }
+
+    macos_space *ActiveSpace;
+    CFStringRef DisplayRef = AXLibGetDisplayIdentifierFromWindowRect(Window->Position, Window->Size);
+    ASSERT(DisplayRef);
+
+    if (AXLibIsDisplayChangingSpaces(DisplayRef)) {
+        goto out;
+    }
+
+    ActiveSpace = AXLibActiveSpace(DisplayRef);
+    ASSERT(ActiveSpace);
+
+    if (AXLibSpaceHasWindow(ActiveSpace->Id, Window->Id)) {
+        // NOTE(choco): we already checked for fullscreen flag but we also need to
+        // check for the space type
+        // 1- when an app enters native fullscreen, space type may not be already
+        //    updated, fullscreen flag will be already set
+        // 2- when an app exits native fullscreen, fullscreen flag is removed
+        //    immediatly, but we may still be in a fullscreen space
+        if (ActiveSpace->Type == kCGSSpaceUser) {
+            virtual_space *VirtualSpace = AcquireVirtualSpace(ActiveSpace);
+            if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+                if (MonocleWindowIndex(&VirtualSpace->Monocle, Window->Id) != -1) {
+                    ApplyMonocleRegion(&VirtualSpace->Monocle, Window->Id, true);
+                }
+            } else if ((VirtualSpace->Tree) && (VirtualSpace->Mode != Virtual_Space_Float)) {
+                node *WindowNode = GetNodeWithId(VirtualSpace, Window->Id);
+                if (WindowNode) {
+                    window_frame_list Frames;
+                    BeginWindowFrameList(&Frames);
+                    ApplyNodeRegionWithPotentialZoom(WindowNode, VirtualSpace, false, &Frames);
+                    CommitWindowFrameList(&Frames);
+                }
+            }
+            ReleaseVirtualSpace(VirtualSpace);
+        }
+    } else if (!AXLibStickyWindow(Window->Id)) {
+        //
+        // NOTE(koekeishiya): The window is not on the active desktop. Record the
+        // window, so that it is restored upon next activation of its desktop.
+        //
+        macos_space **WindowSpaces = AXLibSpacesForWindow(Window->Id);
+        if (WindowSpaces) {
+            macos_space *WindowSpace = *WindowSpaces;
+            if (WindowSpace) {
+                if (WindowSpace->Type == kCGSSpaceUser) {
+                    virtual_space *VirtualSpace = AcquireVirtualSpace(WindowSpace);
+                    if ((VirtualSpaceHasWindows(VirtualSpace)) && (VirtualSpace->Mode != Virtual_Space_Float)) {
+                        VirtualSpaceDeferWindowUpdate(VirtualSpace, Window->Id);
+                    }
+                    ReleaseVirtualSpace(VirtualSpace);
+                }
+                AXLibDestroySpace(WindowSpace);
+            }
+            free(WindowSpaces);
+        }
+    }
+
+    AXLibDestroySpace(ActiveSpace);
+out:
+    CFRelease(DisplayRef);
+}
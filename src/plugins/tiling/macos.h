@@ -0,0 +1,99 @@
+#ifndef PLUGIN_MACOS_H
+#define PLUGIN_MACOS_H
+
+#include <Carbon/Carbon.h>
+#include <stdint.h>
+
+#include "region.h"
+#include "backend.h"
+
+/*
+ * NOTE(koekeishiya): Display properties needed to compute the usable region of a
+ * display. They are cached by display UUID and only refreshed after a display
+ * event, or for the dock and menubar state, once per event we process.
+ */
+struct display_geometry
+{
+    CGRect Bounds;
+    bool IsMain;
+    bool IsLeftMost;
+    bool IsRightMost;
+    bool IsBottomMost;
+};
+
+struct dock_geometry
+{
+    bool Valid;
+    bool MenuBarAutoHide;
+    bool DockAutoHide;
+    int DockOrientation;
+    CGRect DockRect;
+};
+
+struct frame_apply_stats
+{
+    uint32_t Applied;
+    uint32_t Skipped;
+};
+
+enum window_property
+{
+    Window_Property_Fullscreen = (1 << 0),
+    Window_Property_All        = Window_Property_Fullscreen,
+};
+
+/*
+ * NOTE(koekeishiya): Window properties that would otherwise cost a synchronous AX call into
+ * the owning application every time they are read. A property is queried on first use, and
+ * stays valid until a window notification tells us that it may have changed. Generation is
+ * incremented on every invalidation, so that a query that raced with a notification does not
+ * store its stale result. Only windows in our collection have an entry; AddWindowProperties and
+ * RemoveWindowProperties are called when a window is added to and removed from the collection.
+ */
+struct window_properties
+{
+    uint32_t Valid;
+    uint32_t Generation;
+    bool Fullscreen;
+};
+
+struct window_property_stats
+{
+    uint32_t Hits;
+    uint32_t Misses;
+    uint32_t Mismatches;
+};
+
+struct macos_window;
+struct virtual_space;
+
+extern window_backend MacOSWindowBackend;
+
+bool BeginDisplayGeometryCache();
+void EndDisplayGeometryCache();
+void InvalidateDisplayGeometry();
+void InvalidateDockGeometry();
+display_geometry GetDisplayGeometry(CFStringRef DisplayRef);
+
+region CGRectToRegion(CGRect Rect);
+region RoundPreselRegion(region Region, CGPoint Position, CGSize Size);
+void ConstrainRegion(CFStringRef DisplayRef, region *Region);
+region FullscreenRegion(CFStringRef DisplayRef, virtual_space *VirtualSpace);
+
+void ResetFrameApplyStats();
+frame_apply_stats GetFrameApplyStats();
+
+bool BeginWindowPropertyCache();
+void EndWindowPropertyCache();
+void InvalidateWindowProperties(uint32_t WindowId, uint32_t Properties);
+void AddWindowProperties(uint32_t WindowId);
+void RemoveWindowProperties(uint32_t WindowId);
+void ClearWindowProperties();
+bool IsWindowFullscreen(macos_window *Window);
+
+void ResetWindowPropertyStats();
+window_property_stats GetWindowPropertyStats();
+
+void ConstrainWindowToRegion(macos_window *Window);
+
+#endif
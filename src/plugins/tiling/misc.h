@@ -21,25 +21,4 @@ FileExists(const char *Absolutepath)
     return Result;
 }
 
-inline char *
-ReadFile(const char *Absolutepath)
-{
-    char *Contents = NULL;
-    FILE *Descriptor = fopen(Absolutepath, "r");
-
-    if (Descriptor) {
-        fseek(Descriptor, 0, SEEK_END);
-        unsigned Length = ftell(Descriptor);
-        fseek(Descriptor, 0, SEEK_SET);
-
-        Contents = (char *) malloc(Length + 1);
-        fread(Contents, Length, 1, Descriptor);
-        Contents[Length] = '\0';
-
-        fclose(Descriptor);
-    }
-
-    return Contents;
-}
-
 #endif
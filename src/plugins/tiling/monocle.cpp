@@ -0,0 +1,110 @@
+#include "monocle.h"
+#include "backend.h"
+
+#include "../../common/misc/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MONOCLE_MIN_CAPACITY 16
+
+void InitMonocleList(monocle_list *Monocle)
+{
+    memset(Monocle, 0, sizeof(monocle_list));
+}
+
+void ClearMonocleList(monocle_list *Monocle)
+{
+    Monocle->Count = 0;
+}
+
+void FreeMonocleList(monocle_list *Monocle)
+{
+    free(Monocle->Windows);
+    InitMonocleList(Monocle);
+}
+
+/*
+ * NOTE(koekeishiya): A desktop rarely has more than a handful of windows, and a scan
+ * of a packed array of ids is cheaper than maintaining a second index that has to be
+ * updated every time a window is inserted in the middle of the list.
+ */
+int MonocleWindowIndex(monocle_list *Monocle, uint32_t WindowId)
+{
+    for (uint32_t Index = 0; Index < Monocle->Count; ++Index) {
+        if (Monocle->Windows[Index] == WindowId) {
+            return Index;
+        }
+    }
+
+    return -1;
+}
+
+// NOTE(koekeishiya): The index wraps around, so that Index - 1 and Index + 1 are the neighbours.
+uint32_t MonocleWindowAt(monocle_list *Monocle, int Index)
+{
+    ASSERT(Monocle->Count > 0);
+
+    int Count = Monocle->Count;
+    return Monocle->Windows[((Index % Count) + Count) % Count];
+}
+
+void MonocleInsertWindow(monocle_list *Monocle, uint32_t Index, uint32_t WindowId)
+{
+    ASSERT(Index <= Monocle->Count);
+
+    if (Monocle->Count == Monocle->Capacity) {
+        Monocle->Capacity = Monocle->Capacity ? Monocle->Capacity * 2 : MONOCLE_MIN_CAPACITY;
+        Monocle->Windows = (uint32_t *) realloc(Monocle->Windows, sizeof(uint32_t) * Monocle->Capacity);
+    }
+
+    memmove(Monocle->Windows + Index + 1,
+            Monocle->Windows + Index,
+            sizeof(uint32_t) * (Monocle->Count - Index));
+
+    Monocle->Windows[Index] = WindowId;
+    ++Monocle->Count;
+}
+
+bool MonocleRemoveWindow(monocle_list *Monocle, uint32_t WindowId)
+{
+    int Index = MonocleWindowIndex(Monocle, WindowId);
+    if (Index == -1) {
+        return false;
+    }
+
+    --Monocle->Count;
+    memmove(Monocle->Windows + Index,
+            Monocle->Windows + Index + 1,
+            sizeof(uint32_t) * (Monocle->Count - Index));
+    return true;
+}
+
+void MonocleSwapWindows(monocle_list *Monocle, uint32_t A, uint32_t B)
+{
+    ASSERT(A < Monocle->Count && B < Monocle->Count);
+
+    uint32_t Temp = Monocle->Windows[A];
+    Monocle->Windows[A] = Monocle->Windows[B];
+    Monocle->Windows[B] = Temp;
+}
+
+void ApplyMonocleRegion(monocle_list *Monocle, uint32_t WindowId, bool Center)
+{
+    window_frame_list Frames;
+    BeginWindowFrameList(&Frames);
+    WindowFrameListAdd(&Frames, WindowId, Monocle->Region, Center);
+    CommitWindowFrameList(&Frames);
+}
+
+void ApplyMonocleRegion(monocle_list *Monocle, bool Center)
+{
+    window_frame_list Frames;
+    BeginWindowFrameList(&Frames);
+
+    for (uint32_t Index = 0; Index < Monocle->Count; ++Index) {
+        WindowFrameListAdd(&Frames, Monocle->Windows[Index], Monocle->Region, Center);
+    }
+
+    CommitWindowFrameList(&Frames);
+}
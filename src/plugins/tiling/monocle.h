@@ -0,0 +1,35 @@
+#ifndef PLUGIN_MONOCLE_H
+#define PLUGIN_MONOCLE_H
+
+#include <stdint.h>
+
+#include "region.h"
+
+/*
+ * NOTE(koekeishiya): A monocle desktop shows one window at a time, and every window
+ * covers the same region. Instead of a node per window, the windows are stored in a
+ * packed array in cycle order, and the region is stored once for the whole desktop.
+ * The window at a given position, and its neighbours, are simple array lookups.
+ */
+struct monocle_list
+{
+    uint32_t *Windows;
+    uint32_t Count;
+    uint32_t Capacity;
+    region Region;
+};
+
+void InitMonocleList(monocle_list *Monocle);
+void ClearMonocleList(monocle_list *Monocle);
+void FreeMonocleList(monocle_list *Monocle);
+
+int MonocleWindowIndex(monocle_list *Monocle, uint32_t WindowId);
+uint32_t MonocleWindowAt(monocle_list *Monocle, int Index);
+void MonocleInsertWindow(monocle_list *Monocle, uint32_t Index, uint32_t WindowId);
+bool MonocleRemoveWindow(monocle_list *Monocle, uint32_t WindowId);
+void MonocleSwapWindows(monocle_list *Monocle, uint32_t A, uint32_t B);
+
+void ApplyMonocleRegion(monocle_list *Monocle, uint32_t WindowId, bool Center);
+void ApplyMonocleRegion(monocle_list *Monocle, bool Center);
+
+#endif
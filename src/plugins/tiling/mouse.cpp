@@ -10,6 +10,7 @@
 #include "../../common/misc/assert.h"
 
 #include "node.h"
+#include "macos.h"
 #include "vspace.h"
 #include "controller.h"
 #include "constants.h"
@@ -24,6 +25,7 @@
 
 extern "C" OSStatus CGSFindWindowByGeometry(int cid, int zero, int one, int zero_again, CGPoint *screen_point, CGPoint *window_coords_out, int *wid_out, int *cid_out);
 extern macos_window *GetWindowByID(uint32_t Id);
+extern bool WindowHasFlags(macos_window *Window, uint32_t Flags);
 
 enum drag_mode
 {
@@ -140,7 +142,7 @@ CreateResizeBorder(node *Node, macos_window *Window)
 internal void
 CreateResizeBorders(node *Node)
 {
-    if ((Node->WindowId) && (Node->WindowId != Node_PseudoLeaf)) {
+    if ((Node->WindowId) && (Node->WindowId != (uint32_t) Node_PseudoLeaf)) {
         macos_window *Window = GetWindowByID(Node->WindowId);
         ASSERT(Window);
         ResizeBorders.push_back(CreateResizeBorder(Node, Window));
@@ -208,7 +210,7 @@ BeginFloatingWindow(virtual_space *VirtualSpace, drag_mode DragMode)
         return false;
     }
 
-    if ((VirtualSpace->Mode == Virtual_Space_Float) || (AXLibHasFlags(Window, Window_Float))) {
+    if ((VirtualSpace->Mode == Virtual_Space_Float) || (WindowHasFlags(Window, Window_Float))) {
         if ((Cursor.x >= Window->Position.x) &&
             (Cursor.x <= Window->Position.x + Window->Size.width) &&
             (Cursor.y >= Window->Position.y) &&
@@ -237,7 +239,7 @@ BeginTiledWindow(macos_space *Space, virtual_space *VirtualSpace, drag_mode Drag
 
     if (VirtualSpace->Mode != Virtual_Space_Bsp) return false;
     if (!(Root = VirtualSpace->Tree)) return false;
-    if (!(NodeBelowCursor = GetNodeForPoint(Root, &Cursor))) return false;
+    if (!(NodeBelowCursor = GetNodeForPoint(Root, Cursor.x, Cursor.y))) return false;
     if (!(WindowBelowCursor = GetWindowByID(NodeBelowCursor->WindowId))) return false;
 
     if (DragMode == Drag_Mode_Swap) {
@@ -275,14 +277,14 @@ BeginTiledWindow(macos_space *Space, virtual_space *VirtualSpace, drag_mode Drag
         else                   HorizontalWindow = NULL;
 
         if (VerticalWindow) {
-            node *VerticalNode = GetNodeWithId(Root, VerticalWindow->Id, VirtualSpace->Mode);
+            node *VerticalNode = GetNodeWithId(VirtualSpace, VerticalWindow->Id);
             ASSERT(VerticalNode);
             ResizeState.Vertical = GetLowestCommonAncestor(NodeBelowCursor, VerticalNode);
             ResizeState.InitialRatioV = ResizeState.Vertical->Ratio;
         }
 
         if (HorizontalWindow) {
-            node *HorizontalNode = GetNodeWithId(Root, HorizontalWindow->Id, VirtualSpace->Mode);
+            node *HorizontalNode = GetNodeWithId(VirtualSpace, HorizontalWindow->Id);
             ASSERT(HorizontalNode);
             ResizeState.Horizontal = GetLowestCommonAncestor(NodeBelowCursor, HorizontalNode);
             ResizeState.InitialRatioH = ResizeState.Horizontal->Ratio;
@@ -332,7 +334,7 @@ MouseMoveWindowTick()
 {
     if (ResizeState.Mode == Drag_Mode_Swap) {
         CGPoint Cursor = AXLibGetCursorPos();
-        node *NewNode = GetNodeForPoint(ResizeState.VirtualSpace->Tree, &Cursor);
+        node *NewNode = GetNodeForPoint(ResizeState.VirtualSpace->Tree, Cursor.x, Cursor.y);
         if (NewNode && NewNode != ResizeState.Vertical) {
             ResizeState.Vertical = NewNode;
             if (ResizeBorders.size() == 2) {
@@ -390,7 +392,7 @@ MouseMoveWindowEnd()
 
         if ((ResizeState.Horizontal && ResizeState.Vertical) &&
             (ResizeState.Horizontal != ResizeState.Vertical)) {
-            SwapNodeIds(ResizeState.Horizontal, ResizeState.Vertical);
+            SwapNodeIds(ResizeState.Horizontal, ResizeState.Vertical, ResizeState.VirtualSpace);
             ResizeWindowToRegionSize(ResizeState.Horizontal);
             ResizeWindowToRegionSize(ResizeState.Vertical);
         }
@@ -1,22 +1,23 @@
 #include "node.h"
 #include "vspace.h"
+#include "layout.h"
+#include "backend.h"
 #include "constants.h"
+#include "misc.h"
 
-#include "presel.h"
-#include "../../common/config/tokenize.h"
 #include "../../common/config/cvar.h"
 #include "../../common/misc/assert.h"
-#include "../../common/accessibility/window.h"
-#include "../../common/accessibility/element.h"
-#include "../../common/accessibility/display.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <queue>
-#include <map>
+#include <vector>
+#include <algorithm>
+#include <unordered_set>
 
 #define internal static
 
-extern macos_window *GetWindowByID(uint32_t Id);
-
 node_ids AssignNodeIds(uint32_t ExistingId, uint32_t NewId, bool SpawnLeft)
 {
     node_ids NodeIds;
@@ -30,13 +31,18 @@ node_ids AssignNodeIds(uint32_t ExistingId, uint32_t NewId, bool SpawnLeft)
     return NodeIds;
 }
 
-node_split OptimalSplitMode(node *Node)
+internal inline node_split
+OptimalSplitMode(node *Node, float OptimalRatio)
 {
-    float OptimalRatio = CVarFloatingPointValue(CVAR_BSP_OPTIMAL_RATIO);
     float NodeRatio = Node->Region.Width / Node->Region.Height;
     return NodeRatio >= OptimalRatio ? Split_Vertical : Split_Horizontal;
 }
 
+node_split OptimalSplitMode(node *Node)
+{
+    return OptimalSplitMode(Node, CVarFloatingPointValue(CVAR_BSP_OPTIMAL_RATIO));
+}
+
 node_split NodeSplitFromString(char *Value)
 {
     for (int Index = Split_None; Index <= Split_Horizontal; ++Index) {
@@ -47,12 +53,35 @@ node_split NodeSplitFromString(char *Value)
     return Split_None;
 }
 
-node *CreateRootNode(uint32_t WindowId, macos_space *Space, virtual_space *VirtualSpace)
+internal inline bool
+IsWindowNodeId(uint32_t WindowId)
 {
-    node *Node = (node *) malloc(sizeof(node));
-    memset(Node, 0, sizeof(node));
+    bool Result = ((WindowId != Node_Root) &&
+                   (WindowId != (uint32_t) Node_PseudoLeaf));
+    return Result;
+}
+
+// NOTE(koekeishiya): All changes to the window id of a node in a tree must go
+// through here, so that the window-id index of the virtual_space stays valid.
+void SetNodeWindowId(node *Node, uint32_t WindowId, virtual_space *VirtualSpace)
+{
+    if ((IsWindowNodeId(Node->WindowId)) &&
+        (NodeIndexLookup(&VirtualSpace->NodeIndex, Node->WindowId) == Node)) {
+        NodeIndexRemove(&VirtualSpace->NodeIndex, Node->WindowId);
+    }
 
     Node->WindowId = WindowId;
+
+    if (IsWindowNodeId(WindowId)) {
+        NodeIndexInsert(&VirtualSpace->NodeIndex, WindowId, Node);
+    }
+}
+
+node *CreateRootNode(uint32_t WindowId, macos_space *Space, virtual_space *VirtualSpace)
+{
+    node *Node = AllocateNode(&VirtualSpace->NodePool);
+
+    SetNodeWindowId(Node, WindowId, VirtualSpace);
     CreateNodeRegion(Node, Region_Full, Space, VirtualSpace);
     Node->Split = OptimalSplitMode(Node);
     Node->Ratio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
@@ -60,25 +89,35 @@ node *CreateRootNode(uint32_t WindowId, macos_space *Space, virtual_space *Virtu
     return Node;
 }
 
-node *CreateLeafNode(node *Parent, uint32_t WindowId, region_type Type,
-                     macos_space *Space, virtual_space *VirtualSpace)
+internal node *
+CreateLeafNode(node *Parent, uint32_t WindowId, region_type Type, float Ratio,
+               float OptimalRatio, macos_space *Space, virtual_space *VirtualSpace)
 {
-    node *Node = (node *) malloc(sizeof(node));
-    memset(Node, 0, sizeof(node));
+    node *Node = AllocateNode(&VirtualSpace->NodePool);
 
     Node->Parent = Parent;
-    Node->WindowId = WindowId;
+    Node->Depth = Parent->Depth + 1;
+    SetNodeWindowId(Node, WindowId, VirtualSpace);
     CreateNodeRegion(Node, Type, Space, VirtualSpace);
-    Node->Split = OptimalSplitMode(Node);
-    Node->Ratio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
+    Node->Split = OptimalSplitMode(Node, OptimalRatio);
+    Node->Ratio = Ratio;
 
     return Node;
 }
 
+node *CreateLeafNode(node *Parent, uint32_t WindowId, region_type Type,
+                     macos_space *Space, virtual_space *VirtualSpace)
+{
+    return CreateLeafNode(Parent, WindowId, Type,
+                          CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO),
+                          CVarFloatingPointValue(CVAR_BSP_OPTIMAL_RATIO),
+                          Space, VirtualSpace);
+}
+
 void CreateLeafNodePair(node *Parent, uint32_t ExistingWindowId, uint32_t SpawnedWindowId,
                         node_split Split, macos_space *Space, virtual_space *VirtualSpace)
 {
-    Parent->WindowId = Node_Root;
+    SetNodeWindowId(Parent, Node_Root, VirtualSpace);
     Parent->Split = Split;
     Parent->Ratio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
 
@@ -95,10 +134,56 @@ void CreateLeafNodePair(node *Parent, uint32_t ExistingWindowId, uint32_t Spawne
     }
 }
 
+/*
+ * NOTE(koekeishiya): Builds the same tree as inserting the windows one at a time at the
+ * first leaf of minimum depth. That leaf is always the oldest leaf that has not been
+ * split yet, so a fifo of leaves replaces the breadth-first search for every window.
+ * Regions are created top-down together with the nodes, and every cvar is read once.
+ */
+node *CreateNodeTree(uint32_t *Windows, uint32_t Count, node_split Split,
+                     macos_space *Space, virtual_space *VirtualSpace)
+{
+    ASSERT(Count > 0);
+
+    float Ratio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
+    float OptimalRatio = CVarFloatingPointValue(CVAR_BSP_OPTIMAL_RATIO);
+    int SpawnLeft = CVarIntegerValue(CVAR_BSP_SPAWN_LEFT);
+
+    node *Root = CreateRootNode(Windows[0], Space, VirtualSpace);
+
+    uint32_t Head = 0, Tail = 0;
+    node **Leaves = (node **) malloc(sizeof(node *) * (2 * Count - 1));
+    Leaves[Tail++] = Root;
+
+    for (uint32_t Index = 1; Index < Count; ++Index) {
+        node *Parent = Leaves[Head++];
+        node_ids NodeIds = AssignNodeIds(Parent->WindowId, Windows[Index], SpawnLeft);
+
+        SetNodeWindowId(Parent, Node_Root, VirtualSpace);
+        Parent->Split = Split == Split_Optimal ? OptimalSplitMode(Parent, OptimalRatio) : Split;
+        Parent->Ratio = Ratio;
+
+        ASSERT(Parent->Split == Split_Vertical || Parent->Split == Split_Horizontal);
+        if (Parent->Split == Split_Vertical) {
+            Parent->Left = CreateLeafNode(Parent, NodeIds.Left, Region_Left, Ratio, OptimalRatio, Space, VirtualSpace);
+            Parent->Right = CreateLeafNode(Parent, NodeIds.Right, Region_Right, Ratio, OptimalRatio, Space, VirtualSpace);
+        } else if (Parent->Split == Split_Horizontal) {
+            Parent->Left = CreateLeafNode(Parent, NodeIds.Left, Region_Upper, Ratio, OptimalRatio, Space, VirtualSpace);
+            Parent->Right = CreateLeafNode(Parent, NodeIds.Right, Region_Lower, Ratio, OptimalRatio, Space, VirtualSpace);
+        }
+
+        Leaves[Tail++] = Parent->Left;
+        Leaves[Tail++] = Parent->Right;
+    }
+
+    free(Leaves);
+    return Root;
+}
+
 void CreateLeafNodePairPreselect(node *Parent, uint32_t ExistingWindowId, uint32_t SpawnedWindowId,
                                  macos_space *Space, virtual_space *VirtualSpace)
 {
-    Parent->WindowId = Node_Root;
+    SetNodeWindowId(Parent, Node_Root, VirtualSpace);
     Parent->Split = VirtualSpace->Preselect->Split;
     Parent->Ratio = VirtualSpace->Preselect->Ratio;
 
@@ -114,86 +199,221 @@ void CreateLeafNodePairPreselect(node *Parent, uint32_t ExistingWindowId, uint32
     }
 }
 
-internal inline void
-CenterWindowInRegion(macos_window *Window, region Region)
+/*
+ * NOTE(koekeishiya): The bsp part of tiling a window, shared by the plugin and the headless
+ * host. Preselections are handled by the caller. When a new window is being tiled, the
+ * following priority is taking place.
+ *
+ *              1. If there are any pending pseudo-leafs (layout deserialization), fill this region.
+ *              2. If the window at the insertion point is eligible, split this region.
+ *              3. Find the first minimum-depth leaf node and split this region.
+ *
+ * Returns the node whose region has to be applied, or NULL if the window is already tiled.
+ */
+node *InsertWindowNode(virtual_space *VirtualSpace, uint32_t WindowId, uint32_t InsertionPoint, macos_space *Space)
+{
+    if (!VirtualSpace->Tree) {
+        layout_file Layout;
+        if ((ShouldDeserializeVirtualSpace(VirtualSpace)) &&
+            (BeginLayoutFile(VirtualSpace->TreeLayout, &Layout))) {
+            VirtualSpace->Tree = DeserializeLayoutFile(&Layout, VirtualSpace);
+            EndLayoutFile(&Layout);
+            SetNodeWindowId(VirtualSpace->Tree, WindowId, VirtualSpace);
+            CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
+            CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
+        } else {
+            VirtualSpace->Tree = CreateRootNode(WindowId, Space, VirtualSpace);
+        }
+        return VirtualSpace->Tree;
+    }
+
+    if (GetNodeWithId(VirtualSpace, WindowId)) {
+        return NULL;
+    }
+
+    node *Node = GetFirstMinDepthPseudoLeafNode(VirtualSpace->Tree);
+    if (Node) {
+        if (Node->Parent) {
+            int SpawnLeft = CVarIntegerValue(CVAR_BSP_SPAWN_LEFT);
+            node_ids NodeIds = AssignNodeIds(Node->Parent->WindowId, WindowId, SpawnLeft);
+            SetNodeWindowId(Node->Parent, Node_Root, VirtualSpace);
+            SetNodeWindowId(Node->Parent->Left, NodeIds.Left, VirtualSpace);
+            SetNodeWindowId(Node->Parent->Right, NodeIds.Right, VirtualSpace);
+            CreateNodeRegionRecursive(Node->Parent, false, Space, VirtualSpace);
+            return Node->Parent;
+        }
+
+        SetNodeWindowId(Node, WindowId, VirtualSpace);
+        CreateNodeRegion(Node, Region_Full, Space, VirtualSpace);
+        return Node;
+    }
+
+    if (InsertionPoint) {
+        Node = GetNodeWithId(VirtualSpace, InsertionPoint);
+    }
+
+    if (!Node) {
+        Node = GetFirstMinDepthLeafNode(VirtualSpace->Tree);
+        ASSERT(Node != NULL);
+    }
+
+    node_split Split = NodeSplitFromString(CVarStringValue(CVAR_BSP_SPLIT_MODE));
+    if (Split == Split_Optimal) {
+        Split = OptimalSplitMode(Node);
+    }
+
+    CreateLeafNodePair(Node, Node->WindowId, WindowId, Split, Space, VirtualSpace);
+
+    // NOTE(koekeishiya): Reset fullscreen-zoom state.
+    VirtualSpace->Tree->Zoom = NULL;
+    return Node;
+}
+
+/*
+ * NOTE(koekeishiya): The bsp part of untiling a window, shared by the plugin and the headless
+ * host. The sibling of the node takes the place of their parent. Only the tree is changed;
+ * if the sibling had children, the caller has to recreate the regions below the node that is
+ * returned. Returns NULL if there is nothing left to apply, e.g. because the tree is now empty.
+ */
+node *RemoveWindowNode(virtual_space *VirtualSpace, node *Node)
 {
-    CGPoint Position = AXLibGetWindowPosition(Window->Ref);
-    CGSize Size = AXLibGetWindowSize(Window->Ref);
+    /*
+     * NOTE(koekeishiya): The window was in fullscreen-zoom.
+     * We need to null the pointer to prevent a potential bug.
+     */
+    if (VirtualSpace->Tree->Zoom == Node) {
+        VirtualSpace->Tree->Zoom = NULL;
+    }
 
-    float DiffX = (Region.X + Region.Width) - (Position.x + Size.width);
-    float DiffY = (Region.Y + Region.Height) - (Position.y + Size.height);
+    if (!Node->Parent) {
+        FreeNodeTree(VirtualSpace);
+        return NULL;
+    }
 
-    if ((DiffX > 0.0f) || (DiffY > 0.0f)) {
-        float OffsetX = DiffX / 2.0f;
-        Region.X += OffsetX;
-        Region.Width -= OffsetX;
+    if ((!Node->Parent->Left) || (!Node->Parent->Right)) {
+        return NULL;
+    }
 
-        float OffsetY = DiffY / 2.0f;
-        Region.Y += OffsetY;
-        Region.Height -= OffsetY;
+    /*
+     * NOTE(koekeishiya): The window was in parent-zoom.
+     * We need to null the pointer to prevent a potential bug.
+     */
+    if (Node->Parent->Zoom == Node) {
+        Node->Parent->Zoom = NULL;
+    }
+
+    node *NewLeaf = Node->Parent;
+    node *RemainingLeaf = IsRightChild(Node) ? Node->Parent->Left
+                                             : Node->Parent->Right;
+    NewLeaf->Left = NULL;
+    NewLeaf->Right = NULL;
+    NewLeaf->Zoom = NULL;
+
+    SetNodeWindowId(NewLeaf, RemainingLeaf->WindowId, VirtualSpace);
+    if (RemainingLeaf->Left && RemainingLeaf->Right) {
+        NewLeaf->Left = RemainingLeaf->Left;
+        NewLeaf->Left->Parent = NewLeaf;
 
-        AXLibSetWindowPosition(Window->Ref, Region.X, Region.Y);
-        AXLibSetWindowSize(Window->Ref, Region.Width, Region.Height);
+        NewLeaf->Right = RemainingLeaf->Right;
+        NewLeaf->Right->Parent = NewLeaf;
+
+        UpdateNodeDepth(NewLeaf->Left);
+        UpdateNodeDepth(NewLeaf->Right);
     }
+
+    FreeNode(RemainingLeaf, VirtualSpace);
+    FreeNode(Node, VirtualSpace);
+    return NewLeaf;
 }
 
-void ResizeWindowToRegionSize(node *Node, bool Center)
+/*
+ * NOTE(koekeishiya): Removes several windows at once. Every removal only edits the tree, and
+ * the regions below a node that took the place of its parent are recreated once all windows
+ * have been removed, instead of once for every window.
+ */
+void RemoveWindowNodes(virtual_space *VirtualSpace, uint32_t *Windows, uint32_t Count, macos_space *Space)
 {
-    macos_window *Window = GetWindowByID(Node->WindowId);
-    if (!Window) {
+    std::vector<node *> Promoted;
 
-        /*
-         * NOTE(koekeishiya): Sometimes we appear to have a node with reference to a windowid
-         * that is no longer in our cache for whatever reason. We ignore this and return for now,
-         * until we figure out why this is happening / can happen..
-         */
+    for (uint32_t Index = 0; Index < Count; ++Index) {
+        if (!VirtualSpace->Tree) {
+            return;
+        }
+
+        node *Node = GetNodeWithId(VirtualSpace, Windows[Index]);
+        if (!Node) {
+            continue;
+        }
 
+        // NOTE(koekeishiya): The node and its sibling are freed, so they can no longer be promoted.
+        node *Sibling = NULL;
+        if (Node->Parent) {
+            Sibling = IsRightChild(Node) ? Node->Parent->Left : Node->Parent->Right;
+        }
+
+        Promoted.erase(std::remove(Promoted.begin(), Promoted.end(), Node), Promoted.end());
+        Promoted.erase(std::remove(Promoted.begin(), Promoted.end(), Sibling), Promoted.end());
+
+        node *NewLeaf = RemoveWindowNode(VirtualSpace, Node);
+        if ((NewLeaf) && (NewLeaf->Left && NewLeaf->Right) &&
+            (std::find(Promoted.begin(), Promoted.end(), NewLeaf) == Promoted.end())) {
+            Promoted.push_back(NewLeaf);
+        }
+    }
+
+    if (!VirtualSpace->Tree) {
         return;
     }
 
-    bool WindowMoved  = AXLibSetWindowPosition(Window->Ref, Node->Region.X, Node->Region.Y);
-    bool WindowResized = AXLibSetWindowSize(Window->Ref, Node->Region.Width, Node->Region.Height);
+    std::unordered_set<node *> PromotedSet(Promoted.begin(), Promoted.end());
+    for (size_t Index = 0; Index < Promoted.size(); ++Index) {
+        node *Node = Promoted[Index];
+
+        // NOTE(koekeishiya): A subtree below another promoted node is recreated together with it.
+        bool Nested = false;
+        for (node *Parent = Node->Parent; Parent; Parent = Parent->Parent) {
+            if (PromotedSet.find(Parent) != PromotedSet.end()) {
+                Nested = true;
+                break;
+            }
+        }
 
-    if (Center) {
-        if (WindowMoved || WindowResized) {
-            CenterWindowInRegion(Window, Node->Region);
+        if (!Nested) {
+            CreateNodeRegionRecursive(Node, true, Space, VirtualSpace);
         }
     }
 }
 
+void ResizeWindowToRegionSize(node *Node, bool Center, window_frame_list *Frames)
+{
+    WindowFrameListAdd(Frames, Node->WindowId, Node->Region, Center);
+}
+
+void ResizeWindowToRegionSize(node *Node, bool Center)
+{
+    window_frame_list Frames;
+    BeginWindowFrameList(&Frames);
+    ResizeWindowToRegionSize(Node, Center, &Frames);
+    CommitWindowFrameList(&Frames);
+}
+
 // NOTE(koekeishiya): Call ResizeWindowToRegionSize with center -> true
 void ResizeWindowToRegionSize(node *Node)
 {
     ResizeWindowToRegionSize(Node, true);
 }
 
-void ResizeWindowToExternalRegionSize(node *Node, region Region, bool Center)
+void ResizeWindowToExternalRegionSize(node *Node, region Region, bool Center, window_frame_list *Frames)
 {
-    macos_window *Window = GetWindowByID(Node->WindowId);
-    if (!Window) {
-
-        /*
-         * NOTE(koekeishiya): GetWindowByID can fail in this case, so we need to guard for it.
-         *
-         * If it fails, that means we were unable to restore the window back to the position
-         * and size we expected it to get after the latest operation, howeveer since the window
-         * no longer seems to exist anyway, this is actually fine.
-         *
-         * This seems to be triggered by code that handles the zoom-system whenever a window is
-         * untiled from the currently active desktop.
-         */
-
-        return;
-    }
-
-    bool WindowMoved  = AXLibSetWindowPosition(Window->Ref, Region.X, Region.Y);
-    bool WindowResized = AXLibSetWindowSize(Window->Ref, Region.Width, Region.Height);
+    WindowFrameListAdd(Frames, Node->WindowId, Region, Center);
+}
 
-    if (Center) {
-        if (WindowMoved || WindowResized) {
-            CenterWindowInRegion(Window, Region);
-        }
-    }
+void ResizeWindowToExternalRegionSize(node *Node, region Region, bool Center)
+{
+    window_frame_list Frames;
+    BeginWindowFrameList(&Frames);
+    ResizeWindowToExternalRegionSize(Node, Region, Center, &Frames);
+    CommitWindowFrameList(&Frames);
 }
 
 // NOTE(koekeishiya): Call ResizeWindowToExternalRegionSize with center -> true
@@ -202,139 +422,96 @@ void ResizeWindowToExternalRegionSize(node *Node, region Region)
     ResizeWindowToExternalRegionSize(Node, Region, true);
 }
 
-void ApplyNodeRegionWithPotentialZoom(node *Node, virtual_space *VirtualSpace)
+void ApplyNodeRegionWithPotentialZoom(node *Node, virtual_space *VirtualSpace, bool Recursive, window_frame_list *Frames)
 {
-    if (Node->WindowId && Node->WindowId != Node_PseudoLeaf) {
+    if (Node->WindowId && Node->WindowId != (uint32_t) Node_PseudoLeaf) {
         if (Node == VirtualSpace->Tree->Zoom) {
-            ResizeWindowToExternalRegionSize(Node, VirtualSpace->Tree->Region);
+            ResizeWindowToExternalRegionSize(Node, VirtualSpace->Tree->Region, true, Frames);
         } else if (Node->Parent && Node == Node->Parent->Zoom) {
-            ResizeWindowToExternalRegionSize(Node, Node->Parent->Region);
+            ResizeWindowToExternalRegionSize(Node, Node->Parent->Region, true, Frames);
         } else {
-            ResizeWindowToRegionSize(Node, true);
+            ResizeWindowToRegionSize(Node, true, Frames);
         }
     }
 
+    if (!Recursive) {
+        return;
+    }
+
     if (Node->Left && VirtualSpace->Mode == Virtual_Space_Bsp) {
-        ApplyNodeRegionWithPotentialZoom(Node->Left, VirtualSpace);
+        ApplyNodeRegionWithPotentialZoom(Node->Left, VirtualSpace, true, Frames);
     }
 
     if (Node->Right) {
-        ApplyNodeRegionWithPotentialZoom(Node->Right, VirtualSpace);
+        ApplyNodeRegionWithPotentialZoom(Node->Right, VirtualSpace, true, Frames);
     }
 }
 
-void ApplyNodeRegion(node *Node, virtual_space_mode VirtualSpaceMode, bool Center)
+void ApplyNodeRegionWithPotentialZoom(node *Node, virtual_space *VirtualSpace)
+{
+    window_frame_list Frames;
+    BeginWindowFrameList(&Frames);
+    ApplyNodeRegionWithPotentialZoom(Node, VirtualSpace, true, &Frames);
+    CommitWindowFrameList(&Frames);
+}
+
+internal void
+ApplyNodeRegion(node *Node, virtual_space_mode VirtualSpaceMode, bool Center, window_frame_list *Frames)
 {
-    if (Node->WindowId && Node->WindowId != Node_PseudoLeaf) {
-        ResizeWindowToRegionSize(Node, Center);
+    if (Node->WindowId && Node->WindowId != (uint32_t) Node_PseudoLeaf) {
+        ResizeWindowToRegionSize(Node, Center, Frames);
     }
 
     if (Node->Left && VirtualSpaceMode == Virtual_Space_Bsp) {
-        ApplyNodeRegion(Node->Left, VirtualSpaceMode, Center);
+        ApplyNodeRegion(Node->Left, VirtualSpaceMode, Center, Frames);
     }
 
     if (Node->Right) {
-        ApplyNodeRegion(Node->Right, VirtualSpaceMode, Center);
+        ApplyNodeRegion(Node->Right, VirtualSpaceMode, Center, Frames);
     }
 }
 
-// NOTE(koekeishiya): Call ApplyNodeRegion with center -> true
-void ApplyNodeRegion(node *Node, virtual_space_mode VirtualSpaceMode)
+/*
+ * NOTE(koekeishiya): The frames of all windows in the tree are collected into a single
+ * batch, so that a slow application only holds up its own windows.
+ */
+void ApplyNodeRegion(node *Node, virtual_space_mode VirtualSpaceMode, bool Center)
 {
-    ApplyNodeRegion(Node, VirtualSpaceMode, true);
+    window_frame_list Frames;
+    BeginWindowFrameList(&Frames);
+    ApplyNodeRegion(Node, VirtualSpaceMode, Center, &Frames);
+    CommitWindowFrameList(&Frames);
 }
 
-void ConstrainWindowToRegion(macos_window *Window)
+// NOTE(koekeishiya): Call ApplyNodeRegion with center -> true
+void ApplyNodeRegion(node *Node, virtual_space_mode VirtualSpaceMode)
 {
-    if (AXLibHasFlags(Window, Window_Float) || AXLibIsWindowFullscreen(Window->Ref)) {
-        return;
-    }
-
-    macos_space *ActiveSpace;
-    CFStringRef DisplayRef = AXLibGetDisplayIdentifierFromWindowRect(Window->Position, Window->Size);
-    ASSERT(DisplayRef);
-
-    if (AXLibIsDisplayChangingSpaces(DisplayRef)) {
-        goto out;
-    }
-
-    ActiveSpace = AXLibActiveSpace(DisplayRef);
-    ASSERT(ActiveSpace);
-
-    if (AXLibSpaceHasWindow(ActiveSpace->Id, Window->Id)) {
-        // NOTE(choco): we already checked for fullscreen flag but we also need to
-        // check for the space type
-        // 1- when an app enters native fullscreen, space type may not be already
-        //    updated, fullscreen flag will be already set
-        // 2- when an app exits native fullscreen, fullscreen flag is removed
-        //    immediatly, but we may still be in a fullscreen space
-        if (ActiveSpace->Type == kCGSSpaceUser) {
-            virtual_space *VirtualSpace = AcquireVirtualSpace(ActiveSpace);
-            if ((VirtualSpace->Tree) && (VirtualSpace->Mode != Virtual_Space_Float)) {
-                node *WindowNode = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
-                if (WindowNode) {
-                    if (WindowNode == VirtualSpace->Tree->Zoom) {
-                        ResizeWindowToExternalRegionSize(WindowNode, VirtualSpace->Tree->Region);
-                    } else if (WindowNode->Parent && WindowNode == WindowNode->Parent->Zoom) {
-                        ResizeWindowToExternalRegionSize(WindowNode, WindowNode->Parent->Region);
-                    } else {
-                        ResizeWindowToRegionSize(WindowNode, true);
-                    }
-                }
-            }
-            ReleaseVirtualSpace(VirtualSpace);
-        }
-    } else if (!AXLibStickyWindow(Window->Id)) {
-        //
-        // NOTE(koekeishiya): The window is not on the active desktop. Flag the
-        // desktop containing the window for a refresh upon next activation.
-        //
-        macos_space **WindowSpaces = AXLibSpacesForWindow(Window->Id);
-        if (WindowSpaces) {
-            macos_space *WindowSpace = *WindowSpaces;
-            if (WindowSpace) {
-                if (WindowSpace->Type == kCGSSpaceUser) {
-                    virtual_space *VirtualSpace = AcquireVirtualSpace(WindowSpace);
-                    if ((VirtualSpace->Tree) && (VirtualSpace->Mode != Virtual_Space_Float)) {
-                        VirtualSpaceAddFlags(VirtualSpace, Virtual_Space_Require_Region_Update);
-                    }
-                    ReleaseVirtualSpace(VirtualSpace);
-                }
-                AXLibDestroySpace(WindowSpace);
-            }
-            free(WindowSpaces);
-        }
-    }
-
-    AXLibDestroySpace(ActiveSpace);
-out:
-    CFRelease(DisplayRef);
+    ApplyNodeRegion(Node, VirtualSpaceMode, true);
 }
 
 void FreePreselectNode(virtual_space *VirtualSpace)
 {
-    DestroyPreselWindow(VirtualSpace->Preselect->Border);
+    GetWindowBackend()->DestroyPreselBorder(VirtualSpace->Preselect->Border);
     free(VirtualSpace->Preselect->Direction);
     free(VirtualSpace->Preselect);
     VirtualSpace->Preselect = NULL;
 }
 
-void FreeNodeTree(node *Node, virtual_space_mode VirtualSpaceMode)
+// NOTE(koekeishiya): Every node of a virtual_space comes from its pool,
+// so the whole tree is released at once without walking it.
+void FreeNodeTree(virtual_space *VirtualSpace)
 {
-    if (Node->Left && VirtualSpaceMode == Virtual_Space_Bsp) {
-        FreeNodeTree(Node->Left, VirtualSpaceMode);
-    }
-
-    if (Node->Right) {
-        FreeNodeTree(Node->Right, VirtualSpaceMode);
-    }
-
-    free(Node);
+    ResetNodePool(&VirtualSpace->NodePool);
+    ClearNodeIndex(&VirtualSpace->NodeIndex);
+    InvalidateAdjacencyGraph(VirtualSpace);
+    VirtualSpace->Tree = NULL;
 }
 
-void FreeNode(node *Node)
+void FreeNode(node *Node, virtual_space *VirtualSpace)
 {
-    free(Node);
+    SetNodeWindowId(Node, Node_Root, VirtualSpace);
+    InvalidateAdjacencyGraph(VirtualSpace);
+    ReleaseNode(&VirtualSpace->NodePool, Node);
 }
 
 bool IsRightChild(node *Node)
@@ -349,14 +526,32 @@ bool IsLeftChild(node *Node)
     return Result;
 }
 
+// NOTE(koekeishiya): Returns true if Node is a descendant of Tree.
 bool IsNodeInTree(node *Tree, node *Node)
 {
-    bool Result = ((Tree->Left == Node || Tree->Right == Node) ||
-                   (Tree->Left && IsNodeInTree(Tree->Left, Node)) ||
-                   (Tree->Right && IsNodeInTree(Tree->Right, Node)));
+    node *Ancestor = Node->Parent;
+    while (Ancestor && Ancestor->Depth > Tree->Depth) {
+        Ancestor = Ancestor->Parent;
+    }
+
+    bool Result = Ancestor == Tree;
     return Result;
 }
 
+// NOTE(koekeishiya): Must be called for the root of a bsp-subtree that was moved to a different parent.
+void UpdateNodeDepth(node *Node)
+{
+    Node->Depth = Node->Parent ? Node->Parent->Depth + 1 : 0;
+
+    if (Node->Left) {
+        UpdateNodeDepth(Node->Left);
+    }
+
+    if (Node->Right) {
+        UpdateNodeDepth(Node->Right);
+    }
+}
+
 bool IsLeafNode(node *Node)
 {
     bool Result = Node->WindowId != Node_Root;
@@ -376,7 +571,7 @@ node *GetFirstLeafNode(node *Tree)
 node *GetLastLeafNode(node *Tree)
 {
     node *Node = Tree;
-    while ((Node->Right) && (Node->Right->WindowId != Node_PseudoLeaf)) {
+    while ((Node->Right) && (Node->Right->WindowId != (uint32_t) Node_PseudoLeaf)) {
         Node = Node->Right;
     }
 
@@ -431,7 +626,7 @@ node *GetFirstMinDepthPseudoLeafNode(node *Tree)
         node *Node = Queue.front();
         Queue.pop();
 
-        if ((IsLeafNode(Node)) && (Node->WindowId == Node_PseudoLeaf)) {
+        if ((IsLeafNode(Node)) && (Node->WindowId == (uint32_t) Node_PseudoLeaf)) {
             return Node;
         }
 
@@ -490,22 +685,25 @@ node *GetNextLeafNode(node *Node)
 
 node *GetLowestCommonAncestor(node *A, node *B)
 {
-    std::map<node *, bool> Ancestors;
+    if (!A || !B) {
+        return NULL;
+    }
 
-    while (A) {
-        Ancestors[A] = true;
+    while (A->Depth > B->Depth) {
         A = A->Parent;
     }
 
-    while (B) {
-        if (Ancestors.find(B) != Ancestors.end()) {
-            return B;
-        }
+    while (B->Depth > A->Depth) {
+        B = B->Parent;
+    }
 
+    // NOTE(koekeishiya): If A and B are not in the same tree, both pointers become NULL.
+    while (A != B) {
+        A = A->Parent;
         B = B->Parent;
     }
 
-    return NULL;
+    return A;
 }
 
 equalize_node EqualizeNodeTree(node *Tree)
@@ -535,229 +733,98 @@ equalize_node EqualizeNodeTree(node *Tree)
     return TotalLeafs;
 }
 
-node *GetNodeWithId(node *Tree, uint32_t WindowId, virtual_space_mode VirtualSpaceMode)
+node *GetNodeWithId(virtual_space *VirtualSpace, uint32_t WindowId)
 {
-    node *Node = GetFirstLeafNode(Tree);
-    while (Node) {
-        if (Node->WindowId == WindowId) {
-            return Node;
-        } else if (VirtualSpaceMode == Virtual_Space_Bsp) {
-            Node = GetNextLeafNode(Node);
-        } else if (VirtualSpaceMode == Virtual_Space_Monocle) {
-            Node = Node->Right;
-        }
+    if (!IsWindowNodeId(WindowId)) {
+        return NULL;
     }
 
-    return NULL;
+    node *Node = NodeIndexLookup(&VirtualSpace->NodeIndex, WindowId);
+    ASSERT(!Node || Node->WindowId == WindowId);
+    return Node;
 }
 
-void SwapNodeIds(node *A, node *B)
+void SwapNodeIds(node *A, node *B, virtual_space *VirtualSpace)
 {
     uint32_t TempId = A->WindowId;
     A->WindowId = B->WindowId;
     B->WindowId = TempId;
-}
-
-node *GetNodeForPoint(node *Node, CGPoint *Point)
-{
-    node *Current = GetFirstLeafNode(Node);
-    while (Current) {
-        if ((Point->x >= Current->Region.X) &&
-            (Point->x <= Current->Region.X + Current->Region.Width) &&
-            (Point->y >= Current->Region.Y) &&
-            (Point->y <= Current->Region.Y + Current->Region.Height)) {
-            return Current;
-        }
 
-        Current = GetNextLeafNode(Current);
+    if (IsWindowNodeId(A->WindowId)) {
+        NodeIndexInsert(&VirtualSpace->NodeIndex, A->WindowId, A);
     }
 
-    return NULL;
-}
-
-// NOTE(koekeishiya): This type is only used internally
-struct serialized_node
-{
-    int TypeId;
-    char *Type;
-    char *Split;
-    float Ratio;
-    serialized_node *Next;
-};
-
-internal serialized_node *
-ChainSerializedNode(serialized_node *Root, const char *NodeType, node *Node)
-{
-    serialized_node *SerializedNode = (serialized_node *) malloc(sizeof(serialized_node));
-    memset(SerializedNode, 0, sizeof(serialized_node));
-
-    SerializedNode->TypeId = Node_Serialized_Root;
-    SerializedNode->Type = strdup(NodeType);
-    SerializedNode->Split = node_split_str[Node->Split];
-    SerializedNode->Ratio = Node->Ratio;
-
-    Root->Next = SerializedNode;
-    return SerializedNode;
-}
-
-internal serialized_node *
-ChainSerializedNode(serialized_node *Root, const char *NodeType)
-{
-    serialized_node *SerializedNode = (serialized_node *) malloc(sizeof(serialized_node));
-    memset(SerializedNode, 0, sizeof(serialized_node));
-
-    SerializedNode->TypeId = Node_Serialized_Leaf;
-    SerializedNode->Type = strdup(NodeType);
-
-    Root->Next = SerializedNode;
-    return SerializedNode;
+    if (IsWindowNodeId(B->WindowId)) {
+        NodeIndexInsert(&VirtualSpace->NodeIndex, B->WindowId, B);
+    }
 }
 
-internal void
-DestroySerializedNode(serialized_node *Node)
+internal inline bool
+RegionContainsPoint(region *Region, float X, float Y)
 {
-    serialized_node *Next = Node->Next;
-
-    free(Node->Type);
-    free(Node);
-
-    if (Next) DestroySerializedNode(Next);
+    bool Result = ((X >= Region->X) &&
+                   (X <= Region->X + Region->Width) &&
+                   (Y >= Region->Y) &&
+                   (Y <= Region->Y + Region->Height));
+    return Result;
 }
 
-internal serialized_node *
-SerializeRootNode(node *Node, const char *NodeType, serialized_node *SerializedNode)
-{
-    SerializedNode = ChainSerializedNode(SerializedNode, NodeType, Node);
-
-    SerializedNode = IsLeafNode(Node->Left)
-                   ? ChainSerializedNode(SerializedNode, "left_leaf")
-                   : SerializeRootNode(Node->Left, "left_root", SerializedNode);
-
-    SerializedNode = IsLeafNode(Node->Right)
-                   ? ChainSerializedNode(SerializedNode, "right_leaf")
-                   : SerializeRootNode(Node->Right, "right_root", SerializedNode);
+/*
+ * NOTE(koekeishiya): The region of a child is always contained in the region of its
+ * parent, so we can descend the tree instead of visiting every leaf. The left child is
+ * tested first, which matches the order of a leaf walk for points on a shared edge.
+ * If neither child contains the point, it lies in the gap between them.
+ *
+ * Zoomed nodes keep their own region, so they do not need special treatment here.
+ */
+node *GetNodeForPoint(node *Node, float X, float Y)
+{
+    node *Current = Node;
+    while (!IsLeafNode(Current)) {
+        if (Current->Left && RegionContainsPoint(&Current->Left->Region, X, Y)) {
+            Current = Current->Left;
+        } else if (Current->Right && RegionContainsPoint(&Current->Right->Region, X, Y)) {
+            Current = Current->Right;
+        } else {
+            return NULL;
+        }
+    }
 
-    return SerializedNode;
+    return RegionContainsPoint(&Current->Region, X, Y) ? Current : NULL;
 }
 
-// NOTE(koekeishiya): Caller is responsible for memory
-char *SerializeNodeToBuffer(node *Node)
+void RotateBSPTree(node *Node, char *Degrees)
 {
-    serialized_node SerializedNode = {};
-    SerializeRootNode(Node, "root", &SerializedNode);
-
-    serialized_node *Current = SerializedNode.Next;
-
-    char *Cursor, *Buffer, *EndOfBuffer;
-    size_t BufferSize = sizeof(char) * 2048;
-    size_t BytesWritten = 0;
-
-    Cursor = Buffer = (char *) malloc(BufferSize);
-    EndOfBuffer = Buffer + BufferSize;
-
-    while (Current) {
-        if (Current->TypeId == Node_Serialized_Root) {
-            ASSERT(Cursor < EndOfBuffer);
-            BytesWritten = snprintf(Cursor, BufferSize,
-                                    "%s %s %.3f\n",
-                                    Current->Type,
-                                    Current->Split,
-                                    Current->Ratio);
-            ASSERT(BytesWritten >= 0);
-            Cursor += BytesWritten;
-            BufferSize -= BytesWritten;
-        } else if (Current->TypeId == Node_Serialized_Leaf) {
-            ASSERT(Cursor < EndOfBuffer);
-            BytesWritten = snprintf(Cursor, BufferSize,
-                                    "%s\n", Current->Type);
-            ASSERT(BytesWritten >= 0);
-            Cursor += BytesWritten;
-            BufferSize -= BytesWritten;
-        }
+    if ((StringEquals(Degrees, "90") && Node->Split == Split_Vertical) ||
+        (StringEquals(Degrees, "270") && Node->Split == Split_Horizontal) ||
+        (StringEquals(Degrees, "180"))) {
+        node *Temp = Node->Left;
+        Node->Left = Node->Right;
+        Node->Right = Temp;
+        Node->Ratio = 1 - Node->Ratio;
+    }
 
-        Current = Current->Next;
+    if (!StringEquals(Degrees, "180")) {
+        if      (Node->Split == Split_Horizontal)   Node->Split = Split_Vertical;
+        else if (Node->Split == Split_Vertical)     Node->Split = Split_Horizontal;
     }
 
-    DestroySerializedNode(SerializedNode.Next);
-    return Buffer;
+    if (!IsLeafNode(Node)) {
+        RotateBSPTree(Node->Left, Degrees);
+        RotateBSPTree(Node->Right, Degrees);
+    }
 }
 
-node *DeserializeNodeFromBuffer(char *Buffer)
+node *MirrorBSPTree(node *Tree, node_split Axis)
 {
-    node *Tree, *Current;
-    Current = Tree = (node *) malloc(sizeof(node));
-    memset(Tree, 0, sizeof(node));
-
-    const char *Cursor = Buffer;
+    if (!IsLeafNode(Tree)) {
+        node *Left = MirrorBSPTree(Tree->Left, Axis);
+        node *Right = MirrorBSPTree(Tree->Right, Axis);
 
-    token Token = GetToken(&Cursor);
-    ASSERT(TokenEquals(Token, "root"));
-
-    token Split = GetToken(&Cursor);
-    char *SplitString = TokenToString(Split);
-    token Ratio = GetToken(&Cursor);
-
-    Tree->WindowId = Node_PseudoLeaf;
-    Tree->Split = NodeSplitFromString(SplitString);
-    free(SplitString);
-    Tree->Ratio = TokenToFloat(Ratio);
-
-    Token = GetToken(&Cursor);
-    while (Token.Length > 0) {
-        if (TokenEquals(Token, "left_root")) {
-            node *Left = (node *) malloc(sizeof(node));
-            memset(Left, 0, sizeof(node));
-
-            token Split = GetToken(&Cursor);
-            char *SplitString = TokenToString(Split);
-            token Ratio = GetToken(&Cursor);
-
-            Left->WindowId = Node_PseudoLeaf;
-            Left->Parent = Current;
-            Left->Split = NodeSplitFromString(SplitString);
-            free(SplitString);
-            Left->Ratio = TokenToFloat(Ratio);
-
-            Current->Left = Left;
-            Current = Left;
-        } else if (TokenEquals(Token, "right_root")) {
-            node *Right = (node *) malloc(sizeof(node));
-            memset(Right, 0, sizeof(node));
-
-            token Split = GetToken(&Cursor);
-            char *SplitString = TokenToString(Split);
-            token Ratio = GetToken(&Cursor);
-
-            Right->WindowId = Node_PseudoLeaf;
-            Right->Parent = Current;
-            Right->Split = NodeSplitFromString(SplitString);
-            free(SplitString);
-            Right->Ratio = TokenToFloat(Ratio);
-
-            Current->Right = Right;
-            Current = Right;
-        } else if (TokenEquals(Token, "left_leaf")) {
-            node *Leaf = (node *) malloc(sizeof(node));
-            memset(Leaf, 0, sizeof(node));
-
-            Leaf->WindowId = Node_PseudoLeaf;
-            Leaf->Parent = Current;
-            Leaf->Ratio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
-            Current->Left = Leaf;
-        } else if (TokenEquals(Token, "right_leaf")) {
-            node *Leaf = (node *) malloc(sizeof(node));
-            memset(Leaf, 0, sizeof(node));
-
-            Leaf->WindowId = Node_PseudoLeaf;
-            Leaf->Parent = Current;
-            Leaf->Ratio = CVarFloatingPointValue(CVAR_BSP_SPLIT_RATIO);
-            Current->Right = Leaf;
-
-            // NOTE(koekeishiya): After parsing a right-leaf, we are done with this node
-            Current = Current->Parent;
+        if (Tree->Split == Axis) {
+            Tree->Left = Right;
+            Tree->Right = Left;
         }
-
-        Token = GetToken(&Cursor);
     }
 
     return Tree;
@@ -5,16 +5,15 @@
 
 #include "region.h"
 #include "vspace.h"
+#include "adjacency.h"
 
 struct presel_window;
+struct window_frame_list;
 
 enum node_type
 {
     Node_PseudoLeaf = -1,
     Node_Root = 0,
-
-    Node_Serialized_Root = 1,
-    Node_Serialized_Leaf = 2
 };
 
 static char *node_split_str[] =
@@ -63,6 +62,11 @@ struct node
 
     node *Zoom;
     region Region;
+    uint32_t Depth;
+
+    node *Adjacent[DIRECTION_COUNT];
+    uint32_t AdjacencyGeneration;
+    uint32_t AdjacencyMask;
 };
 
 struct equalize_node
@@ -80,32 +84,40 @@ node_ids AssignNodeIds(uint32_t ExistingId, uint32_t NewId, bool SpawnLeft);
 node_split OptimalSplitMode(node *Node);
 node_split NodeSplitFromString(char *Value);
 
+void SetNodeWindowId(node *Node, uint32_t WindowId, virtual_space *VirtualSpace);
 node *CreateRootNode(uint32_t WindowId, macos_space *Space, virtual_space *VirtualSpace);
 node *CreateLeafNode(node *Parent, uint32_t WindowId, region_type Type, macos_space *Space, virtual_space *VirtualSpace);
 void CreateLeafNodePair(node *Parent, uint32_t ExistingWindowId, uint32_t SpawnedWindowId, node_split Split, macos_space *Space, virtual_space *VirtualSpace);
+node *CreateNodeTree(uint32_t *Windows, uint32_t Count, node_split Split, macos_space *Space, virtual_space *VirtualSpace);
 void CreateLeafNodePairPreselect(node *Parent, uint32_t ExistingWindowId, uint32_t SpawnedWindowId, macos_space *Space, virtual_space *VirtualSpace);
+node *InsertWindowNode(virtual_space *VirtualSpace, uint32_t WindowId, uint32_t InsertionPoint, macos_space *Space);
+node *RemoveWindowNode(virtual_space *VirtualSpace, node *Node);
+void RemoveWindowNodes(virtual_space *VirtualSpace, uint32_t *Windows, uint32_t Count, macos_space *Space);
 equalize_node EqualizeNodeTree(node *Tree);
-void FreeNodeTree(node *Node, virtual_space_mode VirtualSpaceMode);
+void RotateBSPTree(node *Node, char *Degrees);
+node *MirrorBSPTree(node *Tree, node_split Axis);
+void FreeNodeTree(virtual_space *VirtualSpace);
 void FreePreselectNode(virtual_space *VirtualSpace);
-void FreeNode(node *Node);
+void FreeNode(node *Node, virtual_space *VirtualSpace);
 
 void ApplyNodeRegion(node *Node, virtual_space_mode VirtualSpaceMode);
 void ApplyNodeRegion(node *Node, virtual_space_mode VirtualSpaceMode, bool Center);
 void ApplyNodeRegionWithPotentialZoom(node *Node, virtual_space *VirtualSpace);
+void ApplyNodeRegionWithPotentialZoom(node *Node, virtual_space *VirtualSpace, bool Recursive, window_frame_list *Frames);
 
 void ResizeWindowToRegionSize(node *Node);
 void ResizeWindowToRegionSize(node *Node, bool Center);
+void ResizeWindowToRegionSize(node *Node, bool Center, window_frame_list *Frames);
 
 void ResizeWindowToExternalRegionSize(node *Node, region Region);
 void ResizeWindowToExternalRegionSize(node *Node, region Region, bool Center);
-
-struct macos_window;
-void ConstrainWindowToRegion(macos_window *Window);
+void ResizeWindowToExternalRegionSize(node *Node, region Region, bool Center, window_frame_list *Frames);
 
 bool IsLeafNode(node *Node);
 bool IsLeftChild(node *Node);
 bool IsRightChild(node *Node);
 bool IsNodeInTree(node *Tree, node *Node);
+void UpdateNodeDepth(node *Node);
 
 node *GetFirstLeafNode(node *Tree);
 node *GetLastLeafNode(node *Tree);
@@ -116,14 +128,10 @@ node *GetLowestCommonAncestor(node *A, node *B);
 
 node *GetNextLeafNode(node *Node);
 node *GetPrevLeafNode(node *Node);
-node *GetNodeWithId(node *Tree, uint32_t WindowId, virtual_space_mode VirtualSpaceMode);
-
-struct CGPoint;
-node *GetNodeForPoint(node *Node, CGPoint *Point);
+node *GetNodeWithId(virtual_space *VirtualSpace, uint32_t WindowId);
 
-void SwapNodeIds(node *A, node *B);
+node *GetNodeForPoint(node *Node, float X, float Y);
 
-char *SerializeNodeToBuffer(node *Node);
-node *DeserializeNodeFromBuffer(char *Buffer);
+void SwapNodeIds(node *A, node *B, virtual_space *VirtualSpace);
 
 #endif
@@ -5,6 +5,7 @@
 
 #include <map>
 #include <vector>
+#include <unordered_set>
 
 #include "../../api/plugin_api.h"
 #include "../../common/accessibility/display.h"
@@ -37,11 +38,23 @@
 
 #include "presel.h"
 #include "config.h"
+#include "pool.h"
+#include "index.h"
+#include "history.h"
+#include "adjacency.h"
 #include "region.h"
+#include "frame.h"
+#include "backend.h"
+#include "monocle.h"
+#include "cache.h"
+#include "table.h"
+#include "macos.h"
 #include "node.h"
 #include "vspace.h"
+#include "layout.h"
 #include "controller.h"
 #include "rule.h"
+#include "ruleindex.h"
 #include "mouse.h"
 #include "constants.h"
 #include "misc.h"
@@ -50,10 +63,23 @@ extern chunkwm_log *c_log;
 
 #include "presel.mm"
 #include "config.cpp"
+#include "pool.cpp"
+#include "index.cpp"
+#include "adjacency.cpp"
 #include "region.cpp"
+#include "frame.cpp"
+#include "backend.cpp"
+#include "monocle.cpp"
+#include "cache.cpp"
+#include "table.cpp"
+#include "macos.cpp"
 #include "node.cpp"
+#include "vspacebase.cpp"
 #include "vspace.cpp"
+#include "layout.cpp"
+#include "history.cpp"
 #include "controller.cpp"
+#include "ruleindex.cpp"
 #include "rule.cpp"
 #include "mouse.cpp"
 
@@ -75,9 +101,6 @@ operator!=(const CGSize& lhs, const CGSize& rhs)
 typedef std::map<pid_t, macos_application *> macos_application_map;
 typedef macos_application_map::iterator macos_application_map_it;
 
-typedef std::map<uint32_t, macos_window *> macos_window_map;
-typedef macos_window_map::iterator macos_window_map_it;
-
 #define CGSDefaultConnection _CGSDefaultConnection()
 typedef int CGSConnectionID;
 extern "C" CGSConnectionID _CGSDefaultConnection(void);
@@ -88,8 +111,9 @@ internal const char *PluginName = "Tiling";
 internal const char *PluginVersion = "0.3.17";
 
 internal macos_application_map Applications;
-internal macos_window_map Windows;
+internal window_table Windows;
 internal pthread_mutex_t WindowsLock;
+internal uint64_t WindowsEpoch;
 internal event_tap EventTap;
 internal chunkwm_api API;
 chunkwm_log *c_log;
@@ -118,24 +142,16 @@ internal void Reload()
 }
 #endif
 
-macos_window_map CopyWindowCache()
-{
-    pthread_mutex_lock(&WindowsLock);
-    macos_window_map Copy = Windows;
-    pthread_mutex_unlock(&WindowsLock);
-    return Copy;
-}
-
 internal void
 FadeWindows(uint32_t FocusedWindowId)
 {
     float Alpha = CVarFloatingPointValue(CVAR_WINDOW_FADE_ALPHA);
     float Duration = CVarFloatingPointValue(CVAR_WINDOW_FADE_DURATION);
-    macos_window_map Copy = CopyWindowCache();
+    window_snapshot *Snapshot = AcquireWindowSnapshot();
 
-    for (macos_window_map_it It = Copy.begin(); It != Copy.end(); ++It) {
-        macos_window *Window = It->second;
-        if (!AXLibHasFlags(Window, Rule_Alpha_Changed)) {
+    for (uint32_t Index = 0; Index < Snapshot->Count; ++Index) {
+        macos_window *Window = Snapshot->Windows[Index];
+        if (!WindowHasFlags(Window, Rule_Alpha_Changed)) {
             if (Window->Id == FocusedWindowId) {
                 ExtendedDockSetWindowAlpha(FocusedWindowId, 1.0f, Duration);
             } else {
@@ -143,6 +159,8 @@ FadeWindows(uint32_t FocusedWindowId)
             }
         }
     }
+
+    ReleaseWindowSnapshot(Snapshot);
 }
 
 /*
@@ -150,21 +168,23 @@ FadeWindows(uint32_t FocusedWindowId)
  * There is no way to do this, without caching AXUIElementRef references.
  * Here we perform a lookup of macos_window structs.
  */
-internal inline macos_window *
-_GetWindowByID(uint32_t Id)
-{
-    macos_window_map_it It = Windows.find(Id);
-    return It != Windows.end() ? It->second : NULL;
-}
-
 macos_window *GetWindowByID(uint32_t Id)
 {
     pthread_mutex_lock(&WindowsLock);
-    macos_window *Result = _GetWindowByID(Id);
+    macos_window *Result = WindowTableLookup(&Windows, Id);
     pthread_mutex_unlock(&WindowsLock);
     return Result;
 }
 
+/*
+ * NOTE(koekeishiya): The name of a window is replaced by chunkwm on the event thread when
+ * its title changes. Threads other than the event thread must read it through this function.
+ */
+char *CopyWindowName(macos_window *Window)
+{
+    return AXLibGetWindowTitle(Window->Ref);
+}
+
 uint32_t GetFocusedWindowId()
 {
     AXUIElementRef ApplicationRef, WindowRef;
@@ -192,69 +212,201 @@ macos_window *GetFocusedWindow()
     return WindowId ? GetWindowByID(WindowId) : NULL;
 }
 
+/*
+ * NOTE(koekeishiya): The windows in our collection are shared with chunkwm and the other
+ * plugins. The flags that belong to us are only stored in the flags column of the window
+ * table, and the flags that chunkwm maintains are read from the window itself.
+ */
+#define Window_Plugin_Flags (Window_Float | Window_Sticky | Window_ForceTile | \
+                             Rule_State_Tiled | Rule_Desktop_Changed | Rule_Alpha_Changed | \
+                             Window_Table_Standard)
+
+internal inline uint32_t
+WindowStandardFlag(macos_window *Window)
+{
+    return AXLibIsWindowStandard(Window) ? Window_Table_Standard : 0;
+}
+
+internal inline uint32_t
+CombineWindowFlags(macos_window *Window, uint32_t TableFlags)
+{
+    return (Window->Flags & ~Window_Plugin_Flags) | TableFlags;
+}
+
+// NOTE(koekeishiya): Caller must hold WindowsLock.
+internal inline int
+WindowCollectionSlot(macos_window *Window)
+{
+    int Slot = WindowTableSlot(&Windows, Window->Id);
+    return ((Slot != -1) && (Windows.Windows[Slot] == Window)) ? Slot : -1;
+}
+
+uint32_t GetWindowFlags(macos_window *Window)
+{
+    pthread_mutex_lock(&WindowsLock);
+    int Slot = WindowCollectionSlot(Window);
+    uint32_t TableFlags = (Slot != -1) ? Windows.Flags[Slot] : WindowStandardFlag(Window);
+    pthread_mutex_unlock(&WindowsLock);
+    return CombineWindowFlags(Window, TableFlags);
+}
+
+bool WindowHasFlags(macos_window *Window, uint32_t Flags)
+{
+    bool Result = ((GetWindowFlags(Window) & Flags) != 0);
+    return Result;
+}
+
+internal void
+UpdateWindowFlags(macos_window *Window, uint32_t Add, uint32_t Clear)
+{
+    uint32_t Shared = (Add | Clear) & ~Window_Plugin_Flags;
+    if (Shared & Add)   __sync_or_and_fetch(&Window->Flags, Shared & Add);
+    if (Shared & Clear) __sync_and_and_fetch(&Window->Flags, ~(Shared & Clear));
+
+    pthread_mutex_lock(&WindowsLock);
+    int Slot = WindowCollectionSlot(Window);
+    if (Slot != -1) {
+        uint32_t Flags = (Windows.Flags[Slot] | (Add & Window_Plugin_Flags)) & ~(Clear & Window_Plugin_Flags);
+        WindowTableSetFlags(&Windows, Window->Id, Flags);
+    }
+    pthread_mutex_unlock(&WindowsLock);
+}
+
+void AddWindowFlags(macos_window *Window, uint32_t Flags)
+{
+    UpdateWindowFlags(Window, Flags, 0);
+}
+
+void ClearWindowFlags(macos_window *Window, uint32_t Flags)
+{
+    UpdateWindowFlags(Window, 0, Flags);
+}
+
+// NOTE(koekeishiya): chunkwm refreshes the role and subrole of a window when it is deminimized.
+internal void
+UpdateWindowStandardFlag(macos_window *Window)
+{
+    if (AXLibIsWindowStandard(Window)) {
+        AddWindowFlags(Window, Window_Table_Standard);
+    } else {
+        ClearWindowFlags(Window, Window_Table_Standard);
+    }
+}
+
+// NOTE(koekeishiya): Caller must hold WindowsLock.
+internal void
+PublishWindowCollection()
+{
+    PublishWindowSnapshot(Windows.Windows, Windows.Count);
+}
+
 // NOTE(koekeishiya): Caller is responsible for making sure that the window is not a dupe.
 internal void
 AddWindowToCollection(macos_window *Window)
 {
     if (!Window->Id) return;
     pthread_mutex_lock(&WindowsLock);
-    Windows[Window->Id] = Window;
+    WindowTableInsert(&Windows, Window, Window->Id, WindowStandardFlag(Window), Window->Level, Window->Owner->PID);
+    PublishWindowCollection();
     pthread_mutex_unlock(&WindowsLock);
+    AddWindowProperties(Window->Id);
     ApplyRulesForWindow(Window);
 }
 
+/*
+ * NOTE(koekeishiya): The window that is returned may still be visited by an iteration
+ * of an older snapshot. Caller must hand it to DestroyWindowFromCollection instead of
+ * releasing it directly.
+ */
 internal macos_window *
 RemoveWindowFromCollection(macos_window *Window)
 {
     pthread_mutex_lock(&WindowsLock);
-    macos_window *Result = _GetWindowByID(Window->Id);
+    macos_window *Result = WindowTableRemove(&Windows, Window->Id);
     if (Result) {
-        Windows.erase(Window->Id);
+        PublishWindowCollection();
     }
     pthread_mutex_unlock(&WindowsLock);
     return Result;
 }
 
+internal void
+DestroyWindowFromCollection(macos_window *Window)
+{
+    RemoveWindowProperties(Window->Id);
+
+    pthread_mutex_lock(&WindowsLock);
+    RetireWindow(Window);
+    pthread_mutex_unlock(&WindowsLock);
+}
+
 internal void
 ClearWindowCache()
 {
     pthread_mutex_lock(&WindowsLock);
-    for (macos_window_map_it It = Windows.begin(); It != Windows.end(); ++It) {
-        macos_window *Window = It->second;
-        AXLibDestroyWindow(Window);
+    for (uint32_t Index = 0; Index < Windows.Count; ++Index) {
+        RetireWindow(Windows.Windows[Index]);
     }
-    Windows.clear();
+    ClearWindowTable(&Windows);
+    PublishWindowCollection();
+    WindowsEpoch = 0;
     pthread_mutex_unlock(&WindowsLock);
+    ClearWindowProperties();
 }
 
+/*
+ * NOTE(koekeishiya): chunkwm owns the window registry, and we take a reference to the windows
+ * that we are not already tracking instead of copying them. Returns the window in our collection.
+ */
+internal macos_window *
+AcquireWindow(uint32_t WindowId)
+{
+    macos_window *Result = GetWindowByID(WindowId);
+    if (!Result) {
+        Result = API.AcquireWindow(WindowId);
+        if (Result) {
+            AddWindowToCollection(Result);
+        }
+    }
+    return Result;
+}
+
+// NOTE(koekeishiya): If the registry has not changed since our last update, there is nothing to do.
 internal void
-AddApplicationWindowList(macos_application *Application)
+UpdateWindowCollection()
 {
-    macos_window **WindowList = AXLibWindowListForApplication(Application);
-    if (!WindowList) {
+    chunkwm_window_view View;
+
+    if (!API.AcquireWindowView(&View, WindowsEpoch)) {
         return;
     }
 
-    macos_window **List = WindowList;
-    macos_window *Window;
-    while ((Window = *List++)) {
-        if (GetWindowByID(Window->Id)) {
-            AXLibDestroyWindow(Window);
-        } else {
-            AddWindowToCollection(Window);
-        }
+    for (uint32_t Index = 0; Index < View.Count; ++Index) {
+        AcquireWindow(View.Ids[Index]);
     }
 
-    free(WindowList);
+    WindowsEpoch = View.Epoch;
+    API.ReleaseWindowView(&View);
 }
 
-internal void
-UpdateWindowCollection()
+/*
+ * NOTE(koekeishiya): Returns the windows in our collection that are owned by the given process,
+ * whether they were added by the last update of our collection or by an earlier one.
+ */
+internal std::vector<macos_window *>
+GetWindowsForApplication(macos_application *Application)
 {
-    for (macos_application_map_it It = Applications.begin(); It != Applications.end(); ++It) {
-        macos_application *Application = It->second;
-        AddApplicationWindowList(Application);
+    std::vector<macos_window *> Result;
+
+    pthread_mutex_lock(&WindowsLock);
+    for (uint32_t Slot = 0; Slot < Windows.Count; ++Slot) {
+        if (Windows.Owners[Slot] == Application->PID) {
+            Result.push_back(Windows.Windows[Slot]);
+        }
     }
+    pthread_mutex_unlock(&WindowsLock);
+
+    return Result;
 }
 
 internal void
@@ -293,7 +445,7 @@ BroadcastFocusedWindowFloating()
 
 void BroadcastFocusedWindowFloating(macos_window *Window)
 {
-    uint32_t Status = (uint32_t) AXLibHasFlags(Window, Window_Float);
+    uint32_t Status = (uint32_t) WindowHasFlags(Window, Window_Float);
     uint32_t Data[2] = { Window->Id, Status };
     API.Broadcast(PluginName, "focused_window_float", (char *) Data, sizeof(Data));
 }
@@ -304,34 +456,41 @@ void BroadcastFocusedDesktopMode(virtual_space *VirtualSpace)
     API.Broadcast(PluginName, "focused_desktop_mode", (char *) Data, strlen(Data) + 1);
 }
 
-bool IsWindowValid(macos_window *Window)
+internal inline bool
+IsWindowValid(uint32_t Flags)
 {
     bool Result;
-    if (AXLibHasFlags(Window, Window_Invalid)) {
+    if (Flags & Window_Invalid) {
         Result = false;
-    } else if (AXLibHasFlags(Window, Window_ForceTile)) {
+    } else if (Flags & Window_ForceTile) {
         Result = true;
     } else {
-        Result = ((AXLibIsWindowStandard(Window)) &&
-                  (AXLibHasFlags(Window, Window_Movable)) &&
-                  (AXLibHasFlags(Window, Window_Resizable)));
+        Result = ((Flags & Window_Table_Standard) &&
+                  (Flags & Window_Movable) &&
+                  (Flags & Window_Resizable));
     }
     return Result;
 }
 
+bool IsWindowValid(macos_window *Window)
+{
+    return IsWindowValid(GetWindowFlags(Window));
+}
+
 internal bool
 IsWindowFocusable(macos_window *Window)
 {
+    uint32_t Flags = GetWindowFlags(Window);
     bool Result = ((AXLibIsWindowStandard(Window) ||
-                    AXLibHasFlags(Window, Window_ForceTile)) &&
-                   (!AXLibHasFlags(Window, Window_Invalid)));
+                    (Flags & Window_ForceTile)) &&
+                   (!(Flags & Window_Invalid)));
     return Result;
 }
 
 internal bool
 TileWindowPreValidation(macos_window *Window)
 {
-    if (AXLibHasFlags(Window, Window_Float)) {
+    if (WindowHasFlags(Window, Window_Float)) {
         return false;
     }
 
@@ -349,145 +508,117 @@ TileWindowPreValidation(macos_window *Window)
     return true;
 }
 
-// NOTE(koekeishiya): Caller is responsible for making sure that the window is a valid window
-// that we can properly manage. The given macos_space must also be of type kCGSSpaceUser,
-// meaning that it is a space we can legally interact with.
-void TileWindowOnSpace(macos_window *Window, macos_space *Space, virtual_space *VirtualSpace)
+// NOTE(koekeishiya): The window is placed after the insertion point, or at the end of the list.
+internal void
+TileWindowOnMonocleSpace(macos_window *Window, macos_space *Space, virtual_space *VirtualSpace, bool Apply)
 {
-    CFStringRef DisplayRef;
+    monocle_list *Monocle = &VirtualSpace->Monocle;
+    if (MonocleWindowIndex(Monocle, Window->Id) != -1) {
+        return;
+    }
 
-    if (VirtualSpace->Mode == Virtual_Space_Float) {
-        goto out;
+    if (Monocle->Count == 0) {
+        CreateMonocleRegion(Monocle, Space, VirtualSpace);
     }
 
-    /*
-     * NOTE(koekeishiya): This function appears to always return a valid identifier!
-     * Could this potentially return NULL if an invalid CGSSpaceID is passed ?
-     * The function returns NULL if "Displays have separate spaces" is disabled !!!
-     */
-    DisplayRef = AXLibGetDisplayIdentifierFromSpace(Space->Id);
-    ASSERT(DisplayRef);
+    int Index = -1;
+    uint32_t InsertionPoint = CVarUnsignedValue(CVAR_BSP_INSERTION_POINT);
+    if (!InsertionPoint) {
+        InsertionPoint = CVarUnsignedValue(CVAR_FOCUSED_WINDOW);
+    }
 
-    if (AXLibIsDisplayChangingSpaces(DisplayRef)) {
-        goto display_free;
+    if (InsertionPoint) {
+        Index = MonocleWindowIndex(Monocle, InsertionPoint);
     }
 
-    if (VirtualSpace->Tree) {
-        node *Exists = GetNodeWithId(VirtualSpace->Tree, Window->Id, VirtualSpace->Mode);
-        if (Exists) {
-            goto display_free;
-        }
+    MonocleInsertWindow(Monocle, Index != -1 ? Index + 1 : Monocle->Count, Window->Id);
+    if (Apply) {
+        ApplyMonocleRegion(Monocle, Window->Id, true);
+    }
+}
 
-        node *Node = NULL;
-        uint32_t InsertionPoint = CVarUnsignedValue(CVAR_BSP_INSERTION_POINT);
-        if (!InsertionPoint) {
-            InsertionPoint = CVarUnsignedValue(CVAR_FOCUSED_WINDOW);
+/*
+ * NOTE(koekeishiya): If Apply is false, the tree and its regions are updated, but no frames
+ * are applied. The caller is then responsible for applying the tree once it is done.
+ *
+ * The caller is responsible for making sure that the virtual space is not in float mode,
+ * and that the display of the space is not changing spaces.
+ */
+internal void
+TileWindowOnSpaceUnchecked(macos_window *Window, macos_space *Space, virtual_space *VirtualSpace, bool Apply)
+{
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        TileWindowOnMonocleSpace(Window, Space, VirtualSpace, Apply);
+        return;
+    }
+
+    if (VirtualSpace->Tree) {
+        if (GetNodeWithId(VirtualSpace, Window->Id)) {
+            return;
         }
 
-        if (VirtualSpace->Mode == Virtual_Space_Bsp) {
-
-            /*
-             * NOTE(koekeishiya): When a new window is being tiled, the following priority is taking place.
-             *
-             *              1. If the desktop has an active preselection, the window is placed here.
-             *              2. If there are any pending pseudo-leafs (layout deserialization), fill this region.
-             *              3. If the focused window is eligible, split this region.
-             *              4. Find the first minimum-depth leaf node and split this region.
-             */
-
-            if (VirtualSpace->Preselect) {
-                CreateLeafNodePairPreselect(VirtualSpace->Preselect->Node,
-                                            VirtualSpace->Preselect->Node->WindowId,
-                                            Window->Id, Space, VirtualSpace);
+        // NOTE(koekeishiya): If the desktop has an active preselection, the window is placed here.
+        if (VirtualSpace->Preselect) {
+            CreateLeafNodePairPreselect(VirtualSpace->Preselect->Node,
+                                        VirtualSpace->Preselect->Node->WindowId,
+                                        Window->Id, Space, VirtualSpace);
+            if (Apply) {
                 ApplyNodeRegion(VirtualSpace->Preselect->Node, VirtualSpace->Mode);
-                FreePreselectNode(VirtualSpace);
-            } else {
-                Node = GetFirstMinDepthPseudoLeafNode(VirtualSpace->Tree);
-                if (Node) {
-                    if (Node->Parent) {
-                        int SpawnLeft = CVarIntegerValue(CVAR_BSP_SPAWN_LEFT);
-                        node_ids NodeIds = AssignNodeIds(Node->Parent->WindowId, Window->Id, SpawnLeft);
-                        Node->Parent->WindowId = Node_Root;
-                        Node->Parent->Left->WindowId = NodeIds.Left;
-                        Node->Parent->Right->WindowId = NodeIds.Right;
-                        CreateNodeRegionRecursive(Node->Parent, false, Space, VirtualSpace);
-                        ApplyNodeRegion(Node->Parent, VirtualSpace->Mode);
-                    } else {
-                        Node->WindowId = Window->Id;
-                        CreateNodeRegion(Node, Region_Full, Space, VirtualSpace);
-                        ApplyNodeRegion(Node, VirtualSpace->Mode);
-                    }
-                    goto display_free;
-                }
-
-                if (InsertionPoint) {
-                    Node = GetNodeWithId(VirtualSpace->Tree, InsertionPoint, VirtualSpace->Mode);
-                }
-
-                if (!Node) {
-                    Node = GetFirstMinDepthLeafNode(VirtualSpace->Tree);
-                    ASSERT(Node != NULL);
-                }
-
-                node_split Split = NodeSplitFromString(CVarStringValue(CVAR_BSP_SPLIT_MODE));
-                if (Split == Split_Optimal) {
-                    Split = OptimalSplitMode(Node);
-                }
-
-                CreateLeafNodePair(Node, Node->WindowId, Window->Id, Split, Space, VirtualSpace);
-                ApplyNodeRegion(Node, VirtualSpace->Mode);
             }
+            FreePreselectNode(VirtualSpace);
 
             // NOTE(koekeishiya): Reset fullscreen-zoom state.
-            if (VirtualSpace->Tree->Zoom) {
-                VirtualSpace->Tree->Zoom = NULL;
-            }
-        } else if (VirtualSpace->Mode == Virtual_Space_Monocle) {
-            if (InsertionPoint) {
-                Node = GetNodeWithId(VirtualSpace->Tree, InsertionPoint, VirtualSpace->Mode);
-            }
+            VirtualSpace->Tree->Zoom = NULL;
+            return;
+        }
+    }
 
-            if (!Node) {
-                Node = GetLastLeafNode(VirtualSpace->Tree);
-                ASSERT(Node != NULL);
-            }
+    uint32_t InsertionPoint = CVarUnsignedValue(CVAR_BSP_INSERTION_POINT);
+    if (!InsertionPoint) {
+        InsertionPoint = CVarUnsignedValue(CVAR_FOCUSED_WINDOW);
+    }
 
-            node *NewNode = CreateRootNode(Window->Id, Space, VirtualSpace);
+    node *Node = InsertWindowNode(VirtualSpace, Window->Id, InsertionPoint, Space);
+    if ((Node) && (Apply)) {
+        ApplyNodeRegion(Node, VirtualSpace->Mode);
+    }
+}
 
-            if (Node->Right) {
-                node *Next = Node->Right;
-                Next->Left = NewNode;
-                NewNode->Right = Next;
-            }
+internal bool
+IsDisplayOfSpaceChangingSpaces(macos_space *Space)
+{
+    /*
+     * NOTE(koekeishiya): This function appears to always return a valid identifier!
+     * Could this potentially return NULL if an invalid CGSSpaceID is passed ?
+     * The function returns NULL if "Displays have separate spaces" is disabled !!!
+     */
+    CFStringRef DisplayRef = AXLibGetDisplayIdentifierFromSpace(Space->Id);
+    ASSERT(DisplayRef);
 
-            NewNode->Left = Node;
-            Node->Right = NewNode;
-            ResizeWindowToRegionSize(NewNode);
-        }
-    } else {
-        char *Buffer;
-        if ((ShouldDeserializeVirtualSpace(VirtualSpace)) &&
-            ((Buffer = ReadFile(VirtualSpace->TreeLayout)))) {
-            VirtualSpace->Tree = DeserializeNodeFromBuffer(Buffer);
-            VirtualSpace->Tree->WindowId = Window->Id;
-            CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
-            CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
-            ResizeWindowToRegionSize(VirtualSpace->Tree);
-            free(Buffer);
-        } else {
-            // NOTE(koekeishiya): This path is equal for both bsp and monocle spaces!
-            VirtualSpace->Tree = CreateRootNode(Window->Id, Space, VirtualSpace);
-            ResizeWindowToRegionSize(VirtualSpace->Tree);
-        }
+    bool Result = AXLibIsDisplayChangingSpaces(DisplayRef);
+    CFRelease(DisplayRef);
+    return Result;
+}
+
+// NOTE(koekeishiya): Caller is responsible for making sure that the window is a valid window
+// that we can properly manage. The given macos_space must also be of type kCGSSpaceUser,
+// meaning that it is a space we can legally interact with.
+void TileWindowOnSpace(macos_window *Window, macos_space *Space, virtual_space *VirtualSpace)
+{
+    if (VirtualSpace->Mode == Virtual_Space_Float) {
+        return;
     }
 
-display_free:
-    CFRelease(DisplayRef);
-out:;
+    if (IsDisplayOfSpaceChangingSpaces(Space)) {
+        return;
+    }
+
+    TileWindowOnSpaceUnchecked(Window, Space, VirtualSpace, true);
 }
 
 void TileWindow(macos_window *Window)
 {
+    BEGIN_TIMED_BLOCK();
     if (TileWindowPreValidation(Window)) {
         macos_space *Space;
         bool Success = AXLibActiveSpace(&Space);
@@ -501,12 +632,14 @@ void TileWindow(macos_window *Window)
 
         AXLibDestroySpace(Space);
     }
+
+    END_TIMED_BLOCK();
 }
 
 internal bool
 UntileWindowPreValidation(macos_window *Window)
 {
-    if (AXLibHasFlags(Window, Window_Float)) {
+    if (WindowHasFlags(Window, Window_Float)) {
         return false;
     }
 
@@ -521,86 +654,43 @@ UntileWindowPreValidation(macos_window *Window)
 // This is required to make sure that RebalanceWindowTree works properly.
 // See https://github.com/koekeishiya/chunkwm/issues/66 for history.
 internal void
-UntileWindowFromSpace(uint32_t WindowId, macos_space *Space, virtual_space *VirtualSpace)
+UntileWindowFromSpace(uint32_t WindowId, macos_space *Space, virtual_space *VirtualSpace, bool Apply)
 {
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        MonocleRemoveWindow(&VirtualSpace->Monocle, WindowId);
+        return;
+    }
+
     if ((!VirtualSpace->Tree) || (VirtualSpace->Mode == Virtual_Space_Float)) {
         return;
     }
 
-    node *Node = GetNodeWithId(VirtualSpace->Tree, WindowId, VirtualSpace->Mode);
+    node *Node = GetNodeWithId(VirtualSpace, WindowId);
     if (!Node) {
         return;
     }
 
     if (VirtualSpace->Mode == Virtual_Space_Bsp) {
-        /*
-         * NOTE(koekeishiya): The window was in fullscreen-zoom.
-         * We need to null the pointer to prevent a potential bug.
-         */
-        if (VirtualSpace->Tree->Zoom == Node) {
-            VirtualSpace->Tree->Zoom = NULL;
+        node *NewLeaf = RemoveWindowNode(VirtualSpace, Node);
+        if (!NewLeaf) {
+            return;
         }
 
-        if (Node->Parent && Node->Parent->Left && Node->Parent->Right) {
-            /*
-             * NOTE(koekeishiya): The window was in parent-zoom.
-             * We need to null the pointer to prevent a potential bug.
-             */
-            if (Node->Parent->Zoom == Node) {
-                Node->Parent->Zoom = NULL;
-            }
-
-            node *NewLeaf = Node->Parent;
-            node *RemainingLeaf = IsRightChild(Node) ? Node->Parent->Left
-                                                     : Node->Parent->Right;
-            NewLeaf->Left = NULL;
-            NewLeaf->Right = NULL;
-            NewLeaf->Zoom = NULL;
-
-            NewLeaf->WindowId = RemainingLeaf->WindowId;
-            if (RemainingLeaf->Left && RemainingLeaf->Right) {
-                NewLeaf->Left = RemainingLeaf->Left;
-                NewLeaf->Left->Parent = NewLeaf;
-
-                NewLeaf->Right = RemainingLeaf->Right;
-                NewLeaf->Right->Parent = NewLeaf;
-
-                CreateNodeRegionRecursive(NewLeaf, true, Space, VirtualSpace);
-            }
+        if (NewLeaf->Left && NewLeaf->Right) {
+            CreateNodeRegionRecursive(NewLeaf, true, Space, VirtualSpace);
+        }
 
-            /*
-             * NOTE(koekeishiya): Re-zoom window after spawned window closes.
-             * see reference: https://github.com/koekeishiya/chunkwm/issues/20
-             */
+        /*
+         * NOTE(koekeishiya): Re-zoom window after spawned window closes.
+         * see reference: https://github.com/koekeishiya/chunkwm/issues/20
+         */
+        if (Apply) {
             ApplyNodeRegion(NewLeaf, VirtualSpace->Mode);
             if (NewLeaf->Parent && NewLeaf->Parent->Zoom) {
                 ResizeWindowToExternalRegionSize(NewLeaf->Parent->Zoom,
                                                  NewLeaf->Parent->Region);
             }
-
-            FreeNode(RemainingLeaf);
-            FreeNode(Node);
-        } else if (!Node->Parent) {
-            FreeNode(VirtualSpace->Tree);
-            VirtualSpace->Tree = NULL;
-        }
-    } else if (VirtualSpace->Mode == Virtual_Space_Monocle) {
-        node *Prev = Node->Left;
-        node *Next = Node->Right;
-
-        if (Prev) {
-            Prev->Right = Next;
         }
-
-        if (Next) {
-            Next->Left = Prev;
-        }
-
-        if (Node == VirtualSpace->Tree) {
-            VirtualSpace->Tree = Next;
-        }
-
-        FreeNode(Node);
     }
 }
 
@@ -609,11 +699,12 @@ UntileWindowFromSpace(uint32_t WindowId, macos_space *Space, virtual_space *Virt
 // meaning that it is a space we can legally interact with.
 void UntileWindowFromSpace(macos_window *Window, macos_space *Space, virtual_space *VirtualSpace)
 {
-    UntileWindowFromSpace(Window->Id, Space, VirtualSpace);
+    UntileWindowFromSpace(Window->Id, Space, VirtualSpace, true);
 }
 
 void UntileWindow(macos_window *Window)
 {
+    BEGIN_TIMED_BLOCK();
     if (UntileWindowPreValidation(Window)) {
         __AppleGetDisplayIdentifierFromMacOSWindow(Window);
         ASSERT(DisplayRef);
@@ -630,6 +721,8 @@ void UntileWindow(macos_window *Window)
         AXLibDestroySpace(Space);
         __AppleFreeDisplayIdentifierFromWindow();
     }
+
+    END_TIMED_BLOCK();
 }
 
 /* NOTE(koekeishiya): Returns a vector of CGWindowIDs. */
@@ -645,38 +738,47 @@ std::vector<uint32_t> GetAllVisibleWindowsForSpace(macos_space *Space, bool Incl
         bool Success = AXLibCGSSpaceIDToDesktopID(Space->Id, NULL, &DesktopId);
         ASSERT(Success);
 
+        /*
+         * NOTE(koekeishiya): The windows are classified using the id and flags columns of
+         * the window table, and the flags that chunkwm maintains on the shared macos_window.
+         */
+        pthread_mutex_lock(&WindowsLock);
         for (int Index = 0; Index < WindowCount; ++Index) {
             uint32_t WindowId = WindowList[Index];
 
-            macos_window *Window = GetWindowByID(WindowId);
-            if (!Window) {
+            int Slot = WindowTableSlot(&Windows, WindowId);
+            if (Slot == -1) {
                 // NOTE(koekeishiya): The chunkwm core does not report these windows to
                 // plugins, and they are therefore never cached, we simply ignore them.
                 // DEBUG_PRINT("   %d:window not cached\n", WindowId);
                 continue;
             }
 
-            if (IsWindowValid(Window) || IncludeInvalidWindows) {
+            macos_window *Window = Windows.Windows[Slot];
+            uint32_t Flags = CombineWindowFlags(Window, Windows.Flags[Slot]);
+
+            if (IsWindowValid(Flags) || IncludeInvalidWindows) {
                 c_log(C_LOG_LEVEL_DEBUG,
                       "%d:desktop   %d:%d:%s:%s\n",
                       DesktopId,
-                      Window->Id,
-                      Window->Level,
+                      WindowId,
+                      Windows.Levels[Slot],
                       Window->Owner->Name,
                       Window->Name);
-                if ((!AXLibHasFlags(Window, Window_Float)) || (IncludeFloatingWindows)) {
-                    Result.push_back(Window->Id);
+                if ((!(Flags & Window_Float)) || (IncludeFloatingWindows)) {
+                    Result.push_back(WindowId);
                 }
             } else {
                 c_log(C_LOG_LEVEL_DEBUG,
                       "%d:desktop   %d:%d:invalid window:%s:%s\n",
                       DesktopId,
-                      Window->Id,
-                      Window->Level,
+                      WindowId,
+                      Windows.Levels[Slot],
                       Window->Owner->Name,
                       Window->Name);
             }
         }
+        pthread_mutex_unlock(&WindowsLock);
 
         free(WindowList);
     }
@@ -691,21 +793,22 @@ std::vector<uint32_t> GetAllVisibleWindowsForSpace(macos_space *Space)
 }
 
 internal std::vector<uint32_t>
-GetAllWindowsInTree(node *Tree, virtual_space_mode VirtualSpaceMode)
+GetAllWindowsInTree(virtual_space *VirtualSpace)
 {
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        monocle_list *Monocle = &VirtualSpace->Monocle;
+        return std::vector<uint32_t>(Monocle->Windows, Monocle->Windows + Monocle->Count);
+    }
+
     std::vector<uint32_t> Windows;
 
-    node *Node = GetFirstLeafNode(Tree);
+    node *Node = GetFirstLeafNode(VirtualSpace->Tree);
     while (Node) {
         if (IsLeafNode(Node)) {
             Windows.push_back(Node->WindowId);
         }
 
-        if (VirtualSpaceMode == Virtual_Space_Bsp) {
-            Node = GetNextLeafNode(Node);
-        } else if (VirtualSpaceMode == Virtual_Space_Monocle) {
-            Node = Node->Right;
-        }
+        Node = GetNextLeafNode(Node);
     }
 
     return Windows;
@@ -714,19 +817,12 @@ GetAllWindowsInTree(node *Tree, virtual_space_mode VirtualSpaceMode)
 internal std::vector<uint32_t>
 GetAllWindowsToAddToTree(std::vector<uint32_t> &VisibleWindows, std::vector<uint32_t> &WindowsInTree)
 {
-    std::vector<uint32_t> Windows;
-    for (size_t WindowIndex = 0; WindowIndex < VisibleWindows.size(); ++WindowIndex) {
-        bool Found = false;
-        uint32_t WindowId = VisibleWindows[WindowIndex];
-
-        for (size_t Index = 0; Index < WindowsInTree.size(); ++Index) {
-            if (WindowId == WindowsInTree[Index]) {
-                Found = true;
-                break;
-            }
-        }
+    std::unordered_set<uint32_t> InTree(WindowsInTree.begin(), WindowsInTree.end());
 
-        if ((!Found) && (!AXLibStickyWindow(WindowId))) {
+    std::vector<uint32_t> Windows;
+    for (size_t Index = 0; Index < VisibleWindows.size(); ++Index) {
+        uint32_t WindowId = VisibleWindows[Index];
+        if ((InTree.find(WindowId) == InTree.end()) && (!AXLibStickyWindow(WindowId))) {
             Windows.push_back(WindowId);
         }
     }
@@ -737,24 +833,100 @@ GetAllWindowsToAddToTree(std::vector<uint32_t> &VisibleWindows, std::vector<uint
 internal std::vector<uint32_t>
 GetAllWindowsToRemoveFromTree(std::vector<uint32_t> &VisibleWindows, std::vector<uint32_t> &WindowsInTree)
 {
+    std::unordered_set<uint32_t> Visible(VisibleWindows.begin(), VisibleWindows.end());
+
     std::vector<uint32_t> Windows;
     for (size_t Index = 0; Index < WindowsInTree.size(); ++Index) {
-        bool Found = false;
-        uint32_t WindowId = WindowsInTree[Index];
+        if (Visible.find(WindowsInTree[Index]) == Visible.end()) {
+            Windows.push_back(WindowsInTree[Index]);
+        }
+    }
 
-        for (size_t WindowIndex = 0; WindowIndex < VisibleWindows.size(); ++WindowIndex) {
-            if (VisibleWindows[WindowIndex] == WindowId) {
-                Found = true;
-                break;
-            }
+    return Windows;
+}
+
+internal void
+UntileWindowsFromSpace(std::vector<uint32_t> &Windows, macos_space *Space, virtual_space *VirtualSpace)
+{
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        for (size_t Index = 0; Index < Windows.size(); ++Index) {
+            MonocleRemoveWindow(&VirtualSpace->Monocle, Windows[Index]);
         }
+    } else if ((VirtualSpace->Tree) && (VirtualSpace->Mode == Virtual_Space_Bsp)) {
+        RemoveWindowNodes(VirtualSpace, Windows.data(), Windows.size(), Space);
+    }
+}
 
-        if (!Found) {
-            Windows.push_back(WindowsInTree[Index]);
+/*
+ * NOTE(koekeishiya): Windows are removed and added without applying any frames, so that
+ * the caller can apply the frames of all windows in a single pass. The regions of the tree
+ * are up to date before the first window is added, and every window that is added only
+ * creates the regions of the nodes that it splits. The display of the space is checked
+ * once for all windows. Returns false if the windows already matched.
+ */
+internal bool
+MergeWindowsIntoSpace(macos_space *Space, virtual_space *VirtualSpace, std::vector<uint32_t> &Windows)
+{
+    std::vector<uint32_t> WindowsInTree = GetAllWindowsInTree(VirtualSpace);
+    std::vector<uint32_t> WindowsToAdd = GetAllWindowsToAddToTree(Windows, WindowsInTree);
+    std::vector<uint32_t> WindowsToRemove = GetAllWindowsToRemoveFromTree(Windows, WindowsInTree);
+
+    if (WindowsToAdd.empty() && WindowsToRemove.empty()) {
+        return false;
+    }
+
+    UntileWindowsFromSpace(WindowsToRemove, Space, VirtualSpace);
+
+    if (WindowsToAdd.empty()) {
+        return true;
+    }
+
+    bool Tile = ((VirtualSpace->Mode != Virtual_Space_Float) &&
+                 (!IsDisplayOfSpaceChangingSpaces(Space)));
+
+    for (size_t Index = 0; Index < WindowsToAdd.size(); ++Index) {
+        macos_window *Window = GetWindowByID(WindowsToAdd[Index]);
+        if ((Window) && (TileWindowPreValidation(Window)) && (Tile)) {
+            TileWindowOnSpaceUnchecked(Window, Space, VirtualSpace, false);
         }
     }
 
-    return Windows;
+    return true;
+}
+
+/*
+ * NOTE(koekeishiya): A virtual space that was found in the state file on startup gets
+ * the tree that it had before chunkwm was restarted. Windows that no longer exist are
+ * removed, and new windows are added, before the frames of all windows are applied once.
+ */
+internal bool
+CreateRestoredWindowTreeForSpaceWithWindows(macos_space *Space, virtual_space *VirtualSpace, std::vector<uint32_t> &Windows)
+{
+    space_state *State = VirtualSpace->RestoreState;
+    VirtualSpace->RestoreState = NULL;
+
+    if ((!State) || (State->Mode != (uint32_t) VirtualSpace->Mode)) {
+        return false;
+    }
+
+    DeserializeSpaceState(State, VirtualSpace);
+    if (!VirtualSpaceHasWindows(VirtualSpace)) {
+        return false;
+    }
+
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        CreateMonocleRegion(&VirtualSpace->Monocle, Space, VirtualSpace);
+    } else {
+        CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
+        CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
+    }
+
+    MergeWindowsIntoSpace(Space, VirtualSpace, Windows);
+    if (VirtualSpaceHasWindows(VirtualSpace)) {
+        VirtualSpaceUpdateRegions(VirtualSpace);
+    }
+
+    return true;
 }
 
 /*
@@ -766,31 +938,25 @@ GetAllWindowsToRemoveFromTree(std::vector<uint32_t> &VisibleWindows, std::vector
 internal void
 CreateWindowTreeForSpaceWithWindows(macos_space *Space, virtual_space *VirtualSpace, std::vector<uint32_t> Windows)
 {
-    node *New, *Root = CreateRootNode(Windows[0], Space, VirtualSpace);
-    VirtualSpace->Tree = Root;
+    if (CreateRestoredWindowTreeForSpaceWithWindows(Space, VirtualSpace, Windows)) {
+        return;
+    }
 
+    BEGIN_TIMED_BLOCK();
     if (VirtualSpace->Mode == Virtual_Space_Bsp) {
-        for (size_t Index = 1; Index < Windows.size(); ++Index) {
-            New = GetFirstMinDepthLeafNode(Root);
-            ASSERT(New != NULL);
-
-            node_split Split = NodeSplitFromString(CVarStringValue(CVAR_BSP_SPLIT_MODE));
-            if (Split == Split_Optimal) {
-                Split = OptimalSplitMode(New);
-            }
-
-            CreateLeafNodePair(New, New->WindowId, Windows[Index], Split, Space, VirtualSpace);
-        }
+        node_split Split = NodeSplitFromString(CVarStringValue(CVAR_BSP_SPLIT_MODE));
+        VirtualSpace->Tree = CreateNodeTree(&Windows[0], Windows.size(), Split, Space, VirtualSpace);
     } else if (VirtualSpace->Mode == Virtual_Space_Monocle) {
-        for (size_t Index = 1; Index < Windows.size(); ++Index) {
-            New = CreateRootNode(Windows[Index], Space, VirtualSpace);
-            Root->Right = New;
-            New->Left = Root;
-            Root = New;
+        monocle_list *Monocle = &VirtualSpace->Monocle;
+        CreateMonocleRegion(Monocle, Space, VirtualSpace);
+
+        for (size_t Index = 0; Index < Windows.size(); ++Index) {
+            MonocleInsertWindow(Monocle, Monocle->Count, Windows[Index]);
         }
     }
+    END_TIMED_BLOCK();
 
-    ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode);
+    VirtualSpaceUpdateRegions(VirtualSpace);
 }
 
 /*
@@ -801,13 +967,18 @@ CreateWindowTreeForSpaceWithWindows(macos_space *Space, virtual_space *VirtualSp
 internal void
 CreateDeserializedWindowTreeForSpaceWithWindows(macos_space *Space, virtual_space *VirtualSpace, std::vector<uint32_t> Windows)
 {
+    if ((!VirtualSpace->Tree) &&
+        (CreateRestoredWindowTreeForSpaceWithWindows(Space, VirtualSpace, Windows))) {
+        return;
+    }
+
     if (!VirtualSpace->Tree) {
-        char *Buffer = ReadFile(VirtualSpace->TreeLayout);
-        if (Buffer) {
-            VirtualSpace->Tree = DeserializeNodeFromBuffer(Buffer);
-            free(Buffer);
+        layout_file Layout;
+        if (BeginLayoutFile(VirtualSpace->TreeLayout, &Layout)) {
+            VirtualSpace->Tree = DeserializeLayoutFile(&Layout, VirtualSpace);
+            EndLayoutFile(&Layout);
         } else {
-            c_log(C_LOG_LEVEL_ERROR, "failed to open '%s' for reading!\n", VirtualSpace->TreeLayout);
+            c_log(C_LOG_LEVEL_ERROR, "failed to load layout '%s'!\n", VirtualSpace->TreeLayout);
             CreateWindowTreeForSpaceWithWindows(Space, VirtualSpace, Windows);
             return;
         }
@@ -823,13 +994,13 @@ CreateDeserializedWindowTreeForSpaceWithWindows(macos_space *Space, virtual_spac
                 // existing node configuration.
                 int SpawnLeft = CVarIntegerValue(CVAR_BSP_SPAWN_LEFT);
                 node_ids NodeIds = AssignNodeIds(Node->Parent->WindowId, Windows[Index], SpawnLeft);
-                Node->Parent->WindowId = Node_Root;
-                Node->Parent->Left->WindowId = NodeIds.Left;
-                Node->Parent->Right->WindowId = NodeIds.Right;
+                SetNodeWindowId(Node->Parent, Node_Root, VirtualSpace);
+                SetNodeWindowId(Node->Parent->Left, NodeIds.Left, VirtualSpace);
+                SetNodeWindowId(Node->Parent->Right, NodeIds.Right, VirtualSpace);
             } else {
                 // NOTE(koekeishiya): This is the root node, we temporarily
                 // use it as a leaf node, even though it really isn't.
-                Node->WindowId = Windows[Index];
+                SetNodeWindowId(Node, Windows[Index], VirtualSpace);
             }
         } else {
             // NOTE(koekeishiya): There are more windows than containers in the layout
@@ -855,7 +1026,7 @@ void CreateWindowTreeForSpace(macos_space *Space, virtual_space *VirtualSpace)
 {
     std::vector<uint32_t> Windows;
 
-    if ((VirtualSpace->Tree) ||
+    if ((VirtualSpaceHasWindows(VirtualSpace)) ||
         (VirtualSpace->Mode == Virtual_Space_Float)) {
         return;
     }
@@ -920,28 +1091,16 @@ space_free:
  * passed to this function is of type kCGSSpaceUser, and that the virtual space
  * is set to a tiling mode, and that an existing tree is present. The window list
  * must also be non-empty !!!
+ *
+ * The frames of all windows are applied in a single pass once the tree has been
+ * updated, and a window that did not end up moving is never touched.
  */
 internal void
 RebalanceWindowTreeForSpaceWithWindows(macos_space *Space, virtual_space *VirtualSpace, std::vector<uint32_t> Windows)
 {
-    std::vector<uint32_t> WindowsInTree = GetAllWindowsInTree(VirtualSpace->Tree, VirtualSpace->Mode);
-    std::vector<uint32_t> WindowsToAdd = GetAllWindowsToAddToTree(Windows, WindowsInTree);
-    std::vector<uint32_t> WindowsToRemove = GetAllWindowsToRemoveFromTree(Windows, WindowsInTree);
-
-    for (size_t Index = 0; Index < WindowsToRemove.size(); ++Index) {
-        macos_window *Window = GetWindowByID(WindowsToRemove[Index]);
-        if ((Window) && (UntileWindowPreValidation(Window))) {
-            UntileWindowFromSpace(Window, Space, VirtualSpace);
-        } else {
-            UntileWindowFromSpace(WindowsToRemove[Index], Space, VirtualSpace);
-        }
-    }
-
-    for (size_t Index = 0; Index < WindowsToAdd.size(); ++Index) {
-        macos_window *Window = GetWindowByID(WindowsToAdd[Index]);
-        if ((Window) && (TileWindowPreValidation(Window))) {
-            TileWindowOnSpace(Window, Space, VirtualSpace);
-        }
+    if ((MergeWindowsIntoSpace(Space, VirtualSpace, Windows)) &&
+        (VirtualSpaceHasWindows(VirtualSpace))) {
+        VirtualSpaceUpdateRegions(VirtualSpace);
     }
 }
 
@@ -950,7 +1109,7 @@ RebalanceWindowTreeForSpace(macos_space *Space, virtual_space *VirtualSpace)
 {
     std::vector<uint32_t> Windows;
 
-    if ((!VirtualSpace->Tree) ||
+    if ((!VirtualSpaceHasWindows(VirtualSpace)) ||
         (VirtualSpace->Mode == Virtual_Space_Float)) {
         return;
     }
@@ -1020,8 +1179,8 @@ WindowFocusedHandler(uint32_t WindowId)
             goto space_free;
         }
 
-        if (RuleChangedDesktop(Window->Flags)) {
-            AXLibClearFlags(Window, Rule_Desktop_Changed);
+        if (RuleChangedDesktop(GetWindowFlags(Window))) {
+            ClearWindowFlags(Window, Rule_Desktop_Changed);
             goto space_free;
         }
 
@@ -1060,22 +1219,16 @@ ApplicationLaunchedHandler(void *Data)
 {
     macos_application *Application = (macos_application *) Data;
 
-    macos_window **WindowList = AXLibWindowListForApplication(Application);
-    if (WindowList) {
-        macos_window **List = WindowList;
-        macos_window *Window;
-        while ((Window = *List++)) {
-            if (GetWindowByID(Window->Id)) {
-                AXLibDestroyWindow(Window);
-            } else {
-                AddWindowToCollection(Window);
-                if (RuleChangedDesktop(Window->Flags)) continue;
-                if (RuleTiledWindow(Window->Flags))    continue;
-                TileWindow(Window);
-            }
-        }
+    // NOTE(koekeishiya): chunkwm has added the windows of the application to its registry.
+    UpdateWindowCollection();
 
-        free(WindowList);
+    std::vector<macos_window *> Windows = GetWindowsForApplication(Application);
+    for (size_t Index = 0; Index < Windows.size(); ++Index) {
+        macos_window *Window = Windows[Index];
+        uint32_t Flags = GetWindowFlags(Window);
+        if (RuleChangedDesktop(Flags)) continue;
+        if (RuleTiledWindow(Flags))    continue;
+        TileWindow(Window);
     }
 }
 
@@ -1100,7 +1253,7 @@ ApplicationUnhiddenHandler(void *Data)
     macos_application *Application = (macos_application *) Data;
 
     macos_space *Space;
-    macos_window *Window, **List, **WindowList;
+    std::vector<macos_window *> Windows;
 
     bool Success = AXLibActiveSpace(&Space);
     ASSERT(Success);
@@ -1109,20 +1262,13 @@ ApplicationUnhiddenHandler(void *Data)
         goto space_free;
     }
 
-    List = WindowList = AXLibWindowListForApplication(Application);
-    if (!WindowList) {
-        goto space_free;
-    }
-
-    while ((Window = *List++)) {
-        macos_window *Copy = RemoveWindowFromCollection(Window);
-        if (Copy) {
-            AXLibDestroyWindow(Copy);
-        }
-
-        AddWindowToCollection(Window);
+    // NOTE(koekeishiya): chunkwm keeps the windows of a hidden application in its registry.
+    UpdateWindowCollection();
 
-        if (Window && AXLibSpaceHasWindow(Space->Id, Window->Id)) {
+    Windows = GetWindowsForApplication(Application);
+    for (size_t Index = 0; Index < Windows.size(); ++Index) {
+        macos_window *Window = Windows[Index];
+        if (AXLibSpaceHasWindow(Space->Id, Window->Id)) {
             uint32_t LastFocusedWindowId = CVarUnsignedValue(CVAR_LAST_FOCUSED_WINDOW);
             if (LastFocusedWindowId) {
                 UpdateCVar(CVAR_BSP_INSERTION_POINT, LastFocusedWindowId);
@@ -1136,8 +1282,6 @@ ApplicationUnhiddenHandler(void *Data)
         }
     }
 
-    free(WindowList);
-
 space_free:
     AXLibDestroySpace(Space);
 }
@@ -1145,21 +1289,22 @@ space_free:
 internal void
 WindowCreatedHandler(void *Data)
 {
-    macos_window *Window = (macos_window *) Data;
-    macos_window *Copy = AXLibCopyWindow(Window);
-    AddWindowToCollection(Copy);
-    if (RuleChangedDesktop(Copy->Flags)) return;
-    if (RuleTiledWindow(Copy->Flags))    return;
-    TileWindow(Copy);
+    macos_window *Window = AcquireWindow(((macos_window *) Data)->Id);
+    if (!Window) return;
+
+    uint32_t Flags = GetWindowFlags(Window);
+    if (RuleChangedDesktop(Flags)) return;
+    if (RuleTiledWindow(Flags))    return;
+    TileWindow(Window);
 }
 
 internal void
 WindowSheetCreatedHandler(void *Data)
 {
-    macos_window *Window = (macos_window *) Data;
-    macos_window *Copy = AXLibCopyWindow(Window);
-    AddWindowToCollection(Copy);
-    FloatWindow(Copy);
+    macos_window *Window = AcquireWindow(((macos_window *) Data)->Id);
+    if (Window) {
+        FloatWindow(Window);
+    }
 }
 
 internal void
@@ -1167,16 +1312,21 @@ WindowDestroyedHandler(void *Data)
 {
     macos_window *Window = (macos_window *) Data;
 
+    // NOTE(koekeishiya): chunkwm marks the shared window as invalid before we are notified.
+    uint32_t Flags = GetWindowFlags(Window);
+    bool Floating = ((Flags & Window_Float) != 0);
+    bool Valid = IsWindowValid(Flags & ~Window_Invalid);
+
     macos_window *Copy = RemoveWindowFromCollection(Window);
     if (Copy) {
-        if (AXLibHasFlags(Copy, Window_Float)) {
+        if (Floating) {
             unsigned FocusedWindowId = CVarUnsignedValue(CVAR_FOCUSED_WINDOW);
             if (Copy->Id == FocusedWindowId) {
                 BroadcastFocusedWindowFloating();
             }
         }
 
-        if (IsWindowValid(Copy)) {
+        if (Valid) {
             UntileWindow(Copy);
         } else {
             RebalanceWindowTree();
@@ -1186,7 +1336,7 @@ WindowDestroyedHandler(void *Data)
             }
         }
 
-        AXLibDestroyWindow(Copy);
+        DestroyWindowFromCollection(Copy);
     } else {
         // NOTE(koekeishiya): Due to unknown reasons, copy returns null for
         // some windows that we receive a destroyed event for, in particular
@@ -1199,6 +1349,7 @@ internal void
 WindowMinimizedHandler(void *Data)
 {
     macos_window *Window = (macos_window *) Data;
+    InvalidateWindowProperties(Window->Id, Window_Property_All);
 
     macos_window *Copy = GetWindowByID(Window->Id);
     ASSERT(Copy);
@@ -1216,6 +1367,7 @@ internal void
 WindowDeminimizedHandler(void *Data)
 {
     macos_window *Window = (macos_window *) Data;
+    InvalidateWindowProperties(Window->Id, Window_Property_All);
 
     macos_space *Space;
     bool Success = AXLibActiveSpace(&Space);
@@ -1226,18 +1378,7 @@ WindowDeminimizedHandler(void *Data)
         macos_window *Copy = GetWindowByID(Window->Id);
         ASSERT(Copy);
 
-        if (AXLibHasFlags(Copy, Window_Init_Minimized)) {
-            if (Copy->Mainrole) {
-                CFRelease(Copy->Mainrole);
-                AXLibGetWindowRole(Copy->Ref, &Copy->Mainrole);
-            }
-
-            if (Copy->Subrole) {
-                CFRelease(Copy->Subrole);
-                AXLibGetWindowSubrole(Copy->Ref, &Copy->Subrole);
-            }
-            AXLibClearFlags(Copy, Window_Init_Minimized);
-        }
+        UpdateWindowStandardFlag(Copy);
 
         macos_window *LastFocusedWindow = GetWindowByID(CVarUnsignedValue(CVAR_LAST_FOCUSED_WINDOW));
         bool OverrideInsertionPoint = LastFocusedWindow && LastFocusedWindow->Owner->PID != Window->Owner->PID;
@@ -1267,13 +1408,10 @@ internal void
 WindowMovedHandler(void *Data)
 {
     macos_window *Window = (macos_window *) Data;
-    macos_window *Copy = GetWindowByID(Window->Id);
-    if (Copy) {
-        if (Copy->Position != Window->Position) {
-            Copy->Position = Window->Position;
-            if (CVarIntegerValue(CVAR_WINDOW_REGION_LOCKED)) {
-                ConstrainWindowToRegion(Copy);
-            }
+    // NOTE(koekeishiya): chunkwm has already updated the position of the shared window.
+    if (GetWindowByID(Window->Id)) {
+        if (CVarIntegerValue(CVAR_WINDOW_REGION_LOCKED)) {
+            ConstrainWindowToRegion(Window);
         }
     }
 }
@@ -1283,16 +1421,12 @@ WindowResizedHandler(void *Data)
 {
     macos_window *Window = (macos_window *) Data;
 
-    macos_window *Copy = GetWindowByID(Window->Id);
-    if (Copy) {
-        if ((Copy->Position != Window->Position) ||
-            (Copy->Size != Window->Size)) {
-            Copy->Position = Window->Position;
-            Copy->Size = Window->Size;
+    InvalidateWindowProperties(Window->Id, Window_Property_Fullscreen);
 
-            if (CVarIntegerValue(CVAR_WINDOW_REGION_LOCKED)) {
-                ConstrainWindowToRegion(Copy);
-            }
+    // NOTE(koekeishiya): chunkwm has already updated the frame of the shared window.
+    if (GetWindowByID(Window->Id)) {
+        if (CVarIntegerValue(CVAR_WINDOW_REGION_LOCKED)) {
+            ConstrainWindowToRegion(Window);
         }
     }
 }
@@ -1302,14 +1436,9 @@ WindowTitleChangedHandler(void *Data)
 {
     macos_window *Window = (macos_window *) Data;
 
-    macos_window *Copy = GetWindowByID(Window->Id);
-    if (Copy) {
-        if (Copy->Name) {
-            free(Copy->Name);
-        }
-
-        Copy->Name = strdup(Window->Name);
-        ApplyRulesForWindowOnTitleChanged(Copy);
+    // NOTE(koekeishiya): chunkwm has already replaced the name of the shared window.
+    if (GetWindowByID(Window->Id)) {
+        ApplyRulesForWindowOnTitleChanged(Window);
     }
 }
 
@@ -1346,24 +1475,17 @@ SpaceAndDisplayChangedHandler(void *Data)
 
     if (!Windows.empty()) {
         if (VirtualSpace->Mode != Virtual_Space_Float) {
-            if (VirtualSpace->Tree) {
+            if (VirtualSpaceHasWindows(VirtualSpace)) {
                 //
-                // NOTE(koekeishiya): If the activated virtual_space is flagged for resize,
-                // we update the dimensions of all existing nodes in our window-tree.
+                // NOTE(koekeishiya): Work that was deferred while the virtual_space was not
+                // visible, and windows that were added or removed in the meantime, are
+                // handled together, so that every window is applied at most once.
                 //
-                if (VirtualSpaceHasFlags(VirtualSpace, Virtual_Space_Require_Resize)) {
-                    VirtualSpaceRecreateRegions(Space, VirtualSpace);
+                VirtualSpaceBeginDeferredLayout(Space, VirtualSpace);
+                if (MergeWindowsIntoSpace(Space, VirtualSpace, Windows)) {
+                    VirtualSpaceDeferRegionUpdate(VirtualSpace);
                 }
-
-                //
-                // NOTE(koekeishiya): If the activated virtual_space is flagged for region update,
-                // we re-apply all the region of all existing nodes in our window-tree.
-                //
-                if (VirtualSpaceHasFlags(VirtualSpace, Virtual_Space_Require_Region_Update)) {
-                    VirtualSpaceUpdateRegions(VirtualSpace);
-                }
-
-                RebalanceWindowTreeForSpaceWithWindows(Space, VirtualSpace, Windows);
+                VirtualSpaceEndDeferredLayout(VirtualSpace);
             } else if (ShouldDeserializeVirtualSpace(VirtualSpace)) {
                 CreateDeserializedWindowTreeForSpaceWithWindows(Space, VirtualSpace, Windows);
             } else {
@@ -1398,21 +1520,19 @@ RecreateVirtualSpaceRegionsForDisplay(CFStringRef DisplayRef)
         virtual_space *VirtualSpace = AcquireVirtualSpace(Space);
         ASSERT(VirtualSpace);
 
-        if (VirtualSpace->Tree) {
+        if (VirtualSpaceHasWindows(VirtualSpace)) {
             if (Space->Id == ActiveSpace->Id) {
                 //
                 // NOTE(koekeishiya): Update dimensions of the currently active desktop
                 // for the monitor that triggered a resolution change.
                 //
-                CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
-                CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
-                ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode, false);
+                VirtualSpaceRecreateRegions(Space, VirtualSpace);
             } else {
                 //
                 // NOTE(koekeishiya): We can not update dimensions of windows that are on inactive desktops,
                 // so we flag them for change upon next activation instead
                 //
-                VirtualSpaceAddFlags(VirtualSpace, Virtual_Space_Require_Resize);
+                VirtualSpaceDeferResize(VirtualSpace);
             }
         }
 
@@ -1578,6 +1698,8 @@ ChunkwmDaemonCommandHandler(void *Data)
 
 PLUGIN_MAIN_FUNC(PluginMain)
 {
+    InvalidateDockGeometry();
+
     if (StringEquals(Node, "chunkwm_export_application_launched")) {
         ApplicationLaunchedHandler(Data);
         return true;
@@ -1620,14 +1742,19 @@ PLUGIN_MAIN_FUNC(PluginMain)
     } else if (StringEquals(Node, "chunkwm_export_window_title_changed")) {
         WindowTitleChangedHandler(Data);
         return true;
-    } else if ((StringEquals(Node, "chunkwm_export_space_changed")) ||
-               (StringEquals(Node, "chunkwm_export_display_changed"))) {
+    } else if (StringEquals(Node, "chunkwm_export_space_changed")) {
+        SpaceAndDisplayChangedHandler(Data);
+        return true;
+    } else if (StringEquals(Node, "chunkwm_export_display_changed")) {
+        InvalidateDisplayGeometry();
         SpaceAndDisplayChangedHandler(Data);
         return true;
     } else if (StringEquals(Node, "chunkwm_export_display_resized")) {
+        InvalidateDisplayGeometry();
         DisplayResizedHandler(Data);
         return true;
     } else if (StringEquals(Node, "chunkwm_export_display_moved")) {
+        InvalidateDisplayGeometry();
         DisplayMovedHandler(Data);
         return true;
 #if 0
@@ -1658,6 +1785,19 @@ PLUGIN_MAIN_FUNC(PluginMain)
     return false;
 }
 
+// NOTE(koekeishiya): Like the socket and pid-file of chunkwm, the state file belongs to one user.
+internal void
+CreateDesktopStateFileCVar()
+{
+    char StateFile[PATH_MAX] = {};
+    char *User = getenv("USER");
+    if (User) {
+        snprintf(StateFile, sizeof(StateFile), DESKTOP_STATE_FILE_FMT, User);
+    }
+
+    CreateCVar(CVAR_DESKTOP_STATE_FILE, StateFile);
+}
+
 internal bool
 Init(chunkwm_api ChunkwmAPI)
 {
@@ -1672,9 +1812,12 @@ Init(chunkwm_api ChunkwmAPI)
     c_log = API.Log;
     BeginCVars(&API);
 
-    Success = (pthread_mutex_init(&WindowsLock, NULL) == 0);
+    Success = ((pthread_mutex_init(&WindowsLock, NULL) == 0) &&
+               (BeginWindowCache(API.ReleaseWindow)));
     if (!Success) goto out;
 
+    InitWindowTable(&Windows);
+
     CreateCVar(CVAR_SPACE_MODE, virtual_space_mode_str[Virtual_Space_Bsp]);
 
     CreateCVar(CVAR_BAR_ENABLED, 0);
@@ -1692,6 +1835,8 @@ Init(chunkwm_api ChunkwmAPI)
 
     CreateCVar(CVAR_PADDING_STEP_SIZE, 10.0f);
     CreateCVar(CVAR_GAP_STEP_SIZE, 5.0f);
+    CreateCVar(CVAR_DESKTOP_HISTORY_DEPTH, 20);
+    CreateDesktopStateFileCVar();
 
     CreateCVar(CVAR_FOCUSED_WINDOW, 0);
     CreateCVar(CVAR_LAST_FOCUSED_WINDOW, 0);
@@ -1715,6 +1860,8 @@ Init(chunkwm_api ChunkwmAPI)
 
     CreateCVar(CVAR_WINDOW_FLOAT_NEXT, 0);
     CreateCVar(CVAR_WINDOW_REGION_LOCKED, 0);
+    CreateCVar(CVAR_WINDOW_FRAME_TIMEOUT, 1.0f);
+    CreateCVar(CVAR_WINDOW_PROPERTY_VERIFY, 0);
 
     CreateCVar(CVAR_PRE_BORDER_COLOR, 0xffffff00);
     CreateCVar(CVAR_PRE_BORDER_WIDTH, 4);
@@ -1741,9 +1888,10 @@ Init(chunkwm_api ChunkwmAPI)
     for (size_t Index = 0; Index < Applications.size(); ++Index) {
         macos_application *Application = Applications[Index];
         AddApplication(Application);
-        AddApplicationWindowList(Application);
     }
 
+    UpdateWindowCollection();
+
     Success = AXLibActiveSpace(&Space);
     ASSERT(Success);
 
@@ -1755,7 +1903,11 @@ Init(chunkwm_api ChunkwmAPI)
     UpdateCVar(CVAR_ACTIVE_DESKTOP, (int)DesktopId);
     UpdateCVar(CVAR_LAST_ACTIVE_DESKTOP, (int)DesktopId);
 
-    Success = BeginVirtualSpaces();
+    SetWindowBackend(&MacOSWindowBackend);
+    Success = ((BeginVirtualSpaces()) &&
+               (BeginDisplayGeometryCache()) &&
+               (BeginWindowPropertyCache()) &&
+               (BeginFrameApply()));
     if (Success) {
         bool MouseMoveBound = BindMouseMoveAction(CVarStringValue(CVAR_MOUSE_MOVE_BINDING));
         bool MouseResizeBound = BindMouseResizeAction(CVarStringValue(CVAR_MOUSE_RESIZE_BINDING));
@@ -1776,6 +1928,8 @@ Init(chunkwm_api ChunkwmAPI)
     EndEventTap(&EventTap);
     ClearApplicationCache();
     ClearWindowCache();
+    EndWindowCache();
+    FreeWindowTable(&Windows);
 
 out:
     return Success;
@@ -1788,9 +1942,14 @@ Deinit()
 
     ClearApplicationCache();
     ClearWindowCache();
+    EndWindowCache();
+    FreeWindowTable(&Windows);
     FreeWindowRules();
 
     EndVirtualSpaces();
+    EndDisplayGeometryCache();
+    EndWindowPropertyCache();
+    EndFrameApply();
 }
 
 PLUGIN_BOOL_FUNC(PluginInit)
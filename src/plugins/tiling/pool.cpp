@@ -0,0 +1,83 @@
+#include "pool.h"
+#include "node.h"
+
+#include "../../common/misc/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define NODE_POOL_BLOCK_SIZE 64
+
+struct node_pool_block
+{
+    node_pool_block *Next;
+    node Nodes[NODE_POOL_BLOCK_SIZE];
+};
+
+void InitNodePool(node_pool *Pool)
+{
+    memset(Pool, 0, sizeof(node_pool));
+}
+
+node *AllocateNode(node_pool *Pool)
+{
+    node *Node;
+
+    if (Pool->FreeList) {
+        Node = Pool->FreeList;
+        Pool->FreeList = Node->Left;
+    } else {
+        if (!Pool->Current || Pool->Used == NODE_POOL_BLOCK_SIZE) {
+            // NOTE(koekeishiya): Blocks are kept when the pool is reset, reuse them before allocating.
+            node_pool_block *Block = Pool->Current ? Pool->Current->Next : Pool->Blocks;
+            if (!Block) {
+                Block = (node_pool_block *) malloc(sizeof(node_pool_block));
+                Block->Next = NULL;
+
+                if (Pool->Current) {
+                    Pool->Current->Next = Block;
+                } else {
+                    Pool->Blocks = Block;
+                }
+            }
+
+            Pool->Current = Block;
+            Pool->Used = 0;
+        }
+
+        Node = &Pool->Current->Nodes[Pool->Used++];
+    }
+
+    memset(Node, 0, sizeof(node));
+    ++Pool->Count;
+    return Node;
+}
+
+void ReleaseNode(node_pool *Pool, node *Node)
+{
+    ASSERT(Pool->Count > 0);
+
+    Node->Left = Pool->FreeList;
+    Pool->FreeList = Node;
+    --Pool->Count;
+}
+
+void ResetNodePool(node_pool *Pool)
+{
+    Pool->Current = NULL;
+    Pool->Used = 0;
+    Pool->FreeList = NULL;
+    Pool->Count = 0;
+}
+
+void FreeNodePool(node_pool *Pool)
+{
+    node_pool_block *Block = Pool->Blocks;
+    while (Block) {
+        node_pool_block *Next = Block->Next;
+        free(Block);
+        Block = Next;
+    }
+
+    memset(Pool, 0, sizeof(node_pool));
+}
@@ -0,0 +1,31 @@
+#ifndef PLUGIN_POOL_H
+#define PLUGIN_POOL_H
+
+#include <stdint.h>
+
+struct node;
+struct node_pool_block;
+
+/*
+ * NOTE(koekeishiya): Every virtual_space owns a node_pool. Nodes are carved out of
+ * fixed-size blocks so that the nodes of a tree sit next to each other in memory.
+ * Released nodes go on a free-list and are handed out again before we touch a new
+ * block. Resetting the pool releases every node at once, without visiting them.
+ */
+struct node_pool
+{
+    node_pool_block *Blocks;
+    node_pool_block *Current;
+    uint32_t Used;
+
+    node *FreeList;
+    uint32_t Count;
+};
+
+void InitNodePool(node_pool *Pool);
+node *AllocateNode(node_pool *Pool);
+void ReleaseNode(node_pool *Pool, node *Node);
+void ResetNodePool(node_pool *Pool);
+void FreeNodePool(node_pool *Pool);
+
+#endif
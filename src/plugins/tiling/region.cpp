@@ -1,146 +1,30 @@
 #include "region.h"
 #include "node.h"
 #include "vspace.h"
-#include "constants.h"
+#include "backend.h"
+#include "adjacency.h"
 
 #include "../../common/misc/assert.h"
-#include "../../common/accessibility/display.h"
-#include "../../common/accessibility/window.h"
 
 #define internal static
 
-extern macos_window *GetWindowByID(uint32_t Id);
-
-region CGRectToRegion(CGRect Rect)
+// NOTE(koekeishiya): Only a full region depends on the display, so split regions never look it up.
+internal region
+SpaceFullscreenRegion(macos_space *Space, virtual_space *VirtualSpace)
 {
-    region Result = { (float) Rect.origin.x,   (float) Rect.origin.y,
-                      (float) Rect.size.width, (float) Rect.size.height,
-                      Region_Full };
+    region Result = GetWindowBackend()->SpaceRegion(Space);
+    ApplyRegionOffset(&Result, VirtualSpace->Offset);
     return Result;
 }
 
-region RoundPreselRegion(region Region, CGPoint Position, CGSize Size)
+void ApplyRegionOffset(region *Region, region_offset *Offset)
 {
-    region Result = {
-        roundf(Region.X),
-        roundf(Region.Y),
-        roundf(Region.Width),
-        roundf(Region.Height)
-    };
-
-    float DiffX = abs(Region.X - Position.x);
-    float DiffY = abs(Region.Y - Position.y);
-    float DiffW = abs(Region.Width - Size.width);
-    float DiffH = abs(Region.Height - Size.height);
-
-    if ((DiffX >= 0.5) && (DiffX <= 2.5)) {
-        Result.X = Position.x;
-    }
-
-    if ((DiffY >= 0.5) && (DiffY <= 2.5)) {
-        Result.Y = Position.y;
-    }
-
-    if ((DiffW >= 0.5) && (DiffW <= 2.5)) {
-        Result.Width = Size.width;
-    }
-
-    if ((DiffH >= 0.5) && (DiffH <= 2.5)) {
-        Result.Height = Size.height;
-    }
-
-    return Result;
-}
-
-#define OSX_MENU_BAR_HEIGHT 22.0f
-void ConstrainRegion(CFStringRef DisplayRef, region *Region)
-{
-    // NOTE(koekeishiya): Automatically adjust padding to account for osx menubar status.
-    if (!AXLibIsMenuBarAutoHideEnabled()) {
-        Region->Y += OSX_MENU_BAR_HEIGHT;
-        Region->Height -= OSX_MENU_BAR_HEIGHT;
-    }
-
-    if (CVarIntegerValue(CVAR_BAR_ENABLED)) {
-        bool ShouldApplyOffset = true;
-        if (!CVarIntegerValue(CVAR_BAR_ALL_MONITORS)) {
-            CFStringRef MainDisplayRef = AXLibGetDisplayIdentifierForMainDisplay();
-            ASSERT(MainDisplayRef);
-
-            if (CFStringCompare(DisplayRef, MainDisplayRef, 0) != kCFCompareEqualTo) {
-                ShouldApplyOffset = false;
-            }
-
-            CFRelease(MainDisplayRef);
-        }
-
-        if (ShouldApplyOffset) {
-            Region->X += CVarFloatingPointValue(CVAR_BAR_OFFSET_LEFT);
-            Region->Width -= CVarFloatingPointValue(CVAR_BAR_OFFSET_LEFT);
-
-            Region->Y += CVarFloatingPointValue(CVAR_BAR_OFFSET_TOP);
-            Region->Height -= CVarFloatingPointValue(CVAR_BAR_OFFSET_TOP);
-
-            Region->Width -= CVarFloatingPointValue(CVAR_BAR_OFFSET_RIGHT);
-            Region->Height -= CVarFloatingPointValue(CVAR_BAR_OFFSET_BOTTOM);
-        }
-    }
-
-    if (!AXLibIsDockAutoHideEnabled()) {
-        macos_dock_orientation Orientation = AXLibGetDockOrientation();
-        CGRect DockRect = AXLibGetDockRect();
-
-        switch (Orientation) {
-        case Dock_Orientation_Left: {
-            CFStringRef LeftMostDisplayRef = AXLibGetDisplayIdentifierForLeftMostDisplay();
-            ASSERT(LeftMostDisplayRef);
-
-            if (CFStringCompare(DisplayRef, LeftMostDisplayRef, 0) == kCFCompareEqualTo) {
-                Region->X += DockRect.size.width;
-                Region->Width -= DockRect.size.width;
-            }
-
-            CFRelease(LeftMostDisplayRef);
-        } break;
-        case Dock_Orientation_Right: {
-            CFStringRef RightMostDisplayRef = AXLibGetDisplayIdentifierForRightMostDisplay();
-            ASSERT(RightMostDisplayRef);
-
-            if (CFStringCompare(DisplayRef, RightMostDisplayRef, 0) == kCFCompareEqualTo) {
-                Region->Width -= DockRect.size.width;
-            }
-
-            CFRelease(RightMostDisplayRef);
-        } break;
-        case Dock_Orientation_Bottom: {
-            CFStringRef BottomMostDisplayRef = AXLibGetDisplayIdentifierForBottomMostDisplay();
-            ASSERT(BottomMostDisplayRef);
-
-            if (CFStringCompare(DisplayRef, BottomMostDisplayRef, 0) == kCFCompareEqualTo) {
-                Region->Height -= DockRect.size.height;
-            }
-
-            CFRelease(BottomMostDisplayRef);
-        } break;
-        case Dock_Orientation_Top: { /* NOTE(koekeishiya) compiler warning.. */ } break;
-        }
-    }
-}
-
-region FullscreenRegion(CFStringRef DisplayRef, virtual_space *VirtualSpace)
-{
-    region Result = CGRectToRegion(AXLibGetDisplayBounds(DisplayRef));
-    ConstrainRegion(DisplayRef, &Result);
-
-    region_offset *Offset = VirtualSpace->Offset;
     if (Offset) {
-        Result.X += Offset->Left;
-        Result.Y += Offset->Top;
-        Result.Width -= (Offset->Left + Offset->Right);
-        Result.Height -= (Offset->Top + Offset->Bottom);
+        Region->X += Offset->Left;
+        Region->Y += Offset->Top;
+        Region->Width -= (Offset->Left + Offset->Right);
+        Region->Height -= (Offset->Top + Offset->Bottom);
     }
-
-    return Result;
 }
 
 internal region
@@ -233,11 +117,8 @@ void CreateNodeRegion(node *Node, region_type Type, macos_space *Space, virtual_
 {
     ASSERT(Type >= Region_Full && Type <= Region_Lower);
 
-    CFStringRef DisplayRef = AXLibGetDisplayIdentifierFromSpace(Space->Id);
-    ASSERT(DisplayRef);
-
     switch (Type) {
-    case Region_Full:   { Node->Region = FullscreenRegion(DisplayRef, VirtualSpace);        } break;
+    case Region_Full:   { Node->Region = SpaceFullscreenRegion(Space, VirtualSpace);        } break;
     case Region_Left:   { Node->Region = LeftVerticalRegion(Node->Parent, VirtualSpace);    } break;
     case Region_Right:  { Node->Region = RightVerticalRegion(Node->Parent, VirtualSpace);   } break;
     case Region_Upper:  { Node->Region = UpperHorizontalRegion(Node->Parent, VirtualSpace); } break;
@@ -246,18 +127,15 @@ void CreateNodeRegion(node *Node, region_type Type, macos_space *Space, virtual_
     }
 
     Node->Region.Type = Type;
-    CFRelease(DisplayRef);
+    InvalidateAdjacencyGraph(VirtualSpace);
 }
 
 void CreatePreselectRegion(preselect_node *Preselect, region_type Type, macos_space *Space, virtual_space *VirtualSpace)
 {
     ASSERT(Type >= Region_Full && Type <= Region_Lower);
 
-    CFStringRef DisplayRef = AXLibGetDisplayIdentifierFromSpace(Space->Id);
-    ASSERT(DisplayRef);
-
     switch (Type) {
-    case Region_Full:   { Preselect->Region = FullscreenRegion(DisplayRef, VirtualSpace);           } break;
+    case Region_Full:   { Preselect->Region = SpaceFullscreenRegion(Space, VirtualSpace);           } break;
     case Region_Left:   { Preselect->Region = LeftVerticalRegion(Preselect->Node, VirtualSpace);    } break;
     case Region_Right:  { Preselect->Region = RightVerticalRegion(Preselect->Node, VirtualSpace);   } break;
     case Region_Upper:  { Preselect->Region = UpperHorizontalRegion(Preselect->Node, VirtualSpace); } break;
@@ -266,7 +144,12 @@ void CreatePreselectRegion(preselect_node *Preselect, region_type Type, macos_sp
     }
 
     Preselect->Region.Type = Type;
-    CFRelease(DisplayRef);
+}
+
+void CreateMonocleRegion(monocle_list *Monocle, macos_space *Space, virtual_space *VirtualSpace)
+{
+    Monocle->Region = SpaceFullscreenRegion(Space, VirtualSpace);
+    Monocle->Region.Type = Region_Full;
 }
 
 internal void
@@ -303,10 +186,5 @@ void CreateNodeRegionRecursive(node *Node, bool Optimal, macos_space *Space, vir
             CreateNodeRegionRecursive(Node->Left, Optimal, Space, VirtualSpace);
             CreateNodeRegionRecursive(Node->Right, Optimal, Space, VirtualSpace);
         }
-    } else if (VirtualSpace->Mode == Virtual_Space_Monocle) {
-        if (Node && Node->Right) {
-            CreateNodeRegion(Node->Right, Region_Full, Space, VirtualSpace);
-            CreateNodeRegionRecursive(Node->Right, Optimal, Space, VirtualSpace);
-        }
     }
 }
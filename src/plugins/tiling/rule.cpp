@@ -1,11 +1,15 @@
 #include "rule.h"
+#include "ruleindex.h"
+#include "cache.h"
 #include "controller.h"
+#include "macos.h"
 #include "misc.h"
 
 #include "../../common/misc/assert.h"
 #include "../../common/accessibility/display.h"
 #include "../../common/accessibility/window.h"
 #include "../../common/accessibility/application.h"
+#include "../../common/ipc/daemon.h"
 #include "../../common/misc/assert.h"
 
 #include <stdlib.h>
@@ -17,66 +21,79 @@
 
 #define internal static
 
-typedef std::map<uint32_t, macos_window *> macos_window_map;
-typedef macos_window_map::iterator macos_window_map_it;
-
-extern macos_window_map CopyWindowCache();
 extern void TileWindow(macos_window *Window);
+extern void AddWindowFlags(macos_window *Window, uint32_t Flags);
+extern void ClearWindowFlags(macos_window *Window, uint32_t Flags);
+extern bool WindowHasFlags(macos_window *Window, uint32_t Flags);
 
 internal std::vector<window_rule *> WindowRules;
+internal window_rule_index WindowRuleIndex;
 
 internal inline bool
-RegexMatchPattern(regex_t *Regex, const char *Match, const char *Pattern)
+RegexMatchPattern(regex_t *Regex, const char *Match)
+{
+    int Error = regexec(Regex, Match, 0, NULL, 0);
+    return Error == 0;
+}
+
+internal bool
+RegexCompilePattern(regex_t *Regex, bool *Valid, const char *Filter, const char *Pattern, int SockFD)
 {
     int Error = regcomp(Regex, Pattern, REG_EXTENDED);
-    if (!Error) {
-        Error = regexec(Regex, Match, 0, NULL, 0);
-        regfree(Regex);
-    } else {
-        c_log(C_LOG_LEVEL_WARN, "chunkwm-tiling: window rule - could not compile regex!\n");
+    if (Error) {
+        char Reason[128];
+        regerror(Error, Regex, Reason, sizeof(Reason));
+
+        char Message[512];
+        snprintf(Message, sizeof(Message), "chunkwm-tiling: window rule - invalid %s pattern '%s': %s\n", Filter, Pattern, Reason);
+        c_log(C_LOG_LEVEL_WARN, "%s", Message);
+        WriteToSocket(Message, SockFD);
+        return false;
     }
 
-    return Error == 0;
+    *Valid = true;
+    return true;
 }
 
 internal inline void
 ApplyWindowRuleState(macos_window *Window, window_rule *Rule)
 {
     if (StringEquals(Rule->State, "float")) {
-        if (!AXLibHasFlags(Window, Window_Float)) {
+        if (!WindowHasFlags(Window, Window_Float)) {
             UntileWindow(Window);
             FloatWindow(Window);
         }
     } else if (StringEquals(Rule->State, "sticky")) {
         ExtendedDockSetWindowSticky(Window, 1);
-        AXLibAddFlags(Window, Window_Sticky);
+        AddWindowFlags(Window, Window_Sticky);
 
-        if (!AXLibHasFlags(Window, Window_Float)) {
+        if (!WindowHasFlags(Window, Window_Float)) {
             UntileWindow(Window);
             FloatWindow(Window);
         }
     } else if (StringEquals(Rule->State, "tile")) {
-        if (!AXLibHasFlags(Window, Window_ForceTile)) {
+        if (!WindowHasFlags(Window, Window_ForceTile)) {
             UnfloatWindow(Window);
-            AXLibAddFlags(Window, Window_ForceTile);
+            AddWindowFlags(Window, Window_ForceTile);
 
-            if (!AXLibHasFlags(Window, Window_Minimized)) {
+            if (!WindowHasFlags(Window, Window_Minimized)) {
                 macos_space *Space;
                 bool Success = AXLibActiveSpace(&Space);
                 ASSERT(Success);
 
                 if (AXLibSpaceHasWindow(Space->Id, Window->Id)) {
                     TileWindow(Window);
-                    AXLibAddFlags(Window, Rule_State_Tiled);
+                    AddWindowFlags(Window, Rule_State_Tiled);
                 }
 
                 AXLibDestroySpace(Space);
             }
         }
     } else if (StringEquals(Rule->State, "native-fullscreen")) {
-        if (!AXLibIsWindowFullscreen(Window->Ref)) {
+        if (!IsWindowFullscreen(Window)) {
             AXLibSetWindowFullscreen(Window->Ref, true);
-            AXLibAddFlags(Window, Rule_Desktop_Changed);
+            InvalidateWindowProperties(Window->Id, Window_Property_Fullscreen);
+            AddWindowFlags(Window, Rule_Desktop_Changed);
         }
     } else {
         c_log(C_LOG_LEVEL_WARN, "chunkwm-tiling: window rule - invalid state '%s', ignored..\n", Rule->State);
@@ -87,7 +104,7 @@ internal inline void
 ApplyWindowRuleDesktop(macos_window *Window, window_rule *Rule)
 {
     if (SendWindowToDesktop(Window, Rule->Desktop)) {
-        AXLibAddFlags(Window, Rule_Desktop_Changed);
+        AddWindowFlags(Window, Rule_Desktop_Changed);
         if (Rule->FollowDesktop) {
             FocusDesktop(Rule->Desktop);
             AXLibSetFocusedWindow(Window->Ref);
@@ -100,7 +117,7 @@ internal inline void
 ApplyWindowRuleMonitor(macos_window *Window, window_rule *Rule)
 {
     if (SendWindowToMonitor(Window, Rule->Monitor)) {
-        AXLibAddFlags(Window, Rule_Desktop_Changed);
+        AddWindowFlags(Window, Rule_Desktop_Changed);
         if (Rule->FollowDesktop) {
             FocusMonitor(Rule->Monitor);
             AXLibSetFocusedWindow(Window->Ref);
@@ -124,7 +141,7 @@ ApplyWindowRuleAlpha(macos_window *Window, window_rule *Rule)
     float Alpha;
     if (sscanf(Rule->Alpha, "%f", &Alpha) == 1) {
         ExtendedDockSetWindowAlpha(Window->Id, Alpha);
-        AXLibAddFlags(Window, Rule_Alpha_Changed);
+        AddWindowFlags(Window, Rule_Alpha_Changed);
     }
 }
 
@@ -137,16 +154,17 @@ ApplyWindowRuleGridLayout(macos_window *Window, window_rule *Rule)
 internal inline void
 ApplyWindowRule(macos_window *Window, window_rule *Rule)
 {
-    regex_t Regex;
+    if ((Rule->OwnerLiteral) && (Window->Owner->Name) && (!strstr(Window->Owner->Name, Rule->OwnerLiteral))) return;
+    if ((Rule->NameLiteral) && (Window->Name) && (!strstr(Window->Name, Rule->NameLiteral))) return;
 
     bool Match = true;
     if (Rule->Owner && Window->Owner->Name) {
-        Match = RegexMatchPattern(&Regex, Window->Owner->Name, Rule->Owner);
+        Match = RegexMatchPattern(&Rule->OwnerRegex, Window->Owner->Name);
         if (!Match) return;
     }
 
     if (Rule->Name && Window->Name) {
-        Match &= RegexMatchPattern(&Regex, Window->Name, Rule->Name);
+        Match &= RegexMatchPattern(&Rule->NameRegex, Window->Name);
         if (!Match) return;
     }
 
@@ -161,7 +179,7 @@ ApplyWindowRule(macos_window *Window, window_rule *Rule)
     }
 
     if (Rule->Except && Window->Name) {
-        Match &= !RegexMatchPattern(&Regex, Window->Name, Rule->Except);
+        Match &= !RegexMatchPattern(&Rule->ExceptRegex, Window->Name);
         if (!Match) return;
     }
 
@@ -173,46 +191,56 @@ ApplyWindowRule(macos_window *Window, window_rule *Rule)
     if (Rule->GridLayout) ApplyWindowRuleGridLayout(Window, Rule);
 }
 
-void ApplyRulesForWindow(macos_window *Window)
+/*
+ * NOTE(koekeishiya): The candidates live in the scratch bitset of the index. Rules are
+ * applied from the event handlers, one window at a time, and applying a rule never
+ * applies the rules of another window, so the bitset is not overwritten while we walk it.
+ */
+internal void
+ApplyWindowRuleCandidates(macos_window *Window, bool TitleChanged)
 {
-    for (size_t Index = 0; Index < WindowRules.size(); ++Index) {
-        window_rule *Rule = WindowRules[Index];
-        ApplyWindowRule(Window, Rule);
+    std::vector<uint64_t> &Candidates = FindWindowRuleCandidates(&WindowRuleIndex, Window->Owner->Name,
+                                                                 Window->Name, TitleChanged);
+    for (size_t Word = 0; Word < Candidates.size(); ++Word) {
+        uint64_t Bits = Candidates[Word];
+        while (Bits) {
+            uint32_t Position = (Word << 6) + __builtin_ctzll(Bits);
+            ApplyWindowRule(Window, WindowRules[Position]);
+            Bits &= Bits - 1;
+        }
     }
 }
 
+void ApplyRulesForWindow(macos_window *Window)
+{
+    ApplyWindowRuleCandidates(Window, false);
+}
+
 void ApplyRulesForWindowOnTitleChanged(macos_window *Window)
 {
-    for (size_t Index = 0; Index < WindowRules.size(); ++Index) {
-        window_rule *Rule = WindowRules[Index];
-        if (Rule->Name || Rule->Except) {
-            ApplyWindowRule(Window, Rule);
-        }
-    }
+    ApplyWindowRuleCandidates(Window, true);
 }
 
 internal void
 ApplyRuleToExistingWindows(window_rule *Rule)
 {
-    macos_window_map Windows = CopyWindowCache();
-    for (macos_window_map_it It = Windows.begin(); It != Windows.end(); ++It) {
-        macos_window *Window = It->second;
+    window_snapshot *Snapshot = AcquireWindowSnapshot();
+    for (uint32_t Index = 0; Index < Snapshot->Count; ++Index) {
+        macos_window *Window = Snapshot->Windows[Index];
         ApplyWindowRule(Window, Rule);
     }
-}
-
-void AddWindowRule(window_rule *Rule)
-{
-    window_rule *Result = (window_rule *) malloc(sizeof(window_rule));
-    memcpy(Result, Rule, sizeof(window_rule));
-    WindowRules.push_back(Result);
-    ApplyRuleToExistingWindows(Result);
+    ReleaseWindowSnapshot(Snapshot);
 }
 
 internal void
 FreeWindowRule(window_rule *Rule)
 {
     ASSERT(Rule);
+    if (Rule->OwnerRegexValid)  regfree(&Rule->OwnerRegex);
+    if (Rule->NameRegexValid)   regfree(&Rule->NameRegex);
+    if (Rule->ExceptRegexValid) regfree(&Rule->ExceptRegex);
+    if (Rule->OwnerLiteral)     free(Rule->OwnerLiteral);
+    if (Rule->NameLiteral)      free(Rule->NameLiteral);
     if (Rule->Owner)      free(Rule->Owner);
     if (Rule->Name)       free(Rule->Name);
     if (Rule->Role)       CFRelease(Rule->Role);
@@ -225,6 +253,50 @@ FreeWindowRule(window_rule *Rule)
     free(Rule);
 }
 
+/*
+ * NOTE(koekeishiya): The patterns of a rule are compiled once, here, instead of every
+ * time the rule is tested against a window. A rule with a pattern that does not compile
+ * is rejected, and the reason is written back to the client that sent it.
+ */
+bool AddWindowRule(window_rule *Rule, int SockFD)
+{
+    window_rule *Result = (window_rule *) malloc(sizeof(window_rule));
+    memcpy(Result, Rule, sizeof(window_rule));
+    Result->OwnerRegexValid = false;
+    Result->NameRegexValid = false;
+    Result->ExceptRegexValid = false;
+    Result->OwnerLiteral = NULL;
+    Result->NameLiteral = NULL;
+
+    if ((Result->Owner) &&
+        (!RegexCompilePattern(&Result->OwnerRegex, &Result->OwnerRegexValid, "owner", Result->Owner, SockFD))) {
+        goto err;
+    }
+
+    if ((Result->Name) &&
+        (!RegexCompilePattern(&Result->NameRegex, &Result->NameRegexValid, "name", Result->Name, SockFD))) {
+        goto err;
+    }
+
+    if ((Result->Except) &&
+        (!RegexCompilePattern(&Result->ExceptRegex, &Result->ExceptRegexValid, "except", Result->Except, SockFD))) {
+        goto err;
+    }
+
+    if (Result->Owner) Result->OwnerLiteral = ExtractRequiredLiteral(Result->Owner);
+    if (Result->Name)  Result->NameLiteral = ExtractRequiredLiteral(Result->Name);
+
+    AddWindowRuleToIndex(&WindowRuleIndex, WindowRules.size(), Result->OwnerLiteral,
+                         Result->NameLiteral, Result->Name || Result->Except);
+    WindowRules.push_back(Result);
+    ApplyRuleToExistingWindows(Result);
+    return true;
+
+err:
+    FreeWindowRule(Result);
+    return false;
+}
+
 void FreeWindowRules()
 {
     for (size_t Index = 0; Index < WindowRules.size(); ++Index) {
@@ -233,4 +305,5 @@ void FreeWindowRules()
     }
 
     WindowRules.clear();
+    ClearWindowRuleIndex(&WindowRuleIndex);
 }
@@ -3,6 +3,7 @@
 
 #include <CoreFoundation/CFString.h>
 #include <stdint.h>
+#include <regex.h>
 
 enum window_rule_flags
 {
@@ -24,9 +25,21 @@ struct window_rule
     char *Level;
     char *Alpha;
     char *GridLayout;
+
+    // NOTE(koekeishiya): Compiled from Owner, Name and Except when the rule is added.
+    regex_t OwnerRegex;
+    regex_t NameRegex;
+    regex_t ExceptRegex;
+    bool OwnerRegexValid;
+    bool NameRegexValid;
+    bool ExceptRegexValid;
+
+    // NOTE(koekeishiya): A substring that every match of the Owner / Name pattern contains.
+    char *OwnerLiteral;
+    char *NameLiteral;
 };
 
-void AddWindowRule(window_rule *Rule);
+bool AddWindowRule(window_rule *Rule, int SockFD);
 
 struct macos_window;
 void ApplyRulesForWindow(macos_window *Window);
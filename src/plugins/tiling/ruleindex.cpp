@@ -0,0 +1,225 @@
+#include "ruleindex.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#define internal static
+
+internal inline void
+EndLiteralRun(char *Run, size_t *RunLength, char *Best, size_t *BestLength)
+{
+    if (*RunLength > *BestLength) {
+        memcpy(Best, Run, *RunLength);
+        *BestLength = *RunLength;
+    }
+
+    *RunLength = 0;
+}
+
+/*
+ * NOTE(koekeishiya): Find the longest run of literal characters that every string matched
+ * by the pattern must contain. Only the top level of the pattern is considered; groups,
+ * bracket expressions, anchors and escapes that may have a special meaning end the current
+ * run, and a character followed by a quantifier that allows zero repetitions is skipped.
+ * A pattern with a top-level alternation has no required literal.
+ */
+char *ExtractRequiredLiteral(const char *Pattern)
+{
+    size_t Length = strlen(Pattern);
+    size_t RunLength = 0, BestLength = 0;
+    char *Run = (char *) malloc(Length + 1);
+    char *Best = (char *) malloc(Length + 1);
+    char *Result = NULL;
+    int Depth = 0;
+
+    for (const char *Cursor = Pattern; *Cursor; ++Cursor) {
+        char Char = *Cursor;
+        bool Literal = false;
+
+        if (Char == '\\') {
+            if (!Cursor[1]) break;
+            Char = *++Cursor;
+            Literal = (!isalnum(Char)) && (Char != '<') && (Char != '>') && (Char != '`') && (Char != '\'');
+        } else if (Char == '[') {
+            ++Cursor;
+            if (*Cursor == '^') ++Cursor;
+            if (*Cursor == ']') ++Cursor;
+            while ((*Cursor) && (*Cursor != ']')) {
+                if ((Cursor[0] == '[') && ((Cursor[1] == ':') || (Cursor[1] == '.') || (Cursor[1] == '='))) {
+                    char Delimiter = Cursor[1];
+                    Cursor += 2;
+                    while ((*Cursor) && (!((Cursor[0] == Delimiter) && (Cursor[1] == ']')))) ++Cursor;
+                    if (!*Cursor) break;
+                    ++Cursor;
+                }
+                ++Cursor;
+            }
+            if (!*Cursor) break;
+        } else if (Char == '(') {
+            ++Depth;
+        } else if (Char == ')') {
+            if (Depth) --Depth;
+        } else if (Char == '|') {
+            if (!Depth) goto out;
+        } else if (Char == '{') {
+            while ((*Cursor) && (*Cursor != '}')) ++Cursor;
+            if (!*Cursor) break;
+        } else if ((Char != '*') && (Char != '?') && (Char != '+') &&
+                   (Char != '.') && (Char != '^') && (Char != '$')) {
+            Literal = true;
+        }
+
+        char Next = Cursor[1];
+        if ((!Literal) || (Depth) || (Next == '*') || (Next == '?') || (Next == '{')) {
+            EndLiteralRun(Run, &RunLength, Best, &BestLength);
+            continue;
+        }
+
+        Run[RunLength++] = Char;
+        if (Next == '+') {
+            EndLiteralRun(Run, &RunLength, Best, &BestLength);
+        }
+    }
+
+    EndLiteralRun(Run, &RunLength, Best, &BestLength);
+
+    if (BestLength >= WINDOW_RULE_INDEX_KEY_LENGTH) {
+        Best[BestLength] = '\0';
+        Result = Best;
+        Best = NULL;
+    }
+
+out:
+    free(Best);
+    free(Run);
+    return Result;
+}
+
+internal inline uint32_t
+WindowRuleIndexBucket(const char *Key)
+{
+    uint32_t Trigram = ((uint32_t)(uint8_t) Key[0] << 16) |
+                       ((uint32_t)(uint8_t) Key[1] << 8)  |
+                       ((uint32_t)(uint8_t) Key[2]);
+    return (Trigram * 2654435761u) >> 22;
+}
+
+internal inline void
+SetWindowRuleBit(std::vector<uint64_t> &Bits, uint32_t Rule)
+{
+    Bits[Rule >> 6] |= 1ULL << (Rule & 63);
+}
+
+// NOTE(koekeishiya): Key the rule by the trigram of its literal that is shared by the fewest rules.
+void AddWindowRuleToIndex(window_rule_index *Index, uint32_t Position,
+                          const char *OwnerLiteral, const char *NameLiteral, bool TitleRule)
+{
+    uint32_t Words = (Position >> 6) + 1;
+    if (Index->Unkeyed.size() < Words) {
+        Index->Unkeyed.resize(Words);
+        Index->OwnerKeyed.resize(Words);
+        Index->NameKeyed.resize(Words);
+        Index->TitleRules.resize(Words);
+        Index->AllRules.resize(Words);
+        Index->Scratch.resize(Words);
+    }
+
+    SetWindowRuleBit(Index->AllRules, Position);
+    if (TitleRule) {
+        SetWindowRuleBit(Index->TitleRules, Position);
+    }
+
+    const char *Literal;
+    std::vector<uint32_t> *Buckets;
+    std::vector<uint64_t> *Keyed;
+
+    if (OwnerLiteral) {
+        Literal = OwnerLiteral;
+        Buckets = Index->OwnerBuckets;
+        Keyed = &Index->OwnerKeyed;
+    } else if (NameLiteral) {
+        Literal = NameLiteral;
+        Buckets = Index->NameBuckets;
+        Keyed = &Index->NameKeyed;
+    } else {
+        SetWindowRuleBit(Index->Unkeyed, Position);
+        return;
+    }
+
+    uint32_t Bucket = WindowRuleIndexBucket(Literal);
+    for (const char *Key = Literal + 1; Key[WINDOW_RULE_INDEX_KEY_LENGTH - 1]; ++Key) {
+        uint32_t Candidate = WindowRuleIndexBucket(Key);
+        if (Buckets[Candidate].size() < Buckets[Bucket].size()) {
+            Bucket = Candidate;
+        }
+    }
+
+    Buckets[Bucket].push_back(Position);
+    SetWindowRuleBit(*Keyed, Position);
+}
+
+/*
+ * NOTE(koekeishiya): A filter that is set on a rule is ignored if the window does not have
+ * the corresponding property, so when the owner or title of the window is unknown every
+ * rule keyed by that property is a candidate.
+ */
+internal void
+MarkWindowRuleCandidates(std::vector<uint32_t> *Buckets, std::vector<uint64_t> &Keyed,
+                         const char *String, std::vector<uint64_t> &Candidates)
+{
+    if (!String) {
+        for (size_t Word = 0; Word < Candidates.size(); ++Word) {
+            Candidates[Word] |= Keyed[Word];
+        }
+        return;
+    }
+
+    size_t Length = strlen(String);
+    for (size_t Offset = 0; Offset + WINDOW_RULE_INDEX_KEY_LENGTH <= Length; ++Offset) {
+        std::vector<uint32_t> &Bucket = Buckets[WindowRuleIndexBucket(String + Offset)];
+        for (size_t Index = 0; Index < Bucket.size(); ++Index) {
+            SetWindowRuleBit(Candidates, Bucket[Index]);
+        }
+    }
+}
+
+/*
+ * NOTE(koekeishiya): Returns the candidates in the scratch bitset of the index, which is
+ * overwritten by the next lookup. When the title of a window changed, only the rules
+ * that look at the title are candidates.
+ */
+std::vector<uint64_t> &FindWindowRuleCandidates(window_rule_index *Index, const char *Owner,
+                                                const char *Name, bool TitleChanged)
+{
+    std::vector<uint64_t> &Candidates = Index->Scratch;
+    std::vector<uint64_t> &Filter = TitleChanged ? Index->TitleRules : Index->AllRules;
+
+    for (size_t Word = 0; Word < Candidates.size(); ++Word) {
+        Candidates[Word] = Index->Unkeyed[Word];
+    }
+
+    MarkWindowRuleCandidates(Index->OwnerBuckets, Index->OwnerKeyed, Owner, Candidates);
+    MarkWindowRuleCandidates(Index->NameBuckets, Index->NameKeyed, Name, Candidates);
+
+    for (size_t Word = 0; Word < Candidates.size(); ++Word) {
+        Candidates[Word] &= Filter[Word];
+    }
+
+    return Candidates;
+}
+
+void ClearWindowRuleIndex(window_rule_index *Index)
+{
+    for (size_t Bucket = 0; Bucket < WINDOW_RULE_INDEX_BUCKETS; ++Bucket) {
+        Index->OwnerBuckets[Bucket].clear();
+        Index->NameBuckets[Bucket].clear();
+    }
+
+    Index->Unkeyed.clear();
+    Index->OwnerKeyed.clear();
+    Index->NameKeyed.clear();
+    Index->TitleRules.clear();
+    Index->AllRules.clear();
+    Index->Scratch.clear();
+}
@@ -0,0 +1,42 @@
+#ifndef PLUGIN_RULE_INDEX_H
+#define PLUGIN_RULE_INDEX_H
+
+#include <stdint.h>
+#include <vector>
+
+#define WINDOW_RULE_INDEX_KEY_LENGTH 3
+#define WINDOW_RULE_INDEX_BUCKETS 1024
+
+/*
+ * NOTE(koekeishiya): Rules are keyed by a trigram of the required literal of their owner
+ * pattern, or of their name pattern if the owner pattern has none. To find the rules that
+ * can match a window, we look up every trigram of the owner and the title of the window,
+ * and add the rules that have no key. Hash collisions only add candidates; every candidate
+ * is still evaluated in full. Candidates are marked in a bitset indexed by the position of
+ * the rule, so that rules are still applied in the order they were added.
+ *
+ * The index only sees the literals of a rule, and does not depend on macOS.
+ */
+struct window_rule_index
+{
+    std::vector<uint32_t> OwnerBuckets[WINDOW_RULE_INDEX_BUCKETS];
+    std::vector<uint32_t> NameBuckets[WINDOW_RULE_INDEX_BUCKETS];
+    std::vector<uint64_t> Unkeyed;
+    std::vector<uint64_t> OwnerKeyed;
+    std::vector<uint64_t> NameKeyed;
+    std::vector<uint64_t> TitleRules;
+    std::vector<uint64_t> AllRules;
+
+    // NOTE(koekeishiya): Holds the candidates of the last lookup, so that a lookup does not allocate.
+    std::vector<uint64_t> Scratch;
+};
+
+char *ExtractRequiredLiteral(const char *Pattern);
+
+void AddWindowRuleToIndex(window_rule_index *Index, uint32_t Position,
+                          const char *OwnerLiteral, const char *NameLiteral, bool TitleRule);
+std::vector<uint64_t> &FindWindowRuleCandidates(window_rule_index *Index, const char *Owner,
+                                                const char *Name, bool TitleChanged);
+void ClearWindowRuleIndex(window_rule_index *Index);
+
+#endif
@@ -0,0 +1,175 @@
+#include "table.h"
+
+#include "../../common/misc/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define internal static
+#define WINDOW_TABLE_MIN_CAPACITY 64
+
+internal inline uint32_t
+WindowTableIndexSlot(window_table *Table, uint32_t WindowId)
+{
+    uint32_t Hash = WindowId * 2654435761u;
+    return Hash & (Table->IndexCapacity - 1);
+}
+
+internal void
+WindowTableIndexInsert(window_table *Table, uint32_t WindowId, uint32_t Row)
+{
+    uint32_t Slot = WindowTableIndexSlot(Table, WindowId);
+    while (Table->Index[Slot].WindowId) {
+        if (Table->Index[Slot].WindowId == WindowId) break;
+        Slot = (Slot + 1) & (Table->IndexCapacity - 1);
+    }
+
+    Table->Index[Slot].WindowId = WindowId;
+    Table->Index[Slot].Slot = Row;
+}
+
+internal void
+WindowTableIndexRemove(window_table *Table, uint32_t WindowId)
+{
+    uint32_t Mask = Table->IndexCapacity - 1;
+    uint32_t Slot = WindowTableIndexSlot(Table, WindowId);
+    while (Table->Index[Slot].WindowId != WindowId) {
+        if (!Table->Index[Slot].WindowId) return;
+        Slot = (Slot + 1) & Mask;
+    }
+
+    uint32_t Hole = Slot;
+    for (;;) {
+        Slot = (Slot + 1) & Mask;
+        if (!Table->Index[Slot].WindowId) break;
+
+        uint32_t Home = WindowTableIndexSlot(Table, Table->Index[Slot].WindowId);
+        if (((Slot - Home) & Mask) >= ((Slot - Hole) & Mask)) {
+            Table->Index[Hole] = Table->Index[Slot];
+            Hole = Slot;
+        }
+    }
+
+    Table->Index[Hole].WindowId = 0;
+    Table->Index[Hole].Slot = 0;
+}
+
+/*
+ * NOTE(koekeishiya): The index has twice the capacity of the columns, which keeps the
+ * load factor at or below 1/2. It is rebuilt from the id column whenever the columns grow.
+ */
+internal void
+WindowTableResize(window_table *Table, uint32_t Capacity)
+{
+    Table->Ids = (uint32_t *) realloc(Table->Ids, sizeof(uint32_t) * Capacity);
+    Table->Flags = (uint32_t *) realloc(Table->Flags, sizeof(uint32_t) * Capacity);
+    Table->Levels = (uint32_t *) realloc(Table->Levels, sizeof(uint32_t) * Capacity);
+    Table->Owners = (int32_t *) realloc(Table->Owners, sizeof(int32_t) * Capacity);
+    Table->Windows = (macos_window **) realloc(Table->Windows, sizeof(macos_window *) * Capacity);
+    Table->Capacity = Capacity;
+
+    free(Table->Index);
+    Table->IndexCapacity = Capacity * 2;
+    Table->Index = (window_table_index_entry *) calloc(Table->IndexCapacity, sizeof(window_table_index_entry));
+
+    for (uint32_t Row = 0; Row < Table->Count; ++Row) {
+        WindowTableIndexInsert(Table, Table->Ids[Row], Row);
+    }
+}
+
+void InitWindowTable(window_table *Table)
+{
+    memset(Table, 0, sizeof(window_table));
+}
+
+void ClearWindowTable(window_table *Table)
+{
+    if (Table->Count) {
+        memset(Table->Index, 0, sizeof(window_table_index_entry) * Table->IndexCapacity);
+        Table->Count = 0;
+    }
+}
+
+void FreeWindowTable(window_table *Table)
+{
+    free(Table->Ids);
+    free(Table->Flags);
+    free(Table->Levels);
+    free(Table->Owners);
+    free(Table->Windows);
+    free(Table->Index);
+    InitWindowTable(Table);
+}
+
+int WindowTableSlot(window_table *Table, uint32_t WindowId)
+{
+    if (!Table->Count) return -1;
+
+    uint32_t Slot = WindowTableIndexSlot(Table, WindowId);
+    while (Table->Index[Slot].WindowId) {
+        if (Table->Index[Slot].WindowId == WindowId) {
+            return Table->Index[Slot].Slot;
+        }
+
+        Slot = (Slot + 1) & (Table->IndexCapacity - 1);
+    }
+
+    return -1;
+}
+
+macos_window *WindowTableLookup(window_table *Table, uint32_t WindowId)
+{
+    int Slot = WindowTableSlot(Table, WindowId);
+    return Slot != -1 ? Table->Windows[Slot] : NULL;
+}
+
+// NOTE(koekeishiya): If the window id is already in the table, its row is replaced.
+void WindowTableInsert(window_table *Table, macos_window *Window, uint32_t WindowId, uint32_t Flags, uint32_t Level, int32_t Owner)
+{
+    ASSERT(WindowId != 0);
+
+    int Slot = WindowTableSlot(Table, WindowId);
+    if (Slot == -1) {
+        if (Table->Count == Table->Capacity) {
+            WindowTableResize(Table, Table->Capacity ? Table->Capacity * 2 : WINDOW_TABLE_MIN_CAPACITY);
+        }
+
+        Slot = Table->Count++;
+        WindowTableIndexInsert(Table, WindowId, Slot);
+    }
+
+    Table->Ids[Slot] = WindowId;
+    Table->Flags[Slot] = Flags;
+    Table->Levels[Slot] = Level;
+    Table->Owners[Slot] = Owner;
+    Table->Windows[Slot] = Window;
+}
+
+macos_window *WindowTableRemove(window_table *Table, uint32_t WindowId)
+{
+    int Slot = WindowTableSlot(Table, WindowId);
+    if (Slot == -1) return NULL;
+
+    macos_window *Result = Table->Windows[Slot];
+    WindowTableIndexRemove(Table, WindowId);
+
+    uint32_t Last = --Table->Count;
+    if ((uint32_t) Slot != Last) {
+        Table->Ids[Slot] = Table->Ids[Last];
+        Table->Flags[Slot] = Table->Flags[Last];
+        Table->Levels[Slot] = Table->Levels[Last];
+        Table->Owners[Slot] = Table->Owners[Last];
+        Table->Windows[Slot] = Table->Windows[Last];
+        WindowTableIndexInsert(Table, Table->Ids[Slot], Slot);
+    }
+
+    return Result;
+}
+
+void WindowTableSetFlags(window_table *Table, uint32_t WindowId, uint32_t Flags)
+{
+    int Slot = WindowTableSlot(Table, WindowId);
+    if (Slot != -1) {
+        Table->Flags[Slot] = Flags;
+    }
+}
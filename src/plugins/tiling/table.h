@@ -0,0 +1,52 @@
+#ifndef PLUGIN_TABLE_H
+#define PLUGIN_TABLE_H
+
+#include <stdint.h>
+
+struct macos_window;
+
+/*
+ * NOTE(koekeishiya): Set in the flags column for windows that have a standard role and
+ * subrole, so that a window can be classified without reading the macos_window.
+ */
+#define Window_Table_Standard (1u << 31)
+
+struct window_table_index_entry
+{
+    uint32_t WindowId;
+    uint32_t Slot;
+};
+
+/*
+ * NOTE(koekeishiya): The windows that we track, stored as parallel arrays. Passes that
+ * filter windows only need the id and the flags, and read them from contiguous memory
+ * instead of chasing a pointer to every macos_window. Rows are kept packed; removing a
+ * window moves the last row into its slot. The index maps a window id to its slot using
+ * the same open-addressing scheme as the node_index.
+ */
+struct window_table
+{
+    uint32_t *Ids;
+    uint32_t *Flags;
+    uint32_t *Levels;
+    int32_t *Owners;
+    macos_window **Windows;
+    uint32_t Count;
+    uint32_t Capacity;
+
+    window_table_index_entry *Index;
+    uint32_t IndexCapacity;
+};
+
+void InitWindowTable(window_table *Table);
+void ClearWindowTable(window_table *Table);
+void FreeWindowTable(window_table *Table);
+
+void WindowTableInsert(window_table *Table, macos_window *Window, uint32_t WindowId, uint32_t Flags, uint32_t Level, int32_t Owner);
+macos_window *WindowTableRemove(window_table *Table, uint32_t WindowId);
+void WindowTableSetFlags(window_table *Table, uint32_t WindowId, uint32_t Flags);
+
+int WindowTableSlot(window_table *Table, uint32_t WindowId);
+macos_window *WindowTableLookup(window_table *Table, uint32_t WindowId);
+
+#endif
@@ -1,5 +1,7 @@
 #include "vspace.h"
 #include "node.h"
+#include "layout.h"
+#include "backend.h"
 #include "constants.h"
 #include "misc.h"
 
@@ -8,14 +10,30 @@
 #include "../../common/misc/assert.h"
 #include "../../common/config/cvar.h"
 
+#include <dispatch/dispatch.h>
 #include <stdlib.h>
 #include <pthread.h>
+#include <vector>
 
 #define internal static
 #define local_persist static
 
+#define VIRTUAL_SPACE_CHECKPOINT_DELAY 1.0f
+#define DEFERRED_LAYOUT_MAX_WINDOWS 32
+
 internal virtual_space_map VirtualSpaces;
-internal pthread_mutex_t VirtualSpacesLock;
+internal pthread_rwlock_t VirtualSpacesLock;
+
+/*
+ * NOTE(koekeishiya): The state file that was loaded on startup stays mapped, and every
+ * virtual space that is created looks up its previous state there. Checkpoints are
+ * written by CheckpointTimer, and are only written if the state actually changed.
+ */
+internal space_state_file SpaceStateFile;
+internal layout_buffer LastCheckpoint;
+internal dispatch_queue_t CheckpointQueue;
+internal dispatch_source_t CheckpointTimer;
+internal bool CheckpointPending;
 
 internal virtual_space_mode
 VirtualSpaceModeFromString(char *Value)
@@ -69,13 +87,14 @@ internal virtual_space *
 CreateAndInitVirtualSpace(macos_space *Space)
 {
     virtual_space *VirtualSpace = (virtual_space *) malloc(sizeof(virtual_space));
-    VirtualSpace->Tree = NULL;
-    VirtualSpace->Preselect = NULL;
 
     // TODO(koekeishiya): How do we react if this call fails ??
-    bool Mutex = pthread_mutex_init(&VirtualSpace->Lock, NULL) == 0;
+    bool Mutex = InitVirtualSpace(VirtualSpace, Virtual_Space_Bsp);
     ASSERT(Mutex);
 
+    VirtualSpace->Uuid = CopyCFStringToC(Space->Ref);
+    ASSERT(VirtualSpace->Uuid);
+
     // NOTE(koekeishiya): The monitor arrangement is not necessary here.
     // We are able to address spaces using mission-control indexing.
     unsigned DesktopId = 1;
@@ -88,94 +107,307 @@ CreateAndInitVirtualSpace(macos_space *Space)
     VirtualSpace->_Offset = Config.Offset;
     VirtualSpace->Offset = &VirtualSpace->_Offset;
 
+    // NOTE(koekeishiya): The tree of a restored space is built once its windows are tiled.
+    VirtualSpace->RestoreState = FindSpaceState(&SpaceStateFile, Space->Id, VirtualSpace->Uuid);
+    if (VirtualSpace->RestoreState) {
+        VirtualSpace->Mode = (virtual_space_mode) VirtualSpace->RestoreState->Mode;
+        VirtualSpace->_Offset = VirtualSpace->RestoreState->Offset;
+        VirtualSpace->Offset = VirtualSpace->RestoreState->HasOffset ? &VirtualSpace->_Offset : NULL;
+    }
+
     return VirtualSpace;
 }
 
-bool ShouldDeserializeVirtualSpace(virtual_space *VirtualSpace)
+internal virtual_space *
+FindVirtualSpace(int SpaceId)
 {
-    bool Result = ((VirtualSpace->Mode == Virtual_Space_Bsp) &&
-                   (VirtualSpace->TreeLayout) &&
-                   (FileExists(VirtualSpace->TreeLayout)));
-    return Result;
+    virtual_space_map_it It = VirtualSpaces.find(SpaceId);
+    return It != VirtualSpaces.end() ? It->second : NULL;
 }
 
-bool VirtualSpaceHasFlags(virtual_space *VirtualSpace, uint32_t Flag)
+/*
+ * NOTE(koekeishiya): If the requested space does not exist, we create it.
+ *
+ * A space is only created once, but looked up for every event and command, so
+ * the lookup only takes the registry lock for reading. The lock is taken for
+ * writing if we have to create the space, in which case we have to look again,
+ * because another thread may have created it in the meantime. The lock of the
+ * virtual space itself is taken after the registry lock has been released.
+ */
+virtual_space *AcquireVirtualSpace(macos_space *Space)
 {
-    bool Result = ((VirtualSpace->Flags & Flag) != 0);
-    return Result;
-}
+    virtual_space *VirtualSpace;
 
-void VirtualSpaceAddFlags(virtual_space *VirtualSpace, uint32_t Flag)
-{
-    VirtualSpace->Flags |= Flag;
+    pthread_rwlock_rdlock(&VirtualSpacesLock);
+    VirtualSpace = FindVirtualSpace(Space->Id);
+    pthread_rwlock_unlock(&VirtualSpacesLock);
+
+    if (!VirtualSpace) {
+        pthread_rwlock_wrlock(&VirtualSpacesLock);
+        VirtualSpace = FindVirtualSpace(Space->Id);
+        if (!VirtualSpace) {
+            VirtualSpace = CreateAndInitVirtualSpace(Space);
+            VirtualSpaces[Space->Id] = VirtualSpace;
+        }
+        pthread_rwlock_unlock(&VirtualSpacesLock);
+    }
+
+    pthread_mutex_lock(&VirtualSpace->Lock);
+    return VirtualSpace;
 }
 
-void VirtualSpaceClearFlags(virtual_space *VirtualSpace, uint32_t Flag)
+internal bool
+IsSpaceStateLive(std::vector<std::pair<int, virtual_space *> > &Spaces, space_state *State)
 {
-    VirtualSpace->Flags &= ~Flag;
+    for (size_t Index = 0; Index < Spaces.size(); ++Index) {
+        if (Spaces[Index].first == State->SpaceId) {
+            return true;
+        }
+    }
+
+    return false;
 }
 
-// NOTE(koekeishiya): If the requested space does not exist, we create it.
-virtual_space *AcquireVirtualSpace(macos_space *Space)
+/*
+ * NOTE(koekeishiya): Every virtual space is serialized while holding only its own lock.
+ * The registry lock is released before that, because a thread that holds the lock of a
+ * virtual space may be waiting for the registry lock.
+ *
+ * Only a virtual space that has been rebuilt replaces its record in the state file. A space
+ * that still has a pending RestoreState, and a space that we have not created since we were
+ * loaded, keep the record of the state file that was loaded on startup. Otherwise the first
+ * checkpoint would discard the layouts of every desktop that has not been visited yet.
+ */
+internal void
+WriteVirtualSpaceCheckpoint(void *Unused)
 {
-    virtual_space *VirtualSpace;
+    __sync_lock_release(&CheckpointPending);
 
-    char *SpaceCRef = CopyCFStringToC(Space->Ref);
-    ASSERT(SpaceCRef);
+    char *Absolutepath = CVarStringValue(CVAR_DESKTOP_STATE_FILE);
+    if (!Absolutepath || !*Absolutepath) {
+        return;
+    }
 
-    pthread_mutex_lock(&VirtualSpacesLock);
-    virtual_space_map_it It = VirtualSpaces.find(SpaceCRef);
-    if (It != VirtualSpaces.end()) {
-        VirtualSpace = It->second;
-        free(SpaceCRef);
-    } else {
-        VirtualSpace = CreateAndInitVirtualSpace(Space);
-        VirtualSpaces[SpaceCRef] = VirtualSpace;
+    std::vector<std::pair<int, virtual_space *> > Spaces;
+    pthread_rwlock_rdlock(&VirtualSpacesLock);
+    Spaces.assign(VirtualSpaces.begin(), VirtualSpaces.end());
+    pthread_rwlock_unlock(&VirtualSpacesLock);
+
+    layout_buffer Buffer;
+    BeginSpaceStateBuffer(&Buffer);
+
+    for (size_t Index = 0; Index < Spaces.size(); ++Index) {
+        virtual_space *VirtualSpace = Spaces[Index].second;
+        pthread_mutex_lock(&VirtualSpace->Lock);
+        if (VirtualSpace->RestoreState) {
+            CopySpaceState(&Buffer, VirtualSpace->RestoreState);
+        } else {
+            SerializeSpaceState(&Buffer, Spaces[Index].first, VirtualSpace);
+        }
+        pthread_mutex_unlock(&VirtualSpace->Lock);
     }
-    pthread_mutex_unlock(&VirtualSpacesLock);
 
-    pthread_mutex_lock(&VirtualSpace->Lock);
-    return VirtualSpace;
+    for (space_state *State = NextSpaceState(&SpaceStateFile, NULL);
+         State != NULL;
+         State = NextSpaceState(&SpaceStateFile, State)) {
+        if (!IsSpaceStateLive(Spaces, State)) {
+            CopySpaceState(&Buffer, State);
+        }
+    }
+
+    if ((Buffer.Size == LastCheckpoint.Size) &&
+        (memcmp(Buffer.Data, LastCheckpoint.Data, Buffer.Size) == 0)) {
+        free(Buffer.Data);
+        return;
+    }
+
+    if (!WriteSpaceStateFile(&Buffer, Absolutepath)) {
+        c_log(C_LOG_LEVEL_WARN, "chunkwm-tiling: failed to write state file '%s'\n", Absolutepath);
+    }
+
+    free(LastCheckpoint.Data);
+    LastCheckpoint = Buffer;
+}
+
+// NOTE(koekeishiya): Changes that happen before the timer fires are written in the same checkpoint.
+internal void
+ScheduleVirtualSpaceCheckpoint()
+{
+    if (!__sync_lock_test_and_set(&CheckpointPending, true)) {
+        uint64_t Delay = VIRTUAL_SPACE_CHECKPOINT_DELAY * NSEC_PER_SEC;
+        dispatch_source_set_timer(CheckpointTimer, dispatch_time(DISPATCH_TIME_NOW, Delay),
+                                  DISPATCH_TIME_FOREVER, Delay / 10);
+    }
 }
 
+/*
+ * NOTE(koekeishiya): Any change to a virtual space is made while holding its lock, so a
+ * checkpoint is scheduled when the lock is released. Releasing a virtual space that did
+ * not change is cheap, because the checkpoint is skipped if the state is unchanged.
+ */
 void ReleaseVirtualSpace(virtual_space *VirtualSpace)
 {
     pthread_mutex_unlock(&VirtualSpace->Lock);
+    ScheduleVirtualSpaceCheckpoint();
 }
 
 bool BeginVirtualSpaces()
 {
-    return pthread_mutex_init(&VirtualSpacesLock, NULL) == 0;
+    if (pthread_rwlock_init(&VirtualSpacesLock, NULL) != 0) {
+        return false;
+    }
+
+    char *Absolutepath = CVarStringValue(CVAR_DESKTOP_STATE_FILE);
+    if (Absolutepath && *Absolutepath) {
+        BeginSpaceStateFile(Absolutepath, &SpaceStateFile);
+    }
+
+    CheckpointQueue = dispatch_queue_create("chunkwm-tiling.checkpoint", DISPATCH_QUEUE_SERIAL);
+    CheckpointTimer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, CheckpointQueue);
+    dispatch_source_set_event_handler_f(CheckpointTimer, &WriteVirtualSpaceCheckpoint);
+    dispatch_source_set_timer(CheckpointTimer, DISPATCH_TIME_FOREVER, DISPATCH_TIME_FOREVER, 0);
+    dispatch_resume(CheckpointTimer);
+
+    return true;
 }
 
 void EndVirtualSpaces()
 {
-    for (virtual_space_map_it It = VirtualSpaces.begin(); It != VirtualSpaces.end(); ++It) {
-        virtual_space *VirtualSpace = It->second;
+    // NOTE(koekeishiya): Wait for a checkpoint in progress, and write the final state ourselves.
+    dispatch_source_cancel(CheckpointTimer);
+    dispatch_sync_f(CheckpointQueue, NULL, &WriteVirtualSpaceCheckpoint);
+    dispatch_release(CheckpointTimer);
+    dispatch_release(CheckpointQueue);
 
-        if (VirtualSpace->Tree) {
-            FreeNodeTree(VirtualSpace->Tree, VirtualSpace->Mode);
-        }
+    EndSpaceStateFile(&SpaceStateFile);
+    free(LastCheckpoint.Data);
+    memset(&LastCheckpoint, 0, sizeof(layout_buffer));
 
-        pthread_mutex_destroy(&VirtualSpace->Lock);
+    for (virtual_space_map_it It = VirtualSpaces.begin(); It != VirtualSpaces.end(); ++It) {
+        virtual_space *VirtualSpace = It->second;
+        FreeVirtualSpace(VirtualSpace);
         free(VirtualSpace);
-        free((char *) It->first);
     }
 
     VirtualSpaces.clear();
-    pthread_mutex_destroy(&VirtualSpacesLock);
+    pthread_rwlock_destroy(&VirtualSpacesLock);
 }
 
 void VirtualSpaceRecreateRegions(macos_space *Space, virtual_space *VirtualSpace)
 {
-    CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
-    CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
-    ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode, false);
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        CreateMonocleRegion(&VirtualSpace->Monocle, Space, VirtualSpace);
+        ApplyMonocleRegion(&VirtualSpace->Monocle, false);
+    } else {
+        CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
+        CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
+        ApplyNodeRegion(VirtualSpace->Tree, VirtualSpace->Mode, false);
+    }
     VirtualSpaceClearFlags(VirtualSpace, Virtual_Space_Require_Resize);
 }
 
 void VirtualSpaceUpdateRegions(virtual_space *VirtualSpace)
 {
-    ApplyNodeRegionWithPotentialZoom(VirtualSpace->Tree, VirtualSpace);
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        ApplyMonocleRegion(&VirtualSpace->Monocle, true);
+    } else {
+        ApplyNodeRegionWithPotentialZoom(VirtualSpace->Tree, VirtualSpace);
+    }
     VirtualSpaceClearFlags(VirtualSpace, Virtual_Space_Require_Region_Update);
 }
+
+void VirtualSpaceDeferResize(virtual_space *VirtualSpace)
+{
+    VirtualSpaceAddFlags(VirtualSpace, Virtual_Space_Require_Resize);
+    VirtualSpaceDeferRegionUpdate(VirtualSpace);
+}
+
+void VirtualSpaceDeferRegionUpdate(virtual_space *VirtualSpace)
+{
+    VirtualSpaceAddFlags(VirtualSpace, Virtual_Space_Require_Region_Update);
+    VirtualSpace->Deferred.Count = 0;
+}
+
+/*
+ * NOTE(koekeishiya): A window that is recorded more than once is only applied once. If
+ * enough windows are recorded, the whole desktop is applied instead.
+ */
+void VirtualSpaceDeferWindowUpdate(virtual_space *VirtualSpace, uint32_t WindowId)
+{
+    deferred_layout *Deferred = &VirtualSpace->Deferred;
+
+    if (VirtualSpaceHasFlags(VirtualSpace, Virtual_Space_Require_Region_Update)) {
+        return;
+    }
+
+    for (uint32_t Index = 0; Index < Deferred->Count; ++Index) {
+        if (Deferred->Windows[Index] == WindowId) {
+            return;
+        }
+    }
+
+    if (Deferred->Count == DEFERRED_LAYOUT_MAX_WINDOWS) {
+        VirtualSpaceDeferRegionUpdate(VirtualSpace);
+        return;
+    }
+
+    if (Deferred->Count == Deferred->Capacity) {
+        Deferred->Capacity = Deferred->Capacity ? Deferred->Capacity * 2 : 4;
+        Deferred->Windows = (uint32_t *) realloc(Deferred->Windows, sizeof(uint32_t) * Deferred->Capacity);
+    }
+
+    Deferred->Windows[Deferred->Count++] = WindowId;
+}
+
+/*
+ * NOTE(koekeishiya): Recreates the regions of a desktop that was resized while it was not
+ * visible, without applying them. The caller may change the tree before all deferred work
+ * is applied by VirtualSpaceEndDeferredLayout.
+ */
+void VirtualSpaceBeginDeferredLayout(macos_space *Space, virtual_space *VirtualSpace)
+{
+    if (!VirtualSpaceHasFlags(VirtualSpace, Virtual_Space_Require_Resize)) {
+        return;
+    }
+
+    if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+        CreateMonocleRegion(&VirtualSpace->Monocle, Space, VirtualSpace);
+    } else if (VirtualSpace->Tree) {
+        CreateNodeRegion(VirtualSpace->Tree, Region_Full, Space, VirtualSpace);
+        CreateNodeRegionRecursive(VirtualSpace->Tree, false, Space, VirtualSpace);
+    }
+
+    VirtualSpaceClearFlags(VirtualSpace, Virtual_Space_Require_Resize);
+}
+
+void VirtualSpaceEndDeferredLayout(virtual_space *VirtualSpace)
+{
+    deferred_layout *Deferred = &VirtualSpace->Deferred;
+
+    if (!VirtualSpaceHasWindows(VirtualSpace)) {
+        VirtualSpaceClearFlags(VirtualSpace, Virtual_Space_Require_Region_Update);
+    } else if (VirtualSpaceHasFlags(VirtualSpace, Virtual_Space_Require_Region_Update)) {
+        VirtualSpaceUpdateRegions(VirtualSpace);
+    } else if (Deferred->Count > 0) {
+        window_frame_list Frames;
+        BeginWindowFrameList(&Frames);
+
+        for (uint32_t Index = 0; Index < Deferred->Count; ++Index) {
+            uint32_t WindowId = Deferred->Windows[Index];
+            if (VirtualSpace->Mode == Virtual_Space_Monocle) {
+                if (MonocleWindowIndex(&VirtualSpace->Monocle, WindowId) != -1) {
+                    WindowFrameListAdd(&Frames, WindowId, VirtualSpace->Monocle.Region, true);
+                }
+            } else {
+                node *Node = GetNodeWithId(VirtualSpace, WindowId);
+                if (Node) {
+                    ApplyNodeRegionWithPotentialZoom(Node, VirtualSpace, false, &Frames);
+                }
+            }
+        }
+
+        CommitWindowFrameList(&Frames);
+    }
+
+    Deferred->Count = 0;
+}
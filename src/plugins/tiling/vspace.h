@@ -2,11 +2,16 @@
 #define PLUGIN_VSPACE_H
 
 #include "region.h"
+#include "pool.h"
+#include "index.h"
+#include "history.h"
+#include "monocle.h"
 
 #include "../../common/misc/string.h"
 #include <stdint.h>
 #include <pthread.h>
 #include <map>
+#include <unordered_map>
 
 static char *virtual_space_mode_str[] =
 {
@@ -34,7 +39,22 @@ enum virtual_space_flags
     Virtual_Space_Require_Region_Update = 1 << 1,
 };
 
+/*
+ * NOTE(koekeishiya): The windows of a desktop that is not visible can not be moved, so
+ * layout work for such a desktop is recorded instead, and performed in a single pass once
+ * the desktop is activated. Require_Resize means that the regions have to be recreated,
+ * and Require_Region_Update that every window has to be applied. Otherwise, only the
+ * windows in this list are applied.
+ */
+struct deferred_layout
+{
+    uint32_t *Windows;
+    uint32_t Count;
+    uint32_t Capacity;
+};
+
 struct preselect_node;
+struct space_state;
 struct virtual_space
 {
     virtual_space_mode Mode;
@@ -42,27 +62,72 @@ struct virtual_space
 
     region_offset *Offset;
     char *TreeLayout;
+    char *Uuid;
     node *Tree;
     uint32_t Flags;
+    uint32_t AdjacencyGeneration;
     preselect_node *Preselect;
+    node_pool NodePool;
+    node_index NodeIndex;
+    layout_history History;
+    monocle_list Monocle;
+    deferred_layout Deferred;
+    space_state *RestoreState;
 
     pthread_mutex_t Lock;
 };
 
-typedef std::map<const char *, virtual_space *, string_comparator> virtual_space_map;
+inline bool VirtualSpaceHasFlags(virtual_space *VirtualSpace, uint32_t Flag)
+{
+    bool Result = ((VirtualSpace->Flags & Flag) != 0);
+    return Result;
+}
+
+inline void VirtualSpaceAddFlags(virtual_space *VirtualSpace, uint32_t Flag)
+{
+    VirtualSpace->Flags |= Flag;
+}
+
+inline void VirtualSpaceClearFlags(virtual_space *VirtualSpace, uint32_t Flag)
+{
+    VirtualSpace->Flags &= ~Flag;
+}
+
+// NOTE(koekeishiya): Bsp desktops keep their windows in Tree, monocle desktops in Monocle.
+inline bool VirtualSpaceHasWindows(virtual_space *VirtualSpace)
+{
+    bool Result = VirtualSpace->Mode == Virtual_Space_Monocle
+                ? VirtualSpace->Monocle.Count > 0
+                : VirtualSpace->Tree != NULL;
+    return Result;
+}
+
+/*
+ * NOTE(koekeishiya): Virtual spaces are looked up by the CGSSpaceID of the space, which
+ * does not require us to copy the uuid of the space out of its CFStringRef. The uuid is
+ * copied once when the virtual space is created, so that a checkpoint can identify the
+ * space without going back to macOS.
+ */
+typedef std::unordered_map<int, virtual_space *> virtual_space_map;
 typedef virtual_space_map::iterator virtual_space_map_it;
 
-struct macos_space;
+bool InitVirtualSpace(virtual_space *VirtualSpace, virtual_space_mode Mode);
+void FreeVirtualSpace(virtual_space *VirtualSpace);
 bool ShouldDeserializeVirtualSpace(virtual_space *VirtualSpace);
-bool VirtualSpaceHasFlags(virtual_space *VirtualSpace, uint32_t Flag);
-void VirtualSpaceAddFlags(virtual_space *VirtualSpace, uint32_t Flag);
-void VirtualSpaceClearFlags(virtual_space *VirtualSpace, uint32_t Flag);
+
+struct macos_space;
 virtual_space *AcquireVirtualSpace(macos_space *Space);
 void ReleaseVirtualSpace(virtual_space *VirtualSpace);
 
 void VirtualSpaceRecreateRegions(macos_space *Space, virtual_space *VirtualSpace);
 void VirtualSpaceUpdateRegions(virtual_space *VirtualSpace);
 
+void VirtualSpaceDeferResize(virtual_space *VirtualSpace);
+void VirtualSpaceDeferRegionUpdate(virtual_space *VirtualSpace);
+void VirtualSpaceDeferWindowUpdate(virtual_space *VirtualSpace, uint32_t WindowId);
+void VirtualSpaceBeginDeferredLayout(macos_space *Space, virtual_space *VirtualSpace);
+void VirtualSpaceEndDeferredLayout(virtual_space *VirtualSpace);
+
 bool BeginVirtualSpaces();
 void EndVirtualSpaces();
 
@@ -0,0 +1,56 @@
+#include "vspace.h"
+#include "node.h"
+#include "misc.h"
+
+#include "../../common/misc/assert.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+/*
+ * NOTE(koekeishiya): The parts of a virtual space that do not depend on macOS, shared by
+ * the plugin and the headless host. The plugin registers its virtual spaces by the space
+ * they belong to, and applies the desktop config and the saved state in vspace.cpp.
+ */
+bool InitVirtualSpace(virtual_space *VirtualSpace, virtual_space_mode Mode)
+{
+    memset(VirtualSpace, 0, sizeof(virtual_space));
+    VirtualSpace->Mode = Mode;
+    VirtualSpace->AdjacencyGeneration = 1;
+    InitNodePool(&VirtualSpace->NodePool);
+    InitNodeIndex(&VirtualSpace->NodeIndex);
+    InitLayoutHistory(&VirtualSpace->History);
+    InitMonocleList(&VirtualSpace->Monocle);
+
+    bool Result = pthread_mutex_init(&VirtualSpace->Lock, NULL) == 0;
+    return Result;
+}
+
+// NOTE(koekeishiya): Does not free the virtual_space itself.
+void FreeVirtualSpace(virtual_space *VirtualSpace)
+{
+    if (VirtualSpace->Preselect) {
+        FreePreselectNode(VirtualSpace);
+    }
+
+    FreeNodePool(&VirtualSpace->NodePool);
+    FreeNodeIndex(&VirtualSpace->NodeIndex);
+    FreeLayoutHistory(&VirtualSpace->History);
+    FreeMonocleList(&VirtualSpace->Monocle);
+    free(VirtualSpace->Deferred.Windows);
+    pthread_mutex_destroy(&VirtualSpace->Lock);
+    free(VirtualSpace->Uuid);
+
+    VirtualSpace->Tree = NULL;
+    VirtualSpace->Deferred.Windows = NULL;
+    VirtualSpace->Uuid = NULL;
+}
+
+bool ShouldDeserializeVirtualSpace(virtual_space *VirtualSpace)
+{
+    bool Result = ((VirtualSpace->Mode == Virtual_Space_Bsp) &&
+                   (VirtualSpace->TreeLayout) &&
+                   (FileExists(VirtualSpace->TreeLayout)));
+    return Result;
+}